@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "bit_swizzle.h"
+# include  <cstring>
+# include  <cassert>
+
+# if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define HAVE_X86_SIMD 1
+#  include  <immintrin.h>
+# endif
+
+/*
+ * Table that maps a byte to its bit reversal.
+ */
+struct reverse_table_t {
+      reverse_table_t()
+      {
+	    for (int idx = 0 ; idx < 256 ; idx += 1) {
+		  uint8_t val = 0;
+		  for (int bit = 0 ; bit < 8 ; bit += 1) {
+			if (idx & (1 << bit))
+			      val |= 0x80 >> bit;
+		  }
+		  rev[idx] = val;
+	    }
+      }
+      uint8_t rev[256];
+};
+static const reverse_table_t reverse_table;
+
+static inline bool is_blank8(const uint8_t*src)
+{
+      uint64_t word;
+      memcpy(&word, src, 8);
+      return word == UINT64_C(0xffffffffffffffff);
+}
+
+/*
+ * Scalar versions. These also finish the tails that the SIMD versions
+ * leave behind, so must handle any length.
+ */
+static void swizzle_x8_scalar(uint8_t*dst, const uint8_t*src, size_t len)
+{
+      const uint8_t*rev = reverse_table.rev;
+      size_t idx = 0;
+      while (idx < len) {
+	    if (idx+8 <= len && is_blank8(src+idx)) {
+		  if (dst != src)
+			memset(dst+idx, 0xff, 8);
+		  idx += 8;
+		  continue;
+	    }
+
+	    size_t end = idx+8 <= len? idx+8 : len;
+	    for ( ; idx < end ; idx += 1)
+		  dst[idx] = rev[src[idx]];
+      }
+}
+
+static void swizzle_x16_scalar(uint8_t*dst, const uint8_t*src, size_t len)
+{
+      const uint8_t*rev = reverse_table.rev;
+      size_t idx = 0;
+      while (idx < len) {
+	    if (idx+8 <= len && is_blank8(src+idx)) {
+		  if (dst != src)
+			memset(dst+idx, 0xff, 8);
+		  idx += 8;
+		  continue;
+	    }
+
+	    size_t end = idx+8 <= len? idx+8 : len;
+	    for ( ; idx < end ; idx += 2) {
+		  uint8_t val0 = rev[src[idx+1]];
+		  uint8_t val1 = rev[src[idx+0]];
+		  dst[idx+0] = val0;
+		  dst[idx+1] = val1;
+	    }
+      }
+}
+
+# ifdef HAVE_X86_SIMD
+/*
+ * Reverse the bits of each byte with two pshufb nibble lookups: the
+ * reversed low nibble becomes the high nibble, and the reversed high
+ * nibble becomes the low nibble. For the x16 layout, a third pshufb
+ * swaps the bytes of each pair first.
+ */
+__attribute__((target("ssse3")))
+static void swizzle_ssse3(uint8_t*dst, const uint8_t*src, size_t len, bool swap_pairs)
+{
+      const __m128i rev_lo = _mm_setr_epi8(0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+					   0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, (char)0xf0);
+      const __m128i rev_hi = _mm_setr_epi8(0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+					   0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f);
+      const __m128i pairs = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+					  9, 8, 11, 10, 13, 12, 15, 14);
+      const __m128i mask = _mm_set1_epi8(0x0f);
+      const __m128i ones = _mm_set1_epi8(-1);
+
+      size_t idx = 0;
+      for ( ; idx+16 <= len ; idx += 16) {
+	    __m128i val = _mm_loadu_si128((const __m128i*)(src+idx));
+	    if (_mm_movemask_epi8(_mm_cmpeq_epi8(val, ones)) == 0xffff) {
+		  if (dst != src)
+			_mm_storeu_si128((__m128i*)(dst+idx), val);
+		  continue;
+	    }
+	    if (swap_pairs)
+		  val = _mm_shuffle_epi8(val, pairs);
+	    __m128i lo = _mm_and_si128(val, mask);
+	    __m128i hi = _mm_and_si128(_mm_srli_epi16(val, 4), mask);
+	    val = _mm_or_si128(_mm_shuffle_epi8(rev_lo, lo), _mm_shuffle_epi8(rev_hi, hi));
+	    _mm_storeu_si128((__m128i*)(dst+idx), val);
+      }
+
+      if (swap_pairs)
+	    swizzle_x16_scalar(dst+idx, src+idx, len-idx);
+      else
+	    swizzle_x8_scalar(dst+idx, src+idx, len-idx);
+}
+
+/*
+ * AVX2 version, 32 bytes at a time. The pshufb lookups work within
+ * 128bit lanes, which is fine because the tables and the pair swap
+ * are the same in both lanes.
+ */
+__attribute__((target("avx2")))
+static void swizzle_avx2(uint8_t*dst, const uint8_t*src, size_t len, bool swap_pairs)
+{
+      const __m256i rev_lo = _mm256_setr_epi8(0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+					      0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, (char)0xf0,
+					      0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
+					      0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, (char)0xf0);
+      const __m256i rev_hi = _mm256_setr_epi8(0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+					      0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f,
+					      0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e,
+					      0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f);
+      const __m256i pairs = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+					     9, 8, 11, 10, 13, 12, 15, 14,
+					     1, 0, 3, 2, 5, 4, 7, 6,
+					     9, 8, 11, 10, 13, 12, 15, 14);
+      const __m256i mask = _mm256_set1_epi8(0x0f);
+      const __m256i ones = _mm256_set1_epi8(-1);
+
+      size_t idx = 0;
+      for ( ; idx+32 <= len ; idx += 32) {
+	    __m256i val = _mm256_loadu_si256((const __m256i*)(src+idx));
+	    if (_mm256_testc_si256(val, ones)) {
+		  if (dst != src)
+			_mm256_storeu_si256((__m256i*)(dst+idx), val);
+		  continue;
+	    }
+	    if (swap_pairs)
+		  val = _mm256_shuffle_epi8(val, pairs);
+	    __m256i lo = _mm256_and_si256(val, mask);
+	    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(val, 4), mask);
+	    val = _mm256_or_si256(_mm256_shuffle_epi8(rev_lo, lo), _mm256_shuffle_epi8(rev_hi, hi));
+	    _mm256_storeu_si256((__m256i*)(dst+idx), val);
+      }
+
+      if (swap_pairs)
+	    swizzle_x16_scalar(dst+idx, src+idx, len-idx);
+      else
+	    swizzle_x8_scalar(dst+idx, src+idx, len-idx);
+}
+# endif
+
+typedef void (*swizzle_fun_t)(uint8_t*dst, const uint8_t*src, size_t len, bool swap_pairs);
+
+static void swizzle_scalar(uint8_t*dst, const uint8_t*src, size_t len, bool swap_pairs)
+{
+      if (swap_pairs)
+	    swizzle_x16_scalar(dst, src, len);
+      else
+	    swizzle_x8_scalar(dst, src, len);
+}
+
+/*
+ * Pick the best version for the processor that we are running on.
+ */
+static swizzle_fun_t choose_swizzle(void)
+{
+# ifdef HAVE_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+	    return swizzle_avx2;
+      if (__builtin_cpu_supports("ssse3"))
+	    return swizzle_ssse3;
+# endif
+      return swizzle_scalar;
+}
+static const swizzle_fun_t swizzle_fun = choose_swizzle();
+
+void bit_swizzle(uint8_t*dst, const uint8_t*src, size_t len, swizzle_t layout)
+{
+      switch (layout) {
+	  case SWIZZLE_NONE:
+	    if (dst != src)
+		  memmove(dst, src, len);
+	    break;
+	  case SWIZZLE_X8:
+	    swizzle_fun(dst, src, len, false);
+	    break;
+	  case SWIZZLE_X16:
+	    assert(len % 2 == 0);
+	    swizzle_fun(dst, src, len, true);
+	    break;
+      }
+}
+
+void bit_swizzle_dual_qspi(uint8_t*primary, uint8_t*secondary,
+			   const uint8_t*src, size_t len)
+{
+      assert(len % 2 == 0);
+
+      for (size_t idx = 0 ; idx < len ; idx += 2) {
+	    uint8_t val0 = src[idx+0];
+	    uint8_t val1 = src[idx+1];
+	    primary[idx/2]   = ((val0 & 0x0f) << 4) | (val1 & 0x0f);
+	    secondary[idx/2] = (val0 & 0xf0) | (val1 >> 4);
+      }
+}
@@ -0,0 +1,59 @@
+#ifndef __bit_swizzle_H
+#define __bit_swizzle_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * The byte layouts that a configuration stream can be stored in,
+ * depending on the width of the configuration bus.
+ *
+ *   SWIZZLE_NONE -- Bytes are stored as they are in the stream.
+ *   SWIZZLE_X8   -- Bits are reversed within each byte.
+ *   SWIZZLE_X16  -- Bits are reversed within each byte, and pairs of
+ *                   bytes are swapped. This is the BPI16 layout.
+ */
+enum swizzle_t {
+      SWIZZLE_NONE = 0,
+      SWIZZLE_X8,
+      SWIZZLE_X16
+};
+
+/*
+ * Convert len bytes from src into the layout, into dst. The dst and
+ * src may be the same buffer. For SWIZZLE_X16 the len must be even.
+ * Runs of 0xff (erased flash) are the same in all layouts, and are
+ * passed through without being converted.
+ */
+extern void bit_swizzle(uint8_t*dst, const uint8_t*src, size_t len, swizzle_t layout);
+
+/*
+ * Split the stream for dual quad-SPI (x8 SPI), where two flash parts
+ * each supply one nibble of every byte. The primary part holds the
+ * low nibbles (D[3:0]) and the secondary the high nibbles (D[7:4]),
+ * packed two to a byte with the earlier nibble in the high half. The
+ * len must be even, and each destination gets len/2 bytes.
+ */
+extern void bit_swizzle_dual_qspi(uint8_t*primary, uint8_t*secondary,
+				  const uint8_t*src, size_t len);
+
+#endif
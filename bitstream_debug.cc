@@ -18,8 +18,81 @@
  *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+/*
+ * Print the configuration packets of a bit stream, for debugging.
+ *
+ * COMMAND LINE FLAGS:
+ *   --input=<path>   The .bit file (or .mcs file) to read.
+ *
+ *   --summary
+ *                    Instead of listing the packets, print how many
+ *                    times each register is written and read, how
+ *                    many times each command is issued, how many
+ *                    bytes of FDRI data there are, and how many CRC
+ *                    checks and resets there are.
+ *
+ *   --index=<path>
+ *                    Instead of listing the packets, write the packet
+ *                    index of the stream to the file. If the path ends
+ *                    in .json, the index is written as JSON, and
+ *                    otherwise in the binary format that
+ *                    packet_index::read() loads. The offsets in the
+ *                    index count from the first byte after the 0xff
+ *                    pad, which is the payload() of a bit_file_view.
+ *
+ *   --index-in=<path>
+ *                    Load the packet index for --summary and --frames
+ *                    from a binary index file that --index wrote,
+ *                    instead of walking the stream again. The file
+ *                    must be the index of this same stream.
+ *
+ *   --frames
+ *                    Instead of listing the packets, split the FDRI
+ *                    data into frames and print where they go: the
+ *                    decoded frame address of each FDRI write, the
+ *                    all-zero and duplicate frames, the frames that are
+ *                    copied most, and the frames and bytes for each
+ *                    column. The frames of a write are counted against
+ *                    the column in the FAR of the write, since the
+ *                    device geometry is not known here.
+ *
+ *   --diff=<a>,<b>
+ *                    Instead of reading an --input, compare the streams
+ *                    in two files packet by packet. Print the register
+ *                    writes that change, or that are only in one of the
+ *                    streams, and the ranges of frames whose hashes
+ *                    differ. The exit code is 0 if the streams are the
+ *                    same, and 1 if they differ.
+ *
+ *   --family=7series
+ *   --family=ultrascale
+ *   --family=ultrascale+
+ *                    The device family, which sets the frame size and
+ *                    the FAR layout. The default is taken from the
+ *                    IDCODE in the stream.
+ *
+ *   --threads=<N> (default: 0)
+ *                    Number of threads that hash frames. The default
+ *                    (0) uses one per processor.
+ *
+ *   --timings
+ *   --metrics-json=<path>
+ *                    Print the wall and CPU time, bytes and allocations
+ *                    of each phase of the work to stderr, or write them
+ *                    with a trace timeline to a JSON file.
+ *
+ * The listing prints one line for each packet, and a run of NOP
+ * packets as a single line.
+ */
+
 # include  "read_bit_file.h"
+# include  "packet_index.h"
+# include  "frame_map.h"
+# include  "metrics.h"
 # include  <vector>
+# include  <string>
+# include  <map>
+# include  <algorithm>
 # include  <cstdint>
 # include  <cstdio>
 # include  <cstdlib>
@@ -60,101 +133,705 @@ static const char*command_name(uint32_t command)
       return name_table[command];
 }
 
-static void process_type1(const vector<uint8_t>&vec, size_t&ptr)
+static const uint8_t REG_CRC  = 0x00;
+static const uint8_t REG_FDRI = 0x02;
+static const uint8_t REG_CMD  = 0x04;
+static const uint32_t CMD_RCRC = 0x07;
+
+/*
+ * The listing is most of the work for large streams, so the data
+ * words are formatted by hand into a line buffer, instead of with a
+ * printf for each word.
+ */
+static char* put_words(char*out, const uint8_t*data, size_t word_count, bool command)
 {
-      assert(ptr+4 <= vec.size());
-      uint32_t command = vec[ptr+0];
-      command <<= 8;
-      command += vec[ptr+1];
-      command <<= 8;
-      command += vec[ptr+2];
-      command <<= 8;
-      command += vec[ptr+3];
+      static const char hex[16] = {'0','1','2','3','4','5','6','7',
+				   '8','9','a','b','c','d','e','f'};
+
+      for (size_t idx = 0 ; idx < word_count ; idx += 1) {
+	    uint32_t val = get_word(data + 4*idx);
+	    *out++ = ' ';
+	    for (int sh = 28 ; sh >= 0 ; sh -= 4)
+		  *out++ = hex[(val >> sh) & 0xf];
+	    if (command && idx == 0)
+		  out += sprintf(out, " (%s)", command_name(val));
+      }
+
+      *out++ = '\n';
+      return out;
+}
+
+/*
+ * Print a type-1 packet. The pkt points to the packet header word,
+ * and the caller has checked that the whole packet is present.
+ */
+static void process_type1(vector<char>&line, const uint8_t*pkt)
+{
+      uint32_t command = get_word(pkt);
 
       size_t word_count = (command >>  0) & 0x000007ff;
       uint8_t address   = (command >> 13) & 0x1f;
       uint8_t opcode    = (command >> 27) & 0x3;
 
-      assert(ptr+4+4*word_count <= vec.size());
-
+      char*out = &line[0];
       switch (opcode) {
 	  case 0: /* NO-OP */
-	    fprintf(stdout, "NOP            (word_count=%zu):", word_count);
-	    for (size_t idx = 0 ; idx < word_count ; idx += 1) {
-		  uint32_t val = vec[ptr+4+4*idx+0];
-		  val <<= 8;
-		  val += vec[ptr+4+4*idx+1];
-		  val <<= 8;
-		  val += vec[ptr+4+4*idx+2];
-		  val <<= 8;
-		  val += vec[ptr+4+4*idx+3];
-		  fprintf(stdout, " %08x", val);
-	    }
-	    fprintf(stdout, "\n");
+	    out += sprintf(out, "NOP            (word_count=%zu):", word_count);
+	    out = put_words(out, pkt+4, word_count, false);
 	    break;
 	  case 1: /* Read */
-	    fprintf(stdout, "Read  %-8s (word_count=%zu)\n", register_name(address), word_count);
+	    out += sprintf(out, "Read  %-8s (word_count=%zu)\n", register_name(address), word_count);
 	    break;
 	  case 2: /* Write */
-	    fprintf(stdout, "Write %-8s (word_count=%zu):", register_name(address), word_count);
-	    for (size_t idx = 0 ; idx < word_count ; idx += 1) {
-		  uint32_t val = vec[ptr+4+4*idx+0];
-		  val <<= 8;
-		  val += vec[ptr+4+4*idx+1];
-		  val <<= 8;
-		  val += vec[ptr+4+4*idx+2];
-		  val <<= 8;
-		  val += vec[ptr+4+4*idx+3];
-		  fprintf(stdout, " %08x", val);
-		  if (address == 0x04 && idx == 0) {
-			fprintf(stdout, " (%s)", command_name(val));
-		  }
-	    }
-	    fprintf(stdout, "\n");
+	    out += sprintf(out, "Write %-8s (word_count=%zu):", register_name(address), word_count);
+	    out = put_words(out, pkt+4, word_count, address == REG_CMD);
 	    break;
 	  case 3: /* Reserved Opcode */
-	    fprintf(stdout, "RESERVED       (address=0x%x, word_count=%zu)\n", address, word_count);
+	    out += sprintf(out, "RESERVED       (address=0x%x, word_count=%zu)\n", address, word_count);
 	    break;
 	  default:
 	    assert(0);
       }
 
-	// Advance the pointer past the packet.
-      ptr += 4 + 4*word_count;
+      fwrite(&line[0], 1, out - &line[0], stdout);
 }
 
-static void process_type2(const vector<uint8_t>&vec, size_t&ptr)
+static void process_type2(const uint8_t*pkt)
 {
-      assert(ptr+4 <= vec.size());
-      size_t word_count = vec[ptr+0] & 0x07;
-      word_count <<= 8;
-      word_count += vec[ptr+1];
-      word_count <<= 8;
-      word_count += vec[ptr+2];
-      word_count <<= 8;
-      word_count += vec[ptr+3];
+      size_t word_count = get_word(pkt) & 0x07ffffff;
 
       fprintf(stdout, "Type 2 Packet: word_count=%zu (0x%zx)\n", word_count, word_count);
       fprintf(stdout, " ... skip %zu bytes of data ...\n", 4 * word_count);
-      
-      assert(ptr + 4 + 4*word_count <= vec.size());
-      ptr += 4 + 4*word_count;
+}
+
+static void flush_nops(size_t&nop_run)
+{
+      if (nop_run == 1)
+	    fprintf(stdout, "NOP            (word_count=0):\n");
+      else if (nop_run > 1)
+	    fprintf(stdout, "NOP            (word_count=0): ... %zu times\n", nop_run);
+      nop_run = 0;
+}
+
+/*
+ * List the packets, starting at the first packet after the sync
+ * word. The stream is read in place, one packet at a time.
+ */
+static int list_packets(const bit_file_view&vec_in, size_t ptr)
+{
+      metrics_phase phase ("list packets", vec_in.size() - ptr);
+
+	// The sync word is in the payload, so from here on the stream
+	// is in memory and the pad does not matter.
+      assert(ptr >= vec_in.pad_size());
+      const uint8_t*base = vec_in.payload() - vec_in.pad_size();
+      const size_t size = vec_in.size();
+
+	// Big enough for the longest type-1 packet.
+      vector<char> line (64 + 12 * 0x800);
+      size_t nop_run = 0;
+
+      while (ptr < size) {
+	    if (ptr+4 > size) {
+		  flush_nops(nop_run);
+		  fprintf(stderr, "truncated packet at ptr=0x%04zx\n", ptr);
+		  return -1;
+	    }
+
+	    const uint8_t*pkt = base + ptr;
+	    uint32_t word = get_word(pkt);
+	    size_t word_count;
+	    switch (word >> 29) {
+		case 1: /* Type 1 */
+		  word_count = word & 0x7ff;
+		  break;
+		case 2: /* Type 2 */
+		  word_count = word & 0x07ffffff;
+		  break;
+		default: /* error */
+		  flush_nops(nop_run);
+		  fprintf(stderr, "mal-formed packet at ptr=0x%04zx\n", ptr);
+		  return 1;
+	    }
+
+	    if (ptr + 4 + 4*word_count > size) {
+		  flush_nops(nop_run);
+		  fprintf(stderr, "truncated packet at ptr=0x%04zx\n", ptr);
+		  return -1;
+	    }
+
+	      // Runs of NOP packets are very common, so count them
+	      // and print the run as one line.
+	    if (word == 0x20000000) {
+		  nop_run += 1;
+
+	    } else if (word >> 29 == 1) {
+		  flush_nops(nop_run);
+		  process_type1(line, pkt);
+
+	    } else {
+		  flush_nops(nop_run);
+		  process_type2(pkt);
+	    }
+
+	      // Advance the pointer past the packet.
+	    ptr += 4 + 4*word_count;
+      }
+
+      flush_nops(nop_run);
+      return 0;
+}
+
+/*
+ * Print the totals for the packets in the index.
+ */
+static void print_summary(const bit_file_view&vec_in, const packet_index&index)
+{
+      metrics_phase phase ("summary", vec_in.payload_size());
+
+      const uint8_t*vec = vec_in.payload();
+
+	// The last entry of the register tables counts registers
+	// outside the usual 32.
+      size_t reg_writes[33], reg_reads[33], reg_words[33];
+      size_t cmd_count[32];
+      memset(reg_writes, 0, sizeof reg_writes);
+      memset(reg_reads, 0, sizeof reg_reads);
+      memset(reg_words, 0, sizeof reg_words);
+      memset(cmd_count, 0, sizeof cmd_count);
+
+      size_t type1_count = 0, type2_count = 0, nop_count = 0;
+      uint64_t fdri_bytes = 0;
+      size_t crc_checks = 0;
+
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.type == 1)
+		  type1_count += 1;
+	    else
+		  type2_count += 1;
+
+	    size_t reg = pkt.reg < 32? pkt.reg : 32;
+	    switch (pkt.opcode) {
+		case 0:
+		  nop_count += 1;
+		  break;
+		case 1:
+		  reg_reads[reg] += 1;
+		  reg_words[reg] += pkt.word_count;
+		  break;
+		case 2:
+		  reg_writes[reg] += 1;
+		  reg_words[reg] += pkt.word_count;
+		  if (pkt.reg == REG_FDRI)
+			fdri_bytes += 4 * (uint64_t)pkt.word_count;
+		  if (pkt.reg == REG_CRC)
+			crc_checks += 1;
+		  if (pkt.reg == REG_CMD) {
+			for (size_t wdx = 0 ; wdx < pkt.word_count ; wdx += 1)
+			      cmd_count[get_word(vec + pkt.offset + 4 + 4*wdx) & 0x1f] += 1;
+		  }
+		  break;
+		default:
+		  break;
+	    }
+      }
+
+      fprintf(stdout, "Stream size: %zu bytes after %zu bytes of pad (sync word at offset 0x%04zx)\n",
+	      vec_in.payload_size(), vec_in.pad_size(), vec_in.pad_size() + index.sync_offset());
+      fprintf(stdout, "Packets: %zu type 1 (%zu NOP), %zu type 2\n",
+	      type1_count, nop_count, type2_count);
+      fprintf(stdout, "FDRI data: %llu bytes\n", (unsigned long long)fdri_bytes);
+      fprintf(stdout, "CRC checks: %zu, CRC resets (RCRC): %zu\n",
+	      crc_checks, cmd_count[CMD_RCRC]);
+
+      fprintf(stdout, "\n%-8s %8s %8s %12s\n", "Register", "Writes", "Reads", "Words");
+      for (size_t reg = 0 ; reg < 33 ; reg += 1) {
+	    if (reg_writes[reg] == 0 && reg_reads[reg] == 0)
+		  continue;
+	    fprintf(stdout, "%-8s %8zu %8zu %12zu\n", reg < 32? register_name(reg) : "other",
+		    reg_writes[reg], reg_reads[reg], reg_words[reg]);
+      }
+
+      fprintf(stdout, "\n%-9s %8s\n", "Command", "Count");
+      for (size_t cmd = 0 ; cmd < 32 ; cmd += 1) {
+	    if (cmd_count[cmd] == 0)
+		  continue;
+	    fprintf(stdout, "%-9s %8zu\n", command_name(cmd), cmd_count[cmd]);
+      }
+}
+
+struct column_stats_t {
+      frame_address_t address;
+      size_t frames;
+      size_t zero_frames;
+      size_t duplicate_frames;
+      uint64_t nonzero_bytes;
+};
+
+static bool more_copies(const pair<size_t,size_t>&a, const pair<size_t,size_t>&b)
+{
+      if (a.second != b.second)
+	    return a.second > b.second;
+      return a.first < b.first;
+}
+
+/*
+ * Print where the frame data goes.
+ */
+static void print_frames(const frame_map&frames)
+{
+      metrics_phase phase ("frame report");
+
+      const size_t frame_bytes = 4 * frames.frame_words();
+      const size_t nframes = frames.size();
+      const vector<frame_write_t>&writes = frames.writes();
+
+      fprintf(stdout, "Family: %s, frame size %zu words (%zu bytes)\n",
+	      family_name(frames.family()), frames.frame_words(), frame_bytes);
+      fprintf(stdout, "FDRI writes: %zu, MFWR writes: %zu\n", writes.size(), frames.mfwr_writes());
+      fprintf(stdout, "Frames: %zu (%llu bytes)\n", nframes,
+	      (unsigned long long)nframes * frame_bytes);
+      if (nframes == 0)
+	    return;
+
+      fprintf(stdout, "All-zero frames: %zu (%.1f%%)\n", frames.zero_frames(),
+	      100.0 * frames.zero_frames() / nframes);
+      fprintf(stdout, "Duplicate frames: %zu (%.1f%%)\n", frames.duplicate_frames(),
+	      100.0 * frames.duplicate_frames() / nframes);
+      fprintf(stdout, "Unique frames: %zu\n",
+	      nframes - frames.zero_frames() - frames.duplicate_frames());
+
+	// Long lists of writes come from streams that write the FAR
+	// for every frame, so only list the first of them.
+      const size_t max_writes = 32;
+      fprintf(stdout, "\n%5s  %-10s %5s %3s %3s %6s %5s %8s %5s\n", "Write", "FAR",
+	      "Block", "Top", "Row", "Column", "Minor", "Frames", "Extra");
+      for (size_t idx = 0 ; idx < writes.size() && idx < max_writes ; idx += 1) {
+	    const frame_write_t&cur = writes[idx];
+	    frame_address_t addr = decode_frame_address(cur.far, frames.family());
+	    fprintf(stdout, "%5zu  0x%08x %5u %3u %3u %6u %5u %8zu %5zu\n", idx, cur.far,
+		    addr.block, addr.top, addr.row, addr.column, addr.minor,
+		    cur.frames, cur.extra_words);
+      }
+      if (writes.size() > max_writes)
+	    fprintf(stdout, "  ... %zu more writes ...\n", writes.size() - max_writes);
+
+	// Count the copies of each frame that has any.
+      vector<size_t> copies (nframes, 0);
+      for (size_t idx = 0 ; idx < nframes ; idx += 1) {
+	    if (frames[idx].first != idx)
+		  copies[frames[idx].first] += 1;
+      }
+
+      vector< pair<size_t,size_t> > most;
+      for (size_t idx = 0 ; idx < nframes ; idx += 1) {
+	    if (copies[idx] > 0)
+		  most.push_back(make_pair(idx, copies[idx]));
+      }
+
+      const size_t max_most = min(most.size(), (size_t)8);
+      partial_sort(most.begin(), most.begin() + max_most, most.end(), more_copies);
+      if (max_most > 0)
+	    fprintf(stdout, "\nMost copied frames:\n");
+      for (size_t idx = 0 ; idx < max_most ; idx += 1) {
+	    const frame_info_t&cur = frames[most[idx].first];
+	    fprintf(stdout, "  Frame %zu (FAR 0x%08x + %u, %u nonzero words, hash %016llx): %zu copies\n",
+		    most[idx].first, cur.far, cur.index, cur.nonzero_words,
+		    (unsigned long long)cur.hash, most[idx].second);
+      }
+
+	// Add up the frames of each column. The map key sorts the
+	// columns by block, top/bottom, row and column.
+      map<uint64_t,column_stats_t> columns;
+      for (size_t idx = 0 ; idx < nframes ; idx += 1) {
+	    const frame_info_t&cur = frames[idx];
+	    frame_address_t addr = decode_frame_address(cur.far, frames.family());
+	    uint64_t key = ((((uint64_t)addr.block * 2 + addr.top) * 64 + addr.row) << 10) + addr.column;
+
+	    map<uint64_t,column_stats_t>::iterator col = columns.find(key);
+	    if (col == columns.end()) {
+		  column_stats_t tmp;
+		  tmp.address = addr;
+		  tmp.frames = 0;
+		  tmp.zero_frames = 0;
+		  tmp.duplicate_frames = 0;
+		  tmp.nonzero_bytes = 0;
+		  col = columns.insert(make_pair(key, tmp)).first;
+	    }
+
+	    col->second.frames += 1;
+	    if (cur.nonzero_words == 0)
+		  col->second.zero_frames += 1;
+	    else if (cur.first != idx)
+		  col->second.duplicate_frames += 1;
+	    col->second.nonzero_bytes += 4 * cur.nonzero_words;
+      }
+
+      fprintf(stdout, "\n%5s %3s %3s %6s %8s %8s %8s %12s %14s\n", "Block", "Top", "Row",
+	      "Column", "Frames", "Zero", "Dup", "Bytes", "Nonzero bytes");
+      for (map<uint64_t,column_stats_t>::const_iterator cur = columns.begin()
+		 ; cur != columns.end() ; ++ cur) {
+	    const column_stats_t&col = cur->second;
+	    fprintf(stdout, "%5u %3u %3u %6u %8zu %8zu %8zu %12llu %14llu\n",
+		    col.address.block, col.address.top, col.address.row, col.address.column,
+		    col.frames, col.zero_frames, col.duplicate_frames,
+		    (unsigned long long)col.frames * frame_bytes,
+		    (unsigned long long)col.nonzero_bytes);
+      }
+}
+
+static bool is_json_path(const char*path)
+{
+      size_t len = strlen(path);
+      return len >= 5 && strcmp(path+len-5, ".json") == 0;
+}
+
+static bool write_index_json(FILE*fd, const char*path_in, const bit_file_view&vec_in,
+			     const packet_index&index)
+{
+      static const char*opcode_name[4] = { "nop", "read", "write", "reserved" };
+      const uint8_t*vec = vec_in.payload();
+
+      fprintf(fd, "{\n  \"input\": \"%s\",\n", path_in);
+      fprintf(fd, "  \"pad\": %zu,\n  \"stream_size\": %zu,\n", vec_in.pad_size(), vec_in.payload_size());
+      fprintf(fd, "  \"sync_offset\": %zu,\n  \"packets\": [\n", index.sync_offset());
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    fprintf(fd, "    { \"offset\": %zu, \"type\": %u, \"opcode\": \"%s\"",
+		    pkt.offset, pkt.type, opcode_name[pkt.opcode & 3]);
+	    if (pkt.opcode != 0 && pkt.reg < 32)
+		  fprintf(fd, ", \"reg\": \"%s\"", register_name(pkt.reg));
+	    else if (pkt.opcode != 0)
+		  fprintf(fd, ", \"reg\": %u", pkt.reg);
+	    fprintf(fd, ", \"word_count\": %u", pkt.word_count);
+	      // Single word writes are register settings, so give
+	      // the value too.
+	    if (pkt.type == 1 && pkt.opcode == 2 && pkt.word_count == 1)
+		  fprintf(fd, ", \"value\": %u", get_word(vec + pkt.offset + 4));
+	    fprintf(fd, " }%s\n", idx+1 < index.size()? "," : "");
+      }
+      fprintf(fd, "  ]\n}\n");
+
+      return ferror(fd) == 0;
+}
+
+/*
+ * Open and index a stream for --diff.
+ */
+static bool load_stream(bit_file_view&view, packet_index&index, const char*path)
+{
+      FILE*fd = fopen(path, "rb");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to open input .bit file: %s\n", path);
+	    return false;
+      }
+
+      bool rc = view.load(fd, path);
+      fclose(fd);
+      if (! rc)
+	    return false;
+
+      if (! index.build(view.payload(), view.payload_size())) {
+	    fprintf(stderr, "NO SYNC WORD in %s\n", path);
+	    return false;
+      }
+
+      return true;
+}
+
+/*
+ * The packets that --diff compares are the register reads and writes,
+ * other than the FDRI data, which is compared frame by frame.
+ */
+static void diff_packets(vector<size_t>&res, const packet_index&index)
+{
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.opcode == 0 || pkt.reg == REG_FDRI)
+		  continue;
+	    res.push_back(idx);
+      }
+}
+
+static bool same_packet_kind(const packet_info_t&a, const packet_info_t&b)
+{
+      return a.type == b.type && a.opcode == b.opcode && a.reg == b.reg;
+}
+
+static void print_diff_packet(char mark, const uint8_t*vec, const packet_info_t&pkt)
+{
+      fprintf(stdout, "  %c %-5s %-8s (word_count=%u)", mark, pkt.opcode == 1? "Read" : "Write",
+	      register_name(pkt.reg), pkt.word_count);
+      if (pkt.opcode == 2 && pkt.word_count > 0) {
+	    uint32_t val = get_word(vec + pkt.offset + 4);
+	    fprintf(stdout, " %08x", val);
+	    if (pkt.reg == REG_CMD)
+		  fprintf(stdout, " (%s)", command_name(val));
+	    if (pkt.word_count > 1)
+		  fprintf(stdout, " ...");
+      }
+      fprintf(stdout, "\n");
+}
+
+/*
+ * Walk the register packets of the two streams together. Packets of
+ * the same kind are matched up, and their data compared. When the
+ * kinds differ, look a little way ahead in each stream for the
+ * nearest match, and report the packets skipped over as only in that
+ * stream. Return the number of differences.
+ */
+static size_t diff_register_writes(const uint8_t*vec_a, const packet_index&index_a,
+				   const uint8_t*vec_b, const packet_index&index_b)
+{
+      metrics_phase phase ("diff packets");
+
+      vector<size_t> list_a, list_b;
+      diff_packets(list_a, index_a);
+      diff_packets(list_b, index_b);
+
+      const size_t lookahead = 64;
+      size_t count = 0;
+      size_t ia = 0, ib = 0;
+      while (ia < list_a.size() || ib < list_b.size()) {
+	    if (ia < list_a.size() && ib < list_b.size()) {
+		  const packet_info_t&pa = index_a[list_a[ia]];
+		  const packet_info_t&pb = index_b[list_b[ib]];
+		  if (same_packet_kind(pa, pb)) {
+			const uint8_t*da = vec_a + pa.offset + 4;
+			const uint8_t*db = vec_b + pb.offset + 4;
+			if (pa.word_count == 1 && pb.word_count == 1) {
+			      uint32_t va = get_word(da);
+			      uint32_t vb = get_word(db);
+			      if (va != vb) {
+				    fprintf(stdout, "  * %-5s %-8s %08x -> %08x", pa.opcode == 1? "Read" : "Write",
+					    register_name(pa.reg), va, vb);
+				    if (pa.reg == REG_CMD)
+					  fprintf(stdout, " (%s -> %s)", command_name(va), command_name(vb));
+				    fprintf(stdout, "  (at 0x%zx, 0x%zx)\n", pa.offset, pb.offset);
+				    count += 1;
+			      }
+
+			} else if (pa.word_count != pb.word_count
+				   || memcmp(da, db, 4*(size_t)pa.word_count) != 0) {
+			      size_t words = 0;
+			      for (size_t idx = 0 ; idx < pa.word_count && idx < pb.word_count ; idx += 1) {
+				    if (memcmp(da+4*idx, db+4*idx, 4) != 0)
+					  words += 1;
+			      }
+			      fprintf(stdout, "  * %-5s %-8s (word_count=%u -> %u) %zu words differ"
+				      "  (at 0x%zx, 0x%zx)\n", pa.opcode == 1? "Read" : "Write",
+				      register_name(pa.reg), pa.word_count, pb.word_count,
+				      words, pa.offset, pb.offset);
+			      count += 1;
+			}
+
+			ia += 1;
+			ib += 1;
+			continue;
+		  }
+	    }
+
+	      // Find the nearest packet in each stream that matches
+	      // the current packet of the other.
+	    size_t skip_a = lookahead+1, skip_b = lookahead+1;
+	    for (size_t dist = 1 ; dist <= lookahead ; dist += 1) {
+		  if (skip_a > lookahead && ia+dist < list_a.size() && ib < list_b.size()
+		      && same_packet_kind(index_a[list_a[ia+dist]], index_b[list_b[ib]]))
+			skip_a = dist;
+		  if (skip_b > lookahead && ib+dist < list_b.size() && ia < list_a.size()
+		      && same_packet_kind(index_a[list_a[ia]], index_b[list_b[ib+dist]]))
+			skip_b = dist;
+	    }
+
+	    if (ib >= list_b.size() || (skip_a <= lookahead && skip_a <= skip_b)) {
+		  size_t end = ib < list_b.size()? min(ia + skip_a, list_a.size()) : list_a.size();
+		  for ( ; ia < end ; ia += 1, count += 1)
+			print_diff_packet('-', vec_a, index_a[list_a[ia]]);
+
+	    } else if (ia >= list_a.size() || skip_b <= lookahead) {
+		  size_t end = ia < list_a.size()? min(ib + skip_b, list_b.size()) : list_b.size();
+		  for ( ; ib < end ; ib += 1, count += 1)
+			print_diff_packet('+', vec_b, index_b[list_b[ib]]);
+
+	    } else {
+		  print_diff_packet('-', vec_a, index_a[list_a[ia]]);
+		  print_diff_packet('+', vec_b, index_b[list_b[ib]]);
+		  ia += 1;
+		  ib += 1;
+		  count += 2;
+	    }
+      }
+
+      return count;
+}
+
+/*
+ * Compare the frames of the two streams in order, by hash, and print
+ * the runs of frames that differ. Return the number of frames that
+ * differ, counting the frames that are only in the longer stream.
+ */
+static size_t diff_frames(const frame_map&frames_a, const frame_map&frames_b)
+{
+      metrics_phase phase ("diff frames");
+
+      const size_t max_ranges = 64;
+      const size_t ncommon = min(frames_a.size(), frames_b.size());
+      size_t count = 0;
+      size_t ranges = 0;
+
+      size_t idx = 0;
+      while (idx < ncommon) {
+	    if (frames_a[idx].hash == frames_b[idx].hash) {
+		  idx += 1;
+		  continue;
+	    }
+
+	    size_t end = idx + 1;
+	    while (end < ncommon && frames_a[end].hash != frames_b[end].hash)
+		  end += 1;
+
+	    if (ranges < max_ranges) {
+		  const frame_info_t&first = frames_a[idx];
+		  fprintf(stdout, "  Frames %zu-%zu (%zu frames, from FAR 0x%08x + %u) differ\n",
+			  idx, end-1, end-idx, first.far, first.index);
+	    }
+
+	    ranges += 1;
+	    count += end - idx;
+	    idx = end;
+      }
+
+      if (ranges > max_ranges)
+	    fprintf(stdout, "  ... %zu more ranges ...\n", ranges - max_ranges);
+
+      if (frames_a.size() != frames_b.size()) {
+	    const char*which = frames_a.size() > frames_b.size()? "a" : "b";
+	    size_t extra = max(frames_a.size(), frames_b.size()) - ncommon;
+	    fprintf(stdout, "  Frames %zu-%zu (%zu frames) are only in %s\n",
+		    ncommon, ncommon + extra - 1, extra, which);
+	    count += extra;
+      }
+
+      fprintf(stdout, "Frames: %zu in a, %zu in b, %zu differ in %zu ranges\n",
+	      frames_a.size(), frames_b.size(), count, ranges);
+      return count;
+}
+
+static int diff_streams(const char*path_a, const char*path_b, bool family_flag,
+			device_family_t family, unsigned threads)
+{
+      fprintf(stdout, "Comparing a: %s\n", path_a);
+      fprintf(stdout, "     with b: %s\n", path_b);
+      fflush(stdout);
+
+      bit_file_view vec_a, vec_b;
+      packet_index index_a, index_b;
+      if (! load_stream(vec_a, index_a, path_a))
+	    return -1;
+      if (! load_stream(vec_b, index_b, path_b))
+	    return -1;
+
+      device_family_t family_a = family, family_b = family;
+      if (! family_flag) {
+	    family_a = stream_family(vec_a.payload(), index_a);
+	    family_b = stream_family(vec_b.payload(), index_b);
+	    if (family_a != family_b)
+		  fprintf(stdout, "Family: %s in a, %s in b\n",
+			  family_name(family_a), family_name(family_b));
+      }
+
+      fprintf(stdout, "Register writes:\n");
+      size_t packet_diffs = diff_register_writes(vec_a.payload(), index_a, vec_b.payload(), index_b);
+      if (packet_diffs == 0)
+	    fprintf(stdout, "  (same)\n");
+
+      frame_map frames_a, frames_b;
+      frames_a.build(vec_a.payload(), index_a, family_a, threads);
+      frames_b.build(vec_b.payload(), index_b, family_b, threads);
+
+      fprintf(stdout, "Frame data:\n");
+      size_t frame_diffs = diff_frames(frames_a, frames_b);
+
+      if (packet_diffs == 0 && frame_diffs == 0) {
+	    fprintf(stdout, "Streams are the same.\n");
+	    return 0;
+      }
+
+      fprintf(stdout, "Streams differ: %zu register writes, %zu frames.\n", packet_diffs, frame_diffs);
+      return 1;
 }
 
 int main(int argc, char*argv[])
 {
       const char*path_in = 0;
+      const char*path_index = 0;
+      const char*path_index_in = 0;
+      string path_diff;
+      bool summary_flag = false;
+      bool frames_flag = false;
+      bool family_flag = false;
+      device_family_t family = FAMILY_7SERIES;
+      unsigned threads = 0;
 
       for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+
 	    if (strncmp(argv[optarg],"--input=",8) == 0) {
 		  path_in = argv[optarg] + 8;
 
+	    } else if (strcmp(argv[optarg],"--summary") == 0) {
+		  summary_flag = true;
+
+	    } else if (strncmp(argv[optarg],"--index=",8) == 0) {
+		  path_index = argv[optarg] + 8;
+
+	    } else if (strncmp(argv[optarg],"--index-in=",11) == 0) {
+		  path_index_in = argv[optarg] + 11;
+
+	    } else if (strncmp(argv[optarg],"--diff=",7) == 0) {
+		  path_diff = argv[optarg] + 7;
+
+	    } else if (strcmp(argv[optarg],"--frames") == 0) {
+		  frames_flag = true;
+
+	    } else if (strcmp(argv[optarg],"--family=7series") == 0) {
+		  family = FAMILY_7SERIES;
+		  family_flag = true;
+
+	    } else if (strcmp(argv[optarg],"--family=ultrascale") == 0) {
+		  family = FAMILY_ULTRASCALE;
+		  family_flag = true;
+
+	    } else if (strcmp(argv[optarg],"--family=ultrascale+") == 0) {
+		  family = FAMILY_ULTRASCALE_PLUS;
+		  family_flag = true;
+
+	    } else if (strncmp(argv[optarg],"--threads=",10) == 0) {
+		  threads = strtoul(argv[optarg]+10, 0, 0);
+
 	    } else {
 		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
 		  return -1;
 	    }
       }
 
+	// The listing can be very long, so give it a big buffer.
+      static char stdout_buf[1 << 16];
+      setvbuf(stdout, stdout_buf, _IOFBF, sizeof stdout_buf);
+
+      if (! path_diff.empty()) {
+	    size_t comma = path_diff.find(',');
+	    if (comma == string::npos) {
+		  fprintf(stderr, "Please specify two files with --diff=<a>,<b>.\n");
+		  return -1;
+	    }
+
+	    return diff_streams(path_diff.substr(0, comma).c_str(), path_diff.substr(comma+1).c_str(),
+				family_flag, family, threads);
+      }
+
       if (path_in == 0) {
 	    fprintf(stderr, "Please specify an input file with --input=<path>.\n");
 	    return -1;
@@ -169,14 +846,72 @@ int main(int argc, char*argv[])
       fprintf(stdout, "Reading input .bit file: %s\n", path_in);
       fflush(stdout);
       
-      vector<uint8_t> vec_in;
-      read_bit_file(vec_in, fd_in);
-      if (vec_in.size() == 0)
+      bit_file_view vec_in;
+      if (! vec_in.load(fd_in, path_in))
 	    return -1;
 
       fclose(fd_in);
       fd_in = 0;
 
+      if (summary_flag || path_index || frames_flag) {
+	    packet_index index;
+	    if (path_index_in) {
+		  FILE*fd = fopen(path_index_in, "rb");
+		  if (fd == 0) {
+			fprintf(stderr, "Unable to open index file: %s\n", path_index_in);
+			return -1;
+		  }
+
+		  bool rc = index.read(fd, vec_in.payload(), vec_in.payload_size());
+		  fclose(fd);
+		  if (! rc) {
+			fprintf(stderr, "Unable to load index file: %s\n", path_index_in);
+			return -1;
+		  }
+
+		  fprintf(stdout, "Read index of %zu packets: %s\n", index.size(), path_index_in);
+
+	    } else if (! index.build(vec_in.payload(), vec_in.payload_size())) {
+		  fprintf(stderr, "NO SYNC WORD\n");
+		  return -1;
+	    }
+
+	    if (summary_flag)
+		  print_summary(vec_in, index);
+
+	    if (frames_flag) {
+		  if (! family_flag)
+			family = stream_family(vec_in.payload(), index);
+
+		  frame_map frames;
+		  frames.build(vec_in.payload(), index, family, threads);
+		  if (summary_flag)
+			fprintf(stdout, "\n");
+		  print_frames(frames);
+	    }
+
+	    if (path_index) {
+		  FILE*fd = fopen(path_index, "wb");
+		  if (fd == 0) {
+			fprintf(stderr, "Unable to open index file: %s\n", path_index);
+			return -1;
+		  }
+
+		  bool rc = is_json_path(path_index)
+			? write_index_json(fd, path_in, vec_in, index)
+			: index.write(fd, vec_in.payload(), vec_in.payload_size());
+		  fclose(fd);
+		  if (! rc) {
+			fprintf(stderr, "Unable to write index file: %s\n", path_index);
+			return -1;
+		  }
+
+		  fprintf(stdout, "Wrote index of %zu packets: %s\n", index.size(), path_index);
+	    }
+
+	    return 0;
+      }
+
       size_t ptr = 0;
 	// Look for bus width detect words.
 	// Scan past the ff prefix stream.
@@ -229,20 +964,5 @@ int main(int argc, char*argv[])
       
 	// Now we found the sync word. The stream is happening and
 	// should be just type 1 and type 2 headers from now on.
-      while (ptr < vec_in.size()) {
-	    switch ((vec_in[ptr] >> 5) & 0x07) {
-		case 1: /* Type 1 */
-		  process_type1(vec_in, ptr);
-		  break;
-		case 2: /* Type 2 */
-		  process_type2(vec_in, ptr);
-		  break;
-		default: /* error */
-		  fprintf(stderr, "mal-formed packet at ptr=0x%04zx\n", ptr);
-		  return 01;
-	    }
-      }
-
-
-      return 0;
+      return list_packets(vec_in, ptr);
 }
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Write a synthetic .bit file, for testing and benchmarking the other
+ * tools without real designs. See synth_stream.h for what the stream
+ * holds.
+ *
+ * COMMAND LINE FLAGS:
+ *   --output=<path>  The .bit file to write.
+ *
+ *   --size=<N>[K|M] (default: 4M)
+ *                    Size of the frame data, in bytes.
+ *
+ *   --family=7series (default)
+ *   --family=ultrascale
+ *   --family=ultrascale+
+ *                    The device family, which sets the frame size and
+ *                    the IDCODE.
+ *
+ *   --seed=<N> (default: 1)
+ *                    Seed for the random frames.
+ *
+ *   --axss=<N> (default: 0x53494c56)
+ *   --bspi=<N> (default: 0x0b)
+ *   --cor0=<N> (default: 0x066055dc)
+ *   --cor1=<N> (default: 0)
+ *   --wbstar=<N> (default: 0)
+ *   --no-axss
+ *   --no-bspi
+ *   --no-wbstar
+ *                    Values of the header register writes, or leave
+ *                    the write out.
+ *
+ *   --crc=valid (default)
+ *   --crc=bad
+ *   --crc=none
+ *                    Write CRC checks with the right values, CRC checks
+ *                    that do not validate, or no CRC checks.
+ *
+ *   --timings
+ *   --metrics-json=<path>
+ *                    Print the wall and CPU time, bytes and allocations
+ *                    of each phase of the work to stderr, or write them
+ *                    with a trace timeline to a JSON file.
+ */
+
+# include  "synth_stream.h"
+# include  "metrics.h"
+# include  <vector>
+# include  <cstdint>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+
+using namespace std;
+
+static size_t parse_size(const char*text)
+{
+      char*ep;
+      size_t val = strtoul(text, &ep, 0);
+      if (*ep == 'k' || *ep == 'K')
+	    val *= 1024;
+      else if (*ep == 'm' || *ep == 'M')
+	    val *= 1024*1024;
+      return val;
+}
+
+int main(int argc, char*argv[])
+{
+      const char*path_out = 0;
+      synth_options_t opt;
+
+      for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+
+	    if (strncmp(argv[optarg],"--output=",9) == 0) {
+		  path_out = argv[optarg] + 9;
+
+	    } else if (strncmp(argv[optarg],"--size=",7) == 0) {
+		  opt.fdri_bytes = parse_size(argv[optarg]+7);
+
+	    } else if (strcmp(argv[optarg],"--family=7series") == 0) {
+		  opt.family = SYNTH_7SERIES;
+
+	    } else if (strcmp(argv[optarg],"--family=ultrascale") == 0) {
+		  opt.family = SYNTH_ULTRASCALE;
+
+	    } else if (strcmp(argv[optarg],"--family=ultrascale+") == 0) {
+		  opt.family = SYNTH_ULTRASCALE_PLUS;
+
+	    } else if (strncmp(argv[optarg],"--seed=",7) == 0) {
+		  opt.seed = strtoul(argv[optarg]+7, 0, 0);
+
+	    } else if (strncmp(argv[optarg],"--axss=",7) == 0) {
+		  opt.axss = strtoul(argv[optarg]+7, 0, 0);
+		  opt.write_axss = true;
+
+	    } else if (strncmp(argv[optarg],"--bspi=",7) == 0) {
+		  opt.bspi = strtoul(argv[optarg]+7, 0, 0);
+		  opt.write_bspi = true;
+
+	    } else if (strncmp(argv[optarg],"--cor0=",7) == 0) {
+		  opt.cor0 = strtoul(argv[optarg]+7, 0, 0);
+
+	    } else if (strncmp(argv[optarg],"--cor1=",7) == 0) {
+		  opt.cor1 = strtoul(argv[optarg]+7, 0, 0);
+
+	    } else if (strncmp(argv[optarg],"--wbstar=",9) == 0) {
+		  opt.wbstar = strtoul(argv[optarg]+9, 0, 0);
+		  opt.write_wbstar = true;
+
+	    } else if (strcmp(argv[optarg],"--no-axss") == 0) {
+		  opt.write_axss = false;
+
+	    } else if (strcmp(argv[optarg],"--no-bspi") == 0) {
+		  opt.write_bspi = false;
+
+	    } else if (strcmp(argv[optarg],"--no-wbstar") == 0) {
+		  opt.write_wbstar = false;
+
+	    } else if (strcmp(argv[optarg],"--crc=valid") == 0) {
+		  opt.crc = SYNTH_CRC_VALID;
+
+	    } else if (strcmp(argv[optarg],"--crc=bad") == 0) {
+		  opt.crc = SYNTH_CRC_BAD;
+
+	    } else if (strcmp(argv[optarg],"--crc=none") == 0) {
+		  opt.crc = SYNTH_CRC_NONE;
+
+	    } else {
+		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
+		  return -1;
+	    }
+      }
+
+      if (path_out == 0) {
+	    fprintf(stderr, "No output file? Please specify --output=<path>\n");
+	    return -1;
+      }
+
+      vector<uint8_t> vec;
+      make_synth_bit_file(vec, opt);
+
+      FILE*fd = fopen(path_out, "wb");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to open output file: %s\n", path_out);
+	    return -1;
+      }
+
+      size_t rc = fwrite(&vec[0], 1, vec.size(), fd);
+      fclose(fd);
+      if (rc != vec.size()) {
+	    fprintf(stderr, "Unable to write output file: %s\n", path_out);
+	    return -1;
+      }
+
+      fprintf(stdout, "Wrote %zu bytes to %s\n", vec.size(), path_out);
+      return 0;
+}
@@ -0,0 +1,363 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "boot_estimate.h"
+# include  "packet_index.h"
+# include  "metrics.h"
+# include  <cstdlib>
+# include  <cstring>
+
+using namespace std;
+
+static const uint32_t REG_CMD  = 0x04;
+static const uint32_t REG_FDRI = 0x02;
+static const uint32_t REG_COR0 = 0x09;
+static const uint32_t REG_COR1 = 0x0e;
+static const uint32_t REG_BSPI = 0x1f;
+static const uint32_t CMD_DESYNC = 0x0d;
+static const uint32_t CMD_IPROG  = 0x0f;
+
+/*
+ * The master CCLK runs at this rate (MHz) until COR0 is written.
+ */
+static const double default_cclk_mhz = 3.0;
+
+/*
+ * Nominal master CCLK rates (MHz) of the OSCFSEL codes in COR0[22:17]
+ * that are known. Code 0 is the default rate. The codes of the other
+ * ConfigRate settings are not in order of their rates (the BPI16 gold
+ * COR0 0x062055dc uses code 0x10), and are not listed here, so the
+ * estimate needs --cclk=<MHz> for them. The internal oscillator is
+ * only good to about +/-50% anyway, so --cclk is also the way to use
+ * the rate that a part is measured at.
+ */
+struct config_rate_t {
+      uint32_t oscfsel;
+      double mhz;
+};
+static const config_rate_t config_rates[] = {
+      { 0x00, 3.0 }
+};
+static const size_t config_rate_count = sizeof config_rates / sizeof config_rates[0];
+
+/*
+ * IPROG resets the configuration logic and clears the configuration
+ * memory, like PROGRAM_B, before the FPGA reads the next image. Use
+ * the program latency of the data sheets (T_PL, 5 ms) as the time.
+ */
+static const double iprog_ms = 5.0;
+
+boot_bus_t boot_bus_at_reset(bool bpi)
+{
+      boot_bus_t bus;
+      bus.bpi = bpi;
+      bus.width = bpi? 16 : 1;
+      bus.cclk_mhz = default_cclk_mhz;
+      bus.eclk = false;
+      return bus;
+}
+
+double boot_bus_ms(size_t bytes, const boot_bus_t&bus)
+{
+      if (bus.cclk_mhz <= 0.0 || bus.width == 0)
+	    return 0.0;
+
+      double cycles = 8.0 * bytes / bus.width;
+      if (bus.bpi) {
+	    double pages = cycles / bus.bpi_page_words;
+	    cycles = pages * (bus.bpi_first_read_cycles + bus.bpi_page_words - 1);
+      }
+      return cycles / (bus.cclk_mhz * 1000.0);
+}
+
+double boot_iprog_ms()
+{
+      return iprog_ms;
+}
+
+/*
+ * The SPI bus width of a BSPI read command. Return 0 if the command
+ * is not known, so that the width does not change.
+ */
+static unsigned bspi_width(uint32_t BSPI)
+{
+      switch (BSPI & 0xff) {
+	  case 0x03: /* Read */
+	  case 0x0b: /* Fast Read */
+	  case 0x0c: /* Fast Read, 4-byte address */
+	  case 0x13: /* Read, 4-byte address */
+	    return 1;
+	  case 0x3b: /* Dual Output Fast Read */
+	  case 0x3c: /* ... 4-byte address */
+	    return 2;
+	  case 0x6b: /* Quad Output Fast Read */
+	  case 0x6c: /* ... 4-byte address */
+	    return 4;
+	  default:
+	    return 0;
+      }
+}
+
+/*
+ * Set the bus clock from a COR0 value: ECLK_EN (bit 26) selects the
+ * external EMCCLK, and OSCFSEL (bits 22:17) the ConfigRate, which
+ * --cclk replaces. Return false if the OSCFSEL code is not one that
+ * is known, and --cclk is not given. The clock is then not known, and
+ * is set to 0.
+ */
+static bool cor0_clock(boot_bus_t&bus, uint32_t COR0, const boot_estimate_options_t&opt)
+{
+      bus.eclk = (COR0 & 0x04000000)? true : false;
+      bus.cclk_flag = false;
+
+      if (bus.eclk && opt.emcclk_mhz > 0.0) {
+	    bus.cclk_mhz = opt.emcclk_mhz;
+	    return true;
+      }
+
+      if (opt.cclk_mhz > 0.0) {
+	    bus.cclk_mhz = opt.cclk_mhz;
+	    bus.cclk_flag = true;
+	    return true;
+      }
+
+      const uint32_t oscfsel = (COR0 >> 17) & 0x3f;
+      for (size_t idx = 0 ; idx < config_rate_count ; idx += 1) {
+	    if (config_rates[idx].oscfsel == oscfsel) {
+		  bus.cclk_mhz = config_rates[idx].mhz;
+		  return true;
+	    }
+      }
+
+      bus.cclk_mhz = 0.0;
+      return false;
+}
+
+bool estimate_stream_boot(const uint8_t*data, size_t len, const boot_bus_t&bus,
+			  const boot_estimate_options_t&opt, boot_timing_t&res)
+{
+      metrics_phase phase ("boot estimate", len);
+
+      res = boot_timing_t();
+      res.bus = bus;
+
+      packet_index index;
+      if (! index.build(data, len))
+	    return false;
+
+      res.scan_bytes = index.sync_offset();
+      res.scan_ms = boot_bus_ms(res.scan_bytes, res.bus);
+
+	// Add up the time of each span of bytes that is read with the
+	// same bus. A COR0, COR1 (BPI) or BSPI (SPI) write changes
+	// the bus for the bytes after it.
+      size_t mark = index.sync_offset();
+      size_t end = len;
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.opcode != 2)
+		  continue;
+
+	    const size_t pkt_end = pkt.offset + 4 + 4*(size_t)pkt.word_count;
+	    if (pkt.reg == REG_FDRI)
+		  res.fdri_bytes += 4*(size_t)pkt.word_count;
+
+	    if (pkt.word_count == 0 || pkt_end > len)
+		  continue;
+
+	    const uint32_t val = get_word(data + pkt.offset + 4);
+
+	    if (pkt.reg == REG_CMD && (val == CMD_DESYNC || val == CMD_IPROG)) {
+		  res.iprog = val == CMD_IPROG;
+		  end = pkt_end;
+		  break;
+	    }
+
+	    if (pkt.reg == REG_COR0) {
+		  res.sync_ms += boot_bus_ms(pkt_end - mark, res.bus);
+		  mark = pkt_end;
+		  if (! cor0_clock(res.bus, val, opt) && ! res.cclk_unknown) {
+			res.cclk_unknown = true;
+			res.cclk_unknown_cor0 = val;
+		  }
+
+	    } else if (pkt.reg == REG_COR1 && res.bus.bpi) {
+		  res.sync_ms += boot_bus_ms(pkt_end - mark, res.bus);
+		  mark = pkt_end;
+		  static const unsigned page_words[4] = { 1, 4, 8, 1 };
+		  res.bus.bpi_page_words = page_words[val & 3];
+		  res.bus.bpi_first_read_cycles = ((val >> 2) & 3) + 1;
+
+	    } else if (pkt.reg == REG_BSPI && !res.bus.bpi) {
+		  res.sync_ms += boot_bus_ms(pkt_end - mark, res.bus);
+		  mark = pkt_end;
+		  unsigned width = bspi_width(val);
+		  if (width != 0)
+			res.bus.width = width;
+	    }
+      }
+
+      res.sync_bytes = end - index.sync_offset();
+      res.sync_ms += boot_bus_ms(end - mark, res.bus);
+      return true;
+}
+
+string boot_bus_name(const boot_bus_t&bus, const boot_estimate_options_t&opt)
+{
+      char buf[128];
+      const char*clock = "";
+      if (bus.eclk && opt.emcclk_mhz > 0.0)
+	    clock = " (EMCCLK)";
+      else if (bus.eclk && bus.cclk_flag)
+	    clock = " (EMCCLK rate not given, using --cclk)";
+      else if (bus.eclk)
+	    clock = " (EMCCLK rate not given, using ConfigRate)";
+      else if (bus.cclk_flag)
+	    clock = " (--cclk)";
+
+      char page[64] = "";
+      if (bus.bpi && bus.bpi_page_words > 1)
+	    snprintf(page, sizeof page, ", %u-word pages", bus.bpi_page_words);
+
+      snprintf(buf, sizeof buf, "%s x%u%s, %.1f MHz%s", bus.bpi? "BPI" : "SPI",
+	       bus.width, page, bus.cclk_mhz, clock);
+      return buf;
+}
+
+/*
+ * Print the error for an image whose CCLK rate is not known. Return
+ * true if the rate of the image is not known.
+ */
+static bool print_cclk_unknown(FILE*err, const char*name, const boot_timing_t&tim)
+{
+      if (! tim.cclk_unknown)
+	    return false;
+
+      fprintf(err, "Boot time estimate: COR0 0x%08x of the %s image selects OSCFSEL "
+	      "code %u, and the ConfigRate of that code is not known.\n", tim.cclk_unknown_cor0,
+	      name, (tim.cclk_unknown_cor0 >> 17) & 0x3f);
+      return true;
+}
+
+static void print_image(FILE*log, const char*name, const boot_timing_t&tim,
+			const boot_estimate_options_t&opt)
+{
+      fprintf(log, "  %-7s: %zu bytes sync to DONE (%zu FDRI), %s: %.1f ms\n",
+	      name, tim.sync_bytes, tim.fdri_bytes,
+	      boot_bus_name(tim.bus, opt).c_str(), tim.sync_ms);
+      if (tim.scan_bytes > 0)
+	    fprintf(log, "  %-7s  %zu bytes of pad before the sync word: %.1f ms\n",
+		    "", tim.scan_bytes, tim.scan_ms);
+}
+
+bool report_quickboot_boot(const uint8_t*header, size_t sector,
+			   const uint8_t*gold, size_t gold_len,
+			   const uint8_t*silver, size_t silver_len,
+			   bool bpi, const boot_estimate_options_t&opt, FILE*log, FILE*err)
+{
+	// The header, and each image up to its COR0 write, are read
+	// at the default rate, even with --cclk.
+      const boot_bus_t reset_bus = boot_bus_at_reset(bpi);
+
+	// The gold image is read after the two header sectors, if the
+	// Critical Switch word is erased.
+      const double gold_scan_ms = boot_bus_ms(sector+sector, reset_bus);
+      boot_timing_t gold_tim;
+      bool gold_rc = estimate_stream_boot(gold, gold_len, reset_bus, opt, gold_tim);
+
+      boot_timing_t header_tim;
+      bool header_rc = estimate_stream_boot(header, sector+sector, reset_bus, opt, header_tim);
+      const bool header_iprog = header_rc && header_tim.iprog;
+
+	// IPROG resets the clock, but the SPI read command (and so the
+	// bus width) from a BSPI write stays.
+      boot_timing_t silver_tim;
+      bool silver_rc = false;
+      if (header_iprog) {
+	    boot_bus_t silver_bus = reset_bus;
+	    silver_bus.width = header_tim.bus.width;
+	    silver_rc = estimate_stream_boot(silver, silver_len, silver_bus, opt, silver_tim);
+      }
+
+	// Without the clock of an image there is no estimate for it,
+	// so print no estimate at all rather than a partial one.
+      bool unknown = false;
+      if (silver_rc && print_cclk_unknown(err, "silver", silver_tim))
+	    unknown = true;
+      if (gold_rc && print_cclk_unknown(err, "gold", gold_tim))
+	    unknown = true;
+      if (unknown) {
+	    fprintf(err, "Boot time estimate: give the CCLK rate with --cclk=<MHz>.\n");
+	    return false;
+      }
+
+      fprintf(log, "Boot time estimate (%s at power on):\n",
+	      boot_bus_name(reset_bus, opt).c_str());
+
+      if (header_iprog) {
+	    fprintf(log, "  header : %zu bytes to IPROG, %s: %.1f ms\n",
+		    header_tim.scan_bytes + header_tim.sync_bytes,
+		    boot_bus_name(reset_bus, opt).c_str(),
+		    header_tim.scan_ms + header_tim.sync_ms);
+	    fprintf(log, "  IPROG  : %.1f ms\n", iprog_ms);
+
+	    if (! silver_rc) {
+		  fprintf(log, "  silver : no sync word\n");
+	    } else {
+		  print_image(log, "silver", silver_tim, opt);
+		  fprintf(log, "  Silver boot: %.1f ms (header, IPROG, silver)\n",
+			  header_tim.scan_ms + header_tim.sync_ms + iprog_ms
+			  + silver_tim.scan_ms + silver_tim.sync_ms);
+	    }
+
+      } else {
+	    fprintf(log, "  header : no Critical Switch word, the FPGA reads on to the gold image\n");
+      }
+
+      if (! gold_rc) {
+	    fprintf(log, "  gold   : no sync word\n");
+      } else {
+	    print_image(log, "gold", gold_tim, opt);
+	    fprintf(log, "  Gold boot: %.1f ms (header sectors, gold)\n",
+		    gold_scan_ms + gold_tim.scan_ms + gold_tim.sync_ms);
+      }
+
+      return true;
+}
+
+bool parse_boot_estimate_flag(boot_estimate_options_t&opt, const char*flag)
+{
+      if (strcmp(flag,"--estimate-boot") == 0) {
+	    opt.estimate = true;
+	    return true;
+      }
+
+      if (strncmp(flag,"--emcclk=",9) == 0) {
+	    opt.emcclk_mhz = strtod(flag+9, 0);
+	    return true;
+      }
+
+      if (strncmp(flag,"--cclk=",7) == 0) {
+	    opt.cclk_mhz = strtod(flag+7, 0);
+	    return true;
+      }
+
+      return false;
+}
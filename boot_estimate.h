@@ -0,0 +1,150 @@
+#ifndef __boot_estimate_H
+#define __boot_estimate_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <string>
+# include  <cstdio>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * A static estimate of the configuration time of an image in flash.
+ * The FPGA reads the flash at the CCLK rate, a bus width of bits at a
+ * time, and both change as the stream is read: a COR0 write selects
+ * the ConfigRate (or the external EMCCLK), and a BSPI write selects
+ * the SPI read command, and so the width. The estimate walks the
+ * packets of a stream, and adds up the time to read the bytes
+ * between these changes. It does not count the startup sequence after
+ * DESYNC, which is a handful of CCLK cycles.
+ */
+
+struct boot_estimate_options_t {
+      boot_estimate_options_t() : estimate(false), emcclk_mhz(0), cclk_mhz(0) { }
+
+      bool estimate;
+	// The frequency of EMCCLK, for streams that set ECLK_EN in
+	// COR0. Zero means it is not known.
+      double emcclk_mhz;
+	// Use this CCLK rate instead of the ConfigRate in COR0. It
+	// applies from the COR0 write on; the clock before it (at
+	// power on and after IPROG) is still the default rate.
+	// Zero means use COR0.
+      double cclk_mhz;
+};
+
+/*
+ * The state of the configuration bus. The clock is the CCLK rate in
+ * MHz and the width is in bits.
+ */
+struct boot_bus_t {
+      boot_bus_t()
+      : bpi(false), width(1), cclk_mhz(0), eclk(false), cclk_flag(false),
+	bpi_page_words(1), bpi_first_read_cycles(1) { }
+
+      bool bpi;
+      unsigned width;
+      double cclk_mhz;
+	// The clock is EMCCLK.
+      bool eclk;
+	// The clock is the --cclk rate.
+      bool cclk_flag;
+	// BPI page reads (from COR1): the first read of a page takes
+	// more than one cycle, and the rest of the page one each.
+      unsigned bpi_page_words;
+      unsigned bpi_first_read_cycles;
+};
+
+/*
+ * The time to read a stream from flash, up to DESYNC or IPROG.
+ */
+struct boot_timing_t {
+	// Bytes before the sync word, and the time to read them.
+      size_t scan_bytes;
+      double scan_ms;
+	// Bytes from the sync word up to and including the DESYNC
+	// or IPROG command, and the time to read them.
+      size_t sync_bytes;
+      double sync_ms;
+      size_t fdri_bytes;
+	// True if the stream ends with IPROG instead of DESYNC.
+      bool iprog;
+	// True if a COR0 write selects an OSCFSEL code whose rate is
+	// not known, and --cclk is not given. The times after it are
+	// then not known either. This is the COR0 value.
+      bool cclk_unknown;
+      uint32_t cclk_unknown_cor0;
+	// The bus at the end of the stream.
+      boot_bus_t bus;
+};
+
+/*
+ * The bus at power on, or after IPROG: SPI flash is read one bit at
+ * a time, and BPI16 flash 16 bits at a time, at the default CCLK.
+ */
+extern boot_bus_t boot_bus_at_reset(bool bpi);
+
+/*
+ * The time to read the bytes at the bus rate, in milliseconds.
+ */
+extern double boot_bus_ms(size_t bytes, const boot_bus_t&bus);
+
+/*
+ * Walk the stream (with any 0xff pad before it) and estimate the time
+ * to read it, starting with the given bus. Return false if the stream
+ * has no sync word.
+ */
+extern bool estimate_stream_boot(const uint8_t*data, size_t len, const boot_bus_t&bus,
+				 const boot_estimate_options_t&opt, boot_timing_t&res);
+
+/*
+ * Describe the bus, for example "SPI x4, 50.0 MHz (EMCCLK)".
+ */
+extern std::string boot_bus_name(const boot_bus_t&bus, const boot_estimate_options_t&opt);
+
+/*
+ * The time for IPROG to reset the configuration logic and clear the
+ * configuration memory before the FPGA reads the next image.
+ */
+extern double boot_iprog_ms();
+
+/*
+ * Print the estimate for a quickboot image to the log. The header is
+ * the two sectors of the quickboot header, and the gold image follows
+ * it. The FPGA reads the header, and goes with IPROG to the silver
+ * image; or if the Critical Switch word is erased, reads on through
+ * the header to the gold image. Return false (after printing a message
+ * to err, and no estimate) if the CCLK rate of an image is not known:
+ * only OSCFSEL code 0 is, so most images need --cclk=<MHz>.
+ */
+extern bool report_quickboot_boot(const uint8_t*header, size_t sector,
+				  const uint8_t*gold, size_t gold_len,
+				  const uint8_t*silver, size_t silver_len,
+				  bool bpi, const boot_estimate_options_t&opt,
+				  FILE*log, FILE*err =stderr);
+
+/*
+ * Interpret the --estimate-boot, --emcclk=<MHz> and --cclk=<MHz>
+ * flags.
+ */
+extern bool parse_boot_estimate_flag(boot_estimate_options_t&opt, const char*flag);
+
+#endif
@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "build_cache.h"
+# include  "metrics.h"
+# include  "map_file.h"
+# include  <cstdio>
+# include  <cstring>
+# include  <cerrno>
+# ifndef _WIN32
+# include  <sys/types.h>
+# include  <sys/stat.h>
+# include  <unistd.h>
+# endif
+
+using namespace std;
+
+static const uint8_t cache_magic[4] = { 'Q', 'B', 'C', '1' };
+
+/*
+ * Hash the executable itself, so that any change to the tools makes
+ * new keys. This is done once, the first time a key is made.
+ */
+static string hash_tool_executable()
+{
+# ifdef __linux__
+      FILE*fd = fopen("/proc/self/exe", "rb");
+      if (fd == 0)
+	    return string();
+
+      mapped_file file;
+      bool rc = file.map(fd);
+      fclose(fd);
+      if (! rc)
+	    return string();
+
+      uint8_t digest[32];
+      sha256::digest(digest, file.data(), file.size());
+
+      char text[65];
+      for (int idx = 0 ; idx < 32 ; idx += 1)
+	    snprintf(text + 2*idx, 3, "%02x", digest[idx]);
+      return text;
+# else
+      return string();
+# endif
+}
+
+const string& cache_tool_version()
+{
+      static const string version = hash_tool_executable();
+      return version;
+}
+
+cache_key_t::cache_key_t(const char*kind)
+{
+      add(QUICKBOOT_CACHE_VERSION);
+      add(cache_tool_version().c_str());
+      add(kind);
+}
+
+void cache_key_t::add(const uint8_t*data, size_t len)
+{
+	// Add the length first, so that adjacent items cannot run
+	// together into the same hash.
+      uint8_t tmp[8];
+      for (int idx = 0 ; idx < 8 ; idx += 1)
+	    tmp[idx] = (uint64_t)len >> (8*idx);
+      hash_.update(tmp, 8);
+      hash_.update(data, len);
+}
+
+void cache_key_t::add(const vector<uint8_t>&vec)
+{
+      add(vec.empty()? 0 : &vec[0], vec.size());
+}
+
+void cache_key_t::add(uint32_t val)
+{
+      uint8_t tmp[4];
+      for (int idx = 0 ; idx < 4 ; idx += 1)
+	    tmp[idx] = val >> (8*idx);
+      add(tmp, 4);
+}
+
+void cache_key_t::add(const char*text)
+{
+      add((const uint8_t*)text, strlen(text));
+}
+
+string cache_key_t::finish()
+{
+      uint8_t digest[32];
+      hash_.finish(digest);
+
+      char text[65];
+      for (int idx = 0 ; idx < 32 ; idx += 1)
+	    snprintf(text + 2*idx, 3, "%02x", digest[idx]);
+      return text;
+}
+
+build_cache::build_cache()
+{
+}
+
+build_cache::~build_cache()
+{
+}
+
+# ifndef _WIN32
+bool build_cache::open(const char*dir)
+{
+      if (mkdir(dir, 0777) < 0 && errno != EEXIST) {
+	    fprintf(stderr, "Unable to create cache directory %s: %s\n", dir, strerror(errno));
+	    return false;
+      }
+
+      dir_ = dir;
+      return true;
+}
+
+bool build_cache::lookup(const string&name, vector< vector<uint8_t> >&blobs)
+{
+      metrics_phase phase ("cache lookup");
+
+      blobs.clear();
+      if (dir_.empty())
+	    return false;
+
+	/* No lock is needed: entries are only ever renamed into
+	   place whole, so this opens either an old entry or the
+	   complete new one. */
+      string path = dir_ + "/" + name + ".qbc";
+
+      FILE*fd = fopen(path.c_str(), "rb");
+      if (fd == 0)
+	    return false;
+
+	/* An entry that is too short to hold even the header and the
+	   hash (an empty file left by a crash, say) is a miss. Check
+	   that before mapping it. */
+      struct stat sb;
+      if (fstat(fileno(fd), &sb) != 0 || ! S_ISREG(sb.st_mode)
+	  || (size_t)sb.st_size < 4+4+32) {
+	    fclose(fd);
+	    fprintf(stderr, "Ignoring damaged cache entry: %s\n", path.c_str());
+	    return false;
+      }
+
+      mapped_file file;
+      bool rc = file.map(fd);
+      fclose(fd);
+      if (! rc)
+	    return false;
+
+      const uint8_t*data = file.data();
+      const size_t size = file.size();
+
+	/* Check the magic number and the hash of the contents. */
+      if (size < 4+4+32 || memcmp(data, cache_magic, 4) != 0) {
+	    fprintf(stderr, "Ignoring damaged cache entry: %s\n", path.c_str());
+	    return false;
+      }
+
+      uint8_t digest[32];
+      sha256::digest(digest, data, size-32);
+      if (memcmp(digest, data+size-32, 32) != 0) {
+	    fprintf(stderr, "Ignoring damaged cache entry: %s\n", path.c_str());
+	    return false;
+      }
+
+      size_t ptr = 4;
+      uint32_t count = 0;
+      for (int idx = 0 ; idx < 4 ; idx += 1)
+	    count |= (uint32_t)data[ptr++] << (8*idx);
+
+      for (uint32_t blob = 0 ; blob < count ; blob += 1) {
+	    if (ptr+8 > size-32) {
+		  blobs.clear();
+		  return false;
+	    }
+	    uint64_t len = 0;
+	    for (int idx = 0 ; idx < 8 ; idx += 1)
+		  len |= (uint64_t)data[ptr++] << (8*idx);
+	    if (len > size-32-ptr) {
+		  blobs.clear();
+		  return false;
+	    }
+	    blobs.push_back(vector<uint8_t>(data+ptr, data+ptr+len));
+	    ptr += len;
+      }
+
+      return true;
+}
+
+/*
+ * Write the entry into a temporary file first, then rename it into
+ * place, so that a reader never sees a partial entry, even if this
+ * process dies while it writes.
+ */
+bool build_cache::store(const string&name, const vector<const vector<uint8_t>*>&blobs)
+{
+      metrics_phase phase ("cache store");
+
+      if (dir_.empty())
+	    return false;
+
+      string path = dir_ + "/" + name + ".qbc";
+      string path_tmp = dir_ + "/" + name + ".XXXXXX";
+      vector<char> tmp_name (path_tmp.begin(), path_tmp.end());
+      tmp_name.push_back(0);
+
+      int fdn = mkstemp(&tmp_name[0]);
+      if (fdn < 0) {
+	    fprintf(stderr, "Unable to write cache entry %s: %s\n", path.c_str(), strerror(errno));
+	    return false;
+      }
+
+      FILE*fd = fdopen(fdn, "wb");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to write cache entry %s: %s\n", path.c_str(), strerror(errno));
+	    close(fdn);
+	    remove(&tmp_name[0]);
+	    return false;
+      }
+
+      sha256 hash;
+
+      uint8_t head[8];
+      memcpy(head, cache_magic, 4);
+      for (int idx = 0 ; idx < 4 ; idx += 1)
+	    head[4+idx] = (uint32_t)blobs.size() >> (8*idx);
+      fwrite(head, 1, 8, fd);
+      hash.update(head, 8);
+
+      for (size_t blob = 0 ; blob < blobs.size() ; blob += 1) {
+	    const vector<uint8_t>&vec = *blobs[blob];
+	    uint8_t len[8];
+	    for (int idx = 0 ; idx < 8 ; idx += 1)
+		  len[idx] = (uint64_t)vec.size() >> (8*idx);
+	    fwrite(len, 1, 8, fd);
+	    hash.update(len, 8);
+	    if (vec.size() > 0) {
+		  fwrite(&vec[0], 1, vec.size(), fd);
+		  hash.update(&vec[0], vec.size());
+	    }
+      }
+
+      uint8_t digest[32];
+      hash.finish(digest);
+      fwrite(digest, 1, 32, fd);
+
+	/* Sync the data before the rename, so that after a crash the
+	   entry is either absent or complete, never renamed but
+	   empty. */
+      bool rc = fflush(fd) == 0 && ! ferror(fd) && fsync(fdn) == 0;
+      fchmod(fdn, 0644);
+      fclose(fd);
+
+      if (rc)
+	    rc = rename(&tmp_name[0], path.c_str()) == 0;
+
+      if (! rc) {
+	    fprintf(stderr, "Unable to write cache entry %s: %s\n", path.c_str(), strerror(errno));
+	    remove(&tmp_name[0]);
+	    return false;
+      }
+
+      return true;
+}
+
+# else
+
+/*
+ * The cache needs mkstemp and atomic renames, so it is not
+ * available in the Windows build.
+ */
+bool build_cache::open(const char*)
+{
+      fprintf(stderr, "The build cache is not supported on this platform.\n");
+      return false;
+}
+
+bool build_cache::lookup(const string&, vector< vector<uint8_t> >&blobs)
+{
+      blobs.clear();
+      return false;
+}
+
+bool build_cache::store(const string&, const vector<const vector<uint8_t>*>&)
+{
+      return false;
+}
+
+# endif
@@ -0,0 +1,104 @@
+#ifndef __build_cache_H
+#define __build_cache_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "sha256.h"
+# include  <vector>
+# include  <string>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * The format of the cache entries. The keys also include a hash of
+ * the running executable (see cache_tool_version), so a rebuilt tool
+ * never uses the entries of an older one.
+ */
+# define QUICKBOOT_CACHE_VERSION "quickboot-cache 2"
+
+/*
+ * Return the SHA-256 (as hex text) of the executable that is running,
+ * computed once. If the executable cannot be read, return the empty
+ * string, and the cache is then keyed by QUICKBOOT_CACHE_VERSION
+ * alone.
+ */
+extern const std::string& cache_tool_version();
+
+/*
+ * A cache_key_t is the hash that names a cache entry. Start it with
+ * the kind of entry, then add the stripped input stream and every
+ * option that affects the result. The cache format and tool version
+ * are added first.
+ */
+class cache_key_t {
+
+    public:
+      explicit cache_key_t(const char*kind);
+
+      void add(const uint8_t*data, size_t len);
+      void add(const std::vector<uint8_t>&vec);
+      void add(uint32_t val);
+      void add(const char*text);
+
+	// Finish the hash, and return the name of the entry (the
+	// hash as hex text).
+      std::string finish();
+
+    private:
+      sha256 hash_;
+};
+
+/*
+ * A build_cache is a directory of processed images, named by their
+ * cache_key_t. Each entry holds one or more blobs (for example a gold
+ * and a silver stream) and a SHA-256 of its contents, so that a damaged
+ * entry is treated as a miss. Entries are written to a temporary file
+ * and renamed into place. The rename is atomic, so a reader sees
+ * either the old entry or the complete new one, and many builder
+ * processes (and threads) can share a cache without a lock.
+ */
+class build_cache {
+
+    public:
+      build_cache();
+      ~build_cache();
+
+	// Use the directory as the cache, and create it if needed.
+	// Return false (after printing a message) if it cannot be
+	// used. The cache then does nothing.
+      bool open(const char*dir);
+      bool is_open() const { return ! dir_.empty(); }
+
+	// Get the blobs of the named entry. Return false if there is
+	// no such (valid) entry.
+      bool lookup(const std::string&name, std::vector< std::vector<uint8_t> >&blobs);
+
+	// Write the named entry. Return false if it cannot be written.
+      bool store(const std::string&name, const std::vector<const std::vector<uint8_t>*>&blobs);
+
+    private:
+      std::string dir_;
+
+    private: // not implemented
+      build_cache(const build_cache&);
+      build_cache& operator= (const build_cache&);
+};
+
+#endif
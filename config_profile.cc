@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "config_profile.h"
+# include  "packet_index.h"
+# include  <cstring>
+
+using namespace std;
+
+static const uint32_t REG_COR0 = 0x09;
+static const uint32_t REG_COR1 = 0x0e;
+static const uint32_t REG_BSPI = 0x1f;
+
+/*
+ * The ConfigRate profiles keep the ConfigRate of the design (set with
+ * BITSTREAM.CONFIG.CONFIGRATE), and only change the bus. Faster boots
+ * need EMCCLK.
+ */
+static const config_profile_t profiles[] = {
+      { "spi-x1-fast",   "SPI x1 fast read at the ConfigRate of the design",
+	false, 1, false, 1, 1 },
+      { "spi-x2-fast",   "SPI x2 dual output fast read at the ConfigRate of the design",
+	false, 2, false, 1, 1 },
+      { "spi-x4-fast",   "SPI x4 quad output fast read at the ConfigRate of the design",
+	false, 4, false, 1, 1 },
+      { "spi-x4-emcclk", "SPI x4 quad output fast read at EMCCLK",
+	false, 4, true,  1, 1 },
+      { "bpi16-page",    "BPI16 8-word page reads at the ConfigRate of the design",
+	true,  0, false, 8, 4 },
+      { "bpi16-page-emcclk", "BPI16 8-word page reads at EMCCLK",
+	true,  0, true,  8, 4 },
+};
+static const size_t profile_count = sizeof profiles / sizeof profiles[0];
+
+const config_profile_t* find_config_profile(const char*name)
+{
+      for (size_t idx = 0 ; idx < profile_count ; idx += 1) {
+	    if (strcmp(profiles[idx].name, name) == 0)
+		  return profiles + idx;
+      }
+
+      return 0;
+}
+
+void list_config_profiles(FILE*fd)
+{
+      for (size_t idx = 0 ; idx < profile_count ; idx += 1)
+	    fprintf(fd, "  %-17s %s\n", profiles[idx].name, profiles[idx].description);
+}
+
+const config_profile_t* check_config_profile(const char*name, bool bpi16, FILE*err)
+{
+      const config_profile_t*prof = find_config_profile(name);
+      if (prof == 0) {
+	    fprintf(err, "Unknown config profile: %s\n", name);
+	    fprintf(err, "The config profiles are:\n");
+	    list_config_profiles(err);
+	    return 0;
+      }
+
+      if (prof->bpi16 != bpi16) {
+	    fprintf(err, "Config profile %s is for %s flash, not %s flash.\n",
+		    prof->name, prof->bpi16? "BPI16" : "SPI", bpi16? "BPI16" : "SPI");
+	    return 0;
+      }
+
+      return prof;
+}
+
+/*
+ * ECLK_EN is COR0[26]. OSCFSEL (the ConfigRate, COR0[22:17]) is left
+ * as the design set it.
+ */
+uint32_t config_profile_cor0(const config_profile_t&prof, uint32_t COR0)
+{
+      if (prof.emcclk)
+	    return COR0 | 0x04000000;
+
+      return COR0;
+}
+
+/*
+ * BPI_PAGE_SIZE is COR1[1:0] (1, 4 or 8 words), and
+ * BPI_1ST_READ_CYCLE is COR1[3:2] (1 to 4 cycles).
+ */
+uint32_t config_profile_cor1(const config_profile_t&prof, uint32_t COR1)
+{
+      uint32_t page = 0;
+      if (prof.bpi_page_words == 8)
+	    page = 2;
+      else if (prof.bpi_page_words == 4)
+	    page = 1;
+
+      COR1 &= ~0x0000000f;
+      COR1 |= ((prof.bpi_first_read_cycles - 1) & 3) << 2;
+      COR1 |= page;
+      return COR1;
+}
+
+uint32_t config_profile_bspi(const config_profile_t&prof, bool addr32)
+{
+      switch (prof.spi_width) {
+	  case 4:
+	    return addr32? 0x6c : 0x6b;
+	  case 2:
+	    return addr32? 0x3c : 0x3b;
+	  default:
+	    return addr32? 0x0c : 0x0b;
+      }
+}
+
+void config_profile_edits(vector<register_edit_t>&edits, const config_profile_t&prof,
+			  const uint8_t*vec, const packet_index&index, bool addr32)
+{
+      if (prof.emcclk) {
+	    uint32_t COR0 = index.extract_register_write(vec, REG_COR0);
+	    edits.push_back(register_edit_t(REG_COR0, config_profile_cor0(prof, COR0)));
+      }
+
+      if (prof.bpi16) {
+	    uint32_t COR1 = index.extract_register_write(vec, REG_COR1);
+	    edits.push_back(register_edit_t(REG_COR1, config_profile_cor1(prof, COR1)));
+      } else {
+	    edits.push_back(register_edit_t(REG_BSPI, config_profile_bspi(prof, addr32)));
+      }
+}
+
+static const char*reg_name(uint32_t reg)
+{
+      switch (reg) {
+	  case REG_COR0: return "COR0";
+	  case REG_COR1: return "COR1";
+	  case REG_BSPI: return "BSPI";
+	  default:       return "?";
+      }
+}
+
+void print_config_profile_edits(FILE*log, const char*image,
+				const vector<register_edit_t>&edits, size_t skip)
+{
+      for (size_t idx = skip ; idx < edits.size() ; idx += 1) {
+	    const register_edit_t&edit = edits[idx];
+	    if (edit.found)
+		  fprintf(log, "... %s (%s): 0x%08x (was: 0x%08x)\n", reg_name(edit.reg),
+			  image, edit.new_value, edit.old_value);
+	    else
+		  fprintf(log, "WARNING        : %s is not present in %s stream.\n",
+			  reg_name(edit.reg), image);
+      }
+}
@@ -0,0 +1,101 @@
+#ifndef __config_profile_H
+#define __config_profile_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "replace_register_write.h"
+# include  <vector>
+# include  <cstdio>
+# include  <cstdint>
+# include  <cstddef>
+
+class packet_index;
+
+/*
+ * A configuration speed profile is a named set of the register
+ * values that decide how fast the FPGA reads its stream from flash:
+ * the CCLK source in COR0, the BPI page reads in COR1, and the SPI
+ * read command (and so the bus width) in BSPI. A profile does not
+ * change the ConfigRate (OSCFSEL) of the stream, which is set in the
+ * design, since the OSCFSEL codes of the rates are not known here.
+ * Nor does it touch CTL0 or CTL1: their fields are for security,
+ * persistence, readback and the like, and none of them sets how the
+ * flash is read. The BPI profiles use asynchronous page reads, as
+ * synchronous burst reads also need the flash itself set up for them,
+ * which the stream cannot do through these registers. The
+ * builders write the same values into the gold and silver images, and
+ * the SPI read command into the quickboot header, so that every stage
+ * of the boot reads the flash the same way.
+ */
+struct config_profile_t {
+      const char*name;
+      const char*description;
+	// The flash type that the profile is for.
+      bool bpi16;
+	// The SPI bus width (1, 2 or 4), or 0 for BPI16 flash.
+      unsigned spi_width;
+	// Use the external EMCCLK instead of the ConfigRate.
+      bool emcclk;
+	// The BPI page size in words (1, 4 or 8) and the CCLK cycles
+	// of the first read of a page (1 to 4).
+      unsigned bpi_page_words;
+      unsigned bpi_first_read_cycles;
+};
+
+/*
+ * Find the profile by name, or return nil if there is no such
+ * profile.
+ */
+extern const config_profile_t* find_config_profile(const char*name);
+
+/*
+ * Print the names and descriptions of the profiles.
+ */
+extern void list_config_profiles(FILE*fd);
+
+/*
+ * Look up the named profile, and check that it is for the flash type.
+ * Return nil (after printing a message to err) if it is not.
+ */
+extern const config_profile_t* check_config_profile(const char*name, bool bpi16,
+						    FILE*err =stderr);
+
+/*
+ * The register values of the profile. The COR0 and COR1 values are
+ * the old values with the fields of the profile replaced. The BSPI
+ * read command uses 4-byte addresses if addr32 is true.
+ */
+extern uint32_t config_profile_cor0(const config_profile_t&prof, uint32_t COR0);
+extern uint32_t config_profile_cor1(const config_profile_t&prof, uint32_t COR1);
+extern uint32_t config_profile_bspi(const config_profile_t&prof, bool addr32);
+
+/*
+ * Add the register edits of the profile for a stream to the edits
+ * list, to apply with replace_register_writes. Report the edits that
+ * were applied with print_config_profile_edits, which skips the first
+ * skip edits.
+ */
+extern void config_profile_edits(std::vector<register_edit_t>&edits,
+				 const config_profile_t&prof, const uint8_t*vec,
+				 const packet_index&index, bool addr32);
+extern void print_config_profile_edits(FILE*log, const char*image,
+				       const std::vector<register_edit_t>&edits, size_t skip);
+
+#endif
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "design_set.h"
+# include  "metrics.h"
+# include  "build_cache.h"
+# include  "packet_index.h"
+# include  "replace_register_write.h"
+# include  "disable_stream_crc.h"
+# include  "stream_crc.h"
+# include  "config_profile.h"
+# include  <string>
+# include  <cctype>
+# include  <cstdlib>
+# include  <cstring>
+# include  <cassert>
+
+using namespace std;
+
+const char*const design_set_names[design_set_count] = { "clif32-4", "clif32-6", "clif31", "clif30" };
+
+static const size_t flash_sector = design_set_flash_sector;
+static const size_t multiboot_offset = design_set_multiboot_offset;
+static const size_t design_offset = design_set_design_offset;
+
+static bool make_design(vector<uint8_t>&vec_out, vector<manifest_region_t>&regions,
+			int design_pos, const bit_file_view&raw_silver,
+			const design_set_options_t&opt, FILE*log);
+
+/*
+ * Interpret a command line flag that sets a design set option. Return
+ * false if the flag is not a design set option.
+ */
+bool parse_design_set_flag(design_set_options_t&opt, const char*flag)
+{
+      if (strcmp(flag,"--disable-silver") == 0) {
+	    opt.debug_trash_silver_mask = 0xff;
+	    opt.debug_trash_silver_header_mask = 0x00;
+
+      } else if (strncmp(flag,"--disable-silver=",17) == 0) {
+	    opt.debug_trash_silver_mask = strtoul(flag+17,0,0);
+	    opt.debug_trash_silver_header_mask = 0x00;
+
+      } else if (strcmp(flag,"--disable-silver-header") == 0) {
+	    opt.debug_trash_silver_mask = 0xff;
+	    opt.debug_trash_silver_header_mask = 0xff;
+
+      } else if (strncmp(flag,"--disable-silver-header=",24) == 0) {
+	    opt.debug_trash_silver_mask = strtoul(flag+24,0,0);
+	    opt.debug_trash_silver_header_mask = opt.debug_trash_silver_mask;
+
+      } else if (strcmp(flag,"--no-disable-silver") == 0) {
+	    opt.debug_trash_silver_mask = 0x00;
+	    opt.debug_trash_silver_header_mask = 0x00;
+
+      } else if (strcmp(flag,"--disable-syncword") == 0) {
+	    opt.debug_trash_syncword_mask = 0xff;
+
+      } else if (strncmp(flag,"--disable-syncword=",19) == 0) {
+	    opt.debug_trash_syncword_mask = strtoul(flag+19,0,0);
+
+      } else if (strcmp(flag,"--no-disable-syncword") == 0) {
+	    opt.debug_trash_syncword_mask = 0x00;
+
+      } else if (strncmp(flag,"--config-profile=",17) == 0) {
+	    opt.config_profile = flag+17;
+
+      } else {
+	    return parse_compress_flag(opt.compress, flag)
+		  || parse_boot_estimate_flag(opt.boot_estimate, flag);
+      }
+
+      return true;
+}
+
+bool make_design_set(vector<uint8_t>&vec_out, vector<manifest_region_t>&regions,
+		     size_t&first_design, size_t&last_design,
+		     const bit_file_view*const designs[design_set_count],
+		     const design_set_options_t&opt, FILE*log)
+{
+      metrics_phase phase ("design set");
+
+      size_t design_count = 0;
+      first_design = 99;
+      last_design = 0;
+      for (size_t pos = 0 ; pos < design_set_count ; pos += 1) {
+	    if (designs[pos] == 0)
+		  continue;
+	    if (pos < first_design) first_design = pos;
+	    last_design = pos;
+	    design_count += 1;
+      }
+
+      if (design_count < 1) {
+	    fprintf(opt.err, "No designs specified?\n");
+	    return false;
+      }
+
+      if ((last_design-first_design+1) != design_count) {
+	    fprintf(opt.err, "Supplied designs are not contiguous.\n");
+	    return false;
+      }
+
+      if (! opt.config_profile.empty()) {
+	    const config_profile_t*profile = check_config_profile(opt.config_profile.c_str(), false, opt.err);
+	    if (profile == 0)
+		  return false;
+	    fprintf(log, "Config profile: %s (%s)\n", profile->name, profile->description);
+      }
+
+      fprintf(log, "Flash sectors are %zu (0x%08zx) bytes.\n", flash_sector, flash_sector);
+
+	/* Make an image that holds the designs. */
+      regions.clear();
+      vec_out.resize((design_count+first_design) * design_offset);
+      memset(&vec_out[0], 0xff, vec_out.size());
+
+      assert(design_count > 0);
+      assert((design_count-1) + first_design == last_design);
+
+      for (size_t pos = first_design ; pos <= last_design ; pos += 1) {
+	    if (designs[pos]->size() <= 1)
+		  continue;
+
+	    string name = design_set_names[pos];
+	    for (size_t idx = 0 ; idx < name.size() ; idx += 1)
+		  name[idx] = toupper(name[idx]);
+
+	    fprintf(log, "Processing %s design...\n", name.c_str());
+	    fflush(log);
+
+	    if (! make_design(vec_out, regions, pos, *designs[pos], opt, log))
+		  return false;
+      }
+
+      return true;
+}
+
+/*
+ * Add the config profile to the cache key. Add every field, and not
+ * only the name, so that a change to the profile table makes new
+ * keys.
+ */
+static void add_profile_key(cache_key_t&key, const config_profile_t&profile)
+{
+      key.add(profile.name);
+      key.add((uint32_t)profile.bpi16);
+      key.add((uint32_t)profile.spi_width);
+      key.add((uint32_t)profile.emcclk);
+      key.add((uint32_t)profile.bpi_page_words);
+      key.add((uint32_t)profile.bpi_first_read_cycles);
+}
+
+/*
+ * Make the gold and silver images of a design from the input silver
+ * stream. The gold image gets a gold AXSS and both get the BSPI (and
+ * the COR0 of the config profile, if there is one), and the CRC
+ * checks are fixed up to match.
+ */
+static void process_design(vector<uint8_t>&vec_gold, vector<uint8_t>&vec_silver,
+			   const bit_file_view&raw_silver, uint8_t BSPI,
+			   const config_profile_t*profile, FILE*log)
+{
+	/* Local copy of the silver image, that we can edit. */
+      raw_silver.copy(vec_silver);
+
+	/* Make a gold image from the silver input. */
+      raw_silver.copy(vec_gold);
+
+	/* The gold and silver images are copies of the same stream,
+	   so one index of the packets serves both. */
+      packet_index index;
+      index.build(vec_silver);
+
+	/* Check the CRC of the stream before it is edited, so that
+	   the CRC can be recomputed after. */
+      size_t crc_checks = 0;
+      const crc_model_t crc_model = check_stream_crcs(&vec_silver[0], index, crc_checks);
+      if (crc_checks > 0 && crc_model == CRC_MODEL_NONE)
+	    fprintf(log, "WARNING        : CRC checks in source stream do not validate.\n");
+
+	/* The gold image gets a gold AXSS and the BSPI. */
+      vector<register_edit_t> gold_edits;
+      gold_edits.push_back(register_edit_t(0x0d, 0x474f4c44, axss_gold_transform));
+      gold_edits.push_back(register_edit_t(0x1f, BSPI));
+
+	/* The silver image gets the same config profile edits. Only
+	   the EMCCLK profiles change COR0; the others keep the
+	   ConfigRate of the design. */
+      vector<register_edit_t> silver_edits;
+      if (profile && profile->emcclk) {
+	    uint32_t COR0 = index.extract_register_write(vec_silver, 0x09);
+	    gold_edits.push_back(register_edit_t(0x09, config_profile_cor0(*profile, COR0)));
+	    silver_edits.push_back(register_edit_t(0x09, config_profile_cor0(*profile, COR0)));
+      }
+
+      replace_register_writes(&vec_gold[0], index, gold_edits);
+
+      const uint32_t AXSS_old = gold_edits[0].old_value;
+      const uint32_t AXSS_target = gold_edits[0].new_value;
+      if (AXSS_old == 0) {
+	    fprintf(log, "WARNING        : AXSS is not present in source stream.\n");
+
+      } else if (AXSS_old == 0x53494c56) { // SILV
+	      // Replace SILV with GOLD
+	    fprintf(log, "... AXSS (gold): 0x474f4c44 (was: 0x%08x)\n", AXSS_old);
+
+      } else if ((AXSS_old & 0xff000000) == 0x53000000) { // S...
+	      // Replace a leading S with G
+	    fprintf(log, "... AXSS (gold): 0x%08x (was: 0x%08x)\n", AXSS_target, AXSS_old);
+      }
+
+      fprintf(log, "... BSPI (gold): 0x%08x (was: 0x%08x)\n", BSPI, gold_edits[1].old_value);
+      if (profile)
+	    print_config_profile_edits(log, "gold", gold_edits, 2);
+
+	/* Recompute the CRC checks of the edited gold image, or
+	   disable them if the input CRC is not valid. */
+      if (crc_model != CRC_MODEL_NONE) {
+	    size_t crc_count = update_stream_crcs(&vec_gold[0], index, crc_model);
+	    fprintf(log, "... CRC (gold): %zu checks recomputed\n", crc_count);
+      } else {
+	    size_t crc_count = disable_stream_crcs(&vec_gold[0], index);
+	    fprintf(log, "... CRC (gold): %zu checks disabled\n", crc_count);
+      }
+
+      uint32_t old_BSPI = index.replace_register_write(vec_silver, 0x1f, BSPI);
+      fprintf(log, "... BSPI (silver): 0x%08x (was: 0x%08x)\n", BSPI, old_BSPI);
+
+      size_t silver_changed = replace_register_writes(&vec_silver[0], index, silver_edits);
+      print_config_profile_edits(log, "silver", silver_edits, 0);
+
+	/* The BSPI edit invalidates the CRC of the silver image. */
+      if ((old_BSPI != BSPI || silver_changed > 0) && crc_model != CRC_MODEL_NONE) {
+	    size_t crc_count = update_stream_crcs(&vec_silver[0], index, crc_model);
+	    fprintf(log, "... CRC (silver): %zu checks recomputed\n", crc_count);
+      }
+}
+
+/*
+ * Make a design into the output vector, based on the design position
+ * (0-3) and the input silver file. Generate a gold file, and write
+ * both into the output image and the correct position for the design.
+ * Return false (after printing a message) if the images cannot be
+ * compressed.
+ */
+static bool make_design(vector<uint8_t>&vec_out, vector<manifest_region_t>&regions,
+			int design_pos, const bit_file_view&raw_silver,
+			const design_set_options_t&opt, FILE*log)
+{
+      const bool debug_trash_silver = opt.debug_trash_silver_mask & (1 << design_pos)? true : false;
+      const bool debug_trash_silver_header = opt.debug_trash_silver_header_mask & (1 << design_pos)? true : false;
+      const bool debug_trash_syncword = opt.debug_trash_syncword_mask & (1 << design_pos)? true : false;
+
+	/* Location in the image of this design (gold and silver) */
+      const size_t design_base = design_pos * design_offset;
+	/* This is the BSPI value to use: 4-byte addresses, because
+	   WBSTAR holds the address in 32-bit mode, and the read
+	   command of the config profile if there is one. */
+      const config_profile_t*profile = opt.config_profile.empty()? 0 : find_config_profile(opt.config_profile.c_str());
+      const uint8_t BSPI = profile? config_profile_bspi(*profile, true) : 0x0c;
+
+	/* The processed gold and silver images depend only on the
+	   input stream, the BSPI value and the config profile, so
+	   they may be in the cache from an earlier build. */
+      string cache_name;
+      if (opt.cache) {
+	    cache_key_t key ("clif-design");
+	    key.add((uint32_t)raw_silver.pad_size());
+	    key.add(raw_silver.payload(), raw_silver.payload_size());
+	    key.add((uint32_t)BSPI);
+	    if (profile)
+		  add_profile_key(key, *profile);
+	    cache_name = key.finish();
+      }
+
+      vector<uint8_t> vec_silver;
+      vector<uint8_t> vec_gold;
+      vector< vector<uint8_t> > cached;
+      if (opt.cache && opt.cache->lookup(cache_name, cached) && cached.size() == 2) {
+	    vec_gold.swap(cached[0]);
+	    vec_silver.swap(cached[1]);
+	    fprintf(log, "... Gold and silver images from cache (%.16s)\n", cache_name.c_str());
+
+      } else {
+	    process_design(vec_gold, vec_silver, raw_silver, BSPI, profile, log);
+
+	    if (opt.cache) {
+		  vector<const vector<uint8_t>*> blobs;
+		  blobs.push_back(&vec_gold);
+		  blobs.push_back(&vec_silver);
+		  opt.cache->store(cache_name, blobs);
+	    }
+      }
+
+	/* The cache holds the images before compression, because
+	   the compression depends on the options. */
+      bool gold_estimated = false;
+      if (opt.compress.compress) {
+	    compress_result_t res;
+	    if (! compress_stream(vec_gold, "gold", opt.compress, res, log, opt.err))
+		  return false;
+	    gold_estimated = ! res.rewritten;
+	    if (! compress_stream(vec_silver, "silver", opt.compress, res, log, opt.err))
+		  return false;
+      }
+
+	/* Put the gold image here (after the design_base) to allow
+	   space for the quickboot header. */
+      const size_t gold_start = flash_sector*2;
+
+      if (gold_start+vec_gold.size() > multiboot_offset) {
+	    fprintf(opt.err, "ERROR: Gold image (%zu bytes) does not fit "
+		    "in multiboot region (%zu bytes)\n",
+		    vec_gold.size(), multiboot_offset - gold_start);
+	    if (gold_estimated)
+		  fprintf(opt.err, "--compress only estimated the gold image; pass "
+			  "--frame-addresses=<path> to rewrite it smaller.\n");
+      }
+
+      const string name = design_set_names[design_pos];
+      regions.push_back(manifest_region_t(name + "-header", design_base, flash_sector+flash_sector));
+      regions.push_back(manifest_region_t(name + "-gold", design_base + gold_start, vec_gold.size()));
+      regions.push_back(manifest_region_t(name + "-silver", design_base + multiboot_offset, vec_silver.size()));
+
+	/* Write the CLIF32-4 images into the total image. */
+      fprintf(log, "... Write GOLD image at byte address 0x%08zx\n",
+	      design_base + gold_start);
+      memcpy(&vec_out[design_base + gold_start], &vec_gold[0], vec_gold.size());
+
+      fprintf(log, "... Write SILVER image at byte address 0x%08zx\n",
+	      design_base + multiboot_offset);
+      memcpy(&vec_out[design_base + multiboot_offset], &vec_silver[0], vec_silver.size());
+
+      if (debug_trash_silver) {
+	    size_t trash_offset = debug_trash_silver_header? 0 : vec_silver.size() / 2;
+	    trash_offset &= ~(flash_sector-1);
+	    fprintf(log, "*** DEBUG Trash sector at 0x%08zx in silver image (0x%08zx in flash image).\n", trash_offset, design_base+multiboot_offset+trash_offset);
+	    for (size_t idx = 0 ; idx < flash_sector ; idx += 1)
+		  vec_out[design_base+multiboot_offset+trash_offset+idx] = 0xff;
+      }
+
+	/* Generate a quickboot header for the image set. */
+      fprintf(log, "... Critical Switch word is aa:99:55:66 at 0x%08zx\n",
+	      design_base + flash_sector - 4);
+      fflush(log);
+
+      uint32_t offset = design_base + multiboot_offset; /* Branch to silver. */
+	// write offset[32:8] to WBSTAR instead of [23:0]. We will be
+	// writing a 0x0000000c to BSPI to call out that mode.
+      offset >>= 8;
+	// Assert that START_ADDR in WBSTAR does not overflow into the
+	// RS_TS_B and RS bits.
+      assert((offset & 0xe0000000) == 0);
+
+	// Normally include the critical sync word. If we are
+	// debugging the absence of that word, then skip it, leaving
+	// the sector filled with 0xff.
+      if (!debug_trash_syncword) {
+	    vec_out[design_base + flash_sector - 4] = 0xaa; /* Sync word */
+	    vec_out[design_base + flash_sector - 3] = 0x99; /* ... */
+	    vec_out[design_base + flash_sector - 2] = 0x55; /* ... */
+	    vec_out[design_base + flash_sector - 1] = 0x66; /* ... */
+      } else {
+	    fprintf(log, "*** DEBUG Clear critical sync word in quickboot header.\n");
+	    fflush(log);
+      }
+      vec_out[design_base + flash_sector + 0] = 0x20; /* NOOP */
+      vec_out[design_base + flash_sector + 1] = 0x00; /* ... */
+      vec_out[design_base + flash_sector + 2] = 0x00; /* ... */
+      vec_out[design_base + flash_sector + 3] = 0x00; /* ... */
+      vec_out[design_base + flash_sector + 4] = 0x30; /* Write to BSPI */
+      vec_out[design_base + flash_sector + 5] = 0x03; /* ... */
+      vec_out[design_base + flash_sector + 6] = 0xe0; /* ... */
+      vec_out[design_base + flash_sector + 7] = 0x01; /* ... */
+      vec_out[design_base + flash_sector + 8] = 0x00; /* ... */
+      vec_out[design_base + flash_sector + 9] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +10] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +11] = BSPI; /* ... */
+      vec_out[design_base + flash_sector +12] = 0x30; /* Write to Command */
+      vec_out[design_base + flash_sector +13] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +14] = 0x80; /* ... */
+      vec_out[design_base + flash_sector +15] = 0x01; /* ... */
+      vec_out[design_base + flash_sector +16] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +17] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +18] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +19] = 0x12; /* ... BSPI_Read */
+      vec_out[design_base + flash_sector +20] = 0x20; /* NOOP */
+      vec_out[design_base + flash_sector +21] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +22] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +23] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +24] = 0x30; /* Set a watchdog timer */
+      vec_out[design_base + flash_sector +25] = 0x02; /* ... */
+      vec_out[design_base + flash_sector +26] = 0x20; /* ... */
+      vec_out[design_base + flash_sector +27] = 0x01; /* ... */
+      vec_out[design_base + flash_sector +28] = 0x40; /* ... */
+      vec_out[design_base + flash_sector +29] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +30] = 0x7f; /* ... */
+      vec_out[design_base + flash_sector +31] = 0xff; /* ... */
+      vec_out[design_base + flash_sector +32] = 0x30; /* Write to WBSTAR */
+      vec_out[design_base + flash_sector +33] = 0x02; /* ... */
+      vec_out[design_base + flash_sector +34] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +35] = 0x01; /* ... */
+      vec_out[design_base + flash_sector +36] = (offset>>24) & 0xff; /* ... */
+      vec_out[design_base + flash_sector +37] = (offset>>16) & 0xff; /* ... */
+      vec_out[design_base + flash_sector +38] = (offset>> 8) & 0xff; /* ... */
+      vec_out[design_base + flash_sector +39] = (offset>> 0) & 0xff; /* ... */
+      vec_out[design_base + flash_sector +40] = 0x30; /* Write to COMMAND */
+      vec_out[design_base + flash_sector +41] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +42] = 0x80; /* ... */
+      vec_out[design_base + flash_sector +43] = 0x01; /* ... */
+      vec_out[design_base + flash_sector +44] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +45] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +46] = 0x00; /* ... */
+      vec_out[design_base + flash_sector +47] = 0x0f; /* ... IPROG */
+
+	/* Pad the rest of the flash_sector with NOOP */
+      for (size_t idx = 48 ; idx < flash_sector ; idx += 4) {
+	    vec_out[design_base + flash_sector + idx + 0] = 0x20;
+	    vec_out[design_base + flash_sector + idx + 1] = 0x00;
+	    vec_out[design_base + flash_sector + idx + 2] = 0x00;
+	    vec_out[design_base + flash_sector + idx + 3] = 0x00;
+      }
+
+      if (opt.boot_estimate.estimate
+	  && ! report_quickboot_boot(&vec_out[design_base], flash_sector,
+				     &vec_out[design_base + gold_start], vec_gold.size(),
+				     &vec_out[design_base + multiboot_offset], vec_silver.size(),
+				     false, opt.boot_estimate, log, opt.err))
+	    return false;
+
+      return true;
+}
\ No newline at end of file
@@ -0,0 +1,100 @@
+#ifndef __design_set_H
+#define __design_set_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "read_bit_file.h"
+# include  "flash_manifest.h"
+# include  "frame_compress.h"
+# include  "boot_estimate.h"
+# include  <vector>
+# include  <string>
+# include  <cstdio>
+# include  <cstdint>
+# include  <cstddef>
+
+class build_cache;
+
+/*
+ * The flash layout of a design set (quickboot_builder3). S25FL128/256
+ * flash chips in Hybrid sector size option have 64Kbyte sectors. The
+ * silver image of a design is 4MBytes past the gold image, and the
+ * flash holds up to 4 designs that are gold/silver pairs.
+ */
+const size_t design_set_flash_sector = 64*1024;
+const size_t design_set_multiboot_offset = 4*1024*1024;
+const size_t design_set_design_offset = 2 * design_set_multiboot_offset;
+const size_t design_set_count = 4;
+
+/*
+ * The names of the designs, by position in the flash.
+ */
+extern const char*const design_set_names[design_set_count];
+
+/*
+ * Options for a design set. The debug masks have a bit for each design
+ * position.
+ */
+struct design_set_options_t {
+      design_set_options_t()
+      : debug_trash_silver_mask(0), debug_trash_silver_header_mask(0),
+	debug_trash_syncword_mask(0), cache(0), err(stderr) { }
+
+	// Blank a sector of the silver image (the first sector if
+	// the header mask bit is also set).
+      int debug_trash_silver_mask;
+      int debug_trash_silver_header_mask;
+	// Leave the Critical Switch word out.
+      int debug_trash_syncword_mask;
+	// An open cache of processed gold and silver streams, or nil.
+      build_cache*cache;
+	// The name of a configuration speed profile (for SPI flash),
+	// or empty for the default BSPI read command.
+      std::string config_profile;
+	// Write the copies of frames in the gold and silver images
+	// with MFWR. All the designs share the frame addresses.
+      compress_options_t compress;
+	// Print an estimate of the configuration time of each design.
+      boot_estimate_options_t boot_estimate;
+	// Where the error messages go.
+      FILE*err;
+};
+
+/*
+ * Make the image of a design set. The designs array has a silver stream
+ * for each design position, or nil for positions that are not used.
+ * The positions that are used must be contiguous. The image starts at
+ * address 0, but the positions before first_design are not used.
+ * Progress messages go to the log. Return false (after printing a
+ * message to opt.err) if the image cannot be made.
+ */
+extern bool make_design_set(std::vector<uint8_t>&vec_out,
+			    std::vector<manifest_region_t>&regions,
+			    size_t&first_design, size_t&last_design,
+			    const bit_file_view*const designs[design_set_count],
+			    const design_set_options_t&opt, FILE*log);
+
+/*
+ * Interpret a command line flag that sets a design set option. Return
+ * false if the flag is not a design set option.
+ */
+extern bool parse_design_set_flag(design_set_options_t&opt, const char*flag);
+
+#endif
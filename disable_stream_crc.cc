@@ -19,42 +19,51 @@
  */
 
 # include  "disable_stream_crc.h"
-# include  <cassert>
+# include  "metrics.h"
+# include  "packet_index.h"
 
 using namespace std;
 
-bool disable_stream_crc(std::vector<uint8_t>&vec)
+const uint32_t REG_CRC  = 0x00;
+
+size_t disable_stream_crcs(uint8_t*vec, const packet_index&index)
 {
-      size_t ptr = vec.size();
-      const size_t base = ptr - 3192;
+      metrics_phase phase ("crc disable");
 
-      const uint8_t magic[4] = {0x30, 0x00, 0x00, 0x01};
-      size_t match = 0;
+      size_t count = 0;
 
-      ptr -= 4;
-      while (ptr>base && match<4) {
-	    if (vec[ptr+match] == magic[match]) {
-		  match += 1;
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.opcode != 2 || pkt.word_count == 0)
+		  continue;
+
+	    uint8_t*data = vec + pkt.offset + 4;
+
+	      // Replace the CRC write with the Reset CRC command.
+	    if (pkt.type == 1 && pkt.reg == REG_CRC && pkt.word_count == 1) {
+		  put_word(vec + pkt.offset, 0x30008001);
+		  put_word(data, 0x00000007);
+		  count += 1;
 		  continue;
 	    }
 
-	    match = 0;
-	    ptr -= 4;
+	      // The stream for another SLR has its own CRC checks.
+	    if (! index.holds_stream(vec, idx))
+		  continue;
+
+	    packet_index sub_index;
+	    sub_index.build(data, 4 * (size_t)pkt.word_count);
+	    count += disable_stream_crcs(data, sub_index);
       }
 
-      if (match < 4)
-	    return false;
-
-      assert(ptr+8 <= vec.size());
-
-	// Replace the CRC code with the Reset CRC command.
-      vec[ptr+0] = 0x30;
-      vec[ptr+1] = 0x00;
-      vec[ptr+2] = 0x80;
-      vec[ptr+3] = 0x01;
-      vec[ptr+4] = 0x00;
-      vec[ptr+5] = 0x00;
-      vec[ptr+6] = 0x00;
-      vec[ptr+7] = 0x07;
-      return true;
+      return count;
+}
+
+size_t disable_stream_crcs(std::vector<uint8_t>&vec)
+{
+      packet_index index;
+      if (! index.build(vec))
+	    return 0;
+
+      return disable_stream_crcs(&vec[0], index);
 }
@@ -22,7 +22,19 @@
 
 # include  <vector>
 # include  <cstdint>
+# include  <cstddef>
 
-extern bool disable_stream_crc(std::vector<uint8_t>&vec);
+class packet_index;
+
+/*
+ * Find every CRC check (a write to the CRC register) in the stream,
+ * and replace it with a Reset CRC command, so that the stream can be
+ * edited without the device rejecting it. The whole stream is
+ * searched, a packet at a time, including the streams for other SLRs
+ * that are embedded in the stream. Return the number of CRC checks
+ * that were replaced.
+ */
+extern size_t disable_stream_crcs(std::vector<uint8_t>&vec);
+extern size_t disable_stream_crcs(uint8_t*vec, const packet_index&index);
 
 #endif
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "flash_delta.h"
+# include  "metrics.h"
+# include  "read_bit_file.h"
+# include  "read_mcs_file.h"
+# include  "map_file.h"
+# include  <algorithm>
+# include  <string>
+# include  <cstdio>
+# include  <cstring>
+
+using namespace std;
+
+flash_delta::flash_delta()
+: sector_size_(0)
+{
+}
+
+static bool is_manifest_path(const char*path)
+{
+      size_t len = strlen(path);
+      return len >= 9 && strcmp(path + len - 9, ".manifest") == 0;
+}
+
+static bool is_bit_path(const char*path)
+{
+      size_t len = strlen(path);
+      return len >= 4 && strcmp(path + len - 4, ".bit") == 0;
+}
+
+/*
+ * The previous image is normally the .mcs file (or its manifest) that
+ * was last programmed into the flash. An .mcs or raw binary image is
+ * already in flash byte order, so it is hashed without a swizzle.
+ *
+ * The .bit inputs of the previous build are not accepted: the image
+ * that they make depends on all the builder options, so rebuilding it
+ * here could hash an image that was never in the flash. Keep the .mcs
+ * or the manifest of each release instead.
+ */
+bool flash_delta::load(const char*path, size_t sector_size, unsigned threads)
+{
+      metrics_phase phase ("delta load");
+
+      sector_size_ = sector_size;
+      sectors_.clear();
+
+      vector<sector_hash_t> res;
+
+      if (is_manifest_path(path)) {
+	    size_t manifest_sector_size;
+	    if (! read_flash_manifest(path, manifest_sector_size, res))
+		  return false;
+	    if (manifest_sector_size != sector_size) {
+		  fprintf(stderr, "%s: Manifest sector size 0x%zx does not match 0x%zx.\n",
+			  path, manifest_sector_size, sector_size);
+		  return false;
+	    }
+
+      } else if (is_bit_path(path)) {
+	    fprintf(stderr, "%s: A .bit file is a stream, not a flash image. Use the "
+		    ".mcs file or the manifest of the previous build.\n", path);
+	    return false;
+
+      } else {
+	    FILE*fd = fopen(path, "rb");
+	    if (fd == 0) {
+		  fprintf(stderr, "Unable to open previous image: %s\n", path);
+		  return false;
+	    }
+
+	    vector<uint8_t> image;
+	    bool rc;
+	    if (is_mcs_path(path)) {
+		  rc = read_mcs_file(image, fd);
+	    } else {
+		  mapped_file file;
+		  rc = file.map(fd);
+		  if (rc)
+			image.assign(file.data(), file.data() + file.size());
+	    }
+	    fclose(fd);
+	    if (! rc)
+		  return false;
+
+	    hash_flash_sectors(res, image, 0, sector_size, SWIZZLE_NONE, threads);
+      }
+
+      for (size_t idx = 0 ; idx < res.size() ; idx += 1)
+	    sectors_[res[idx].address] = res[idx];
+
+      return true;
+}
+
+/*
+ * A sector that the previous image does not cover is taken to be
+ * blank, so it only needs to be written if it is not blank now. A
+ * sector past the end of the new image that the previous image has
+ * data in is also changed, as it must be erased.
+ */
+size_t flash_delta::compare(vector<bool>&changed, const vector<uint8_t>&vec,
+			    size_t start_address, swizzle_t swizzle, unsigned threads) const
+{
+      metrics_phase phase ("delta compare", vec.size());
+
+      vector<sector_hash_t> res;
+      hash_flash_sectors(res, vec, start_address, sector_size_, swizzle, threads);
+
+      size_t nsectors = (vec.size() + sector_size_ - 1) / sector_size_;
+      if (! sectors_.empty())
+	    nsectors = max(nsectors, sectors_.rbegin()->first / sector_size_ + 1);
+      changed.assign(nsectors, false);
+
+      size_t count = 0;
+      for (size_t idx = 0 ; idx < res.size() ; idx += 1) {
+	    const sector_hash_t&cur = res[idx];
+	    map<size_t,sector_hash_t>::const_iterator old = sectors_.find(cur.address);
+
+	    bool flag;
+	    if (old == sectors_.end())
+		  flag = ! cur.blank;
+	    else
+		  flag = old->second.size != cur.size
+			|| memcmp(old->second.sha, cur.sha, 32) != 0;
+
+	    if (flag) {
+		  changed[cur.address / sector_size_] = true;
+		  count += 1;
+	    }
+      }
+
+      for (map<size_t,sector_hash_t>::const_iterator cur = sectors_.lower_bound(vec.size())
+		 ; cur != sectors_.end() ; ++ cur) {
+	    if (cur->first < start_address || cur->first % sector_size_ != 0)
+		  continue;
+	    if (cur->second.blank)
+		  continue;
+	    changed[cur->first / sector_size_] = true;
+	    count += 1;
+      }
+
+      return count;
+}
+
+static bool write_mcs_sectors(const char*path, const vector<uint8_t>&vec,
+			      size_t start_address, const mcs_options_t&opt)
+{
+      FILE*fd = fopen(path, "wb");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to open output file: %s\n", path);
+	    return false;
+      }
+
+      write_to_mcs_file(fd, vec, start_address, opt);
+      fclose(fd);
+      return true;
+}
+
+/*
+ * The changed sectors of a design are erased and written while the
+ * switch sector of that design is erased, so that the device falls
+ * back to the gold image if the update is interrupted. Thus the
+ * switch sector is written last, from a file of its own.
+ */
+bool write_delta_update(const char*path_out, const vector<uint8_t>&vec,
+			size_t start_address, size_t sector_size,
+			const vector<bool>&changed,
+			const vector<delta_design_t>&designs,
+			const mcs_options_t&opt)
+{
+      mcs_options_t delta_opt = opt;
+      delta_opt.sparse = false;
+      delta_opt.sector_size = sector_size;
+      delta_opt.sector_select = changed;
+
+	// The restore file is written from the same image, so the
+	// encoder messages (the target device size) are only printed
+	// for the delta file.
+      mcs_options_t restore_opt = delta_opt;
+      restore_opt.sector_select.assign(changed.size(), false);
+      restore_opt.log = 0;
+
+      vector<size_t> switch_sectors;
+      for (size_t idx = 0 ; idx < designs.size() ; idx += 1) {
+	    const delta_design_t&cur = designs[idx];
+	    bool touched = false;
+	    for (size_t addr = cur.address ; addr < cur.address+cur.size ; addr += sector_size) {
+		  size_t sec = addr / sector_size;
+		  if (sec >= changed.size())
+			break;
+		  if (changed[sec]) {
+			touched = true;
+			break;
+		  }
+	    }
+	    if (! touched)
+		  continue;
+
+	    size_t sec = cur.switch_sector / sector_size;
+	    if (sec < changed.size()) {
+		  delta_opt.sector_select[sec] = false;
+		  restore_opt.sector_select[sec] = true;
+	    }
+	    switch_sectors.push_back(cur.switch_sector);
+      }
+
+	// Changed sectors past the end of the image are only erased.
+      const size_t end_sector = (vec.size() + sector_size - 1) / sector_size;
+      size_t nchanged = 0;
+      vector<size_t> erase_sectors;
+      for (size_t sec = 0 ; sec < delta_opt.sector_select.size() ; sec += 1) {
+	    if (! delta_opt.sector_select[sec])
+		  continue;
+	    nchanged += 1;
+	    if (sec >= end_sector)
+		  erase_sectors.push_back(sec * sector_size);
+      }
+
+	// The total counts the sectors of the new image, and those of
+	// the previous image past its end.
+      const size_t start_sector = start_address / sector_size;
+      size_t ntotal = changed.size() > start_sector? changed.size() - start_sector : 0;
+
+      if (nchanged == 0 && switch_sectors.empty()) {
+	    fprintf(opt.log, "Delta update: No sectors changed, nothing to program.\n");
+	    return write_mcs_sectors(path_out, vec, start_address, delta_opt);
+      }
+
+      if (! write_mcs_sectors(path_out, vec, start_address, delta_opt))
+	    return false;
+
+      string path_restore = string(path_out) + ".restore.mcs";
+      if (! switch_sectors.empty()) {
+	    if (! write_mcs_sectors(path_restore.c_str(), vec, start_address, restore_opt))
+		  return false;
+      }
+
+      fprintf(opt.log, "Delta update: %zu of %zu sectors changed.\n", nchanged, ntotal);
+      int step = 1;
+      if (! switch_sectors.empty()) {
+	    fprintf(opt.log, "  %d: Erase the switch sector(s):", step++);
+	    for (size_t idx = 0 ; idx < switch_sectors.size() ; idx += 1)
+		  fprintf(opt.log, " 0x%08zx", switch_sectors[idx]);
+	    fprintf(opt.log, "\n");
+      }
+      if (! erase_sectors.empty()) {
+	    fprintf(opt.log, "  %d: Erase the %zu sector(s) that are past the end of the"
+		    " new image:", step++, erase_sectors.size());
+	      // The stale sectors need not be contiguous, so print
+	      // each run of them as a range.
+	    size_t idx = 0;
+	    while (idx < erase_sectors.size()) {
+		  size_t end = idx + 1;
+		  while (end < erase_sectors.size()
+			 && erase_sectors[end] == erase_sectors[end-1] + sector_size)
+			end += 1;
+		  fprintf(opt.log, " 0x%08zx-0x%08zx", erase_sectors[idx],
+			  erase_sectors[end-1] + sector_size - 1);
+		  idx = end;
+	    }
+	    fprintf(opt.log, "\n");
+      }
+      fprintf(opt.log, "  %d: Erase and program the sectors in %s\n", step++, path_out);
+      if (! switch_sectors.empty())
+	    fprintf(opt.log, "  %d: Program %s to enable quickboot again.\n",
+		    step++, path_restore.c_str());
+
+      return true;
+}
@@ -0,0 +1,88 @@
+#ifndef __flash_delta_H
+#define __flash_delta_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "flash_manifest.h"
+# include  "write_to_mcs_file.h"
+# include  <vector>
+# include  <map>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * A quickboot design in the flash: the range of the flash that it
+ * covers, and the address of the sector that holds its critical switch
+ * word. Erasing that sector disables the quickboot of the silver
+ * image of the design.
+ */
+struct delta_design_t {
+      delta_design_t(size_t sw, size_t addr, size_t len)
+      : switch_sector(sw), address(addr), size(len) { }
+
+      size_t switch_sector;
+      size_t address;
+      size_t size;
+};
+
+/*
+ * A flash_delta holds the sector hashes of a previous flash image, so
+ * that a field update need only program the sectors that changed. The
+ * previous image may be given as an .mcs file, a manifest that
+ * write_flash_manifest() wrote, or a raw binary image of the flash
+ * starting at address 0. A .bit file is rejected, as it is a stream
+ * and not an image of the flash.
+ */
+class flash_delta {
+
+    public:
+      flash_delta();
+
+	// Load the previous image. Return false (after printing a
+	// message) on error.
+      bool load(const char*path, size_t sector_size, unsigned threads);
+
+	// Mark the sectors (by sector number from address 0) of the
+	// new image, from start_address to the end, that differ from
+	// the previous image. Return the number of changed sectors.
+      size_t compare(std::vector<bool>&changed, const std::vector<uint8_t>&vec,
+		     size_t start_address, swizzle_t swizzle, unsigned threads) const;
+
+    private:
+      size_t sector_size_;
+	// Hashes of the previous image, by sector address.
+      std::map<size_t, sector_hash_t> sectors_;
+};
+
+/*
+ * Write a delta update of the image to path_out, as an .mcs file that
+ * holds only the changed sectors. The switch sectors of the designs
+ * that have changes are left out, and written to a second .mcs file
+ * (path_out with .restore.mcs added) that must be programmed last.
+ * The steps for doing the update are printed. Return false if a file
+ * cannot be written.
+ */
+extern bool write_delta_update(const char*path_out, const std::vector<uint8_t>&vec,
+			       size_t start_address, size_t sector_size,
+			       const std::vector<bool>&changed,
+			       const std::vector<delta_design_t>&designs,
+			       const mcs_options_t&opt);
+
+#endif
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "flash_manifest.h"
+# include  "metrics.h"
+# include  "stream_crc.h"
+# include  "sha256.h"
+# include  <algorithm>
+# include  <thread>
+# include  <atomic>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <cassert>
+
+using namespace std;
+
+static bool is_blank(const uint8_t*src, size_t cnt)
+{
+      size_t idx = 0;
+      for ( ; idx+8 <= cnt ; idx += 8) {
+	    uint64_t word;
+	    memcpy(&word, src+idx, 8);
+	    if (word != UINT64_C(0xffffffffffffffff))
+		  return false;
+      }
+      for ( ; idx < cnt ; idx += 1) {
+	    if (src[idx] != 0xff)
+		  return false;
+      }
+      return true;
+}
+
+/*
+ * Workers take sectors from the shared counter until there are none
+ * left. Each sector is swizzled (if needed) into the worker's own
+ * scratch buffer before it is hashed. Blank sectors all hash the same,
+ * so they are only marked here, and hashed once later.
+ */
+static void hash_sector_worker(atomic<size_t>*next, vector<sector_hash_t>*res,
+			       const vector<uint8_t>*vec, size_t start_address,
+			       size_t sector_size, swizzle_t swizzle)
+{
+      vector<uint8_t> scratch;
+
+      for (;;) {
+	    size_t sec = next->fetch_add(1);
+	    if (sec >= res->size())
+		  break;
+
+	    size_t address = start_address + sec*sector_size;
+	    size_t len = min(sector_size, vec->size() - address);
+	    const uint8_t*src = &(*vec)[address];
+
+	    sector_hash_t&cur = (*res)[sec];
+	    cur.address = address;
+	    cur.size = len;
+	    cur.blank = is_blank(src, len);
+	    if (cur.blank)
+		  continue;
+
+	    if (swizzle != SWIZZLE_NONE) {
+		  scratch.resize(len);
+		  bit_swizzle(&scratch[0], src, len, swizzle);
+		  src = &scratch[0];
+	    }
+
+	    cur.crc = crc32c(src, len);
+	    sha256::digest(cur.sha, src, len);
+      }
+}
+
+void hash_flash_sectors(vector<sector_hash_t>&res, const vector<uint8_t>&vec,
+			size_t start_address, size_t sector_size,
+			swizzle_t swizzle, unsigned threads)
+{
+      metrics_phase phase ("sector hash", vec.size());
+
+	// The X16 layout swaps pairs of bytes, so the image must be
+	// whole pairs (see write_to_mcs).
+      assert(swizzle != SWIZZLE_X16 || (start_address % 2 == 0 && vec.size() % 2 == 0));
+
+      const size_t nsectors = start_address < vec.size()
+	    ? (vec.size() - start_address + sector_size - 1) / sector_size
+	    : 0;
+
+      res.resize(nsectors);
+
+      if (threads == 0)
+	    threads = thread::hardware_concurrency();
+      if (threads == 0)
+	    threads = 1;
+      if (threads > nsectors)
+	    threads = nsectors > 0? nsectors : 1;
+
+      atomic<size_t> next (0);
+      vector<thread> pool;
+      for (unsigned idx = 1 ; idx < threads ; idx += 1)
+	    pool.push_back(thread(hash_sector_worker, &next, &res, &vec,
+				  start_address, sector_size, swizzle));
+      hash_sector_worker(&next, &res, &vec, start_address, sector_size, swizzle);
+      for (size_t idx = 0 ; idx < pool.size() ; idx += 1)
+	    pool[idx].join();
+
+	// Hash a blank sector, and use that for all the blank sectors
+	// that are a whole sector long.
+      vector<uint8_t> blank (sector_size, 0xff);
+      uint32_t blank_crc = crc32c(&blank[0], sector_size);
+      uint8_t blank_sha[32];
+      sha256::digest(blank_sha, &blank[0], sector_size);
+
+      for (size_t sec = 0 ; sec < nsectors ; sec += 1) {
+	    sector_hash_t&cur = res[sec];
+	    if (! cur.blank)
+		  continue;
+	    if (cur.size == sector_size) {
+		  cur.crc = blank_crc;
+		  memcpy(cur.sha, blank_sha, 32);
+	    } else {
+		  cur.crc = crc32c(&blank[0], cur.size);
+		  sha256::digest(cur.sha, &blank[0], cur.size);
+	    }
+      }
+}
+
+bool write_flash_manifest(const char*path, const vector<uint8_t>&vec,
+			  size_t start_address, size_t sector_size,
+			  const vector<manifest_region_t>&regions,
+			  swizzle_t swizzle, unsigned threads)
+{
+      metrics_phase phase ("manifest");
+
+      vector<sector_hash_t> res;
+      hash_flash_sectors(res, vec, start_address, sector_size, swizzle, threads);
+
+      FILE*fd = fopen(path, "w");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to open manifest file: %s\n", path);
+	    return false;
+      }
+
+      fprintf(fd, "# quickboot flash manifest\n");
+      fprintf(fd, "sector-size 0x%08zx\n", sector_size);
+      fprintf(fd, "image 0x%08zx 0x%08zx\n", start_address,
+	      vec.size() > start_address? vec.size() - start_address : 0);
+
+      for (size_t idx = 0 ; idx < regions.size() ; idx += 1) {
+	    fprintf(fd, "region %s 0x%08zx 0x%08zx\n", regions[idx].name.c_str(),
+		    regions[idx].address, regions[idx].size);
+      }
+
+	// One line per sector: address, size, blank/data, CRC-32C
+	// and SHA-256.
+      for (size_t sec = 0 ; sec < res.size() ; sec += 1) {
+	    char sha_text[65];
+	    for (int idx = 0 ; idx < 32 ; idx += 1)
+		  snprintf(sha_text + 2*idx, 3, "%02x", res[sec].sha[idx]);
+	    fprintf(fd, "sector 0x%08zx 0x%08zx %s %08x %s\n", res[sec].address, res[sec].size,
+		    res[sec].blank? "blank" : "data", res[sec].crc, sha_text);
+      }
+
+      fclose(fd);
+      return true;
+}
+
+bool read_flash_manifest(const char*path, size_t&sector_size, vector<sector_hash_t>&res)
+{
+      FILE*fd = fopen(path, "r");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to open manifest file: %s\n", path);
+	    return false;
+      }
+
+      sector_size = 0;
+      res.clear();
+
+      char line[256];
+      size_t lineno = 0;
+      while (fgets(line, sizeof line, fd)) {
+	    lineno += 1;
+
+	    if (strncmp(line, "sector-size ", 12) == 0) {
+		  sector_size = strtoul(line+12, 0, 0);
+		  continue;
+	    }
+
+	    if (strncmp(line, "sector ", 7) != 0)
+		  continue;
+
+	    sector_hash_t cur;
+	    char flag[16], sha_text[65];
+	    if (sscanf(line+7, "%zx %zx %15s %x %64s", &cur.address, &cur.size,
+		       flag, &cur.crc, sha_text) != 5 || strlen(sha_text) != 64) {
+		  fprintf(stderr, "%s:%zu: Malformed sector line.\n", path, lineno);
+		  fclose(fd);
+		  return false;
+	    }
+
+	    cur.blank = strcmp(flag, "blank") == 0;
+	    for (int idx = 0 ; idx < 32 ; idx += 1) {
+		  unsigned val;
+		  sscanf(sha_text + 2*idx, "%2x", &val);
+		  cur.sha[idx] = val;
+	    }
+	    res.push_back(cur);
+      }
+
+      fclose(fd);
+
+      if (sector_size == 0) {
+	    fprintf(stderr, "%s: Not a flash manifest (no sector-size).\n", path);
+	    return false;
+      }
+
+      return true;
+}
@@ -0,0 +1,84 @@
+#ifndef __flash_manifest_H
+#define __flash_manifest_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "bit_swizzle.h"
+# include  <vector>
+# include  <string>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * A named region of the flash image, such as the gold or silver image
+ * of a design, or a quickboot header.
+ */
+struct manifest_region_t {
+      manifest_region_t(const std::string&n, size_t addr, size_t len)
+      : name(n), address(addr), size(len) { }
+
+      std::string name;
+      size_t address;
+      size_t size;
+};
+
+/*
+ * The hashes of one erase sector of a flash image.
+ */
+struct sector_hash_t {
+      size_t address;
+      size_t size;
+      bool blank;
+      uint32_t crc;
+      uint8_t sha[32];
+};
+
+/*
+ * Hash every erase sector of the image from start_address to the
+ * end. The sectors are hashed as they will be in the flash, after
+ * the swizzle is applied. The sectors are hashed by a pool of
+ * threads. A threads value of 0 means one per processor.
+ */
+extern void hash_flash_sectors(std::vector<sector_hash_t>&res, const std::vector<uint8_t>&vec,
+			       size_t start_address, size_t sector_size,
+			       swizzle_t swizzle, unsigned threads);
+
+/*
+ * Write a manifest of the flash image to the path. The manifest lists
+ * the regions, and the CRC-32C and SHA-256 of every erase sector of
+ * the image from start_address to the end, with a flag for sectors
+ * that are blank (all 0xff), as hash_flash_sectors() makes them, so
+ * that the flash can be checked by reading it back a sector at a time.
+ * Return false if the file cannot be written.
+ */
+extern bool write_flash_manifest(const char*path, const std::vector<uint8_t>&vec,
+				 size_t start_address, size_t sector_size,
+				 const std::vector<manifest_region_t>&regions,
+				 swizzle_t swizzle, unsigned threads);
+
+/*
+ * Read back the sector size and sector hashes from a manifest that
+ * write_flash_manifest() wrote. Return false (after printing a
+ * message) if the file cannot be read or is not a manifest.
+ */
+extern bool read_flash_manifest(const char*path, size_t&sector_size,
+				std::vector<sector_hash_t>&res);
+
+#endif
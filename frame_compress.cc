@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "frame_compress.h"
+# include  "frame_map.h"
+# include  "packet_index.h"
+# include  "stream_crc.h"
+# include  "disable_stream_crc.h"
+# include  "metrics.h"
+# include  <algorithm>
+# include  <map>
+# include  <cstdlib>
+# include  <cstring>
+# include  <cassert>
+
+using namespace std;
+
+static const uint32_t WRITE_FAR  = 0x30002001;
+static const uint32_t WRITE_CMD  = 0x30008001;
+static const uint32_t WRITE_FDRI = 0x30004000;
+static const uint32_t WRITE_MFWR = 0x30014002;
+static const uint32_t TYPE2_WRITE = 0x50000000;
+static const uint32_t NOOP = 0x20000000;
+static const uint32_t CMD_WCFG = 0x01;
+static const uint32_t CMD_MFW  = 0x02;
+
+/*
+ * Words that it takes to write a frame with MFWR (a FAR write and a
+ * two word MFWR write), to start another FDRI write (the pad frame,
+ * FAR and WCFG writes, a NOP and the two FDRI headers), and to load a
+ * frame to copy (an FDRI write of the frame without a pad, and the
+ * MFW command).
+ */
+static const size_t mfwr_frame_words = 5;
+static size_t split_words(size_t fw) { return fw + 7; }
+static size_t group_words(size_t fw) { return fw + 9; }
+
+static void put_packet_word(vector<uint8_t>&dst, uint32_t val)
+{
+      size_t ptr = dst.size();
+      dst.resize(ptr + 4);
+      put_word(&dst[ptr], val);
+}
+
+/*
+ * Write count frames, starting with the frame at src, to the frame
+ * address far. If pad is true, they are followed by the pad frame
+ * that pushes the last frame out of the frame buffer. Without the pad,
+ * the last frame stays in the frame buffer, which is how the source
+ * of the MFW command is loaded.
+ */
+static void put_frames(vector<uint8_t>&dst, uint32_t far, const uint8_t*src,
+		       size_t count, size_t fw, bool pad)
+{
+      const size_t words = (pad? count+1 : count) * fw;
+
+      put_packet_word(dst, WRITE_FAR);
+      put_packet_word(dst, far);
+      put_packet_word(dst, WRITE_CMD);
+      put_packet_word(dst, CMD_WCFG);
+      put_packet_word(dst, NOOP);
+      put_packet_word(dst, WRITE_FDRI);
+      put_packet_word(dst, TYPE2_WRITE | words);
+
+      size_t ptr = dst.size();
+      dst.resize(ptr + 4*words, 0);
+      memcpy(&dst[ptr], src, 4*count*fw);
+}
+
+/*
+ * The device model of the replay: an FDRI write of N frames writes
+ * the first N-1 to the FAR and the addresses that follow it, and
+ * leaves the last one in the frame buffer. An MFWR write copies the
+ * frame buffer to the FAR. The FAR advances in the order of the frame
+ * address list, which is the order of the frames in the original
+ * stream.
+ */
+bool replay_frame_writes(map<uint32_t,const uint8_t*>&dst, const uint8_t*vec,
+			 const packet_index&index, size_t fw,
+			 const vector<uint32_t>&addresses, FILE*err)
+{
+      map<uint32_t,size_t> position;
+      for (size_t idx = 0 ; idx < addresses.size() ; idx += 1)
+	    position[addresses[idx]] = idx;
+
+      dst.clear();
+      uint32_t far = 0;
+      const uint8_t*frame_buffer = 0;
+
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.opcode != 2 || pkt.word_count == 0)
+		  continue;
+
+	    const uint8_t*data = vec + pkt.offset + 4;
+
+	    if (pkt.reg == 0x01) {
+		  far = get_word(data);
+
+	    } else if (pkt.reg == 0x02) {
+		  if (pkt.word_count % fw != 0) {
+			fprintf(err, "Replay: FDRI write of %u words is not whole frames.\n",
+				pkt.word_count);
+			return false;
+		  }
+
+		  const size_t count = pkt.word_count / fw;
+		  map<uint32_t,size_t>::const_iterator cur = position.find(far);
+		  if (count > 1 && (cur == position.end() || cur->second + count-1 > addresses.size())) {
+			fprintf(err, "Replay: FDRI write at FAR 0x%08x is outside the "
+				"frame address list.\n", far);
+			return false;
+		  }
+		  for (size_t frame = 0 ; frame+1 < count ; frame += 1)
+			dst[addresses[cur->second + frame]] = data + 4*fw*frame;
+		  frame_buffer = data + 4*fw*(count-1);
+
+	    } else if (pkt.reg == 0x0a) {
+		  if (frame_buffer == 0) {
+			fprintf(err, "Replay: MFWR write before any frame is loaded.\n");
+			return false;
+		  }
+		  dst[far] = frame_buffer;
+	    }
+      }
+
+      return true;
+}
+
+/*
+ * Replay the rewritten stream, and check that each frame address gets
+ * the same frame as in the original stream, and no other address is
+ * written. Both replays use the same address list, so this checks the
+ * bookkeeping of the rewrite, not the list.
+ */
+static bool verify_rewrite(const vector<uint8_t>&out, const vector<uint8_t>&vec,
+			   const frame_map&frames, size_t nframes, size_t fw,
+			   const vector<uint32_t>&addresses, FILE*err)
+{
+      packet_index index;
+      index.build(out);
+
+      map<uint32_t,const uint8_t*> written;
+      if (! replay_frame_writes(written, &out[0], index, fw, addresses, err))
+	    return false;
+
+      if (written.size() != nframes) {
+	    fprintf(err, "Replay: %zu frames written, expected %zu.\n", written.size(), nframes);
+	    return false;
+      }
+
+      for (size_t idx = 0 ; idx < nframes ; idx += 1) {
+	    map<uint32_t,const uint8_t*>::const_iterator cur = written.find(addresses[idx]);
+	    if (cur == written.end() || memcmp(cur->second, &vec[frames[idx].offset], 4*fw) != 0) {
+		  fprintf(err, "Replay: frame %zu (FAR 0x%08x) does not match the input.\n",
+			  idx, addresses[idx]);
+		  return false;
+	    }
+      }
+
+      return true;
+}
+
+bool read_frame_addresses(vector<uint32_t>&dst, const char*path, size_t count, FILE*err)
+{
+      FILE*fd = fopen(path, "r");
+      if (fd == 0) {
+	    fprintf(err, "Unable to open frame address file: %s\n", path);
+	    return false;
+      }
+
+      dst.clear();
+      char line[256];
+      size_t lineno = 0;
+      while (fgets(line, sizeof line, fd)) {
+	    lineno += 1;
+	    char*cp = line + strspn(line, " \t");
+	    if (*cp == '#' || *cp == '\n' || *cp == '\r' || *cp == 0)
+		  continue;
+
+	    char*ep;
+	    unsigned long far = strtoul(cp, &ep, 16);
+	    ep += strspn(ep, " \t\r\n");
+	    if (ep == cp || *ep != 0 || far > 0xffffffffUL) {
+		  fprintf(err, "%s:%zu: Not a frame address: %s", path, lineno, cp);
+		  fclose(fd);
+		  return false;
+	    }
+	    dst.push_back(far);
+      }
+
+      fclose(fd);
+
+      if (dst.size() != count) {
+	    fprintf(err, "Frame address file %s has %zu addresses, but the stream "
+		    "has %zu frames.\n", path, dst.size(), count);
+	    return false;
+      }
+
+	// Each address is written once, so they must all differ.
+      vector<uint32_t> sorted (dst);
+      sort(sorted.begin(), sorted.end());
+      for (size_t idx = 1 ; idx < sorted.size() ; idx += 1) {
+	    if (sorted[idx] == sorted[idx-1]) {
+		  fprintf(err, "Frame address file %s lists FAR 0x%08x more than once.\n",
+			  path, sorted[idx]);
+		  return false;
+	    }
+      }
+
+      return true;
+}
+
+bool compress_stream(vector<uint8_t>&vec, const char*name,
+		     const compress_options_t&opt, compress_result_t&res,
+		     FILE*log, FILE*err)
+{
+      metrics_phase phase ("frame compress", vec.size());
+
+      memset(&res, 0, sizeof res);
+      res.bytes_in = vec.size();
+      res.bytes_out = vec.size();
+
+      packet_index index;
+      index.build(vec);
+
+      frame_map frames;
+      frames.build(&vec[0], index, stream_family(&vec[0], index), opt.threads);
+      const size_t fw = frames.frame_words();
+
+	// Only the usual layout, with all the frames in one FDRI write
+	// and a pad frame at the end, is rewritten.
+      if (frames.writes().size() != 1 || frames.mfwr_writes() > 0
+	  || frames.writes()[0].frames < 2 || frames.writes()[0].extra_words != 0) {
+	    fprintf(log, "Frame compression (%s): frames are not in one FDRI write, "
+		    "not compressed.\n", name);
+	    return true;
+      }
+
+      const frame_write_t&write = frames.writes()[0];
+      const size_t nframes = write.frames - 1;
+      res.frames = nframes;
+
+      vector<uint32_t> addresses;
+      if (! opt.frame_addresses.empty()) {
+	    if (! read_frame_addresses(addresses, opt.frame_addresses.c_str(), nframes, err)) {
+		  fprintf(err, "The %s stream is not compressed.\n", name);
+		  return false;
+	    }
+      }
+
+	// The frame that each frame is a copy of, or itself. The zero
+	// frames are all copies of the first zero frame.
+      vector<size_t> rep (nframes);
+      size_t first_zero = nframes;
+      for (size_t idx = 0 ; idx < nframes ; idx += 1) {
+	    if (frames[idx].nonzero_words == 0) {
+		  if (first_zero == nframes)
+			first_zero = idx;
+		  rep[idx] = first_zero;
+		  if (idx != first_zero)
+			res.zero_frames += 1;
+	    } else {
+		    // The hashes only find candidates; a frame is only a
+		    // copy if the words match.
+		  const size_t first = frames[idx].first;
+		  if (first != idx && memcmp(&vec[frames[first].offset],
+					     &vec[frames[idx].offset], 4*fw) == 0)
+			rep[idx] = first;
+		  else
+			rep[idx] = idx;
+		  if (rep[idx] != idx)
+			res.duplicate_frames += 1;
+	    }
+      }
+
+	// A run of copies is left out of the FDRI write if the words
+	// that it saves pay for splitting the write in two.
+      vector<bool> drop (nframes, false);
+      size_t idx = 0;
+      while (idx < nframes) {
+	    if (rep[idx] == idx) {
+		  idx += 1;
+		  continue;
+	    }
+
+	    size_t end = idx;
+	    while (end < nframes && rep[end] != end)
+		  end += 1;
+
+	    if ((end - idx) * (fw - mfwr_frame_words) > split_words(fw)) {
+		  for (size_t cur = idx ; cur < end ; cur += 1)
+			drop[cur] = true;
+	    }
+
+	    idx = end;
+      }
+
+	// A frame that is copied must be loaded again, so that must
+	// also pay for itself.
+      vector<size_t> copies (nframes, 0);
+      for (idx = 0 ; idx < nframes ; idx += 1) {
+	    if (drop[idx])
+		  copies[rep[idx]] += 1;
+      }
+
+      vector< pair<size_t,size_t> > mfwr;
+      for (idx = 0 ; idx < nframes ; idx += 1) {
+	    if (! drop[idx])
+		  continue;
+	    if (copies[rep[idx]] * (fw - mfwr_frame_words) <= group_words(fw))
+		  drop[idx] = false;
+	    else
+		  mfwr.push_back(make_pair(rep[idx], idx));
+      }
+
+      sort(mfwr.begin(), mfwr.end());
+      res.mfwr_frames = mfwr.size();
+
+	// Make the new frame data section: the runs of frames that are
+	// still written through FDRI, then the MFWR writes of each
+	// set of copies. Without the frame addresses, this is only to
+	// measure the result.
+      vector<uint8_t> sec;
+      idx = 0;
+      while (idx < nframes) {
+	    if (drop[idx]) {
+		  idx += 1;
+		  continue;
+	    }
+
+	    size_t end = idx;
+	    while (end < nframes && ! drop[end])
+		  end += 1;
+
+	    put_frames(sec, addresses.empty()? 0 : addresses[idx],
+		       &vec[frames[idx].offset], end - idx, fw, true);
+	    idx = end;
+      }
+
+      for (idx = 0 ; idx < mfwr.size() ; idx += 1) {
+	    const size_t src = mfwr[idx].first;
+	    if (idx == 0 || mfwr[idx-1].first != src) {
+		  put_frames(sec, addresses.empty()? 0 : addresses[src],
+			     &vec[frames[src].offset], 1, fw, false);
+		  put_packet_word(sec, WRITE_CMD);
+		  put_packet_word(sec, CMD_MFW);
+	    }
+
+	    put_packet_word(sec, WRITE_FAR);
+	    put_packet_word(sec, addresses.empty()? 0 : addresses[mfwr[idx].second]);
+	    put_packet_word(sec, WRITE_MFWR);
+	    put_packet_word(sec, 0);
+	    put_packet_word(sec, 0);
+      }
+
+	// The section replaces the FDRI write, and the type-1 FDRI
+	// header in front of it.
+      const packet_info_t&pkt = index[write.packet];
+      size_t sec_start = pkt.offset;
+      if (write.packet > 0) {
+	    const packet_info_t&prev = index[write.packet - 1];
+	    if (pkt.type == 2 && prev.type == 1 && prev.reg == 0x02 && prev.word_count == 0)
+		  sec_start = prev.offset;
+      }
+      const size_t sec_end = pkt.offset + 4 + 4*(size_t)pkt.word_count;
+
+      res.bytes_out = vec.size() - (sec_end - sec_start) + sec.size();
+      if (res.mfwr_frames == 0)
+	    res.bytes_out = vec.size();
+
+      const double saved = 100.0 * (1.0 - (double)res.bytes_out / res.bytes_in);
+      fprintf(log, "Frame compression (%s): %zu frames, %zu all-zero, %zu copies, "
+	      "%zu written with MFWR\n", name, res.frames, res.zero_frames,
+	      res.duplicate_frames, res.mfwr_frames);
+      fprintf(log, "... %zu -> %zu bytes (%.2f:1, %.1f%% less to load at configuration)\n",
+	      res.bytes_in, res.bytes_out, (double)res.bytes_in / res.bytes_out, saved);
+
+      if (res.mfwr_frames == 0)
+	    return true;
+
+      if (addresses.empty()) {
+	    fprintf(log, "... not rewritten: the frame addresses are not known "
+		    "(use --frame-addresses=<path>)\n");
+	    return true;
+      }
+
+      size_t crc_checks = 0;
+      const crc_model_t crc_model = check_stream_crcs(&vec[0], index, crc_checks);
+
+      vector<uint8_t> out;
+      out.reserve(res.bytes_out);
+      out.insert(out.end(), vec.begin(), vec.begin() + sec_start);
+      out.insert(out.end(), sec.begin(), sec.end());
+      out.insert(out.end(), vec.begin() + sec_end, vec.end());
+      assert(out.size() == res.bytes_out);
+
+      if (! verify_rewrite(out, vec, frames, nframes, fw, addresses, err)) {
+	    fprintf(err, "Frame compression (%s): the rewritten stream does not "
+		    "replay to the input frames.\n", name);
+	    return false;
+      }
+      fprintf(log, "... replay of the FAR/FDRI/MFWR writes matches the input frames (with the same address list)\n");
+
+      vec.swap(out);
+
+      index.build(vec);
+      if (crc_model != CRC_MODEL_NONE) {
+	    size_t crc_count = update_stream_crcs(&vec[0], index, crc_model);
+	    fprintf(log, "... recomputed %zu CRC checks\n", crc_count);
+
+      } else if (crc_checks > 0) {
+	    size_t crc_count = disable_stream_crcs(&vec[0], index);
+	    fprintf(log, "... %zu CRC checks disabled\n", crc_count);
+      }
+
+      res.rewritten = true;
+      return true;
+}
+
+bool parse_compress_flag(compress_options_t&opt, const char*flag)
+{
+      if (strcmp(flag,"--compress") == 0) {
+	    opt.compress = true;
+	    return true;
+      }
+
+      if (strncmp(flag,"--frame-addresses=",18) == 0) {
+	    opt.compress = true;
+	    opt.frame_addresses = flag + 18;
+	    return true;
+      }
+
+      return false;
+}
@@ -0,0 +1,114 @@
+#ifndef __frame_compress_H
+#define __frame_compress_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <map>
+# include  <string>
+# include  <cstdio>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * Frame compression replaces the frames of a stream that are all zero
+ * or that are copies of another frame with multiple frame writes
+ * (MFWR), the way the compressed streams of the vendor tools do. Each
+ * set of identical frames is written through FDRI once, and then the
+ * MFW command copies it to the address of each of the others.
+ *
+ * To write a frame with MFWR, its frame address must be known. In the
+ * usual layout, the frames are all in one long FDRI write, and the FAR
+ * advances through them in an order that depends on the geometry of
+ * the device, which the stream does not hold. So the stream is only
+ * rewritten if the frame addresses are given; otherwise the savings
+ * are only estimated.
+ */
+
+class packet_index;
+
+struct compress_options_t {
+      compress_options_t() : compress(false), threads(0) { }
+
+      bool compress;
+	// A file that lists the FAR of each data frame of the FDRI
+	// write, in stream order, one hex number per line.
+      std::string frame_addresses;
+      unsigned threads;
+};
+
+struct compress_result_t {
+	// Data frames, not counting the pad frame after each write.
+      size_t frames;
+      size_t zero_frames;
+      size_t duplicate_frames;
+	// Frames that are written with MFWR.
+      size_t mfwr_frames;
+      size_t bytes_in;
+      size_t bytes_out;
+      bool rewritten;
+};
+
+/*
+ * Find the frames that can be written with MFWR, and rewrite the
+ * stream (which includes the 0xff pad) if the options give the frame
+ * addresses. The input and the rewritten stream are both replayed
+ * (see replay_frame_writes) with the same address list, and the
+ * rewrite is refused if they do not give each address the same frame.
+ * That catches slips of the writer, not a wrong address list or a
+ * device that advances the FAR some other way. The CRC checks are
+ * recomputed if they validate before.
+ * The stream name is for the messages in the log. Return false (after
+ * printing a message to err) if the frame addresses cannot be used.
+ */
+extern bool compress_stream(std::vector<uint8_t>&vec, const char*name,
+			    const compress_options_t&opt, compress_result_t&res,
+			    FILE*log, FILE*err =stderr);
+
+/*
+ * Read a frame address list for a stream with count frames. Return
+ * false (after printing a message to err) if the file cannot be read,
+ * has a line that is not a hex address, lists an address twice, or
+ * does not have exactly count addresses.
+ */
+extern bool read_frame_addresses(std::vector<uint32_t>&dst, const char*path,
+				 size_t count, FILE*err =stderr);
+
+/*
+ * Replay the FAR, FDRI and MFWR writes of a stream with frames of fw
+ * words, and make the map from each frame address that is written to
+ * the data that it gets. The FAR advances through an FDRI write in
+ * the order of the addresses list, and the last frame of each FDRI
+ * write stays in the frame buffer, which is what MFWR copies. This
+ * is a model that follows the address list, not the device, so it can
+ * only compare two streams that use the same list.
+ * Return false (after printing a message to err) if the writes do
+ * not fit the model.
+ */
+extern bool replay_frame_writes(std::map<uint32_t,const uint8_t*>&dst, const uint8_t*vec,
+				const packet_index&index, size_t fw,
+				const std::vector<uint32_t>&addresses, FILE*err =stderr);
+
+/*
+ * Interpret the --compress and --frame-addresses=<path> flags.
+ */
+extern bool parse_compress_flag(compress_options_t&opt, const char*flag);
+
+#endif
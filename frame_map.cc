@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "frame_map.h"
+# include  "packet_index.h"
+# include  "work_pool.h"
+# include  "metrics.h"
+# include  <unordered_map>
+# include  <algorithm>
+# include  <cstring>
+# include  <cassert>
+
+using namespace std;
+
+static const uint16_t REG_FAR    = 0x01;
+static const uint16_t REG_FDRI   = 0x02;
+static const uint16_t REG_MFWR   = 0x0a;
+static const uint16_t REG_IDCODE = 0x0c;
+
+const char* family_name(device_family_t family)
+{
+      switch (family) {
+	  case FAMILY_ULTRASCALE:
+	    return "ultrascale";
+	  case FAMILY_ULTRASCALE_PLUS:
+	    return "ultrascale+";
+	  default:
+	    return "7series";
+      }
+}
+
+size_t family_frame_words(device_family_t family)
+{
+      switch (family) {
+	  case FAMILY_ULTRASCALE:
+	    return 123;
+	  case FAMILY_ULTRASCALE_PLUS:
+	    return 93;
+	  default:
+	    return 101;
+      }
+}
+
+/*
+ * The family is bits [27:21] of the IDCODE.
+ */
+bool family_from_idcode(uint32_t idcode, device_family_t&family)
+{
+      unsigned code = (idcode >> 21) & 0x7f;
+      if (code == 0x1b) {
+	    family = FAMILY_7SERIES;
+	    return true;
+      }
+      if (code == 0x1c) {
+	    family = FAMILY_ULTRASCALE;
+	    return true;
+      }
+      if (code >= 0x23 && code <= 0x27) {
+	    family = FAMILY_ULTRASCALE_PLUS;
+	    return true;
+      }
+      return false;
+}
+
+device_family_t stream_family(const uint8_t*vec, const packet_index&index)
+{
+      device_family_t family = FAMILY_7SERIES;
+      if (index.header_write(REG_IDCODE))
+	    family_from_idcode(index.extract_register_write(vec, REG_IDCODE), family);
+      return family;
+}
+
+frame_address_t decode_frame_address(uint32_t far, device_family_t family)
+{
+      frame_address_t res;
+      switch (family) {
+	  case FAMILY_ULTRASCALE_PLUS:
+	    res.block  = (far >> 24) & 0x7;
+	    res.top    = 0;
+	    res.row    = (far >> 18) & 0x3f;
+	    res.column = (far >>  8) & 0x3ff;
+	    res.minor  = (far >>  0) & 0xff;
+	    break;
+	  case FAMILY_ULTRASCALE:
+	    res.block  = (far >> 23) & 0x7;
+	    res.top    = 0;
+	    res.row    = (far >> 17) & 0x3f;
+	    res.column = (far >>  7) & 0x3ff;
+	    res.minor  = (far >>  0) & 0x7f;
+	    break;
+	  default:
+	    res.block  = (far >> 23) & 0x7;
+	    res.top    = (far >> 22) & 0x1;
+	    res.row    = (far >> 17) & 0x1f;
+	    res.column = (far >>  7) & 0x3ff;
+	    res.minor  = (far >>  0) & 0x7f;
+	    break;
+      }
+      return res;
+}
+
+frame_map::frame_map()
+: family_(FAMILY_7SERIES), frame_words_(family_frame_words(FAMILY_7SERIES)),
+  zero_frames_(0), duplicate_frames_(0), mfwr_writes_(0)
+{
+}
+
+/*
+ * This only needs to find the same frames, and does not need to
+ * stand up to an attacker, so a multiply and xor for each word, with
+ * a final mix, is enough.
+ */
+uint64_t frame_map::hash_frame(const uint8_t*data, size_t nwords, uint32_t&nonzero_words)
+{
+      uint64_t hash = 0xcbf29ce484222325ULL;
+      uint32_t count = 0;
+      for (size_t idx = 0 ; idx < nwords ; idx += 1) {
+	    uint32_t word;
+	    memcpy(&word, data + 4*idx, 4);
+	    count += word != 0;
+	    hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+      }
+
+      hash ^= hash >> 33;
+      hash *= 0xff51afd7ed558ccdULL;
+      hash ^= hash >> 33;
+      hash *= 0xc4ceb9fe1a85ec53ULL;
+      hash ^= hash >> 33;
+
+      nonzero_words = count;
+      return hash;
+}
+
+struct hash_frames_arg_t {
+      const uint8_t*vec;
+      vector<frame_info_t>*frames;
+      size_t frame_words;
+};
+
+static const size_t frames_per_task = 1024;
+
+static void hash_frames_task(size_t idx, void*arg)
+{
+      hash_frames_arg_t*hash_arg = (hash_frames_arg_t*)arg;
+      vector<frame_info_t>&frames = *hash_arg->frames;
+
+      size_t end = min(frames.size(), (idx+1) * frames_per_task);
+      for (size_t fdx = idx * frames_per_task ; fdx < end ; fdx += 1) {
+	    frame_info_t&cur = frames[fdx];
+	    cur.hash = frame_map::hash_frame(hash_arg->vec + cur.offset,
+					     hash_arg->frame_words, cur.nonzero_words);
+      }
+}
+
+void frame_map::build(const uint8_t*vec, const packet_index&index,
+		      device_family_t family, unsigned threads)
+{
+      metrics_phase phase ("frame map");
+
+      family_ = family;
+      frame_words_ = family_frame_words(family);
+      frames_.clear();
+      writes_.clear();
+      zero_frames_ = 0;
+      duplicate_frames_ = 0;
+      mfwr_writes_ = 0;
+
+	// Walk the packets, and keep track of the FAR, to find where
+	// all the frames are.
+      uint32_t far = 0;
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.opcode != 2)
+		  continue;
+
+	    if (pkt.reg == REG_FAR && pkt.word_count == 1) {
+		  far = get_word(vec + pkt.offset + 4);
+		  continue;
+	    }
+
+	    if (pkt.reg == REG_MFWR) {
+		  mfwr_writes_ += 1;
+		  continue;
+	    }
+
+	    if (pkt.reg != REG_FDRI || pkt.word_count == 0)
+		  continue;
+
+	    frame_write_t write;
+	    write.packet = idx;
+	    write.far = far;
+	    write.first_frame = frames_.size();
+	    write.frames = pkt.word_count / frame_words_;
+	    write.extra_words = pkt.word_count % frame_words_;
+	    writes_.push_back(write);
+
+	    for (size_t fdx = 0 ; fdx < write.frames ; fdx += 1) {
+		  frame_info_t cur;
+		  cur.offset = pkt.offset + 4 + 4*fdx*frame_words_;
+		  cur.far = far;
+		  cur.index = fdx;
+		  cur.nonzero_words = 0;
+		  cur.first = frames_.size();
+		  cur.hash = 0;
+		  frames_.push_back(cur);
+	    }
+      }
+
+      phase.add_bytes(frames_.size() * 4 * frame_words_);
+
+      hash_frames_arg_t arg;
+      arg.vec = vec;
+      arg.frames = &frames_;
+      arg.frame_words = frame_words_;
+      work_pool pool (threads);
+      pool.run((frames_.size() + frames_per_task - 1) / frames_per_task, hash_frames_task, &arg);
+
+	// Find the copies in stream order, so that the first of a set
+	// of identical frames is the one that the others refer to.
+      unordered_map<uint64_t,size_t> seen;
+      seen.reserve(frames_.size());
+      for (size_t idx = 0 ; idx < frames_.size() ; idx += 1) {
+	    frame_info_t&cur = frames_[idx];
+	    if (cur.nonzero_words == 0) {
+		  zero_frames_ += 1;
+		  continue;
+	    }
+
+	    pair<unordered_map<uint64_t,size_t>::iterator,bool> res
+		  = seen.insert(make_pair(cur.hash, idx));
+	    if (! res.second) {
+		  cur.first = res.first->second;
+		  duplicate_frames_ += 1;
+	    }
+      }
+}
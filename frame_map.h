@@ -0,0 +1,143 @@
+#ifndef __frame_map_H
+#define __frame_map_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <cstdint>
+# include  <cstddef>
+
+class packet_index;
+
+/*
+ * The configuration frames of a stream, as written to FDRI. Each FDRI
+ * write starts at the frame address in the FAR register, and holds a
+ * whole number of frames. The frame size and the layout of the FAR
+ * depend on the device family.
+ */
+enum device_family_t {
+      FAMILY_7SERIES = 0,
+      FAMILY_ULTRASCALE,
+      FAMILY_ULTRASCALE_PLUS
+};
+
+extern const char* family_name(device_family_t family);
+extern size_t family_frame_words(device_family_t family);
+
+/*
+ * Get the family from the family field of an IDCODE. Return false if
+ * it is not a family that is known here.
+ */
+extern bool family_from_idcode(uint32_t idcode, device_family_t&family);
+
+/*
+ * Get the family from the IDCODE write in the header of the stream,
+ * or 7-series if there is none.
+ */
+extern device_family_t stream_family(const uint8_t*vec, const packet_index&index);
+
+/*
+ * The fields of a frame address. The 7-series FAR has a top/bottom
+ * bit, and the later families do not, so top is always 0 for them.
+ */
+struct frame_address_t {
+      unsigned block;
+      unsigned top;
+      unsigned row;
+      unsigned column;
+      unsigned minor;
+};
+
+extern frame_address_t decode_frame_address(uint32_t far, device_family_t family);
+
+struct frame_info_t {
+	// Offset of the frame data in the stream.
+      size_t offset;
+	// FAR of the write that holds the frame, and the number of
+	// the frame in that write.
+      uint32_t far;
+      uint32_t index;
+	// Number of data words that are not zero.
+      uint32_t nonzero_words;
+	// Index of the first frame in the stream with the same hash,
+	// which is this frame if there is no earlier one. All-zero
+	// frames are not matched with each other.
+      size_t first;
+      uint64_t hash;
+};
+
+struct frame_write_t {
+	// Index of the FDRI packet in the packet_index.
+      size_t packet;
+      uint32_t far;
+      size_t first_frame;
+      size_t frames;
+	// Data words after the last whole frame.
+      size_t extra_words;
+};
+
+/*
+ * A frame_map splits all the FDRI writes of a stream into frames, and
+ * hashes the frames on a pool of threads. It does not know the
+ * geometry of the device, so it does not know how the FAR advances
+ * from frame to frame within a write; the frames of a write all have
+ * the FAR of the write, and their number in it.
+ */
+class frame_map {
+
+    public:
+      frame_map();
+
+      void build(const uint8_t*vec, const packet_index&index,
+		 device_family_t family, unsigned threads =0);
+
+      device_family_t family() const { return family_; }
+      size_t frame_words() const { return frame_words_; }
+
+      size_t size() const { return frames_.size(); }
+      const frame_info_t& operator[] (size_t idx) const { return frames_[idx]; }
+
+      const std::vector<frame_write_t>& writes() const { return writes_; }
+
+	// Number of frames that are all zero, and of frames that are
+	// copies of an earlier frame.
+      size_t zero_frames() const { return zero_frames_; }
+      size_t duplicate_frames() const { return duplicate_frames_; }
+	// Number of writes to the MFWR register.
+      size_t mfwr_writes() const { return mfwr_writes_; }
+
+	// Hash a frame of the given number of words.
+      static uint64_t hash_frame(const uint8_t*data, size_t nwords, uint32_t&nonzero_words);
+
+    private:
+      device_family_t family_;
+      size_t frame_words_;
+      std::vector<frame_info_t> frames_;
+      std::vector<frame_write_t> writes_;
+      size_t zero_frames_;
+      size_t duplicate_frames_;
+      size_t mfwr_writes_;
+
+    private: // not implemented
+      frame_map(const frame_map&);
+      frame_map& operator= (const frame_map&);
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "map_file.h"
+# ifndef _WIN32
+# include  <sys/types.h>
+# include  <sys/stat.h>
+# include  <sys/mman.h>
+# include  <fcntl.h>
+# include  <unistd.h>
+# endif
+
+using namespace std;
+
+mapped_file::mapped_file()
+: data_(0), size_(0), map_base_(0)
+{
+}
+
+mapped_file::~mapped_file()
+{
+      unmap();
+}
+
+void mapped_file::unmap()
+{
+# ifndef _WIN32
+      if (map_base_)
+	    munmap(map_base_, size_);
+# endif
+      map_base_ = 0;
+      buf_.clear();
+      data_ = 0;
+      size_ = 0;
+}
+
+bool mapped_file::map(FILE*fd, FILE*err)
+{
+      unmap();
+
+# ifndef _WIN32
+	// Only a regular file has a size to map or read. A directory
+	// or a pipe is refused here, before anything is allocated.
+      int fdn = fileno(fd);
+      struct stat sb;
+      if (fstat(fdn, &sb) != 0 || ! S_ISREG(sb.st_mode)) {
+	    fprintf(err, "Not a regular file.\n");
+	    return false;
+      }
+      if (sb.st_size == 0) {
+	    fprintf(err, "File is empty.\n");
+	    return false;
+      }
+
+      size_t file_size = sb.st_size;
+	// We are going to read the whole file front to back, so tell
+	// the kernel to start reading ahead now.
+      posix_fadvise(fdn, 0, 0, POSIX_FADV_SEQUENTIAL);
+      posix_fadvise(fdn, 0, 0, POSIX_FADV_WILLNEED);
+      void*ptr = mmap(0, file_size, PROT_READ, MAP_PRIVATE, fdn, 0);
+      if (ptr != MAP_FAILED) {
+	    madvise(ptr, file_size, MADV_SEQUENTIAL);
+	    madvise(ptr, file_size, MADV_WILLNEED);
+	    map_base_ = ptr;
+	    data_ = (const uint8_t*)ptr;
+	    size_ = file_size;
+	    return true;
+      }
+# else
+      fseek(fd, 0, SEEK_END);
+      long end = ftell(fd);
+      if (end < 0) {
+	    fprintf(err, "Not a regular file.\n");
+	    return false;
+      }
+      if (end == 0) {
+	    fprintf(err, "File is empty.\n");
+	    return false;
+      }
+      size_t file_size = end;
+# endif
+
+	// If the file cannot be mapped, then fall back on reading
+	// the file contents into a local buffer.
+      buf_.resize(file_size);
+
+      fseek(fd, 0, SEEK_SET);
+      size_t rc = fread(&buf_[0], 1, file_size, fd);
+      if (rc != file_size) {
+	    fprintf(err, "Unable to read file bytes\n");
+	    unmap();
+	    return false;
+      }
+
+      data_ = &buf_[0];
+      size_ = file_size;
+      return true;
+}
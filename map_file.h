@@ -0,0 +1,59 @@
+#ifndef __map_file_H
+#define __map_file_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <cstdio>
+# include  <cstdint>
+
+/*
+ * A mapped_file is the read-only contents of an open file. The file
+ * is mapped into memory if possible, and otherwise read into a
+ * buffer. Either way, the contents stay valid after the FILE is
+ * closed, until the mapped_file is unmapped or destroyed.
+ */
+class mapped_file {
+
+    public:
+      mapped_file();
+      ~mapped_file();
+
+	// Map the entire file. Return false (after printing a
+	// message to err) if the file cannot be read, is empty, or
+	// is not a regular file.
+      bool map(FILE*fd, FILE*err =stderr);
+      void unmap();
+
+      const uint8_t*data() const { return data_; }
+      size_t size() const { return size_; }
+
+    private:
+      const uint8_t*data_;
+      size_t size_;
+      void*map_base_;
+      std::vector<uint8_t> buf_;
+
+    private: // not implemented
+      mapped_file(const mapped_file&);
+      mapped_file& operator= (const mapped_file&);
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Decode an .mcs file back into the flash image that it writes. This
+ * is useful for checking an existing .mcs file, or for turning it
+ * into a binary image that other tools can use.
+ *
+ * COMMAND LINE FLAGS:
+ *   --input=<path>   The .mcs file to decode.
+ *
+ *   --output=<path>  Write the decoded image to this file as a raw
+ *                    binary. The image starts at flash address
+ *                    --base, and bytes that the .mcs file does not
+ *                    write are 0xff.
+ *
+ *   --base=<number> (default: 0)
+ *                    Flash address of the first byte of the output.
+ *
+ *   --extents
+ *                    List the extents (contiguous runs of bytes) that
+ *                    the .mcs file writes.
+ *
+ *   --timings
+ *   --metrics-json=<path>
+ *                    Print the wall and CPU time, bytes and allocations
+ *                    of each phase of the work to stderr, or write them
+ *                    with a trace timeline to a JSON file.
+ */
+
+# include  "read_mcs_file.h"
+# include  "map_file.h"
+# include  "metrics.h"
+# include  <vector>
+# include  <chrono>
+# include  <cstdint>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+
+using namespace std;
+
+int main(int argc, char*argv[])
+{
+      const char*path_in = 0;
+      const char*path_out = 0;
+      size_t base_address = 0;
+      bool list_extents = false;
+
+      for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+
+	    if (strncmp(argv[optarg],"--input=",8) == 0) {
+		  path_in = argv[optarg] + 8;
+
+	    } else if (strncmp(argv[optarg],"--output=",9) == 0) {
+		  path_out = argv[optarg] + 9;
+
+	    } else if (strncmp(argv[optarg],"--base=",7) == 0) {
+		  base_address = strtoul(argv[optarg]+7, 0, 0);
+
+	    } else if (strcmp(argv[optarg],"--extents") == 0) {
+		  list_extents = true;
+
+	    } else {
+		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
+		  return -1;
+	    }
+      }
+
+      if (path_in == 0) {
+	    fprintf(stderr, "Please specify an input file with --input=<path>.\n");
+	    return -1;
+      }
+
+      FILE*fd_in = fopen(path_in, "rb");
+      if (fd_in == 0) {
+	    fprintf(stderr, "Unable to open input .mcs file: %s\n", path_in);
+	    return -1;
+      }
+
+      fprintf(stdout, "Reading input .mcs file: %s\n", path_in);
+      fflush(stdout);
+
+      mapped_file file;
+      if (! file.map(fd_in))
+	    return -1;
+
+      fclose(fd_in);
+      fd_in = 0;
+
+      const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+
+      vector<mcs_extent_t> extents;
+      if (! read_mcs_file(extents, file.data(), file.size()))
+	    return -1;
+
+      const double secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+      const double mbytes = file.size() / (1024.0*1024.0);
+
+      size_t data_bytes = 0;
+      size_t end_address = 0;
+      for (size_t idx = 0 ; idx < extents.size() ; idx += 1) {
+	    const mcs_extent_t&ext = extents[idx];
+	    data_bytes += ext.data.size();
+	    if (ext.address + ext.data.size() > end_address)
+		  end_address = ext.address + ext.data.size();
+	    if (list_extents)
+		  fprintf(stdout, "Extent 0x%08zx - 0x%08zx (%zu bytes)\n",
+			  ext.address, ext.address + ext.data.size() - 1, ext.data.size());
+      }
+
+      fprintf(stdout, "Decoded %zu data bytes in %zu extents\n", data_bytes, extents.size());
+      fprintf(stdout, "MCS target device size >= 0x%08zx\n", end_address);
+      fprintf(stdout, "Decoded %.1f MBytes of text in %.3f s (%.1f MB/s)\n",
+	      mbytes, secs, secs > 0? mbytes/secs : 0.0);
+
+      if (path_out) {
+	    vector<uint8_t> image;
+	    mcs_extents_to_image(image, extents, base_address);
+
+	    FILE*fd_out = fopen(path_out, "wb");
+	    if (fd_out == 0) {
+		  fprintf(stderr, "Unable to open output file: %s\n", path_out);
+		  return -1;
+	    }
+
+	    metrics_phase phase ("write output", image.size());
+	    size_t rc = fwrite(&image[0], 1, image.size(), fd_out);
+	    if (rc != image.size()) {
+		  fprintf(stderr, "Unable to write output file: %s\n", path_out);
+		  return -1;
+	    }
+
+	    fclose(fd_out);
+	    fprintf(stdout, "Wrote %zu bytes to %s\n", image.size(), path_out);
+      }
+
+      return 0;
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "metrics.h"
+# include  <vector>
+# include  <string>
+# include  <memory>
+# include  <mutex>
+# include  <chrono>
+# include  <ctime>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# ifndef _WIN32
+# include  <time.h>
+# include  <sys/time.h>
+# include  <sys/resource.h>
+# endif
+
+using namespace std;
+
+bool metrics_enabled = false;
+atomic<uint64_t> metrics_allocations (0);
+atomic<uint64_t> metrics_allocated_bytes (0);
+thread_local uint64_t metrics_thread_allocations = 0;
+
+/*
+ * The totals for all the phases of a name. The depth is the nesting
+ * depth of the first one, for indenting the report. The totals are
+ * added to without a lock, so the times are in nanoseconds.
+ */
+struct phase_total_t {
+      const char*name;
+      unsigned depth;
+      atomic<uint64_t> calls;
+      atomic<uint64_t> wall_ns;
+      atomic<uint64_t> cpu_ns;
+      atomic<uint64_t> bytes;
+      atomic<uint64_t> allocations;
+};
+
+struct trace_event_t {
+      const char*name;
+      unsigned tid;
+      double start;
+      double dur;
+};
+
+/*
+ * Keep the timeline to a reasonable size, even if a phase runs for
+ * every segment of a huge image. The tools have a few dozen phase
+ * names, so the table of totals has a fixed size, and its entries
+ * never move.
+ */
+static const size_t max_trace_events = 200000;
+static const unsigned max_phases = 256;
+
+static mutex metrics_lock;
+static chrono::steady_clock::time_point metrics_start;
+static phase_total_t metrics_phases[max_phases];
+static atomic<unsigned> metrics_phase_count (0);
+static unique_ptr<trace_event_t[]> metrics_trace;
+static atomic<size_t> metrics_trace_count (0);
+static atomic<unsigned> metrics_next_tid (0);
+static string metrics_tool;
+static bool metrics_timings = false;
+static string metrics_json_path;
+
+static thread_local unsigned phase_depth = 0;
+static thread_local unsigned phase_tid = 0;
+
+/*
+ * Each thread keeps the slots of the names that it has seen, hashed
+ * by the address of the name (the names are string literals), so the
+ * shared table is only searched, under the lock, the first time a
+ * thread starts a phase of a name.
+ */
+static const unsigned phase_cache_size = 64;
+struct phase_cache_t {
+      const char*name;
+      unsigned slot;
+};
+static thread_local phase_cache_t phase_cache[phase_cache_size];
+
+static double wall_now()
+{
+      return chrono::duration<double>(chrono::steady_clock::now() - metrics_start).count();
+}
+
+	// This is the CPU time of the calling thread, so that the
+	// phases that run in parallel are not charged for each other.
+static double cpu_now()
+{
+# ifndef _WIN32
+      struct timespec ts;
+      if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+	    return ts.tv_sec + ts.tv_nsec * 1e-9;
+# endif
+      return (double)clock() / CLOCKS_PER_SEC;
+}
+
+	// This is the CPU time of the whole process, all threads.
+static double process_cpu_now()
+{
+# ifndef _WIN32
+      struct timespec ts;
+      if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0)
+	    return ts.tv_sec + ts.tv_nsec * 1e-9;
+# endif
+      return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/*
+ * Find or make the slot of the totals for the name. The totals for a
+ * name are made when the first phase of that name starts, so the
+ * report lists the phases in the order that they started, and outer
+ * phases come before the phases that they hold. If the table is full,
+ * the phase is counted in the last slot.
+ */
+static unsigned intern_phase(const char*name)
+{
+      lock_guard<mutex> guard (metrics_lock);
+
+      const unsigned count = metrics_phase_count.load(memory_order_relaxed);
+      for (unsigned slot = 0 ; slot < count ; slot += 1) {
+	    if (metrics_phases[slot].name == name || strcmp(metrics_phases[slot].name, name) == 0)
+		  return slot;
+      }
+
+      if (count == max_phases)
+	    return max_phases-1;
+
+      phase_total_t&cur = metrics_phases[count];
+      cur.name = name;
+      cur.depth = phase_depth;
+      metrics_phase_count.store(count+1, memory_order_release);
+      return count;
+}
+
+void metrics_phase::begin_()
+{
+      if (phase_tid == 0)
+	    phase_tid = ++metrics_next_tid;
+
+      phase_cache_t&cache = phase_cache[((uintptr_t)name_ >> 3) % phase_cache_size];
+      if (cache.name != name_) {
+	    cache.slot = intern_phase(name_);
+	    cache.name = name_;
+      }
+      slot_ = cache.slot;
+
+      phase_depth += 1;
+      start_allocations_ = metrics_thread_allocations;
+      start_cpu_ = cpu_now();
+      start_wall_ = wall_now();
+}
+
+void metrics_phase::end_()
+{
+      const double wall = wall_now() - start_wall_;
+      const double cpu = cpu_now() - start_cpu_;
+      const uint64_t allocations = metrics_thread_allocations - start_allocations_;
+      phase_depth -= 1;
+
+      phase_total_t&cur = metrics_phases[slot_];
+      cur.calls.fetch_add(1, memory_order_relaxed);
+      cur.wall_ns.fetch_add((uint64_t)(wall * 1e9), memory_order_relaxed);
+      cur.cpu_ns.fetch_add((uint64_t)(cpu * 1e9), memory_order_relaxed);
+      cur.bytes.fetch_add(bytes_, memory_order_relaxed);
+      cur.allocations.fetch_add(allocations, memory_order_relaxed);
+
+      const size_t idx = metrics_trace_count.fetch_add(1, memory_order_relaxed);
+      if (idx < max_trace_events) {
+	    trace_event_t&event = metrics_trace[idx];
+	    event.name = name_;
+	    event.tid = phase_tid;
+	    event.start = start_wall_;
+	    event.dur = wall;
+      }
+}
+
+static long peak_rss_kb()
+{
+# ifndef _WIN32
+      struct rusage usage;
+      if (getrusage(RUSAGE_SELF, &usage) == 0)
+	    return usage.ru_maxrss;
+# endif
+      return 0;
+}
+
+/*
+ * The report is written from atexit, so it comes out whether main
+ * returns or the program calls exit() on an error.
+ */
+static void metrics_report(void)
+{
+      const double wall = wall_now();
+      const double cpu = process_cpu_now();
+      const long rss = peak_rss_kb();
+      const uint64_t allocations = metrics_allocations.load();
+      const uint64_t allocated_bytes = metrics_allocated_bytes.load();
+
+      lock_guard<mutex> guard (metrics_lock);
+
+	// Take a copy of the totals, in seconds.
+      struct phase_report_t {
+	    const char*name;
+	    unsigned depth;
+	    uint64_t calls;
+	    double wall;
+	    double cpu;
+	    uint64_t bytes;
+	    uint64_t allocations;
+      };
+      vector<phase_report_t> phases (metrics_phase_count.load(memory_order_acquire));
+      for (size_t idx = 0 ; idx < phases.size() ; idx += 1) {
+	    const phase_total_t&src = metrics_phases[idx];
+	    phase_report_t&cur = phases[idx];
+	    cur.name = src.name;
+	    cur.depth = src.depth;
+	    cur.calls = src.calls.load();
+	    cur.wall = src.wall_ns.load() * 1e-9;
+	    cur.cpu = src.cpu_ns.load() * 1e-9;
+	    cur.bytes = src.bytes.load();
+	    cur.allocations = src.allocations.load();
+      }
+
+      const size_t trace_count = min(metrics_trace_count.load(), max_trace_events);
+
+      if (metrics_timings) {
+	    fprintf(stderr, "%-28s %7s %10s %10s %14s %10s %10s\n", "Phase", "Calls",
+		    "Wall ms", "CPU ms", "Bytes", "MB/s", "Allocs");
+	    for (size_t idx = 0 ; idx < phases.size() ; idx += 1) {
+		  const phase_report_t&cur = phases[idx];
+		  string name = string(2*cur.depth, ' ') + cur.name;
+		  double mb_s = cur.wall > 0.0? cur.bytes / (1024.0*1024.0) / cur.wall : 0.0;
+		  fprintf(stderr, "%-28s %7llu %10.3f %10.3f %14llu %10.1f %10llu\n",
+			  name.c_str(), (unsigned long long)cur.calls, cur.wall*1000.0,
+			  cur.cpu*1000.0, (unsigned long long)cur.bytes, mb_s,
+			  (unsigned long long)cur.allocations);
+	    }
+	    fprintf(stderr, "Total: wall %.3f ms, CPU %.3f ms, peak RSS %ld KB, "
+		    "%llu allocations (%.1f MBytes)\n", wall*1000.0, cpu*1000.0, rss,
+		    (unsigned long long)allocations, allocated_bytes / (1024.0*1024.0));
+      }
+
+      if (! metrics_json_path.empty()) {
+	    FILE*fd = fopen(metrics_json_path.c_str(), "w");
+	    if (fd == 0) {
+		  fprintf(stderr, "Unable to open metrics file: %s\n", metrics_json_path.c_str());
+		  return;
+	    }
+
+	    fprintf(fd, "{\n  \"tool\": \"%s\",\n", metrics_tool.c_str());
+	    fprintf(fd, "  \"wall_s\": %.6f,\n  \"cpu_s\": %.6f,\n", wall, cpu);
+	    fprintf(fd, "  \"peak_rss_kb\": %ld,\n", rss);
+	    fprintf(fd, "  \"allocations\": %llu,\n  \"allocated_bytes\": %llu,\n",
+		    (unsigned long long)allocations, (unsigned long long)allocated_bytes);
+
+	    fprintf(fd, "  \"phases\": [\n");
+	    for (size_t idx = 0 ; idx < phases.size() ; idx += 1) {
+		  const phase_report_t&cur = phases[idx];
+		  double mb_s = cur.wall > 0.0? cur.bytes / (1024.0*1024.0) / cur.wall : 0.0;
+		  fprintf(fd, "    { \"name\": \"%s\", \"depth\": %u, \"calls\": %llu, \"wall_s\": %.6f,"
+			  " \"cpu_s\": %.6f, \"bytes\": %llu, \"mb_s\": %.1f, \"allocations\": %llu }%s\n",
+			  cur.name, cur.depth, (unsigned long long)cur.calls, cur.wall, cur.cpu,
+			  (unsigned long long)cur.bytes, mb_s, (unsigned long long)cur.allocations,
+			  idx+1 < phases.size()? "," : "");
+	    }
+	    fprintf(fd, "  ],\n");
+
+	      // The timeline is in the Chrome trace event format, so
+	      // this file loads into chrome://tracing or Perfetto as is.
+	    fprintf(fd, "  \"traceEvents\": [\n");
+	    for (size_t idx = 0 ; idx < trace_count ; idx += 1) {
+		  const trace_event_t&cur = metrics_trace[idx];
+		  fprintf(fd, "    { \"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u,"
+			  " \"ts\": %.3f, \"dur\": %.3f }%s\n", cur.name, cur.tid,
+			  cur.start*1e6, cur.dur*1e6, idx+1 < trace_count? "," : "");
+	    }
+	    fprintf(fd, "  ],\n  \"displayTimeUnit\": \"ms\"\n}\n");
+	    fclose(fd);
+      }
+}
+
+bool parse_metrics_flag(const char*tool, const char*flag)
+{
+      if (strcmp(flag,"--timings") == 0) {
+	    metrics_timings = true;
+
+      } else if (strncmp(flag,"--metrics-json=",15) == 0) {
+	    metrics_json_path = flag + 15;
+
+      } else {
+	    return false;
+      }
+
+      if (! metrics_enabled) {
+	      // Name the tool by the last part of its path.
+	    const char*cp = strrchr(tool, '/');
+	    metrics_tool = cp? cp+1 : tool;
+	    metrics_start = chrono::steady_clock::now();
+	    metrics_trace.reset(new trace_event_t[max_trace_events]);
+	    metrics_enabled = true;
+	    atexit(metrics_report);
+      }
+
+      return true;
+}
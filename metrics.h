@@ -0,0 +1,96 @@
+#ifndef __metrics_H
+#define __metrics_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <atomic>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * Phase timing and memory metrics for the tools. A phase is a scope
+ * of work with a name, such as reading an input file or encoding the
+ * .mcs stream. Put a metrics_phase at the top of the scope:
+ *
+ *    metrics_phase phase ("mcs encode", vec.size());
+ *
+ * The phases with the same name are added together. Phases may be
+ * nested, and may run in worker threads; each phase is also an event
+ * on the trace timeline of its thread. The CPU time and allocations
+ * of a phase are those of its own thread.
+ *
+ * Metrics are off unless a tool turns them on with --timings or
+ * --metrics-json=<path>. When they are off, a phase costs a test of
+ * metrics_enabled and nothing else.
+ */
+
+extern bool metrics_enabled;
+
+/*
+ * Allocation counts. These are counted by the operator new in
+ * metrics_new.cc, if the program links it, and only while metrics
+ * are enabled. The process totals are for the report, and the counts
+ * of each thread are for the phases that run in it.
+ */
+extern std::atomic<uint64_t> metrics_allocations;
+extern std::atomic<uint64_t> metrics_allocated_bytes;
+extern thread_local uint64_t metrics_thread_allocations;
+
+class metrics_phase {
+
+    public:
+      explicit metrics_phase(const char*name, uint64_t bytes =0)
+      : name_(name), bytes_(bytes), active_(metrics_enabled)
+      { if (active_) begin_(); }
+
+      ~metrics_phase()
+      { if (active_) end_(); }
+
+	// Count more bytes, for phases that do not know the size of
+	// their work up front.
+      void add_bytes(uint64_t bytes) { bytes_ += bytes; }
+
+    private:
+      void begin_();
+      void end_();
+
+    private:
+      const char*name_;
+      uint64_t bytes_;
+      bool active_;
+      unsigned slot_;
+      double start_wall_;
+      double start_cpu_;
+      uint64_t start_allocations_;
+
+    private: // not implemented
+      metrics_phase(const metrics_phase&);
+      metrics_phase& operator= (const metrics_phase&);
+};
+
+/*
+ * Interpret the --timings and --metrics-json=<path> flags. Either one
+ * turns metrics on, and arranges for the report to be written when the
+ * program exits. The tool name goes into the report. Return false if
+ * the flag is not a metrics flag.
+ */
+extern bool parse_metrics_flag(const char*tool, const char*flag);
+
+#endif
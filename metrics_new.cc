@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Replacements for the global operator new and delete, which count the
+ * allocations while metrics are enabled. This is linked into the tools
+ * but not into libquickboot.a, so that programs that use the library
+ * keep their own allocator.
+ */
+
+# include  "metrics.h"
+# include  <new>
+# include  <cstdlib>
+
+using namespace std;
+
+static void* counted_alloc(size_t size)
+{
+      if (size == 0)
+	    size = 1;
+
+      if (metrics_enabled) {
+	    metrics_thread_allocations += 1;
+	    metrics_allocations.fetch_add(1, memory_order_relaxed);
+	    metrics_allocated_bytes.fetch_add(size, memory_order_relaxed);
+      }
+
+      return malloc(size);
+}
+
+void* operator new(size_t size)
+{
+      void*ptr = counted_alloc(size);
+      if (ptr == 0)
+	    throw bad_alloc();
+      return ptr;
+}
+
+void* operator new[](size_t size)
+{
+      void*ptr = counted_alloc(size);
+      if (ptr == 0)
+	    throw bad_alloc();
+      return ptr;
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+      return counted_alloc(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+      return counted_alloc(size);
+}
+
+void operator delete(void*ptr) noexcept
+{
+      free(ptr);
+}
+
+void operator delete[](void*ptr) noexcept
+{
+      free(ptr);
+}
+
+void operator delete(void*ptr, const nothrow_t&) noexcept
+{
+      free(ptr);
+}
+
+void operator delete[](void*ptr, const nothrow_t&) noexcept
+{
+      free(ptr);
+}
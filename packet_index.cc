@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "packet_index.h"
+# include  "stream_crc.h"
+# include  "metrics.h"
+# include  <cstring>
+# include  <cassert>
+
+using namespace std;
+
+/*
+ * Find the next sync word at or after ptr, and return the offset
+ * just past it, or 0 if there is none.
+ */
+static size_t find_sync(const uint8_t*vec, size_t len, size_t ptr)
+{
+      const uint8_t magic[4] = {0xaa, 0x99, 0x55, 0x66};
+
+      while (ptr+4 <= len) {
+	    const uint8_t*hit = (const uint8_t*)memchr(vec+ptr, magic[0], len-ptr-3);
+	    if (hit == 0)
+		  return 0;
+	    ptr = hit - vec;
+	    if (memcmp(hit, magic, 4) == 0)
+		  return ptr + 4;
+	    ptr += 1;
+      }
+
+      return 0;
+}
+
+packet_index::packet_index()
+: valid_(false), sync_(0)
+{
+      memset(header_write_, 0, sizeof header_write_);
+}
+
+/*
+ * Walk the packets of the stream from the sync word to the end. If
+ * the walk runs into words that are not packets (for example the pad
+ * after a DESYNC) then look for another sync word and carry on from
+ * there.
+ */
+bool packet_index::build(const uint8_t*vec, size_t len)
+{
+      metrics_phase phase ("packet index", len);
+
+      valid_ = false;
+      sync_ = 0;
+      packets_.clear();
+
+      size_t ptr = find_sync(vec, len, 0);
+      if (ptr == 0) {
+	    finish_();
+	    return false;
+      }
+
+      valid_ = true;
+      sync_ = ptr - 4;
+
+      uint16_t last_reg = 0;
+
+      while (ptr+4 <= len) {
+	    uint32_t word = get_word(vec+ptr);
+	    packet_info_t pkt;
+	    pkt.offset = ptr;
+	    pkt.type = word >> 29;
+	    pkt.opcode = (word >> 27) & 0x3;
+
+	    if (pkt.type == 1) {
+		  pkt.word_count = word & 0x7ff;
+		  pkt.reg = (word >> 13) & 0x3fff;
+		  last_reg = pkt.reg;
+
+	    } else if (pkt.type == 2) {
+		  pkt.word_count = word & 0x07ffffff;
+		  pkt.reg = last_reg;
+
+	    } else {
+		    // Not a packet. Look for a sync word that starts
+		    // the stream again.
+		  ptr = find_sync(vec, len, ptr);
+		  if (ptr == 0)
+			break;
+		  continue;
+	    }
+
+	    if (ptr + 4 + 4*(size_t)pkt.word_count > len)
+		  break;
+
+	    packets_.push_back(pkt);
+	    ptr += 4 + 4*pkt.word_count;
+      }
+
+      finish_();
+      return true;
+}
+
+/*
+ * Make the lookup tables from the list of packets. The header of the
+ * stream is everything before the first type-2 packet.
+ */
+void packet_index::finish_()
+{
+      type2_.clear();
+      memset(header_write_, 0, sizeof header_write_);
+
+      bool in_header = true;
+      for (size_t idx = 0 ; idx < packets_.size() ; idx += 1) {
+	    const packet_info_t&pkt = packets_[idx];
+	    if (pkt.type == 2) {
+		  type2_.push_back(idx);
+		  in_header = false;
+	    }
+
+	    if (in_header && pkt.opcode == 2 && pkt.reg < 32 && header_write_[pkt.reg] == 0)
+		  header_write_[pkt.reg] = idx + 1;
+      }
+}
+
+/*
+ * Frame data never holds packets, but other long writes may carry the
+ * stream for another SLR. Such a payload has its own sync word.
+ */
+bool packet_index::holds_stream(const uint8_t*vec, size_t idx) const
+{
+      const packet_info_t&pkt = packets_[idx];
+      if (pkt.opcode != 2 || pkt.reg == 0x02 || pkt.word_count < 2)
+	    return false;
+
+      const uint8_t magic[4] = {0xaa, 0x99, 0x55, 0x66};
+      const uint8_t*data = vec + pkt.offset + 4;
+      for (size_t ptr = 0 ; ptr < 4*(size_t)pkt.word_count ; ptr += 4) {
+	    if (memcmp(data+ptr, magic, 4) == 0)
+		  return true;
+      }
+
+      return false;
+}
+
+size_t packet_index::header_write(uint32_t reg) const
+{
+      if (reg >= 32 || header_write_[reg] == 0)
+	    return 0;
+
+      const packet_info_t&pkt = packets_[header_write_[reg] - 1];
+      assert(pkt.word_count == 1);
+      return pkt.offset + 4;
+}
+
+uint32_t packet_index::extract_register_write(const uint8_t*vec, uint32_t reg) const
+{
+      size_t ptr = header_write(reg);
+      if (ptr == 0)
+	    return 0;
+
+      return get_word(vec+ptr);
+}
+
+uint32_t packet_index::replace_register_write(uint8_t*vec, uint32_t reg, uint32_t val) const
+{
+      size_t ptr = header_write(reg);
+      if (ptr == 0)
+	    return 0;
+
+	// Get the existing word being written, and put the new value
+	// in its place.
+      uint32_t word = get_word(vec+ptr);
+      put_word(vec+ptr, val);
+      return word;
+}
+
+/*
+ * The index file is a 40 byte header followed by a 16 byte record for
+ * each packet. All the numbers are little-endian:
+ *
+ *    0: "QBPKTIDX"
+ *    8: u32 version (1)
+ *   12: u32 CRC-32C of the stream
+ *   16: u64 size of the stream
+ *   24: u64 offset of the sync word
+ *   32: u64 number of packets
+ *
+ * Each packet is a u64 offset, a u32 word count, a u16 register, and
+ * a u8 each for the type and opcode.
+ */
+static const char index_magic[8] = {'Q','B','P','K','T','I','D','X'};
+static const uint32_t index_version = 1;
+static const size_t index_header_size = 40;
+static const size_t index_record_size = 16;
+
+static void put_le(uint8_t*ptr, uint64_t val, size_t nbytes)
+{
+      for (size_t idx = 0 ; idx < nbytes ; idx += 1) {
+	    ptr[idx] = val & 0xff;
+	    val >>= 8;
+      }
+}
+
+static uint64_t get_le(const uint8_t*ptr, size_t nbytes)
+{
+      uint64_t val = 0;
+      for (size_t idx = nbytes ; idx > 0 ; idx -= 1)
+	    val = (val << 8) | ptr[idx-1];
+      return val;
+}
+
+bool packet_index::write(FILE*fd, const uint8_t*vec, size_t len) const
+{
+      metrics_phase phase ("index write", packets_.size() * index_record_size);
+
+      uint8_t head[index_header_size];
+      memcpy(head, index_magic, sizeof index_magic);
+      put_le(head+8,  index_version, 4);
+      put_le(head+12, crc32c(vec, len), 4);
+      put_le(head+16, len, 8);
+      put_le(head+24, sync_, 8);
+      put_le(head+32, packets_.size(), 8);
+      if (fwrite(head, 1, sizeof head, fd) != sizeof head)
+	    return false;
+
+      vector<uint8_t> buf (packets_.size() * index_record_size);
+      for (size_t idx = 0 ; idx < packets_.size() ; idx += 1) {
+	    const packet_info_t&pkt = packets_[idx];
+	    uint8_t*rec = &buf[idx * index_record_size];
+	    put_le(rec+0,  pkt.offset, 8);
+	    put_le(rec+8,  pkt.word_count, 4);
+	    put_le(rec+12, pkt.reg, 2);
+	    rec[14] = pkt.type;
+	    rec[15] = pkt.opcode;
+      }
+
+      if (buf.size() > 0 && fwrite(&buf[0], 1, buf.size(), fd) != buf.size())
+	    return false;
+
+      return true;
+}
+
+bool packet_index::read(FILE*fd, const uint8_t*vec, size_t len)
+{
+      metrics_phase phase ("index read");
+
+      valid_ = false;
+      sync_ = 0;
+      packets_.clear();
+      finish_();
+
+      uint8_t head[index_header_size];
+      if (fread(head, 1, sizeof head, fd) != sizeof head
+	  || memcmp(head, index_magic, sizeof index_magic) != 0) {
+	    fprintf(stderr, "Not a packet index file.\n");
+	    return false;
+      }
+
+      if (get_le(head+8, 4) != index_version) {
+	    fprintf(stderr, "Packet index file version %u is not supported.\n",
+		    (unsigned)get_le(head+8, 4));
+	    return false;
+      }
+
+      if (get_le(head+16, 8) != len || get_le(head+12, 4) != crc32c(vec, len)) {
+	    fprintf(stderr, "Packet index file is not for this stream.\n");
+	    return false;
+      }
+
+      const size_t count = get_le(head+32, 8);
+      vector<uint8_t> buf (count * index_record_size);
+      if (buf.size() > 0 && fread(&buf[0], 1, buf.size(), fd) != buf.size()) {
+	    fprintf(stderr, "Packet index file is truncated.\n");
+	    return false;
+      }
+
+      packets_.resize(count);
+      for (size_t idx = 0 ; idx < count ; idx += 1) {
+	    const uint8_t*rec = &buf[idx * index_record_size];
+	    packet_info_t&pkt = packets_[idx];
+	    pkt.offset = get_le(rec+0, 8);
+	    pkt.word_count = get_le(rec+8, 4);
+	    pkt.reg = get_le(rec+12, 2);
+	    pkt.type = rec[14];
+	    pkt.opcode = rec[15];
+
+	    if (pkt.offset + 4 + 4*(size_t)pkt.word_count > len) {
+		  fprintf(stderr, "Packet index file is corrupt.\n");
+		  packets_.clear();
+		  return false;
+	    }
+      }
+
+      valid_ = true;
+      sync_ = get_le(head+24, 8);
+      finish_();
+      phase.add_bytes(buf.size());
+      return true;
+}
@@ -0,0 +1,128 @@
+#ifndef __packet_index_H
+#define __packet_index_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <cstdio>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * Description of a single configuration packet in a bit stream. For
+ * type-2 packets, the register is the register addressed by the
+ * type-1 packet that precedes it.
+ */
+struct packet_info_t {
+	// Offset of the packet header word in the stream. The data
+	// words (if any) follow it.
+      size_t offset;
+      uint32_t word_count;
+      uint16_t reg;
+      uint8_t type;   // 1 or 2
+      uint8_t opcode; // 0:NOP, 1:Read, 2:Write, 3:Reserved
+};
+
+/*
+ * A packet_index is a list of all the configuration packets in a bit
+ * stream, built in a single pass over the stream. Register lookups
+ * and edits go straight to the packet, instead of scanning the stream
+ * again. Edits that replace register values do not move any packets,
+ * so an index remains valid after such edits, and can be used with
+ * copies of the stream that it was built from.
+ */
+class packet_index {
+
+    public:
+      packet_index();
+
+	// Index the stream. Return false if there is no sync word.
+      bool build(const uint8_t*vec, size_t len);
+      bool build(const std::vector<uint8_t>&vec)
+      { return build(&vec[0], vec.size()); }
+
+	// True if build() found a sync word.
+      bool valid() const { return valid_; }
+	// Offset of the (first) sync word.
+      size_t sync_offset() const { return sync_; }
+
+      size_t size() const { return packets_.size(); }
+      const packet_info_t& operator[] (size_t idx) const { return packets_[idx]; }
+
+	// Indices of the type-2 packets (i.e. FDRI data) in the stream.
+      const std::vector<size_t>& type2_packets() const { return type2_; }
+
+	// Offset of the data word of the first write to the register
+	// in the header of the stream (before the first type-2
+	// packet), or 0 if there is no such write.
+      size_t header_write(uint32_t reg) const;
+
+	// True if the packet is a write whose payload is itself a
+	// stream, i.e. the stream for another SLR.
+      bool holds_stream(const uint8_t*vec, size_t idx) const;
+
+	// Get/replace the value of a register write in the header of
+	// the stream. These return the (old) value, or 0 if there is
+	// no such register write.
+      uint32_t extract_register_write(const uint8_t*vec, uint32_t reg) const;
+      uint32_t replace_register_write(uint8_t*vec, uint32_t reg, uint32_t val) const;
+
+      uint32_t extract_register_write(const std::vector<uint8_t>&vec, uint32_t reg) const
+      { return extract_register_write(&vec[0], reg); }
+      uint32_t replace_register_write(std::vector<uint8_t>&vec, uint32_t reg, uint32_t val) const
+      { return replace_register_write(&vec[0], reg, val); }
+
+	// Save the index to a file, or load it back, so that tools
+	// can share the index of a large stream instead of walking it
+	// again. The file records the size and CRC-32C of the stream,
+	// and read() fails (after printing a message) if they do not
+	// match the stream that is passed in.
+      bool write(FILE*fd, const uint8_t*vec, size_t len) const;
+      bool read(FILE*fd, const uint8_t*vec, size_t len);
+
+    private:
+      void finish_();
+
+    private:
+      bool valid_;
+      size_t sync_;
+      std::vector<packet_info_t> packets_;
+      std::vector<size_t> type2_;
+	// Packet index (+1) of the first header write to each register.
+      size_t header_write_[32];
+};
+
+/*
+ * Bit streams are big-endian 32bit words.
+ */
+inline uint32_t get_word(const uint8_t*ptr)
+{
+      return (ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+}
+
+inline void put_word(uint8_t*ptr, uint32_t val)
+{
+      ptr[0] = (val >> 24) & 0xff;
+      ptr[1] = (val >> 16) & 0xff;
+      ptr[2] = (val >>  8) & 0xff;
+      ptr[3] = (val >>  0) & 0xff;
+}
+
+#endif
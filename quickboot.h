@@ -0,0 +1,62 @@
+#ifndef __quickboot_H
+#define __quickboot_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * This is the header for libquickboot, the library that the quickboot
+ * programs are built on. A program that makes flash images in its own
+ * process, without temporary files, includes this and links with
+ * libquickboot.a. For example:
+ *
+ *    bit_file_view silver;
+ *    silver.map_buffer(bit_data, bit_len);
+ *
+ *    quickboot_options_t opt;
+ *    opt.spi = true;
+ *    vector<uint8_t> image;
+ *    vector<manifest_region_t> regions;
+ *    make_quickboot_image(image, regions, silver, true, silver, opt, log);
+ *
+ *    vector<char> text;
+ *    mcs_buffer_sink sink (text);
+ *    write_to_mcs(sink, image);
+ *
+ * The streams that are loaded into a bit_file_view are only read, so
+ * one loaded stream can be used by many threads at once. Progress
+ * messages go to the log that is passed in, and error messages go to
+ * opt.err (stderr unless the caller sets it), so a program that makes
+ * many images at once can send each its own messages.
+ */
+
+# include  "read_bit_file.h"
+# include  "read_mcs_file.h"
+# include  "packet_index.h"
+# include  "replace_register_write.h"
+# include  "stream_crc.h"
+# include  "quickboot_stream.h"
+# include  "quickboot_image.h"
+# include  "design_set.h"
+# include  "write_to_mcs_file.h"
+# include  "bit_swizzle.h"
+# include  "flash_manifest.h"
+# include  "metrics.h"
+
+#endif
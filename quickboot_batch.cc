@@ -0,0 +1,482 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Build many flash images in one process. The job file lists the
+ * images to make, one per line, as the command line of the program
+ * that would make it on its own:
+ *
+ *    # SPI and BPI16 images, and a design set
+ *    quickboot_builder --output=spi.mcs --silver=clif32.bit --spi
+ *    quickboot_builder --output=bpi.mcs --silver=clif32.bit --bpi16 --multiboot=0x800000
+ *    quickboot_builder3 --output=set.mcs --clif32-4=clif32.bit --clif31=clif31.bit
+ *
+ * A job takes the input, flash type, multiboot, debug, .mcs and
+ * manifest flags of its program. Flags are separated by white space,
+ * and a # starts a comment. Each distinct input file is loaded once,
+ * and shared (read only) by all the jobs that use it. The jobs then
+ * run on a work-stealing pool of threads, and a summary with the time
+ * of each job is printed at the end.
+ *
+ * COMMAND LINE FLAGS:
+ *   --jobs=<path>    The job file.
+ *
+ *   --threads=<N> (default: 0)
+ *                    Number of jobs to run at once. The default (0)
+ *                    runs one per processor.
+ *
+ *   --cache=<dir> (default: $QUICKBOOT_CACHE)
+ *   --no-cache
+ *                    Build cache for quickboot_builder3 jobs.
+ *
+ *   --verbose
+ *                    Print the messages of each job (in job order)
+ *                    before the summary.
+ *
+ *   --timings
+ *   --metrics-json=<path>
+ *                    Print the wall and CPU time, bytes and allocations
+ *                    of each phase of the work to stderr, or write them
+ *                    with a trace timeline to a JSON file.
+ */
+
+# include  "quickboot_image.h"
+# include  "design_set.h"
+# include  "build_cache.h"
+# include  "read_bit_file.h"
+# include  "write_to_mcs_file.h"
+# include  "flash_manifest.h"
+# include  "work_pool.h"
+# include  "metrics.h"
+# include  <vector>
+# include  <string>
+# include  <map>
+# include  <chrono>
+# include  <cstdint>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+
+using namespace std;
+
+/*
+ * An input file, loaded once for all the jobs that use it. The pad is
+ * part of the key, because quickboot_builder3 wants a larger pad than
+ * quickboot_builder.
+ */
+struct batch_input_t {
+      string path;
+      size_t pad;
+      bit_file_view view;
+      bool ok;
+};
+
+struct batch_job_t {
+      batch_job_t() : lineno(0), design_set(false), manifest_flag(true),
+		      gold(-1), silver(-1), ok(false), secs(0.0), size(0), log(0)
+      { for (size_t idx = 0 ; idx < design_set_count ; idx += 1) design[idx] = -1; }
+
+      unsigned lineno;
+	// true for a quickboot_builder3 job.
+      bool design_set;
+      string path_out;
+      string path_manifest;
+      bool manifest_flag;
+      quickboot_options_t qb_options;
+      design_set_options_t ds_options;
+      mcs_options_t mcs_options;
+
+	// The inputs, as indices into the input list, or -1.
+      int gold;
+      int silver;
+      int design[design_set_count];
+
+	// Results
+      bool ok;
+      double secs;
+      size_t size;
+      FILE*log;
+};
+
+struct batch_t {
+      vector<batch_input_t*> inputs;
+      map<string,int> input_map;
+      vector<batch_job_t> jobs;
+};
+
+static int find_input(batch_t&batch, const string&path, size_t pad)
+{
+      char key_pad[32];
+      snprintf(key_pad, sizeof key_pad, "@%zu", pad);
+      const string key = path + key_pad;
+
+      map<string,int>::const_iterator cur = batch.input_map.find(key);
+      if (cur != batch.input_map.end())
+	    return cur->second;
+
+      batch_input_t*input = new batch_input_t;
+      input->path = path;
+      input->pad = pad;
+      input->ok = false;
+      batch.inputs.push_back(input);
+
+      int idx = batch.inputs.size() - 1;
+      batch.input_map[key] = idx;
+      return idx;
+}
+
+/*
+ * Parse one line of the job file into a job. Return false (after
+ * printing a message) if the line is not a valid job.
+ */
+static bool parse_job(batch_t&batch, batch_job_t&job, const char*path, vector<string>&words)
+{
+      if (words[0] == "quickboot_builder") {
+	    job.design_set = false;
+      } else if (words[0] == "quickboot_builder3") {
+	    job.design_set = true;
+      } else {
+	    fprintf(stderr, "%s:%u: Unknown program: %s\n", path, job.lineno, words[0].c_str());
+	    return false;
+      }
+
+	// Jobs run in parallel, so each job encodes its .mcs file
+	// on one thread unless it asks for more.
+      job.mcs_options.threads = 1;
+
+      string path_gold, path_silver;
+      string path_design[design_set_count];
+
+      for (size_t idx = 1 ; idx < words.size() ; idx += 1) {
+	    const char*flag = words[idx].c_str();
+
+	    if (parse_mcs_flag(job.mcs_options, flag))
+		  continue;
+	    if (! job.design_set && parse_quickboot_flag(job.qb_options, flag))
+		  continue;
+	    if (job.design_set && parse_design_set_flag(job.ds_options, flag))
+		  continue;
+
+	    if (strncmp(flag,"--output=",9) == 0) {
+		  job.path_out = flag + 9;
+
+	    } else if (strncmp(flag,"--manifest=",11) == 0) {
+		  job.path_manifest = flag + 11;
+		  job.manifest_flag = true;
+
+	    } else if (strcmp(flag,"--no-manifest") == 0) {
+		  job.manifest_flag = false;
+
+	    } else if (! job.design_set && strncmp(flag,"--gold=",7) == 0) {
+		  path_gold = flag + 7;
+
+	    } else if (! job.design_set && strncmp(flag,"--silver=",9) == 0) {
+		  path_silver = flag + 9;
+
+	    } else if (job.design_set && strncmp(flag,"--clif32-4=",11) == 0) {
+		  path_design[0] = flag + 11;
+
+	    } else if (job.design_set && strncmp(flag,"--clif32-6=",11) == 0) {
+		  path_design[1] = flag + 11;
+
+	    } else if (job.design_set && strncmp(flag,"--clif31=",9) == 0) {
+		  path_design[2] = flag + 9;
+
+	    } else if (job.design_set && strncmp(flag,"--clif30=",9) == 0) {
+		  path_design[3] = flag + 9;
+
+	    } else {
+		  fprintf(stderr, "%s:%u: Unknown flag: %s\n", path, job.lineno, flag);
+		  return false;
+	    }
+      }
+
+      if (job.path_out.empty()) {
+	    fprintf(stderr, "%s:%u: Job has no --output\n", path, job.lineno);
+	    return false;
+      }
+
+      if (job.mcs_options.record_length != 16 && job.mcs_options.record_length != 32
+	  && job.mcs_options.record_length != 64) {
+	    fprintf(stderr, "%s:%u: MCS record length must be 16, 32 or 64 bytes.\n",
+		    path, job.lineno);
+	    return false;
+      }
+
+      if (job.design_set) {
+	    for (size_t idx = 0 ; idx < design_set_count ; idx += 1) {
+		  if (! path_design[idx].empty())
+			job.design[idx] = find_input(batch, path_design[idx], 256+32);
+	    }
+	    return true;
+      }
+
+      if (job.qb_options.spi == job.qb_options.bpi16) {
+	    fprintf(stderr, "%s:%u: Please specify one of --bpi16 or --spi\n", path, job.lineno);
+	    return false;
+      }
+
+      if (path_silver.empty()) {
+	    fprintf(stderr, "%s:%u: Job has no --silver\n", path, job.lineno);
+	    return false;
+      }
+
+      job.silver = find_input(batch, path_silver, 0);
+      job.gold = path_gold.empty()? job.silver : find_input(batch, path_gold, 0);
+      return true;
+}
+
+static bool read_jobs(batch_t&batch, const char*path)
+{
+      FILE*fd = fopen(path, "r");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to open job file: %s\n", path);
+	    return false;
+      }
+
+      bool rc = true;
+      unsigned lineno = 0;
+      char line[4096];
+      while (fgets(line, sizeof line, fd)) {
+	    lineno += 1;
+
+	    char*cp = strchr(line, '#');
+	    if (cp) *cp = 0;
+
+	    vector<string> words;
+	    for (char*tok = strtok(line, " \t\r\n") ; tok ; tok = strtok(0, " \t\r\n"))
+		  words.push_back(tok);
+	    if (words.empty())
+		  continue;
+
+	    batch_job_t job;
+	    job.lineno = lineno;
+	    if (parse_job(batch, job, path, words))
+		  batch.jobs.push_back(job);
+	    else
+		  rc = false;
+      }
+
+      fclose(fd);
+      return rc;
+}
+
+static void load_input(size_t idx, void*arg)
+{
+      batch_t*batch = (batch_t*)arg;
+      batch_input_t*input = batch->inputs[idx];
+
+      FILE*fd = fopen(input->path.c_str(), "rb");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to open input file: %s\n", input->path.c_str());
+	    return;
+      }
+
+      input->ok = input->view.load(fd, input->path.c_str(), input->pad);
+      fclose(fd);
+}
+
+static bool run_job_(batch_t&batch, batch_job_t&job)
+{
+      vector<uint8_t> vec_out;
+      vector<manifest_region_t> regions;
+      size_t start_address = 0;
+      size_t flash_sector;
+
+      if (job.design_set) {
+	    const bit_file_view*designs[design_set_count];
+	    for (size_t idx = 0 ; idx < design_set_count ; idx += 1) {
+		  int in = job.design[idx];
+		  if (in >= 0 && ! batch.inputs[in]->ok)
+			return false;
+		  designs[idx] = in >= 0? &batch.inputs[in]->view : 0;
+	    }
+
+	    size_t first_design, last_design;
+	    if (! make_design_set(vec_out, regions, first_design, last_design,
+				  designs, job.ds_options, job.log))
+		  return false;
+
+	    start_address = first_design * design_set_design_offset;
+	    flash_sector = design_set_flash_sector;
+
+      } else {
+	    const batch_input_t*gold = batch.inputs[job.gold];
+	    const batch_input_t*silver = batch.inputs[job.silver];
+	    if (! gold->ok || ! silver->ok)
+		  return false;
+
+	    if (! make_quickboot_image(vec_out, regions, gold->view, job.gold == job.silver,
+				       silver->view, job.qb_options, job.log))
+		  return false;
+
+	    flash_sector = job.qb_options.flash_sector;
+	    if (job.qb_options.bpi16)
+		  job.mcs_options.swizzle = SWIZZLE_X16;
+      }
+
+      job.size = vec_out.size() - start_address;
+
+      FILE*fd = fopen(job.path_out.c_str(), "wb");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to open output file: %s\n", job.path_out.c_str());
+	    return false;
+      }
+
+      job.mcs_options.log = job.log;
+      write_to_mcs_file(fd, vec_out, start_address, job.mcs_options);
+      fclose(fd);
+
+      if (job.manifest_flag) {
+	    string manifest_out = job.path_manifest.empty()? job.path_out + ".manifest" : job.path_manifest;
+	    if (! write_flash_manifest(manifest_out.c_str(), vec_out, start_address, flash_sector,
+				       regions, job.mcs_options.swizzle, job.mcs_options.threads))
+		  return false;
+
+	    fprintf(job.log, "Wrote manifest: %s\n", manifest_out.c_str());
+      }
+
+      return true;
+}
+
+static void run_job(size_t idx, void*arg)
+{
+      batch_t*batch = (batch_t*)arg;
+      batch_job_t&job = batch->jobs[idx];
+      metrics_phase phase ("batch job");
+
+      const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+      job.ok = run_job_(*batch, job);
+      job.secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+}
+
+int main(int argc, char*argv[])
+{
+      const char*path_jobs = 0;
+      unsigned threads = 0;
+      const char*path_cache = getenv("QUICKBOOT_CACHE");
+      bool verbose = false;
+
+      for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+
+	    if (strncmp(argv[optarg],"--jobs=",7) == 0) {
+		  path_jobs = argv[optarg] + 7;
+
+	    } else if (strncmp(argv[optarg],"--threads=",10) == 0) {
+		  threads = strtoul(argv[optarg]+10, 0, 0);
+
+	    } else if (strncmp(argv[optarg],"--cache=",8) == 0) {
+		  path_cache = argv[optarg] + 8;
+
+	    } else if (strcmp(argv[optarg],"--no-cache") == 0) {
+		  path_cache = 0;
+
+	    } else if (strcmp(argv[optarg],"--verbose") == 0) {
+		  verbose = true;
+
+	    } else {
+		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
+		  return -1;
+	    }
+      }
+
+      if (path_jobs == 0) {
+	    fprintf(stderr, "No job file? Please specify --jobs=<path>\n");
+	    return -1;
+      }
+
+      const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+
+      batch_t batch;
+      if (! read_jobs(batch, path_jobs))
+	    return -1;
+
+      if (batch.jobs.empty()) {
+	    fprintf(stderr, "%s: No jobs.\n", path_jobs);
+	    return -1;
+      }
+
+	/* If the cache cannot be opened, carry on without it. */
+      build_cache cache;
+      if (path_cache && *path_cache && cache.open(path_cache)) {
+	    for (size_t idx = 0 ; idx < batch.jobs.size() ; idx += 1)
+		  batch.jobs[idx].ds_options.cache = &cache;
+      }
+
+      work_pool pool (threads);
+
+	/* Load all the distinct inputs, then run all the jobs. */
+      pool.run(batch.inputs.size(), load_input, &batch);
+
+      const double load_secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+      fprintf(stdout, "Loaded %zu input files for %zu jobs in %.3f s\n",
+	      batch.inputs.size(), batch.jobs.size(), load_secs);
+      fflush(stdout);
+
+      for (size_t idx = 0 ; idx < batch.jobs.size() ; idx += 1) {
+	    batch.jobs[idx].log = tmpfile();
+	    if (batch.jobs[idx].log == 0) {
+		  fprintf(stderr, "Unable to make a log file for job %zu.\n", idx+1);
+		  return -1;
+	    }
+      }
+
+      pool.run(batch.jobs.size(), run_job, &batch);
+
+      const double secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+      if (verbose) {
+	    for (size_t idx = 0 ; idx < batch.jobs.size() ; idx += 1) {
+		  batch_job_t&job = batch.jobs[idx];
+		  fprintf(stdout, "==== Job %zu (line %u): %s\n", idx+1, job.lineno, job.path_out.c_str());
+		  rewind(job.log);
+		  char buf[4096];
+		  size_t len;
+		  while ((len = fread(buf, 1, sizeof buf, job.log)) > 0)
+			fwrite(buf, 1, len, stdout);
+	    }
+      }
+
+	/* Summary of the jobs, in job file order. */
+      size_t nok = 0;
+      fprintf(stdout, "Job   Line  Time (s)  Image size  Output\n");
+      for (size_t idx = 0 ; idx < batch.jobs.size() ; idx += 1) {
+	    const batch_job_t&job = batch.jobs[idx];
+	    if (job.ok) {
+		  nok += 1;
+		  fprintf(stdout, "%4zu %5u  %8.3f  0x%08zx  %s\n", idx+1, job.lineno,
+			  job.secs, job.size, job.path_out.c_str());
+	    } else {
+		  fprintf(stdout, "%4zu %5u  %8.3f  FAILED      %s\n", idx+1, job.lineno,
+			  job.secs, job.path_out.c_str());
+	    }
+	    fclose(job.log);
+      }
+
+      fprintf(stdout, "Built %zu of %zu images in %.3f s on %u threads.\n",
+	      nok, batch.jobs.size(), secs, pool.threads());
+
+      for (size_t idx = 0 ; idx < batch.inputs.size() ; idx += 1)
+	    delete batch.inputs[idx];
+
+      return nok == batch.jobs.size()? 0 : -1;
+}
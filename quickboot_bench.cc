@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * End to end benchmark of the quickboot tools. Run each tool on a
+ * fixed corpus of synthetic streams, and record the wall time, the
+ * peak memory (RSS) and the output bytes per second of the fastest of
+ * a few runs. The results can be written to a JSON file, and compared
+ * against an earlier (baseline) JSON file, so that a change that makes
+ * a tool slower, or bigger, does not go unnoticed.
+ *
+ * COMMAND LINE FLAGS:
+ *   --bindir=<dir> (default: .)
+ *                    Where the tools are.
+ *
+ *   --work=<dir> (default: bench_work)
+ *                    Where the corpus and the outputs go. The corpus
+ *                    is made the first time.
+ *
+ *   --runs=<N> (default: 3)
+ *                    Run each tool this many times, and keep the
+ *                    fastest.
+ *
+ *   --output=<path>
+ *                    Write the results to this JSON file.
+ *
+ *   --baseline=<path>
+ *                    Compare the results with this JSON file from an
+ *                    earlier run. If the file does not exist, there
+ *                    is nothing to compare.
+ *
+ *   --threshold=<percent> (default: 10)
+ *                    A tool regresses if its wall time or peak RSS is
+ *                    more than this much over the baseline (and more
+ *                    than 5ms or 1MByte over). The exit code is
+ *                    non-zero if any tool regresses.
+ */
+
+# include  "synth_stream.h"
+# include  <vector>
+# include  <string>
+# include  <chrono>
+# include  <cstdint>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+# include  <sys/types.h>
+# include  <sys/stat.h>
+# include  <sys/time.h>
+# include  <sys/resource.h>
+# include  <sys/wait.h>
+# include  <fcntl.h>
+# include  <unistd.h>
+
+using namespace std;
+
+/*
+ * The corpus is a large stream for the single image tools, and four
+ * streams that fit the design set slots for quickboot_builder3. The
+ * multiboot address of the large images is moved up to make room.
+ */
+static const size_t corpus_large_bytes = 24*1024*1024;
+static const size_t corpus_design_bytes = 3*1024*1024;
+static const char corpus_multiboot[] = "--multiboot=0x2000000";
+
+/*
+ * Changes smaller than these are noise, and never count as a
+ * regression.
+ */
+static const double noise_wall = 0.005;
+static const long noise_rss_kb = 1024;
+
+struct bench_run_t {
+      string name;
+      double wall;
+      long max_rss_kb;
+      size_t output_bytes;
+      double output_mb_s;
+};
+
+static bool make_corpus_file(const string&path, size_t bytes, uint32_t seed)
+{
+      struct stat sb;
+      if (stat(path.c_str(), &sb) == 0)
+	    return true;
+
+      synth_options_t opt;
+      opt.fdri_bytes = bytes;
+      opt.seed = seed;
+      vector<uint8_t> vec;
+      make_synth_bit_file(vec, opt);
+
+      FILE*fd = fopen(path.c_str(), "wb");
+      if (fd == 0) {
+	    fprintf(stderr, "Unable to write corpus file: %s\n", path.c_str());
+	    return false;
+      }
+      size_t rc = fwrite(&vec[0], 1, vec.size(), fd);
+      fclose(fd);
+      if (rc != vec.size()) {
+	    unlink(path.c_str());
+	    return false;
+      }
+
+      fprintf(stdout, "Made corpus file %s (%zu bytes)\n", path.c_str(), vec.size());
+      return true;
+}
+
+static size_t file_size(const string&path)
+{
+      struct stat sb;
+      if (stat(path.c_str(), &sb) != 0)
+	    return 0;
+      return sb.st_size;
+}
+
+/*
+ * Run the command with its output going to the log, and get the wall
+ * time and the peak RSS of the process. Return false if the command
+ * fails.
+ */
+static bool run_command(const vector<string>&args, const string&path_log,
+			double&wall, long&max_rss_kb)
+{
+      vector<char*> argv;
+      for (size_t idx = 0 ; idx < args.size() ; idx += 1)
+	    argv.push_back(const_cast<char*>(args[idx].c_str()));
+      argv.push_back(0);
+
+      fflush(stdout);
+      fflush(stderr);
+
+      const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+
+      pid_t pid = fork();
+      if (pid < 0) {
+	    perror("fork");
+	    return false;
+      }
+
+      if (pid == 0) {
+	    int fd = open(path_log.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0666);
+	    if (fd >= 0) {
+		  dup2(fd, 1);
+		  dup2(fd, 2);
+		  close(fd);
+	    }
+	    execv(argv[0], &argv[0]);
+	    perror(argv[0]);
+	    _exit(127);
+      }
+
+      int status;
+      struct rusage usage;
+      if (wait4(pid, &status, 0, &usage) < 0) {
+	    perror("wait4");
+	    return false;
+      }
+
+      wall = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+	// Linux gives ru_maxrss in KBytes.
+      max_rss_kb = usage.ru_maxrss;
+
+      return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static void write_results(FILE*fd, const vector<bench_run_t>&runs)
+{
+      fprintf(fd, "{\n  \"version\": 1,\n  \"runs\": [\n");
+      for (size_t idx = 0 ; idx < runs.size() ; idx += 1) {
+	    const bench_run_t&run = runs[idx];
+	    fprintf(fd, "    { \"name\": \"%s\", \"wall_s\": %.6f, \"max_rss_kb\": %ld,"
+		    " \"output_bytes\": %zu, \"output_mb_s\": %.1f }%s\n",
+		    run.name.c_str(), run.wall, run.max_rss_kb, run.output_bytes,
+		    run.output_mb_s, idx+1 < runs.size()? "," : "");
+      }
+      fprintf(fd, "  ]\n}\n");
+}
+
+/*
+ * Read a results file that write_results() wrote. This is not a
+ * general JSON parser: it expects one run per line, as written.
+ */
+static bool read_results(const char*path, vector<bench_run_t>&runs)
+{
+      FILE*fd = fopen(path, "r");
+      if (fd == 0)
+	    return false;
+
+      char line[1024];
+      while (fgets(line, sizeof line, fd)) {
+	    char name[256];
+	    bench_run_t run;
+	    if (sscanf(line, " { \"name\": \"%255[^\"]\", \"wall_s\": %lf, \"max_rss_kb\": %ld,"
+		       " \"output_bytes\": %zu, \"output_mb_s\": %lf",
+		       name, &run.wall, &run.max_rss_kb, &run.output_bytes, &run.output_mb_s) == 5) {
+		  run.name = name;
+		  runs.push_back(run);
+	    }
+      }
+
+      fclose(fd);
+      return true;
+}
+
+int main(int argc, char*argv[])
+{
+      string bindir = ".";
+      string work = "bench_work";
+      unsigned nruns = 3;
+      const char*path_output = 0;
+      const char*path_baseline = 0;
+      double threshold = 10.0;
+
+      for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (strncmp(argv[optarg],"--bindir=",9) == 0) {
+		  bindir = argv[optarg] + 9;
+
+	    } else if (strncmp(argv[optarg],"--work=",7) == 0) {
+		  work = argv[optarg] + 7;
+
+	    } else if (strncmp(argv[optarg],"--runs=",7) == 0) {
+		  nruns = strtoul(argv[optarg]+7, 0, 0);
+
+	    } else if (strncmp(argv[optarg],"--output=",9) == 0) {
+		  path_output = argv[optarg] + 9;
+
+	    } else if (strncmp(argv[optarg],"--baseline=",11) == 0) {
+		  path_baseline = argv[optarg] + 11;
+
+	    } else if (strncmp(argv[optarg],"--threshold=",12) == 0) {
+		  threshold = strtod(argv[optarg]+12, 0);
+
+	    } else {
+		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
+		  return -1;
+	    }
+      }
+
+      if (nruns == 0)
+	    nruns = 1;
+
+      const string corpus = work + "/corpus";
+      const string out = work + "/out";
+      mkdir(work.c_str(), 0777);
+      mkdir(corpus.c_str(), 0777);
+      mkdir(out.c_str(), 0777);
+
+      const string large = corpus + "/large.bit";
+      const string design[4] = { corpus + "/clif32-4.bit", corpus + "/clif32-6.bit",
+				 corpus + "/clif31.bit", corpus + "/clif30.bit" };
+      if (! make_corpus_file(large, corpus_large_bytes, 1))
+	    return -1;
+      for (unsigned idx = 0 ; idx < 4 ; idx += 1) {
+	    if (! make_corpus_file(design[idx], corpus_design_bytes, 2+idx))
+		  return -1;
+      }
+
+	/* The benchmarks. Each is a name, the output file whose size
+	   is the output bytes, and the command. If sized is set, the
+	   bytes are the size of that file instead. */
+      struct bench_t {
+	    string name;
+	    string output;
+	    string sized;
+	    vector<string> args;
+      };
+      vector<bench_t> benches;
+      bench_t cur;
+
+      cur.name = "quickboot_builder-spi";
+      cur.output = out + "/spi.mcs";
+      cur.args.clear();
+      cur.args.push_back(bindir + "/quickboot_builder");
+      cur.args.push_back("--output=" + cur.output);
+      cur.args.push_back("--silver=" + large);
+      cur.args.push_back("--spi");
+      cur.args.push_back(corpus_multiboot);
+      benches.push_back(cur);
+
+      cur.name = "quickboot_builder-bpi16";
+      cur.output = out + "/bpi16.mcs";
+      cur.args.clear();
+      cur.args.push_back(bindir + "/quickboot_builder");
+      cur.args.push_back("--output=" + cur.output);
+      cur.args.push_back("--silver=" + large);
+      cur.args.push_back("--bpi16");
+      cur.args.push_back(corpus_multiboot);
+      benches.push_back(cur);
+
+      cur.name = "quickboot_builder3";
+      cur.output = out + "/clif.mcs";
+      cur.args.clear();
+      cur.args.push_back(bindir + "/quickboot_builder3");
+      cur.args.push_back("--output=" + cur.output);
+      cur.args.push_back("--clif32-4=" + design[0]);
+      cur.args.push_back("--clif32-6=" + design[1]);
+      cur.args.push_back("--clif31=" + design[2]);
+      cur.args.push_back("--clif30=" + design[3]);
+      cur.args.push_back("--no-cache");
+      benches.push_back(cur);
+
+      cur.name = "quickboot_gold";
+      cur.output = out + "/gold.bit";
+      cur.args.clear();
+      cur.args.push_back(bindir + "/quickboot_gold");
+      cur.args.push_back("--output=" + cur.output);
+      cur.args.push_back("--silver=" + large);
+      cur.args.push_back("--bpi16");
+      cur.args.push_back("--no-cache");
+      benches.push_back(cur);
+
+      cur.name = "quickboot_gold3";
+      cur.output = out + "/gold3.bit";
+      cur.args.clear();
+      cur.args.push_back(bindir + "/quickboot_gold3");
+      cur.args.push_back("--output=" + cur.output);
+      cur.args.push_back("--raw=" + large);
+      benches.push_back(cur);
+
+      cur.name = "quickboot_silver3";
+      cur.output = out + "/silver3.bit";
+      cur.args.clear();
+      cur.args.push_back(bindir + "/quickboot_silver3");
+      cur.args.push_back("--output=" + cur.output);
+      cur.args.push_back("--raw=" + large);
+      benches.push_back(cur);
+
+	// bitstream_debug writes to stdout, so its output is the log.
+	// The plain listing only walks the packets, so ask for the
+	// summary and the frame map, which hash every frame of the
+	// stream. The listing is small, so count the input bytes.
+      cur.name = "bitstream_debug";
+      cur.output = out + "/bitstream_debug.log";
+      cur.sized = large;
+      cur.args.clear();
+      cur.args.push_back(bindir + "/bitstream_debug");
+      cur.args.push_back("--input=" + large);
+      cur.args.push_back("--summary");
+      cur.args.push_back("--frames");
+      benches.push_back(cur);
+
+      fprintf(stdout, "%-24s %10s %12s %14s %10s\n", "Tool", "Wall (s)", "Peak RSS KB", "Output bytes", "MB/s");
+
+      vector<bench_run_t> results;
+      bool failed = false;
+      for (size_t idx = 0 ; idx < benches.size() ; idx += 1) {
+	    const bench_t&bench = benches[idx];
+	    const string path_log = bench.name == "bitstream_debug"
+		  ? bench.output : out + "/" + bench.name + ".log";
+
+	    bench_run_t run;
+	    run.name = bench.name;
+	    run.wall = 0.0;
+	    run.max_rss_kb = 0;
+	    bool ok = true;
+	    for (unsigned rdx = 0 ; rdx < nruns && ok ; rdx += 1) {
+		  double wall = 0.0;
+		  long rss = 0;
+		  ok = run_command(bench.args, path_log, wall, rss);
+		  if (rdx == 0 || wall < run.wall) {
+			run.wall = wall;
+			run.max_rss_kb = rss;
+		  }
+	    }
+
+	    if (! ok) {
+		  fprintf(stdout, "%-24s FAILED (see %s)\n", bench.name.c_str(), path_log.c_str());
+		  failed = true;
+		  continue;
+	    }
+
+	    run.output_bytes = file_size(bench.sized.empty()? bench.output : bench.sized);
+	    run.output_mb_s = run.wall > 0? run.output_bytes / (1024.0*1024.0) / run.wall : 0.0;
+	    results.push_back(run);
+
+	    fprintf(stdout, "%-24s %10.3f %12ld %14zu %10.1f\n", run.name.c_str(), run.wall,
+		    run.max_rss_kb, run.output_bytes, run.output_mb_s);
+	    fflush(stdout);
+      }
+
+      if (path_output) {
+	    FILE*fd = fopen(path_output, "w");
+	    if (fd == 0) {
+		  fprintf(stderr, "Unable to open output file: %s\n", path_output);
+		  return -1;
+	    }
+	    write_results(fd, results);
+	    fclose(fd);
+	    fprintf(stdout, "Wrote results: %s\n", path_output);
+      }
+
+      if (path_baseline == 0)
+	    return failed? -1 : 0;
+
+      vector<bench_run_t> baseline;
+      if (! read_results(path_baseline, baseline)) {
+	    fprintf(stdout, "No baseline (%s), nothing to compare.\n", path_baseline);
+	    return failed? -1 : 0;
+      }
+
+	/* Compare each result with the baseline run of the same
+	   name. */
+      fprintf(stdout, "\nCompare with %s (threshold %.1f%%)\n", path_baseline, threshold);
+      fprintf(stdout, "%-24s %10s %10s %8s %12s %12s %8s\n", "Tool", "Wall (s)", "Base",
+	      "Change", "Peak RSS KB", "Base", "Change");
+
+      size_t regressions = 0;
+      for (size_t idx = 0 ; idx < results.size() ; idx += 1) {
+	    const bench_run_t&run = results[idx];
+	    const bench_run_t*base = 0;
+	    for (size_t bdx = 0 ; bdx < baseline.size() ; bdx += 1) {
+		  if (baseline[bdx].name == run.name)
+			base = &baseline[bdx];
+	    }
+	    if (base == 0) {
+		  fprintf(stdout, "%-24s (not in baseline)\n", run.name.c_str());
+		  continue;
+	    }
+
+	    double wall_change = base->wall > 0? 100.0 * (run.wall - base->wall) / base->wall : 0.0;
+	    double rss_change = base->max_rss_kb > 0
+		  ? 100.0 * (run.max_rss_kb - base->max_rss_kb) / base->max_rss_kb : 0.0;
+	      // Differences smaller than the noise floor are not
+	      // regressions, however large they are in percent.
+	    bool regressed = (wall_change > threshold && run.wall - base->wall > noise_wall)
+		  || (rss_change > threshold && run.max_rss_kb - base->max_rss_kb > noise_rss_kb);
+	    if (regressed)
+		  regressions += 1;
+
+	    fprintf(stdout, "%-24s %10.3f %10.3f %+7.1f%% %12ld %12ld %+7.1f%%%s\n",
+		    run.name.c_str(), run.wall, base->wall, wall_change,
+		    run.max_rss_kb, base->max_rss_kb, rss_change,
+		    regressed? "  REGRESSED" : "");
+      }
+
+      if (regressions > 0) {
+	    fprintf(stdout, "%zu tools regressed by more than %.1f%%.\n", regressions, threshold);
+	    return -1;
+      }
+
+      fprintf(stdout, "No regressions.\n");
+      return failed? -1 : 0;
+}
@@ -31,7 +31,8 @@
  *                 contain the .mcs file stream.
  *
  *   --gold=<path> Specify the gold design. This should be a .bit file
- *                 as generated by Xilinx tools. Note that this .bit
+ *                 as generated by Xilinx tools, or an .mcs file that
+ *                 holds such a bit stream. Note that this .bit
  *                 file should NOT include the IPROG command as the
  *                 quickboot header that this program writes will
  *                 include a multiboot and IPROG command sequence.
@@ -69,6 +70,79 @@
  *                 program the device in "gold" mode and let a future
  *                 field update load and enable the silver.
  *
+ *   --sparse-mcs
+ *                 Leave blank (all 0xff) records and segments out of
+ *                 the .mcs file. The device must be erased before it
+ *                 is programmed with a sparse file.
+ *
+ *   --mcs-record-length=<N> (default: 16)
+ *                 Number of data bytes in each .mcs record. This may
+ *                 be 16, 32 or 64.
+ *
+ *   --mcs-threads=<N> (default: 0)
+ *                 Number of threads that encode the .mcs file. The
+ *                 default (0) uses one thread per processor.
+ *
+ *   --manifest=<path> (default: <output>.manifest)
+ *   --no-manifest
+ *                 Write a manifest of the flash image next to the
+ *                 .mcs file. The manifest gives the header, gold and
+ *                 silver regions, and a CRC-32C and SHA-256 of each
+ *                 flash sector, so that a readback of the flash can
+ *                 be checked a sector at a time.
+ *
+ *   --delta-from=<path>
+ *                 Write a delta update to the --output file instead
+ *                 of the full image. The <path> is the previous flash
+ *                 image, as an .mcs file, a manifest or a raw binary
+ *                 image. Only the flash sectors that differ from the
+ *                 previous image are written, except that the first
+ *                 sector (with the Critical Switch word) is written
+ *                 to <output>.restore.mcs to be programmed last. The
+ *                 steps for doing the update are printed.
+ *
+ *   --format=mcs (default)
+ *   --format=bin
+ *                 Write the image as an .mcs file, or as a binary
+ *                 image of the flash, in the byte order that the
+ *                 flash holds it. Delta updates are always .mcs.
+ *
+ *   --dual-qspi
+ *                 For SPI x8 (dual quad-SPI) flash, split the image
+ *                 between the two flash parts, and write an .mcs file
+ *                 for each: <output>_primary.mcs for the part on
+ *                 D[3:0], and <output>_secondary.mcs for the part on
+ *                 D[7:4] (the .mcs suffix of <output> is replaced).
+ *                 Each part holds half of every byte, at half the
+ *                 address. The manifest describes the whole image.
+ *                 Only for --spi and .mcs output, and not for delta
+ *                 updates or --connect.
+ *
+ *   --serve=<socket>
+ *   --serve-images=<N> (default: 16)
+ *   --serve-clients=<N> (default: one for each processor)
+ *                 Do not build an image, but run as a server that
+ *                 builds images for clients on the Unix domain
+ *                 socket. The server keeps the input files and the
+ *                 last <N> images that it made in memory, so repeat
+ *                 requests are fast, and serves up to <N> clients in
+ *                 parallel (others wait their turn).
+ *                 Input files that change on disk are read again.
+ *                 Each request is logged with its latency.
+ *
+ *   --connect=<socket>
+ *                 Have the server on the socket build the image, and
+ *                 write it to the --output file. The server takes
+ *                 the input, flash type, multiboot, .mcs and --format
+ *                 flags. No manifest is written, and --delta-from is
+ *                 not available.
+ *
+ *   --timings
+ *   --metrics-json=<path>
+ *                 Print the wall and CPU time, bytes and allocations
+ *                 of each phase of the work to stderr, or write them
+ *                 with a trace timeline to a JSON file.
+ *
  *    --debug-trash-silver
  *                 Intentionally corrupt the silver image by blanking
  *                 a random sector. This is a debug aid to make sure
@@ -105,12 +179,14 @@
 
 
 # include  "read_bit_file.h"
-# include  "disable_stream_crc.h"
-# include  "extract_register_write.h"
-# include  "replace_register_write.h"
-# include  "test_image_compat.h"
+# include  "quickboot_image.h"
 # include  "write_to_mcs_file.h"
+# include  "flash_manifest.h"
+# include  "flash_delta.h"
+# include  "quickboot_serve.h"
+# include  "metrics.h"
 # include  <vector>
+# include  <string>
 # include  <cstdint>
 # include  <cstdio>
 # include  <cstdlib>
@@ -119,75 +195,94 @@
 
 using namespace std;
 
-static size_t flash_sector  = 0;
-
-static bool disable_silver = false;
-
 /*
- * How to map multiboot_address bits to rs[1:0] in WBSTAR.
+ * The path of the .mcs file for one part of a dual QSPI image: the
+ * suffix goes in front of the .mcs of the output path, if it has one.
  */
-static int bpi16_rs0 = 23;
-static int bpi16_rs1 = 24;
-
-static bool test_gold_image_compatible(const std::vector<uint8_t>&vec);
-
-static void spi_quickboot_header(std::vector<uint8_t>&dst, size_t mb_offset, size_t sector);
-static void bpi16_quickboot_header(std::vector<uint8_t>&dst, size_t mb_offset, size_t sector);
-static void bpi16_fixup_endian(std::vector<uint8_t>&dst);
+static string dual_qspi_path(const char*path_out, const char*suffix)
+{
+      string path = path_out;
+      if (path.size() > 4 && path.compare(path.size()-4, 4, ".mcs") == 0)
+	    path.resize(path.size()-4);
+      return path + suffix + ".mcs";
+}
 
 int main(int argc, char*argv[])
 {
-      size_t multiboot_offset = 0;
       const char*path_out = 0;
       const char*path_gold = 0;
       const char*path_silver = 0;
-      bool bpi16_gen = false;
-      bool spi_gen = false;
-      bool debug_trash_silver = false;
+      quickboot_options_t opt;
+      mcs_options_t mcs_options;
+      const char*path_manifest = 0;
+      bool manifest_flag = true;
+      const char*path_delta = 0;
+      bool bin_flag = false;
+      bool dual_qspi_flag = false;
+      const char*path_serve = 0;
+      unsigned serve_images = 16;
+      unsigned serve_clients = 0;
+      const char*path_connect = 0;
+	// The flags that describe the image, to pass to a server.
+      vector<string> request_args;
 
 	/* Test and interpret the command line flags. */
       for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+
+	    if (parse_quickboot_flag(opt, argv[optarg])) {
+		  request_args.push_back(argv[optarg]);
+		  continue;
+	    }
+	    if (parse_mcs_flag(mcs_options, argv[optarg])) {
+		  request_args.push_back(argv[optarg]);
+		  continue;
+	    }
+
 	    if (strncmp(argv[optarg],"--output=",9) == 0) {
 		  path_out = argv[optarg] + 9;
 
 	    } else if (strncmp(argv[optarg],"--gold=",7) == 0) {
 		  path_gold = argv[optarg] + 7;
+		  request_args.push_back(argv[optarg]);
 
 	    } else if (strncmp(argv[optarg],"--silver=",9) == 0) {
 		  path_silver = argv[optarg] + 9;
+		  request_args.push_back(argv[optarg]);
 
-	    } else if (strcmp(argv[optarg],"--bpi16") == 0) {
-		  bpi16_gen = true;
-
-	    } else if (strcmp(argv[optarg],"--spi") == 0) {
-		  spi_gen = true;
+	    } else if (strcmp(argv[optarg],"--format=mcs") == 0) {
+		  bin_flag = false;
+		  request_args.push_back(argv[optarg]);
 
-	    } else if (strncmp(argv[optarg],"--bpi16-rs0=",12) == 0) {
-		  bpi16_rs0 = strtoul(argv[optarg]+12, 0, 10);
+	    } else if (strcmp(argv[optarg],"--format=bin") == 0) {
+		  bin_flag = true;
+		  request_args.push_back(argv[optarg]);
 
-	    } else if (strncmp(argv[optarg],"--bpi16-rs1=",12) == 0) {
-		  bpi16_rs1 = strtoul(argv[optarg]+12, 0, 10);
+	    } else if (strcmp(argv[optarg],"--dual-qspi") == 0) {
+		  dual_qspi_flag = true;
 
-	    } else if (strcmp(argv[optarg],"--no-bpi16-rs0") == 0) {
-		  bpi16_rs0 = 0;
+	    } else if (strncmp(argv[optarg],"--serve=",8) == 0) {
+		  path_serve = argv[optarg] + 8;
 
-	    } else if (strcmp(argv[optarg],"--no-bpi16-rs1") == 0) {
-		  bpi16_rs1 = 0;
+	    } else if (strncmp(argv[optarg],"--serve-images=",15) == 0) {
+		  serve_images = strtoul(argv[optarg]+15, 0, 0);
 
-	    } else if (strncmp(argv[optarg],"--multiboot=",12) == 0) {
-		  multiboot_offset = strtoul(argv[optarg]+12, 0, 0);
+	    } else if (strncmp(argv[optarg],"--serve-clients=",16) == 0) {
+		  serve_clients = strtoul(argv[optarg]+16, 0, 0);
 
-	    } else if (strcmp(argv[optarg],"--disable-silver") == 0) {
-		  disable_silver = true;
+	    } else if (strncmp(argv[optarg],"--connect=",10) == 0) {
+		  path_connect = argv[optarg] + 10;
 
-	    } else if (strcmp(argv[optarg],"--no-disable-silver") == 0) {
-		  disable_silver = false;
+	    } else if (strncmp(argv[optarg],"--manifest=",11) == 0) {
+		  path_manifest = argv[optarg] + 11;
+		  manifest_flag = true;
 
-	    } else if (strcmp(argv[optarg],"--debug-trash-silver") == 0) {
-		  debug_trash_silver = true;
+	    } else if (strcmp(argv[optarg],"--no-manifest") == 0) {
+		  manifest_flag = false;
 
-	    } else if (strncmp(argv[optarg],"--flash-sector=",15) == 0) {
-		  flash_sector = strtoul(argv[optarg]+15, 0, 0);
+	    } else if (strncmp(argv[optarg],"--delta-from=",13) == 0) {
+		  path_delta = argv[optarg] + 13;
 
 	    } else {
 		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
@@ -195,16 +290,25 @@ int main(int argc, char*argv[])
 	    }
       }
 
-      if (spi_gen==false && bpi16_gen==false) {
+      if (path_serve)
+	    return quickboot_serve(path_serve, serve_images, serve_clients, stdout);
+
+      if (opt.spi==false && opt.bpi16==false) {
 	    fprintf(stderr, "BPI16 or SPI? Please specify --bpi16 or --spi\n");
 	    return -1;
       }
 
-      if (spi_gen && bpi16_gen) {
+      if (opt.spi && opt.bpi16) {
 	    fprintf(stderr, "Please specify only one of --bpi16 or --spi\n");
 	    return -1;
       }
 
+      if (mcs_options.record_length != 16 && mcs_options.record_length != 32
+	  && mcs_options.record_length != 64) {
+	    fprintf(stderr, "MCS record length must be 16, 32 or 64 bytes.\n");
+	    return -1;
+      }
+
       if (path_out == 0) {
 	    fprintf(stderr, "No output file? Please specify --output=<path>\n");
 	    return -1;
@@ -215,6 +319,25 @@ int main(int argc, char*argv[])
 	    return -1;
       }
 
+      if (path_delta && bin_flag) {
+	    fprintf(stderr, "Delta updates are only written as .mcs files.\n");
+	    return -1;
+      }
+
+      if (dual_qspi_flag && (! opt.spi || bin_flag || path_delta || path_connect)) {
+	    fprintf(stderr, "--dual-qspi is only for --spi images written as .mcs files, "
+		    "and not for --delta-from or --connect.\n");
+	    return -1;
+      }
+
+      if (path_connect) {
+	    if (path_delta) {
+		  fprintf(stderr, "--delta-from cannot be used with --connect\n");
+		  return -1;
+	    }
+	    return quickboot_request(path_connect, request_args, path_out, stdout);
+      }
+
       if (path_gold == 0) {
 	    assert(path_silver);
 	    path_gold = path_silver;
@@ -222,16 +345,6 @@ int main(int argc, char*argv[])
       }
 
 
-	// If the flash sector size is not otherwise specified, then
-	// choose a default based on the targeted flash device.
-      if (flash_sector == 0) {
-	    if (spi_gen) {
-		  flash_sector = 4096;
-	    } else if (bpi16_gen) {
-		  flash_sector = 256*1024;
-	    }
-      }
-
 	// Read the gold file, strip any header, and get it ready to
 	// be included in the result file.
       FILE*fd_gold = fopen(path_gold, "rb");
@@ -242,21 +355,13 @@ int main(int argc, char*argv[])
 
       fprintf(stdout, "Reading gold file: %s\n", path_gold);
       fflush(stdout);
-      vector<uint8_t> vec_gold;
-      read_bit_file(vec_gold, fd_gold);
-      if (vec_gold.size() == 0)
+      bit_file_view view_gold;
+      if (! view_gold.load(fd_gold, path_gold))
 	    return -1;
 
       fclose(fd_gold);
       fd_gold = 0;
 
-	// If the gold file is not going to be a copy of the silver
-	// file, then check that it is compatible with this process.
-      if (path_gold != path_silver && !test_gold_image_compatible(vec_gold)) {
-	    fprintf(stderr, "Gold file %s not compatible with Quickboot assembly.\n", path_gold);
-	    return -1;
-      }
-
 	// Read the silver file, strip any header, and be ready.
       FILE*fd_silver = fopen(path_silver, "rb");
       if (fd_silver == 0) {
@@ -266,327 +371,103 @@ int main(int argc, char*argv[])
 
       fprintf(stdout, "Reading silver file: %s\n", path_silver);
       fflush(stdout);
-      vector<uint8_t> vec_silver;
-      read_bit_file(vec_silver, fd_silver);
-      if (vec_silver.size() == 0)
+	// The silver image is not edited, so map it and copy it
+	// straight into the output image.
+      bit_file_view vec_silver;
+      if (! vec_silver.load(fd_silver, path_silver))
 	    return -1;
 
       fclose(fd_silver);
       fd_silver = 0;
 
-      if (! test_silver_image_compatible(vec_silver)) {
-	    fprintf(stderr, "Silver file %s not compatible with Quickboot assembly.\n", path_silver);
-	    return -1;
-      }
-
-	/* Guess a multiboot address based on the target device we are
-	   generating for. Let the command line override this guess. */
-      if (multiboot_offset == 0 && bpi16_gen) {
-	    multiboot_offset = 0x00800000;
-      } else if (multiboot_offset == 0 && spi_gen) {
-	    multiboot_offset = 0x00400000;
-      }
-
-      if (multiboot_offset == 0) {
-	    fprintf(stderr, "Unable to guess the MULTIBOOT address. Please use --multiboot=<number>\n");
-	    return -1;
-      }
-
-      if (multiboot_offset % flash_sector != 0) {
-	    fprintf(stderr, "MULTIBOOT Address 0x%08zx is not on a prom sector boundary\n", multiboot_offset);
-	    fprintf(stderr, "PROM sector size is %zu bytes\n", flash_sector);
+	/* Check the gold and silver streams, make the gold image, and
+	   assemble the quickboot image. */
+      vector<uint8_t> vec_out;
+      vector<manifest_region_t> regions;
+      if (! make_quickboot_image(vec_out, regions, view_gold, path_gold == path_silver,
+				 vec_silver, opt, stdout))
 	    return -1;
-      }
 
+      const size_t flash_sector = opt.flash_sector;
 
-      if ((vec_gold.size() + flash_sector + flash_sector) > multiboot_offset) {
-	    fprintf(stderr, "Unable to fit gold bits into region.\n");
-	    fprintf(stderr, "Gold file is %zu bytes\n", vec_gold.size());
-	    fprintf(stderr, "MULTIBOOT byte address is 0x%08zx\n", multiboot_offset);
-	    fprintf(stderr, "Quickboot header is %zu bytes\n", flash_sector + flash_sector);
-	    return -1;
-      }
+	// The BPI16 byte layout is applied as the image is written
+	// out.
+      if (opt.bpi16)
+	    mcs_options.swizzle = SWIZZLE_X16;
 
-      fprintf(stdout, "MULTIBOOT Address: 0x%08zx\n", multiboot_offset);
-      fprintf(stdout, "PROM erase block Size: %zu bytes\n", flash_sector);
-
-      const uint32_t AXSS_old = replace_register_write(vec_gold, 0x0d, 0x474f4c44);
-      if (AXSS_old == 0) {
-	    fprintf(stdout, "WARNING        : AXSS is not present in source stream.\n");
+	/* In delta mode, write only the sectors that changed since the
+	   previous image. The header sector holds the switch word, and
+	   the update process covers the entire image. */
+      if (path_delta) {
+	    flash_delta delta;
+	    if (! delta.load(path_delta, flash_sector, mcs_options.threads))
+		  return -1;
 
-      } else if (AXSS_old == 0x53494c56) { // SILV
-	      // Replace SILV with GOLD
-	    fprintf(stdout, "... AXSS (gold): 0x474f4c44 (was: 0x%08x)\n", AXSS_old);
+	    vector<bool> changed;
+	    delta.compare(changed, vec_out, 0, mcs_options.swizzle, mcs_options.threads);
 
-      } else if ((AXSS_old & 0xff000000) == 0x53000000) { // S...
-	      // Replace a leading S with G
-	    uint32_t AXSS_target = (AXSS_old & 0x00ffffff) | 0x47000000;
-	    replace_register_write(vec_gold, 0x0d, AXSS_target);
-	    fprintf(stdout, "... AXSS (gold): 0x%08x (was: 0x%08x)\n", AXSS_target, AXSS_old);
-      }
+	    vector<delta_design_t> designs;
+	    designs.push_back(delta_design_t(0, 0, vec_out.size()));
+	    if (! write_delta_update(path_out, vec_out, 0, flash_sector,
+				     changed, designs, mcs_options))
+		  return -1;
 
+      } else if (dual_qspi_flag) {
+	      /* Write the part of the image for each of the two flash
+		 parts to its own .mcs file. */
+	    const string path_primary = dual_qspi_path(path_out, "_primary");
+	    const string path_secondary = dual_qspi_path(path_out, "_secondary");
+	    FILE*fd_primary = fopen(path_primary.c_str(), "wb");
+	    if (fd_primary == 0) {
+		  fprintf(stderr, "Unable to open output file: %s\n", path_primary.c_str());
+		  return -1;
+	    }
+	    FILE*fd_secondary = fopen(path_secondary.c_str(), "wb");
+	    if (fd_secondary == 0) {
+		  fprintf(stderr, "Unable to open output file: %s\n", path_secondary.c_str());
+		  fclose(fd_primary);
+		  return -1;
+	    }
 
-      if (bpi16_gen) {
-	      //uint32_t WBSTAR = replace_register_write(vec_gold, 0x10, 0x20000000);
-	      //fprintf(stdout, "WBSTAR (gold): 0x20000000 (was: 0x%08x)\n", WBSTAR);
+	    mcs_file_sink sink_primary (fd_primary);
+	    mcs_file_sink sink_secondary (fd_secondary);
+	    write_to_mcs_dual_qspi(sink_primary, sink_secondary, vec_out, 0, mcs_options);
 
-	    uint32_t COR0 = replace_register_write(vec_gold, 0x09, 0x062055dc);
-	    fprintf(stdout, "COR0 (gold): 0x062055dc (was: 0x%08x)\n", COR0);
+	    fclose(fd_primary);
+	    fclose(fd_secondary);
+	    fprintf(stdout, "Wrote dual QSPI parts: %s, %s\n", path_primary.c_str(),
+		    path_secondary.c_str());
 
-	    uint32_t COR1 = replace_register_write(vec_gold, 0x0e, 0x0000000e);
-	    fprintf(stdout, "COR1 (gold): 0x0000000e (was: 0x%08x)\n", COR1);
-      }
+      } else {
+	      /* Write the generated image to a .mcs file. This file can
+		 be written to the prom by prom programmer. */
+	    FILE*fd_out = fopen(path_out, "wb");
+	    if (fd_out == 0) {
+		  fprintf(stderr, "Unable to open output file: %s\n", path_out);
+		  return -1;
+	    }
 
-      fprintf(stdout, "Disabling CRC in gold stream (Replace CRC with Reset CRC).\n");
-      while (disable_stream_crc(vec_gold)) {
-	/* repeat */
-      }
+	    if (bin_flag) {
+		  mcs_file_sink sink (fd_out);
+		  write_to_bin(sink, vec_out, 0, mcs_options);
+	    } else {
+		  write_to_mcs_file(fd_out, vec_out, 0, mcs_options);
+	    }
 
-	// To simulate failing to program a segment of the prom, erase
-	// some random sector in the silver image.
-      if (debug_trash_silver) {
-	    size_t trash_offset = vec_silver.size() / 2;
-	    trash_offset &= ~(flash_sector-1);
-	    fprintf(stdout, "**** DEBUG Trash sector at 0x%08zx in silver image.\n", trash_offset);
-	    for (size_t idx = 0 ; idx < flash_sector ; idx += 1)
-		  vec_silver[trash_offset+idx] = 0xff;
+	    fclose(fd_out);
+	    fd_out = 0;
       }
 
+	/* Write the manifest that describes the flash contents. */
+      if (manifest_flag) {
+	    string manifest_out = path_manifest? path_manifest : string(path_out) + ".manifest";
+	    if (! write_flash_manifest(manifest_out.c_str(), vec_out, 0, flash_sector,
+				       regions, mcs_options.swizzle, mcs_options.threads))
+		  return -1;
 
-	/* Now the vec_gold and vec_silver vectors contain the bit
-	   files that will go into the quickboot assembled mcs
-	   stream. */
-      vector<uint8_t> vec_out;
-      vec_out.resize(multiboot_offset + vec_silver.size());
-      memset(&vec_out[0], 0xff, vec_out.size());
-
-	/* Write the gold file into the stream. */
-      fprintf(stdout, "Write GOLD image at byte address 0x%08zx\n",
-	      flash_sector+flash_sector);
-      memcpy(&vec_out[flash_sector+flash_sector], &vec_gold[0], vec_gold.size());
-
-	/* Write the silver file into the stream. */
-      fprintf(stdout, "Write SILVER image at byte address 0x%08zx\n",
-	      multiboot_offset);
-      memcpy(&vec_out[multiboot_offset], &vec_silver[0], vec_silver.size());
-
-	/* Generate a quickboot header for the type of flash that we
-	   are targetting. */
-      assert(spi_gen || bpi16_gen);
-      if (spi_gen) {
-	    spi_quickboot_header(vec_out, multiboot_offset, flash_sector);
-
-      } else if (bpi16_gen) {
-	    bpi16_quickboot_header(vec_out, multiboot_offset, flash_sector);
-	    bpi16_fixup_endian(vec_out);
-      }
-
-	/* Write the generated image to a .mcs file. This file can be
-	   written to the prom by prom programmer. */
-      FILE*fd_out = fopen(path_out, "wb");
-      if (fd_out == 0) {
-	    fprintf(stderr, "Unable to open output file: %s\n", path_out);
-	    return -1;
+	    fprintf(stdout, "Wrote manifest: %s\n", manifest_out.c_str());
       }
 
-      write_to_mcs_file(fd_out, vec_out);
-
-      fclose(fd_out);
-      fd_out = 0;
-
 	/* All done. */
       return 0;
 }
-
-static bool test_gold_image_compatible(const std::vector<uint8_t>&vec)
-{
-      if (!test_basic_image_compatibility(vec)) {
-	    fprintf(stderr, "Gold image fails basic tests.\n");
-	    return false;
-      }
-
-      uint32_t AXSS = extract_register_write(vec, 0x0d);
-      if (AXSS != 0x474f4c44) {
-	    fprintf(stderr, "Found AXSS=0x%08x\n (s/b 0x474f4c44)\n", AXSS);
-	    return false;
-      }
-
-      return true;
-}
-
-static void spi_quickboot_header(std::vector<uint8_t>&dst, size_t mb_offset, size_t sector)
-{
-      fprintf(stdout, "Quickboot SPI header\n");
-      fprintf(stdout, "Critical Switch word is aa:99:55:66 at 0x%08zx (page 0)\n", sector-4);
-
-      memset(&dst[0], 0xff, sector-4);
-
-      if (disable_silver) {
-	    dst[sector- 4] = 0xff;
-	    dst[sector- 3] = 0xff;
-	    dst[sector- 2] = 0xff;
-	    dst[sector- 1] = 0xff;
-      } else {
-	    dst[sector- 4] = 0xaa; /* Sync word */
-	    dst[sector- 3] = 0x99;
-	    dst[sector- 2] = 0x55;
-	    dst[sector- 1] = 0x66;
-      }
-      dst[sector+ 0] = 0x20; /* NOOP */
-      dst[sector+ 1] = 0x00;
-      dst[sector+ 2] = 0x00;
-      dst[sector+ 3] = 0x00;
-      dst[sector+ 4] = 0x30; /* Write to WBSTAR */
-      dst[sector+ 5] = 0x02;
-      dst[sector+ 6] = 0x00;
-      dst[sector+ 7] = 0x01;
-      dst[sector+ 8] = (mb_offset>>24) & 0xff;
-      dst[sector+ 9] = (mb_offset>>16) & 0xff;
-      dst[sector+10] = (mb_offset>> 8) & 0xff;
-      dst[sector+11] = (mb_offset>> 0) & 0xff;
-      dst[sector+12] = 0x30; /* Write to COMMAND */
-      dst[sector+13] = 0x00;
-      dst[sector+14] = 0x80;
-      dst[sector+15] = 0x01;
-      dst[sector+16] = 0x00;
-      dst[sector+17] = 0x00;
-      dst[sector+18] = 0x00;
-      dst[sector+19] = 0x0f; /* ... IPROG command */
-	/* Fill the reset of the second sector with NOOP commands */
-      for (size_t idx = 20 ; idx < sector ; idx += 4) {
-	    dst[sector+idx+0] = 0x20;
-	    dst[sector+idx+1] = 0x00;
-	    dst[sector+idx+2] = 0x00;
-	    dst[sector+idx+3] = 0x00;
-      }
-}
-
-static void bpi16_quickboot_header(std::vector<uint8_t>&dst, size_t mb_offset, size_t sector)
-{
-      fprintf(stdout, "Quickboot BPI header\n");
-      fprintf(stdout, "Critical Switch word is 00:00:00:bb 11:22:00:44 aa:99:44:66 at 0x%08zx (page 0)\n", sector-12);
-
-      uint32_t WBSTAR = 0;
-	// In the quickboot header for a BPI16 device, we use RS[0]
-	// instead of any other multiboot bits.
-
-	// Enable the RS pins.
-      WBSTAR |= 0x20000000; /* RS_TS_B */
-
-	// RS[0] connects to A[23] on the flash, and RS[1] to
-	// A[24]. So transfer those address bits RS[] part of WBSTAR.
-	// (Actually, the mapping may be more complicated then that in
-	// the hardware, but this is what we do logically.)
-      if ((bpi16_rs0!=0) && (mb_offset & (1 << bpi16_rs0)))
-	    WBSTAR |= 0x40000000; /* RS[0]*/
-      if ((bpi16_rs1!=0) && (mb_offset & (1 << bpi16_rs1)))
-	    WBSTAR |= 0x80000000; /* RS[1] */
-
-      WBSTAR |= (mb_offset & 0x00ffffff) / 2;
-
-      fprintf(stdout, "WBSTAR (quickboot header): 0x%08x\n", WBSTAR);
-
-      memset(&dst[0], 0xff, sector);
-
-	// BPI16 devices don't have a simple single word that is a
-	// critical sync word, so use these 3 words in the critical
-	// sync flash.
-      if (disable_silver) {
-	      // If the silver is disabled, then leave the critical
-	      // switch word out.
-	    dst[sector-12] = 0xff;
-	    dst[sector-11] = 0xff;
-	    dst[sector-10] = 0xff;
-	    dst[sector- 9] = 0xff;
-	    dst[sector- 8] = 0xff;
-	    dst[sector- 7] = 0xff;
-	    dst[sector- 6] = 0xff;
-	    dst[sector- 5] = 0xff;
-	    dst[sector- 4] = 0xff;
-	    dst[sector- 3] = 0xff;
-	    dst[sector- 2] = 0xff;
-	    dst[sector- 1] = 0xff;
-      } else {
-	    dst[sector-12] = 0x00; /* Critical Switch word word */
-	    dst[sector-11] = 0x00;
-	    dst[sector-10] = 0x00;
-	    dst[sector- 9] = 0xbb;
-	    dst[sector- 8] = 0x11; /* bus width detect */
-	    dst[sector- 7] = 0x22;
-	    dst[sector- 6] = 0x00;
-	    dst[sector- 5] = 0x44;
-	    dst[sector- 4] = 0xaa; /* Sync word */
-	    dst[sector- 3] = 0x99;
-	    dst[sector- 2] = 0x55;
-	    dst[sector- 1] = 0x66;
-      }
-      dst[sector+ 0] = 0x20; /* NOOP */
-      dst[sector+ 1] = 0x00;
-      dst[sector+ 2] = 0x00;
-      dst[sector+ 3] = 0x00;
-      dst[sector+ 4] = 0x20; /* NOOP */
-      dst[sector+ 5] = 0x00;
-      dst[sector+ 6] = 0x00;
-      dst[sector+ 7] = 0x00;
-      dst[sector+ 8] = 0x20; /* NOOP */
-      dst[sector+ 9] = 0x00;
-      dst[sector+10] = 0x00;
-      dst[sector+11] = 0x00;
-      dst[sector+12] = 0x20; /* NOOP */
-      dst[sector+13] = 0x00;
-      dst[sector+14] = 0x00;
-      dst[sector+15] = 0x00;
-      dst[sector+16] = 0x20; /* NOOP */
-      dst[sector+17] = 0x00;
-      dst[sector+18] = 0x00;
-      dst[sector+19] = 0x00;
-      dst[sector+20] = 0x30; /* WRITE to WBSTAR */
-      dst[sector+21] = 0x02;
-      dst[sector+22] = 0x00;
-      dst[sector+23] = 0x01;
-      dst[sector+24] = (WBSTAR >> 24) & 0xff;
-      dst[sector+25] = (WBSTAR >> 16) & 0xff;
-      dst[sector+26] = (WBSTAR >>  8) & 0xff;
-      dst[sector+27] = (WBSTAR >>  0) & 0xff;
-      dst[sector+28] = 0x30; /* Write to COMMAND */
-      dst[sector+29] = 0x00;
-      dst[sector+30] = 0x80;
-      dst[sector+31] = 0x01;
-      dst[sector+32] = 0x00;
-      dst[sector+33] = 0x00;
-      dst[sector+34] = 0x00;
-      dst[sector+35] = 0x0f; /* ... IPROG command */
-
-	/* Fill the reset of the second sector with NOOP commands */
-      for (size_t idx = 36 ; idx < sector ; idx += 4) {
-	    dst[sector+idx+0] = 0x20;
-	    dst[sector+idx+1] = 0x00;
-	    dst[sector+idx+2] = 0x00;
-	    dst[sector+idx+3] = 0x00;
-      }
-}
-
-static void bpi16_fixup_endian(std::vector<uint8_t>&dst)
-{
-      for (size_t idx = 0 ; idx < dst.size() ; idx += 2) {
-	    uint8_t tmp = dst[idx+1];
-	    uint8_t val0 = tmp & 1;
-	    for (int bit = 1 ; bit < 8 ; bit += 1) {
-		  val0 <<= 1;
-		  tmp >>= 1;
-		  val0 |= tmp & 1;
-	    }
-
-	    tmp = dst[idx+0];
-	    uint8_t val1 = tmp & 1;
-	    for (int bit = 1 ; bit < 8 ; bit += 1) {
-		  val1 <<= 1;
-		  tmp >>= 1;
-		  val1 |= tmp & 1;
-	    }
-
-	    dst[idx+0] = val0;
-	    dst[idx+1] = val1;
-      }
-
-}
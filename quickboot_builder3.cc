@@ -38,6 +38,48 @@
  *                    given designs. If the <mask> is specified, then
  *                    enable this debug feature only for the masked designs.
  *
+ *   --sparse-mcs
+ *                    Leave blank (all 0xff) records and segments out
+ *                    of the .mcs file. The flash must be erased before
+ *                    it is programmed with a sparse file.
+ *
+ *   --mcs-record-length=<N> (default: 16)
+ *                    Number of data bytes in each .mcs record. This
+ *                    may be 16, 32 or 64.
+ *
+ *   --mcs-threads=<N> (default: 0)
+ *                    Number of threads that encode the .mcs file. The
+ *                    default (0) uses one thread per processor.
+ *
+ *   --manifest=<path> (default: <output>.manifest)
+ *   --no-manifest
+ *                    Write a manifest of the flash image next to the
+ *                    .mcs file. The manifest gives the header, gold
+ *                    and silver regions of each design, and a CRC-32C
+ *                    and SHA-256 of each flash sector, so that a
+ *                    readback of the flash can be checked a sector at
+ *                    a time.
+ *
+ *   --delta-from=<path>
+ *                    Write a delta update to the --output file instead
+ *                    of the full image. The <path> is the previous
+ *                    flash image, as an .mcs file, a manifest or a raw
+ *                    binary image. Only the flash sectors that differ
+ *                    from the previous image are written, except that
+ *                    the first sector of each changed design (with its
+ *                    Critical Switch word) is written to
+ *                    <output>.restore.mcs to be programmed last. The
+ *                    steps for doing the update are printed.
+ *
+ *   --cache=<dir> (default: $QUICKBOOT_CACHE)
+ *   --no-cache
+ *                    Keep the processed gold and silver images of each
+ *                    design in a cache directory, keyed by a hash of
+ *                    the input stream and the edits. A later build
+ *                    with the same input skips straight to assembling
+ *                    the flash image. The cache may be shared by
+ *                    builder processes that run at the same time.
+ *
  *   --clif32-4=<path>
  *   --clif32-6=<path>
  *   --clif31=<path>
@@ -45,7 +87,14 @@
  *                    Specify the various input designs that go into
  *                    making the flash image. These input .bit files
  *                    are taken to be silver files. Gold files are
- *                    generated from the silver files.
+ *                    generated from the silver files. An input may
+ *                    also be an .mcs file that holds the bit stream.
+ *
+ *   --timings
+ *   --metrics-json=<path>
+ *                    Print the wall and CPU time, bytes and allocations
+ *                    of each phase of the work to stderr, or write them
+ *                    with a trace timeline to a JSON file.
  *
  * FIELD PROGRAMMING:
  * The quickboot image includes both the gold and the silver FPGA
@@ -84,11 +133,15 @@
  *    (3) clif30
  */
 
-# include  "disable_stream_crc.h"
 # include  "read_bit_file.h"
-# include  "replace_register_write.h"
 # include  "write_to_mcs_file.h"
+# include  "flash_manifest.h"
+# include  "flash_delta.h"
+# include  "build_cache.h"
+# include  "design_set.h"
+# include  "metrics.h"
 # include  <vector>
+# include  <string>
 # include  <cstdint>
 # include  <cstdio>
 # include  <cstdlib>
@@ -97,28 +150,6 @@
 
 using namespace std;
 
-/*
- * S25FL128/256 flash chips in Hybrid sector size option
- * have 64Kbyte sectors.
- */
-static const size_t flash_sector = 64*1024;
-
-/*
- * Silver image is 4MBytes past Gold image
- */
-static const size_t multiboot_offset = 4*1024*1024;
-
-/*
- * Flash contains designs that are gold/silver pairs.
- */
-static const size_t design_offset = 2 * multiboot_offset;
-
-static int debug_trash_silver_mask = 0;
-static int debug_trash_silver_header_mask = 0;
-static int debug_trash_syncword_mask = 0;
-
-static void make_design(vector<uint8_t>&vec_out, int design_pos, const vector<uint8_t>&vec_silver);
-
 int main(int argc, char*argv[])
 {
       const char*path_out = 0;
@@ -126,8 +157,22 @@ int main(int argc, char*argv[])
       const char*path_clif32_4 = 0;
       const char*path_clif31 = 0;
       const char*path_clif30 = 0;
+      mcs_options_t mcs_options;
+      const char*path_manifest = 0;
+      bool manifest_flag = true;
+      const char*path_delta = 0;
+      const char*path_cache = getenv("QUICKBOOT_CACHE");
+      design_set_options_t design_options;
+      build_cache cache;
 
       for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+	    if (parse_design_set_flag(design_options, argv[optarg]))
+		  continue;
+	    if (parse_mcs_flag(mcs_options, argv[optarg]))
+		  continue;
+
 	    if (strncmp(argv[optarg],"--output=",9) == 0) {
 		  path_out = argv[optarg] + 9;
 
@@ -143,51 +188,39 @@ int main(int argc, char*argv[])
 	    } else if (strncmp(argv[optarg],"--clif32-6=",11) == 0) {
 		  path_clif32_6 = argv[optarg] + 11;
 
-	    } else if (strcmp(argv[optarg],"--disable-silver") == 0) {
-		  debug_trash_silver_mask = 0xff;
-		  debug_trash_silver_header_mask = 0x00;
-
-	    } else if (strncmp(argv[optarg],"--disable-silver=",17) == 0) {
-		  debug_trash_silver_mask = strtoul(argv[optarg]+17,0,0);
-		  debug_trash_silver_header_mask = 0x00;
-
-	    } else if (strcmp(argv[optarg],"--disable-silver-header") == 0) {
-		  debug_trash_silver_mask = 0xff;
-		  debug_trash_silver_header_mask = 0xff;
+	    } else if (strncmp(argv[optarg],"--manifest=",11) == 0) {
+		  path_manifest = argv[optarg] + 11;
+		  manifest_flag = true;
 
-	    } else if (strncmp(argv[optarg],"--disable-silver-header=",24) == 0) {
-		  debug_trash_silver_mask = strtoul(argv[optarg]+24,0,0);
-		  debug_trash_silver_header_mask = debug_trash_silver_mask;
+	    } else if (strcmp(argv[optarg],"--no-manifest") == 0) {
+		  manifest_flag = false;
 
-	    } else if (strcmp(argv[optarg],"--no-disable-silver") == 0) {
-		  debug_trash_silver_mask = 0x00;
-		  debug_trash_silver_header_mask = 0x00;
+	    } else if (strncmp(argv[optarg],"--delta-from=",13) == 0) {
+		  path_delta = argv[optarg] + 13;
 
-	    } else if (strcmp(argv[optarg],"--disable-syncword") == 0) {
-		  debug_trash_syncword_mask = 0xff;
+	    } else if (strncmp(argv[optarg],"--cache=",8) == 0) {
+		  path_cache = argv[optarg] + 8;
 
-	    } else if (strncmp(argv[optarg],"--disable-syncword=",19) == 0) {
-		  debug_trash_syncword_mask = strtoul(argv[optarg]+19,0,0);
-
-	    } else if (strcmp(argv[optarg],"--no-disable-syncword") == 0) {
-		  debug_trash_syncword_mask = 0x00;
+	    } else if (strcmp(argv[optarg],"--no-cache") == 0) {
+		  path_cache = 0;
 
 	    } else {
 	    }
       }
 
+      if (mcs_options.record_length != 16 && mcs_options.record_length != 32
+	  && mcs_options.record_length != 64) {
+	    fprintf(stderr, "MCS record length must be 16, 32 or 64 bytes.\n");
+	    return -1;
+      }
+
       if (path_out == 0) {
 	    fprintf(stderr, "No output file? Please specify --output=<path>\n");
 	    return -1;
       }
 
-	/* Number of designs to load. */
-      size_t design_count = 0;
-      size_t first_design = 99;
-      size_t last_design = 0;
-
 	/* Read in the CLIF32-4 design */
-      vector<uint8_t> vec_clif32_4;
+      bit_file_view vec_clif32_4;
       if (path_clif32_4) {
 	    FILE*fd = fopen(path_clif32_4, "rb");
 	    if (fd == 0) {
@@ -197,18 +230,14 @@ int main(int argc, char*argv[])
 
 	    fprintf(stdout, "Reading CLIF32-4 silver file: %s\n", path_clif32_4);
 	    fflush(stdout);
-	    read_bit_file(vec_clif32_4, fd, 256+32 /* Need large 0xff pad */);
-	    if (vec_clif32_4.size() == 0)
+	    if (! vec_clif32_4.load(fd, path_clif32_4, 256+32 /* Need large 0xff pad */))
 		  return -1;
 
-	    design_count += 1;
-	    first_design = 0;
-	    last_design = 0;
 	    fclose(fd);
       }
 
 	/* Read in the CLIF32-6 design */
-      vector<uint8_t> vec_clif32_6;
+      bit_file_view vec_clif32_6;
       if (path_clif32_6) {
 	      /* Read in the CLIF32-6 design */
 	    FILE*fd = fopen(path_clif32_6, "rb");
@@ -219,19 +248,15 @@ int main(int argc, char*argv[])
 
 	    fprintf(stdout, "Reading CLIF32-6 silver file: %s\n", path_clif32_6);
 	    fflush(stdout);
-	    read_bit_file(vec_clif32_6, fd, 256+32 /* Need large 0xff pad */);
-	    if (vec_clif32_6.size() == 0)
+	    if (! vec_clif32_6.load(fd, path_clif32_6, 256+32 /* Need large 0xff pad */))
 		  return -1;
 
-	    design_count += 1;
-	    if (1 < first_design) first_design = 1;
-	    last_design = 1;
 	    fclose(fd);
       }
 
 
 	/* Read in the CLIF31 design */
-      vector<uint8_t> vec_clif31;
+      bit_file_view vec_clif31;
       if (path_clif31) {
 	      /* Read in the CLIF31 design */
 	    FILE*fd = fopen(path_clif31, "rb");
@@ -242,18 +267,14 @@ int main(int argc, char*argv[])
 
 	    fprintf(stdout, "Reading CLIF31 silver file: %s\n", path_clif31);
 	    fflush(stdout);
-	    read_bit_file(vec_clif31, fd, 256+32 /* Need large 0xff pad */);
-	    if (vec_clif31.size() == 0)
+	    if (! vec_clif31.load(fd, path_clif31, 256+32 /* Need large 0xff pad */))
 		  return -1;
 
-	    if (2 < first_design) first_design = 2;
-	    last_design = 2;
-	    design_count += 1;
 	    fclose(fd);
       }
 
 	/* Read in the CLIF30 design */
-      vector<uint8_t> vec_clif30;
+      bit_file_view vec_clif30;
       if (path_clif30) {
 	      /* Read in the CLIF30 design */
 	    FILE*fd = fopen(path_clif30, "rb");
@@ -264,237 +285,82 @@ int main(int argc, char*argv[])
 
 	    fprintf(stdout, "Reading CLIF30 silver file: %s\n", path_clif30);
 	    fflush(stdout);
-	    read_bit_file(vec_clif30, fd, 256+32 /* Need large 0xff pad */);
-	    if (vec_clif30.size() == 0)
+	    if (! vec_clif30.load(fd, path_clif30, 256+32 /* Need large 0xff pad */))
 		  return -1;
 
-	    if (3 < first_design) first_design = 3;
-	    last_design = 3;
-	    design_count += 1;
 	    fclose(fd);
       }
 
-      if (design_count < 1) {
-	    fprintf(stderr, "No designs specified?\n");
-	    return -1;
-      }
-
-      if ((last_design-first_design+1) != design_count) {
-	    fprintf(stderr, "Supplied designs are not contiguous.\n");
-	    return -1;
-      }
+	/* If the cache cannot be opened, carry on without it. */
+      if (path_cache && *path_cache && cache.open(path_cache))
+	    design_options.cache = &cache;
 
-      fprintf(stdout, "Flash sectors are %zu (0x%08zx) bytes.\n", flash_sector, flash_sector);
+      const bit_file_view*designs[design_set_count];
+      designs[0] = path_clif32_4? &vec_clif32_4 : 0;
+      designs[1] = path_clif32_6? &vec_clif32_6 : 0;
+      designs[2] = path_clif31? &vec_clif31 : 0;
+      designs[3] = path_clif30? &vec_clif30 : 0;
 
       vector<uint8_t> vec_out;
-	/* Make an image that holds the designs. */
-      vec_out.resize((design_count+first_design) * design_offset);
-      memset(&vec_out[0], 0xff, vec_out.size());
+      vector<manifest_region_t> regions;
+      size_t first_design, last_design;
+      if (! make_design_set(vec_out, regions, first_design, last_design,
+			    designs, design_options, stdout))
+	    return -1;
 
-      assert(design_count > 0);
-      assert((design_count-1) + first_design == last_design);
+      const size_t start_address = first_design * design_set_design_offset;
 
-      if (vec_clif32_4.size() > 1) {
-	    fprintf(stdout, "Processing CLIF32-4 design...\n");
+      if (path_delta) {
+	      /* In delta mode, write only the sectors that changed
+		 since the previous image. Each design has its own
+		 switch word, in the first sector of the design. */
+	    fprintf(stdout, "Done processing designs, writing delta mcs file.\n");
 	    fflush(stdout);
 
-	    make_design(vec_out, 0, vec_clif32_4);
-      }
+	    flash_delta delta;
+	    if (! delta.load(path_delta, design_set_flash_sector, mcs_options.threads))
+		  return -1;
 
-      if (vec_clif32_6.size() > 1) {
-	    fprintf(stdout, "Processing CLIF32-6 design...\n");
-	    fflush(stdout);
+	    vector<bool> changed;
+	    delta.compare(changed, vec_out, start_address,
+			  mcs_options.swizzle, mcs_options.threads);
 
-	    make_design(vec_out, 1, vec_clif32_6);
-      }
+	    vector<delta_design_t> delta_designs;
+	    for (size_t pos = first_design ; pos <= last_design ; pos += 1) {
+		  size_t design_base = pos * design_set_design_offset;
+		  delta_designs.push_back(delta_design_t(design_base, design_base,
+							 design_set_design_offset));
+	    }
 
+	    if (! write_delta_update(path_out, vec_out, start_address,
+				     design_set_flash_sector, changed, delta_designs, mcs_options))
+		  return -1;
 
-      if (vec_clif31.size() > 1) {
-	    fprintf(stdout, "Processing CLIF31 design...\n");
+      } else {
+	    fprintf(stdout, "Done processing designs, writing mcs file.\n");
+	    FILE*fd = fopen(path_out, "wb");
+	    if (fd == 0) {
+		  fprintf(stderr, "Unable to open output file: %s\n", path_out);
+		  return -1;
+	    }
 	    fflush(stdout);
 
-	    make_design(vec_out, 2, vec_clif31);
-      }
-
-
-      if (vec_clif30.size() > 1) {
-	    fprintf(stdout, "Processing CLIF30 design...\n");
-	    fflush(stdout);
+	    write_to_mcs_file(fd, vec_out, start_address, mcs_options);
 
-	    make_design(vec_out, 3, vec_clif30);
+	    fclose(fd);
+	    fd = 0;
       }
 
+	/* Write the manifest that describes the flash contents. */
+      if (manifest_flag) {
+	    string manifest_out = path_manifest? path_manifest : string(path_out) + ".manifest";
+	    if (! write_flash_manifest(manifest_out.c_str(), vec_out, start_address,
+				       design_set_flash_sector, regions,
+				       mcs_options.swizzle, mcs_options.threads))
+		  return -1;
 
-      fprintf(stdout, "Done processing designs, writing mcs file.\n");
-      FILE*fd = fopen(path_out, "wb");
-      if (fd == 0) {
-	    fprintf(stderr, "Unable to open output file: %s\n", path_out);
-	    return -1;
+	    fprintf(stdout, "Wrote manifest: %s\n", manifest_out.c_str());
       }
-      fflush(stdout);
-
-      write_to_mcs_file(fd, vec_out, first_design * design_offset);
-
-      fclose(fd);
-      fd = 0;
 
       return 0;
 }
-
-/*
- * Make a design into the output vector, based on the design position
- * (0-3) and the input silver file. Generate a gold file, and write
- * both into the output image and the correct position for the design.
- */
-static void make_design(vector<uint8_t>&vec_out, int design_pos, const vector<uint8_t>&raw_silver)
-{
-      const bool debug_trash_silver = debug_trash_silver_mask & (1 << design_pos)? true : false;
-      const bool debug_trash_silver_header = debug_trash_silver_header_mask & (1 << design_pos)? true : false;
-      const bool debug_trash_syncword = debug_trash_syncword_mask & (1 << design_pos)? true : false;
-
-	/* Location in the image of this design (gold and silver) */
-      const size_t design_base = design_pos * design_offset;
-	/* This is the BSPI value to use. */
-      const uint8_t BSPI = 0x0c;
-
-	/* Local copy of the silver image, that we can edit. */
-      vector<uint8_t> vec_silver = raw_silver;
-
-	/* Make a gold image from the silver input. */
-      vector<uint8_t> vec_gold = vec_silver;
-
-      const uint32_t AXSS_old = replace_register_write(vec_gold, 0x0d, 0x474f4c44);
-      if (AXSS_old == 0) {
-	    fprintf(stdout, "WARNING        : AXSS is not present in source stream.\n");
-
-      } else if (AXSS_old == 0x53494c56) { // SILV
-	      // Replace SILV with GOLD
-	    fprintf(stdout, "... AXSS (gold): 0x474f4c44 (was: 0x%08x)\n", AXSS_old);
-
-      } else if ((AXSS_old & 0xff000000) == 0x53000000) { // S...
-	      // Replace a leading S with G
-	    uint32_t AXSS_target = (AXSS_old & 0x00ffffff) | 0x47000000;
-	    replace_register_write(vec_gold, 0x0d, AXSS_target);
-	    fprintf(stdout, "... AXSS (gold): 0x%08x (was: 0x%08x)\n", AXSS_target, AXSS_old);
-      }
-
-      uint32_t old_BSPI = replace_register_write(vec_gold, 0x1f, BSPI);
-      fprintf(stdout, "... BSPI (gold): 0x%08x (was: 0x%08x)\n", BSPI, old_BSPI);
-
-	/* Gold images have the CRC disabled. */
-      while (disable_stream_crc(vec_gold)) {
-	      /* repeat */
-      }
-
-      old_BSPI = replace_register_write(vec_silver, 0x1f, BSPI);
-      fprintf(stdout, "... BSPI (silver): 0x%08x (was: 0x%08x)\n", BSPI, old_BSPI);
-
-	/* Put the gold image here (after the design_base) to allow
-	   space for the quickboot header. */
-      const size_t gold_start = flash_sector*2;
-
-      if (gold_start+vec_gold.size() > multiboot_offset) {
-	    fprintf(stderr, "ERROR: Gold image (%zu bytes) does not fit "
-		    "in multiboot region (%zu bytes)\n",
-		    vec_gold.size(), multiboot_offset - gold_start);
-      }
-
-	/* Write the CLIF32-4 images into the total image. */
-      fprintf(stdout, "... Write GOLD image at byte address 0x%08zx\n",
-	      design_base + gold_start);
-      memcpy(&vec_out[design_base + gold_start], &vec_gold[0], vec_gold.size());
-
-      fprintf(stdout, "... Write SILVER image at byte address 0x%08zx\n",
-	      design_base + multiboot_offset);
-      memcpy(&vec_out[design_base + multiboot_offset], &vec_silver[0], vec_silver.size());
-
-      if (debug_trash_silver) {
-	    size_t trash_offset = debug_trash_silver_header? 0 : vec_silver.size() / 2;
-	    trash_offset &= ~(flash_sector-1);
-	    fprintf(stdout, "*** DEBUG Trash sector at 0x%08zx in silver image (0x%08zx in flash image).\n", trash_offset, design_base+multiboot_offset+trash_offset);
-	    for (size_t idx = 0 ; idx < flash_sector ; idx += 1)
-		  vec_out[design_base+multiboot_offset+trash_offset+idx] = 0xff;
-      }
-
-	/* Generate a quickboot header for the image set. */
-      fprintf(stdout, "... Critical Switch word is aa:99:55:66 at 0x%08zx\n",
-	      design_base + flash_sector - 4);
-      fflush(stdout);
-
-      uint32_t offset = design_base + multiboot_offset; /* Branch to silver. */
-	// write offset[32:8] to WBSTAR instead of [23:0]. We will be
-	// writing a 0x0000000c to BSPI to call out that mode.
-      offset >>= 8;
-	// Assert that START_ADDR in WBSTAR does not overflow into the
-	// RS_TS_B and RS bits.
-      assert((offset & 0xe0000000) == 0);
-
-	// Normally include the critical sync word. If we are
-	// debugging the absence of that word, then skip it, leaving
-	// the sector filled with 0xff.
-      if (!debug_trash_syncword) {
-	    vec_out[design_base + flash_sector - 4] = 0xaa; /* Sync word */
-	    vec_out[design_base + flash_sector - 3] = 0x99; /* ... */
-	    vec_out[design_base + flash_sector - 2] = 0x55; /* ... */
-	    vec_out[design_base + flash_sector - 1] = 0x66; /* ... */
-      } else {
-	    fprintf(stdout, "*** DEBUG Clear critical sync word in quickboot header.\n");
-	    fflush(stdout);
-      }
-      vec_out[design_base + flash_sector + 0] = 0x20; /* NOOP */
-      vec_out[design_base + flash_sector + 1] = 0x00; /* ... */
-      vec_out[design_base + flash_sector + 2] = 0x00; /* ... */
-      vec_out[design_base + flash_sector + 3] = 0x00; /* ... */
-      vec_out[design_base + flash_sector + 4] = 0x30; /* Write to BSPI */
-      vec_out[design_base + flash_sector + 5] = 0x03; /* ... */
-      vec_out[design_base + flash_sector + 6] = 0xe0; /* ... */
-      vec_out[design_base + flash_sector + 7] = 0x01; /* ... */
-      vec_out[design_base + flash_sector + 8] = 0x00; /* ... */
-      vec_out[design_base + flash_sector + 9] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +10] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +11] = BSPI; /* ... */
-      vec_out[design_base + flash_sector +12] = 0x30; /* Write to Command */
-      vec_out[design_base + flash_sector +13] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +14] = 0x80; /* ... */
-      vec_out[design_base + flash_sector +15] = 0x01; /* ... */
-      vec_out[design_base + flash_sector +16] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +17] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +18] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +19] = 0x12; /* ... BSPI_Read */
-      vec_out[design_base + flash_sector +20] = 0x20; /* NOOP */
-      vec_out[design_base + flash_sector +21] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +22] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +23] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +24] = 0x30; /* Set a watchdog timer */
-      vec_out[design_base + flash_sector +25] = 0x02; /* ... */
-      vec_out[design_base + flash_sector +26] = 0x20; /* ... */
-      vec_out[design_base + flash_sector +27] = 0x01; /* ... */
-      vec_out[design_base + flash_sector +28] = 0x40; /* ... */
-      vec_out[design_base + flash_sector +29] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +30] = 0x7f; /* ... */
-      vec_out[design_base + flash_sector +31] = 0xff; /* ... */
-      vec_out[design_base + flash_sector +32] = 0x30; /* Write to WBSTAR */
-      vec_out[design_base + flash_sector +33] = 0x02; /* ... */
-      vec_out[design_base + flash_sector +34] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +35] = 0x01; /* ... */
-      vec_out[design_base + flash_sector +36] = (offset>>24) & 0xff; /* ... */
-      vec_out[design_base + flash_sector +37] = (offset>>16) & 0xff; /* ... */
-      vec_out[design_base + flash_sector +38] = (offset>> 8) & 0xff; /* ... */
-      vec_out[design_base + flash_sector +39] = (offset>> 0) & 0xff; /* ... */
-      vec_out[design_base + flash_sector +40] = 0x30; /* Write to COMMAND */
-      vec_out[design_base + flash_sector +41] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +42] = 0x80; /* ... */
-      vec_out[design_base + flash_sector +43] = 0x01; /* ... */
-      vec_out[design_base + flash_sector +44] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +45] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +46] = 0x00; /* ... */
-      vec_out[design_base + flash_sector +47] = 0x0f; /* ... IPROG */
-
-	/* Pad the rest of the flash_sector with NOOP */
-      for (size_t idx = 48 ; idx < flash_sector ; idx += 4) {
-	    vec_out[design_base + flash_sector + idx + 0] = 0x20;
-	    vec_out[design_base + flash_sector + idx + 1] = 0x00;
-	    vec_out[design_base + flash_sector + idx + 2] = 0x00;
-	    vec_out[design_base + flash_sector + idx + 3] = 0x00;
-      }
-}
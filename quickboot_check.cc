@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Check the library on synthetic streams. Each check makes its inputs
+ * with make_synth_stream (the generator behind bitstream_synth), runs
+ * a kernel of the tools, and checks the result against the input by
+ * an independent path: the .mcs encoder (also for dual quad-SPI)
+ * against the decoder, the CRC recompute against the CRC checker, the
+ * frame compression against a replay of the frame writes, and the
+ * delta update against a decode of the files that it writes. Each check prints PASS or FAIL, and the
+ * exit code is non-zero if any check fails. The messages of the tools
+ * go to check.log in the work directory.
+ *
+ * COMMAND LINE FLAGS:
+ *   --work=<dir> (default: check_work)
+ *                    Where the files that the checks write go.
+ *
+ *   --check=<name>
+ *                    Only run the checks whose name starts with this.
+ */
+
+# include  "synth_stream.h"
+# include  "packet_index.h"
+# include  "replace_register_write.h"
+# include  "stream_crc.h"
+# include  "bit_swizzle.h"
+# include  "write_to_mcs_file.h"
+# include  "read_mcs_file.h"
+# include  "flash_delta.h"
+# include  "frame_map.h"
+# include  "frame_compress.h"
+# include  <vector>
+# include  <map>
+# include  <string>
+# include  <cstdint>
+# include  <cstdio>
+# include  <cstring>
+# include  <sys/types.h>
+# include  <sys/stat.h>
+
+using namespace std;
+
+struct check_state_t {
+      string work;
+      FILE*log;
+};
+
+/*
+ * Read an .mcs file that a check wrote into a list of extents.
+ */
+static bool read_mcs_path(vector<mcs_extent_t>&dst, const string&path)
+{
+      FILE*fd = fopen(path.c_str(), "r");
+      if (fd == 0) {
+	    fprintf(stdout, "  Unable to open %s\n", path.c_str());
+	    return false;
+      }
+      bool rc = read_mcs_file(dst, fd);
+      fclose(fd);
+      if (! rc)
+	    fprintf(stdout, "  %s does not decode\n", path.c_str());
+      return rc;
+}
+
+/*
+ * Encode a stream as .mcs with each record length, sparse or not,
+ * each swizzle and a few start addresses (on 64K segments, like the
+ * multiboot addresses of the builders), decode the text, and undo
+ * the swizzle. The result must be the stream again, from the start
+ * address on. Bytes that the decoder does not get are erased (0xff).
+ */
+static bool check_mcs_roundtrip(check_state_t&st)
+{
+      synth_options_t sopt;
+      sopt.fdri_bytes = 1536*1024;
+      sopt.seed = 2;
+      vector<uint8_t> vec;
+      make_synth_stream(vec, sopt);
+
+      static const size_t record_lengths[] = { 16, 32, 64 };
+      static const swizzle_t swizzles[] = { SWIZZLE_NONE, SWIZZLE_X8, SWIZZLE_X16 };
+      static const size_t start_addresses[] = { 0, 0x10000, 0x30000 };
+
+      size_t cases = 0;
+      for (size_t rdx = 0 ; rdx < 3 ; rdx += 1)
+      for (size_t sdx = 0 ; sdx < 3 ; sdx += 1)
+      for (size_t adx = 0 ; adx < 3 ; adx += 1)
+      for (unsigned sparse = 0 ; sparse < 2 ; sparse += 1) {
+	    mcs_options_t opt;
+	    opt.record_length = record_lengths[rdx];
+	    opt.swizzle = swizzles[sdx];
+	    opt.sparse = sparse != 0;
+	    opt.threads = (cases % 2)? 1 : 0;
+	    opt.log = st.log;
+	    const size_t start = start_addresses[adx];
+
+	    vector<char> text;
+	    mcs_buffer_sink out (text);
+	    write_to_mcs(out, vec, start, opt);
+
+	    vector<mcs_extent_t> extents;
+	    if (! read_mcs_file(extents, (const uint8_t*)&text[0], text.size())) {
+		  fprintf(stdout, "  record length %zu, swizzle %d, start 0x%zx%s: "
+			  "the text does not decode\n", opt.record_length,
+			  (int)opt.swizzle, start, opt.sparse? ", sparse" : "");
+		  return false;
+	    }
+
+	    vector<uint8_t> img;
+	    mcs_extents_to_image(img, extents);
+	    if (img.size() < vec.size())
+		  img.resize(vec.size(), 0xff);
+
+	    bool ok = true;
+	    for (size_t idx = 0 ; idx < start && ok ; idx += 1) {
+		  if (img[idx] != 0xff)
+			ok = false;
+	    }
+	    for (size_t idx = vec.size() ; idx < img.size() && ok ; idx += 1) {
+		  if (img[idx] != 0xff)
+			ok = false;
+	    }
+	    if (ok && start < vec.size()) {
+		  bit_swizzle(&img[start], &img[start], vec.size()-start, opt.swizzle);
+		  ok = memcmp(&img[start], &vec[start], vec.size()-start) == 0;
+	    }
+
+	    if (! ok) {
+		  fprintf(stdout, "  record length %zu, swizzle %d, start 0x%zx%s: "
+			  "the decoded image does not match\n", opt.record_length,
+			  (int)opt.swizzle, start, opt.sparse? ", sparse" : "");
+		  return false;
+	    }
+
+	    cases += 1;
+      }
+
+      fprintf(st.log, "mcs-roundtrip: %zu cases\n", cases);
+      return true;
+}
+
+/*
+ * Encode an image (with an odd size, so the last byte is paired with
+ * an erased one) as the two .mcs streams of dual quad-SPI, decode
+ * both, and put the nibbles back together the way the FPGA reads
+ * them: the high nibble of each byte first, from the secondary part
+ * on D[7:4] and the primary part on D[3:0]. The result must be the
+ * image again, from the start address on.
+ */
+static bool check_dual_qspi_roundtrip(check_state_t&st)
+{
+      synth_options_t sopt;
+      sopt.fdri_bytes = 1024*1024;
+      sopt.seed = 5;
+      vector<uint8_t> vec;
+      make_synth_stream(vec, sopt);
+      vec.push_back(0x5a);
+      if (vec.size() % 2 == 0)
+	    vec.push_back(0xa5);
+
+      static const size_t start_addresses[] = { 0, 0x20000 };
+      for (size_t adx = 0 ; adx < 2 ; adx += 1) {
+	    const size_t start = start_addresses[adx];
+	    mcs_options_t opt;
+	    opt.log = st.log;
+
+	    vector<char> text_primary, text_secondary;
+	    mcs_buffer_sink out_primary (text_primary);
+	    mcs_buffer_sink out_secondary (text_secondary);
+	    write_to_mcs_dual_qspi(out_primary, out_secondary, vec, start, opt);
+
+	    vector<mcs_extent_t> ext_primary, ext_secondary;
+	    if (! read_mcs_file(ext_primary, (const uint8_t*)&text_primary[0],
+				text_primary.size(), st.log)
+		|| ! read_mcs_file(ext_secondary, (const uint8_t*)&text_secondary[0],
+				   text_secondary.size(), st.log)) {
+		  fprintf(stdout, "  start 0x%zx: the parts do not decode\n", start);
+		  return false;
+	    }
+
+	    vector<uint8_t> primary, secondary;
+	    mcs_extents_to_image(primary, ext_primary);
+	    mcs_extents_to_image(secondary, ext_secondary);
+	    const size_t half = (vec.size() + 1) / 2;
+	    if (primary.size() != half || secondary.size() != half) {
+		  fprintf(stdout, "  start 0x%zx: the parts hold %zu and %zu bytes, not %zu\n",
+			  start, primary.size(), secondary.size(), half);
+		  return false;
+	    }
+
+	    for (size_t idx = start/2 ; idx < half ; idx += 1) {
+		  const uint8_t byte0 = (secondary[idx] & 0xf0) | (primary[idx] >> 4);
+		  const uint8_t byte1 = (secondary[idx] << 4) | (primary[idx] & 0x0f);
+		  const uint8_t want1 = 2*idx+1 < vec.size()? vec[2*idx+1] : 0xff;
+		  if (byte0 != vec[2*idx] || byte1 != want1) {
+			fprintf(stdout, "  start 0x%zx: the bytes at 0x%zx do not match\n",
+				start, 2*idx);
+			return false;
+		  }
+	    }
+	    for (size_t idx = 0 ; idx < start/2 ; idx += 1) {
+		  if (primary[idx] != 0xff || secondary[idx] != 0xff) {
+			fprintf(stdout, "  start 0x%zx: the parts write before the start\n",
+				start);
+			return false;
+		  }
+	    }
+      }
+
+      return true;
+}
+
+/*
+ * Streams with valid CRC checks must check, and still check after a
+ * header edit once the CRCs are recomputed. The edit alone must make
+ * them fail. Streams with bad CRC checks, or none, must not check.
+ */
+static bool check_crc_recompute(check_state_t&st)
+{
+      static const synth_family_t families[] = { SYNTH_7SERIES, SYNTH_ULTRASCALE,
+						 SYNTH_ULTRASCALE_PLUS };
+
+      for (size_t fdx = 0 ; fdx < 3 ; fdx += 1) {
+	    synth_options_t sopt;
+	    sopt.family = families[fdx];
+	    sopt.fdri_bytes = 512*1024;
+	    sopt.seed = 3 + fdx;
+	    vector<uint8_t> vec;
+	    make_synth_stream(vec, sopt);
+
+	    packet_index index;
+	    index.build(vec);
+	    size_t count = 0;
+	    const crc_model_t model = check_stream_crcs(&vec[0], index, count);
+	    if (model == CRC_MODEL_NONE || count == 0) {
+		  fprintf(stdout, "  family %zu: the synthetic CRC checks do not validate\n", fdx);
+		  return false;
+	    }
+
+	      // Change COR1 and WBSTAR, the way the builders do.
+	    vector<register_edit_t> edits;
+	    edits.push_back(register_edit_t(0x0e, 0x00000002));
+	    edits.push_back(register_edit_t(0x10, 0x00400000));
+	    if (replace_register_writes(&vec[0], index, edits) != edits.size()) {
+		  fprintf(stdout, "  family %zu: the header edits were not made\n", fdx);
+		  return false;
+	    }
+
+	    size_t edit_count = 0;
+	    if (check_stream_crcs(&vec[0], index, edit_count) != CRC_MODEL_NONE) {
+		  fprintf(stdout, "  family %zu: the CRC checks still validate after "
+			  "the edits\n", fdx);
+		  return false;
+	    }
+
+	    size_t written = update_stream_crcs(&vec[0], index, model);
+	    size_t new_count = 0;
+	    crc_model_t new_model = check_stream_crcs(&vec[0], index, new_count);
+	    if (written != count || new_model != model || new_count != count) {
+		  fprintf(stdout, "  family %zu: %zu of %zu CRC checks recomputed, "
+			  "and they do not validate\n", fdx, written, count);
+		  return false;
+	    }
+	    fprintf(st.log, "crc-recompute: family %zu, %zu CRC checks recomputed\n",
+		    fdx, written);
+      }
+
+      synth_options_t sopt;
+      sopt.fdri_bytes = 64*1024;
+      sopt.crc = SYNTH_CRC_BAD;
+      vector<uint8_t> vec;
+      make_synth_stream(vec, sopt);
+      packet_index index;
+      index.build(vec);
+      size_t count = 0;
+      if (check_stream_crcs(&vec[0], index, count) != CRC_MODEL_NONE || count == 0) {
+	    fprintf(stdout, "  bad CRC checks validate\n");
+	    return false;
+      }
+
+      sopt.crc = SYNTH_CRC_NONE;
+      make_synth_stream(vec, sopt);
+      index.build(vec);
+      if (check_stream_crcs(&vec[0], index, count) != CRC_MODEL_NONE || count != 0) {
+	    fprintf(stdout, "  a stream without CRC checks has %zu\n", count);
+	    return false;
+      }
+
+      return true;
+}
+
+/*
+ * Compress a stream with a frame address list, then replay the frame
+ * writes of the input and of the output. Every address must get the
+ * same frame from both, and the output CRC checks must validate. A
+ * list with the wrong number of addresses must be refused.
+ */
+static bool check_compress_roundtrip(check_state_t&st)
+{
+      synth_options_t sopt;
+      sopt.fdri_bytes = 2*1024*1024;
+      sopt.seed = 7;
+      vector<uint8_t> vec;
+      make_synth_stream(vec, sopt);
+
+      packet_index index;
+      index.build(vec);
+      frame_map frames;
+      frames.build(&vec[0], index, stream_family(&vec[0], index));
+      const size_t fw = frames.frame_words();
+      if (frames.writes().size() != 1 || frames.writes()[0].frames < 2) {
+	    fprintf(stdout, "  the synthetic stream does not have one FDRI write\n");
+	    return false;
+      }
+
+	// The device geometry does not matter to the replay, so the
+	// frames get sequential addresses. The pad frame has none.
+      const size_t nframes = frames.writes()[0].frames - 1;
+      vector<uint32_t> addresses (nframes);
+      const string path_addr = st.work + "/compress.far";
+      FILE*fd = fopen(path_addr.c_str(), "w");
+      if (fd == 0) {
+	    fprintf(stdout, "  Unable to write %s\n", path_addr.c_str());
+	    return false;
+      }
+      for (size_t idx = 0 ; idx < nframes ; idx += 1) {
+	    addresses[idx] = idx;
+	    fprintf(fd, "%08zx\n", idx);
+      }
+      fclose(fd);
+
+      compress_options_t copt;
+      copt.compress = true;
+      copt.frame_addresses = path_addr;
+      compress_result_t res;
+      vector<uint8_t> out = vec;
+      if (! compress_stream(out, "check", copt, res, st.log, st.log)) {
+	    fprintf(stdout, "  compress_stream failed (see check.log)\n");
+	    return false;
+      }
+      if (! res.rewritten || res.mfwr_frames == 0 || out.size() >= vec.size()) {
+	    fprintf(stdout, "  the stream was not rewritten (%zu MFWR frames)\n",
+		    res.mfwr_frames);
+	    return false;
+      }
+
+      packet_index out_index;
+      out_index.build(out);
+      map<uint32_t,const uint8_t*> in_frames, out_frames;
+      if (! replay_frame_writes(in_frames, &vec[0], index, fw, addresses, st.log)
+	  || ! replay_frame_writes(out_frames, &out[0], out_index, fw, addresses, st.log)) {
+	    fprintf(stdout, "  the frame writes do not replay (see check.log)\n");
+	    return false;
+      }
+
+      if (in_frames.size() != nframes || out_frames.size() != nframes) {
+	    fprintf(stdout, "  the replay writes %zu and %zu of %zu frames\n",
+		    in_frames.size(), out_frames.size(), nframes);
+	    return false;
+      }
+      for (map<uint32_t,const uint8_t*>::const_iterator cur = in_frames.begin()
+		 ; cur != in_frames.end() ; ++ cur) {
+	    map<uint32_t,const uint8_t*>::const_iterator got = out_frames.find(cur->first);
+	    if (got == out_frames.end() || memcmp(cur->second, got->second, 4*fw) != 0) {
+		  fprintf(stdout, "  frame 0x%08x does not match after compression\n",
+			  cur->first);
+		  return false;
+	    }
+      }
+
+      size_t count = 0;
+      if (check_stream_crcs(&out[0], out_index, count) == CRC_MODEL_NONE) {
+	    fprintf(stdout, "  the CRC checks of the compressed stream do not validate\n");
+	    return false;
+      }
+
+      fprintf(st.log, "compress-roundtrip: %zu frames, %zu with MFWR, %zu -> %zu bytes\n",
+	      nframes, res.mfwr_frames, vec.size(), out.size());
+
+	// One address short must be refused, and leave the stream alone.
+      fd = fopen(path_addr.c_str(), "w");
+      for (size_t idx = 0 ; idx+1 < nframes ; idx += 1)
+	    fprintf(fd, "%08zx\n", idx);
+      fclose(fd);
+      out = vec;
+      if (compress_stream(out, "check", copt, res, st.log, st.log) || out != vec) {
+	    fprintf(stdout, "  a short frame address list is used\n");
+	    return false;
+      }
+
+      return true;
+}
+
+/*
+ * Check that the extents of a delta file write exactly the selected
+ * sectors, with the data of the new image.
+ */
+static bool check_delta_sectors(const string&path, const vector<uint8_t>&vec,
+				size_t sector_size, const vector<size_t>&sectors)
+{
+      vector<mcs_extent_t> extents;
+      if (! read_mcs_path(extents, path))
+	    return false;
+
+      vector<bool> seen (sectors.size(), false);
+      size_t bytes = 0;
+      for (size_t idx = 0 ; idx < extents.size() ; idx += 1) {
+	    const mcs_extent_t&cur = extents[idx];
+	    for (size_t off = 0 ; off < cur.data.size() ; off += 1) {
+		  const size_t addr = cur.address + off;
+		  size_t sdx = 0;
+		  while (sdx < sectors.size() && sectors[sdx] != addr / sector_size)
+			sdx += 1;
+		  if (sdx == sectors.size()) {
+			fprintf(stdout, "  %s writes 0x%08zx, which is not in a "
+				"changed sector\n", path.c_str(), addr);
+			return false;
+		  }
+		  if (addr >= vec.size() || cur.data[off] != vec[addr]) {
+			fprintf(stdout, "  %s has the wrong data at 0x%08zx\n",
+				path.c_str(), addr);
+			return false;
+		  }
+		  seen[sdx] = true;
+	    }
+	    bytes += cur.data.size();
+      }
+
+      if (bytes != sectors.size() * sector_size) {
+	    fprintf(stdout, "  %s writes %zu bytes, not %zu sectors\n",
+		    path.c_str(), bytes, sectors.size());
+	    return false;
+      }
+      for (size_t sdx = 0 ; sdx < sectors.size() ; sdx += 1) {
+	    if (! seen[sdx]) {
+		  fprintf(stdout, "  %s is missing sector %zu\n", path.c_str(), sectors[sdx]);
+		  return false;
+	    }
+      }
+
+      return true;
+}
+
+/*
+ * Write an image as the previous .mcs file, change two sectors, and
+ * make the delta update. The changed sector with the switch word of
+ * the design must go to the restore file, and the other to the delta
+ * file, each with the data of the new image.
+ */
+static bool check_delta_output(check_state_t&st)
+{
+      const size_t sector_size = 0x10000;
+      synth_options_t sopt;
+      sopt.fdri_bytes = 1024*1024;
+      sopt.seed = 11;
+      vector<uint8_t> vec;
+      make_synth_stream(vec, sopt);
+
+      mcs_options_t opt;
+      opt.log = st.log;
+
+      const string path_prev = st.work + "/delta_prev.mcs";
+      FILE*fd = fopen(path_prev.c_str(), "w");
+      if (fd == 0) {
+	    fprintf(stdout, "  Unable to write %s\n", path_prev.c_str());
+	    return false;
+      }
+      write_to_mcs_file(fd, vec, 0, opt);
+      fclose(fd);
+
+      vector<uint8_t> vec_new = vec;
+      vec_new[3*sector_size + 100] ^= 0x5a;
+      vec_new[7*sector_size + 5] ^= 0x01;
+
+      flash_delta delta;
+      if (! delta.load(path_prev.c_str(), sector_size, 0)) {
+	    fprintf(stdout, "  Unable to load %s\n", path_prev.c_str());
+	    return false;
+      }
+
+      vector<bool> changed;
+      size_t nchanged = delta.compare(changed, vec_new, 0, SWIZZLE_NONE, 0);
+      for (size_t sec = 0 ; sec < changed.size() ; sec += 1) {
+	    if (changed[sec] != (sec == 3 || sec == 7)) {
+		  fprintf(stdout, "  sector %zu is %s\n", sec,
+			  changed[sec]? "changed" : "not changed");
+		  return false;
+	    }
+      }
+      if (nchanged != 2) {
+	    fprintf(stdout, "  %zu sectors changed, not 2\n", nchanged);
+	    return false;
+      }
+
+	// The design covers the whole image, with its switch word in
+	// sector 7.
+      vector<delta_design_t> designs;
+      designs.push_back(delta_design_t(7*sector_size, 0, vec_new.size()));
+
+      const string path_delta = st.work + "/delta.mcs";
+      if (! write_delta_update(path_delta.c_str(), vec_new, 0, sector_size,
+			       changed, designs, opt)) {
+	    fprintf(stdout, "  Unable to write %s\n", path_delta.c_str());
+	    return false;
+      }
+
+      if (! check_delta_sectors(path_delta, vec_new, sector_size, vector<size_t>(1, 3)))
+	    return false;
+      if (! check_delta_sectors(path_delta + ".restore.mcs", vec_new, sector_size,
+				vector<size_t>(1, 7)))
+	    return false;
+
+      return true;
+}
+
+struct check_t {
+      const char*name;
+      bool (*fun)(check_state_t&st);
+};
+
+static const check_t checks[] = {
+      { "mcs-roundtrip",       &check_mcs_roundtrip },
+      { "dual-qspi-roundtrip", &check_dual_qspi_roundtrip },
+      { "crc-recompute",       &check_crc_recompute },
+      { "compress-roundtrip",  &check_compress_roundtrip },
+      { "delta-output",        &check_delta_output },
+      { 0, 0 }
+};
+
+int main(int argc, char*argv[])
+{
+      check_state_t st;
+      st.work = "check_work";
+      const char*check_prefix = "";
+
+      for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (strncmp(argv[optarg],"--work=",7) == 0) {
+		  st.work = argv[optarg] + 7;
+
+	    } else if (strncmp(argv[optarg],"--check=",8) == 0) {
+		  check_prefix = argv[optarg] + 8;
+
+	    } else {
+		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
+		  return -1;
+	    }
+      }
+
+      mkdir(st.work.c_str(), 0777);
+      const string path_log = st.work + "/check.log";
+      st.log = fopen(path_log.c_str(), "w");
+      if (st.log == 0) {
+	    fprintf(stderr, "Unable to open log file: %s\n", path_log.c_str());
+	    return -1;
+      }
+
+      size_t failed = 0;
+      for (const check_t*cur = checks ; cur->name ; cur += 1) {
+	    if (strncmp(cur->name, check_prefix, strlen(check_prefix)) != 0)
+		  continue;
+
+	    fprintf(st.log, "*** %s\n", cur->name);
+	    bool ok = cur->fun(st);
+	    fprintf(stdout, "%-24s %s\n", cur->name, ok? "PASS" : "FAIL");
+	    fflush(stdout);
+	    fflush(st.log);
+	    if (! ok)
+		  failed += 1;
+      }
+
+      fclose(st.log);
+
+      if (failed > 0) {
+	    fprintf(stdout, "%zu check(s) failed.\n", failed);
+	    return 1;
+      }
+      return 0;
+}
@@ -23,10 +23,12 @@
  */
 
 # include  "read_bit_file.h"
-# include  "replace_register_write.h"
-# include  "test_image_compat.h"
-# include  "disable_stream_crc.h"
+# include  "quickboot_stream.h"
+# include  "build_cache.h"
+# include  "frame_compress.h"
+# include  "metrics.h"
 # include  <vector>
+# include  <string>
 # include  <cstdio>
 # include  <cstdint>
 # include  <cstdlib>
@@ -43,8 +45,15 @@ int main(int argc, char*argv[])
 
       bool bpi16_gen = false;
       bool spi_gen = false;
+      const char*path_cache = getenv("QUICKBOOT_CACHE");
+      compress_options_t compress;
 
       for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+	    if (parse_compress_flag(compress, argv[optarg]))
+		  continue;
+
 	    if (strncmp(argv[optarg], "--output=",9) == 0) {
 		  path_out = argv[optarg] + 9;
 
@@ -60,6 +69,12 @@ int main(int argc, char*argv[])
 	    } else if (strncmp(argv[optarg],"--id=",5) == 0) {
 		  id_text = argv[optarg] + 5;
 
+	    } else if (strncmp(argv[optarg],"--cache=",8) == 0) {
+		  path_cache = argv[optarg] + 8;
+
+	    } else if (strcmp(argv[optarg],"--no-cache") == 0) {
+		  path_cache = 0;
+
 	    } else {
 		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
 		  return -1;
@@ -86,6 +101,11 @@ int main(int argc, char*argv[])
 	    return -1;
       }
 
+	// If the cache cannot be opened, carry on without it.
+      build_cache cache;
+      if (path_cache && *path_cache)
+	    cache.open(path_cache);
+
 	// Read the silver file, strip any header, and be ready.
       FILE*fd_silver = fopen(path_silver, "rb");
       if (fd_silver == 0) {
@@ -103,43 +123,47 @@ int main(int argc, char*argv[])
       fclose(fd_silver);
       fd_silver = 0;
 
-      if (! test_silver_image_compatible(vec_silver)) {
-	    fprintf(stderr, "Silver file %s not compatible with Quickboot assembly.\n", path_silver);
-	    return -1;
-      }
-
-      if (id_text) {
-	    fprintf(stdout, "Writing id string \"%s\" into prefix\n", id_text);
-	    memcpy(&vec_silver[0], id_text, strlen(id_text)+1);
+	// The gold stream depends only on the silver stream and the
+	// edits, so it may be in the cache from an earlier build.
+      string cache_name;
+      if (cache.is_open()) {
+	    cache_key_t key ("gold");
+	    key.add(vec_silver);
+	    key.add((uint32_t)bpi16_gen);
+	    cache_name = key.finish();
       }
 
-      const uint32_t AXSS_old = replace_register_write(vec_silver, 0x0d, 0x474f4c44);
-      if (AXSS_old == 0) {
-	    fprintf(stdout, "WARNING        : AXSS is not present in source stream.\n");
+      vector< vector<uint8_t> > cached;
+      if (cache.is_open() && cache.lookup(cache_name, cached) && cached.size() == 1) {
+	    vec_silver.swap(cached[0]);
+	    fprintf(stdout, "Gold stream from cache (%.16s)\n", cache_name.c_str());
 
-      } else if (AXSS_old == 0x53494c56) { // SILV
-	      // Replace SILV with GOLD
-	    fprintf(stdout, "... AXSS (gold): 0x474f4c44 (was: 0x%08x)\n", AXSS_old);
+      } else {
+	    if (! make_gold_stream(vec_silver, bpi16_gen, stdout)) {
+		  fprintf(stderr, "Silver file %s not compatible with Quickboot assembly.\n", path_silver);
+		  return -1;
+	    }
 
-      } else if ((AXSS_old & 0xff000000) == 0x53000000) { // S...
-	      // Replace a leading S with G
-	    uint32_t AXSS_target = (AXSS_old & 0x00ffffff) | 0x47000000;
-	    replace_register_write(vec_silver, 0x0d, AXSS_target);
-	    fprintf(stdout, "... AXSS: 0x%08x (was: 0x%08x)\n", AXSS_target, AXSS_old);
+	    if (cache.is_open()) {
+		  vector<const vector<uint8_t>*> blobs;
+		  blobs.push_back(&vec_silver);
+		  cache.store(cache_name, blobs);
+	    }
       }
 
-
-      if (bpi16_gen) {
-	    uint32_t COR0 = replace_register_write(vec_silver, 0x09, 0x062055dc);
-	    fprintf(stdout, "COR0 (gold): 0x062055dc (was: 0x%08x)\n", COR0);
-
-	    uint32_t COR1 = replace_register_write(vec_silver, 0x0e, 0x0000000e);
-	    fprintf(stdout, "COR1 (gold): 0x0000000e (was: 0x%08x)\n", COR1);
+	// Compress after the cache, because the compression depends
+	// on the options.
+      if (compress.compress) {
+	    compress_result_t res;
+	    if (! compress_stream(vec_silver, "gold", compress, res, stdout))
+		  return -1;
       }
 
-      fprintf(stdout, "Disable CRC in gold stream (Replace CRC with Reset CRC)\n");
-      while (disable_stream_crc(vec_silver)) {
-	/* repeat */
+	// The id string goes into the pad before the stream, so it
+	// is not part of the cached stream.
+      if (id_text) {
+	    fprintf(stdout, "Writing id string \"%s\" into prefix\n", id_text);
+	    memcpy(&vec_silver[0], id_text, strlen(id_text)+1);
       }
 
       FILE*fd_out = fopen(path_out, "wb");
@@ -148,8 +172,10 @@ int main(int argc, char*argv[])
 	    return -1;
       }
 
-      size_t rc = fwrite(&vec_silver[0], 1, vec_silver.size(), fd_out);
-      assert(rc == vec_silver.size());
+      { metrics_phase phase ("write output", vec_silver.size());
+	    size_t rc = fwrite(&vec_silver[0], 1, vec_silver.size(), fd_out);
+	    assert(rc == vec_silver.size());
+      }
 
       fclose(fd_out);
 
@@ -28,8 +28,9 @@
  */
 
 # include  "read_bit_file.h"
-# include  "replace_register_write.h"
-# include  "disable_stream_crc.h"
+# include  "quickboot_stream.h"
+# include  "frame_compress.h"
+# include  "metrics.h"
 # include  <vector>
 # include  <cstdio>
 # include  <cstdint>
@@ -43,8 +44,14 @@ int main(int argc, char*argv[])
 {
       const char*path_out = 0;
       const char*path_raw = 0;
+      compress_options_t compress;
 
       for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+	    if (parse_compress_flag(compress, argv[optarg]))
+		  continue;
+
 	    if (strncmp(argv[optarg], "--output=",9) == 0) {
 		  path_out = argv[optarg] + 9;
 
@@ -84,29 +91,12 @@ int main(int argc, char*argv[])
       fclose(fd_raw);
       fd_raw = 0;
 
+      make_gold3_stream(vec_raw, stdout);
 
-      const uint32_t AXSS_old = replace_register_write(vec_raw, 0x0d, 0x474f4c44);
-      if (AXSS_old == 0) {
-	    fprintf(stdout, "WARNING        : AXSS is not present in source stream.\n");
-
-      } else if (AXSS_old == 0x53494c56) { // SILV
-	      // Replace SILV with GOLD
-	    fprintf(stdout, "... AXSS (gold): 0x474f4c44 (was: 0x%08x)\n", AXSS_old);
-
-      } else if ((AXSS_old & 0xff000000) == 0x53000000) { // S...
-	      // Replace a leading S with G
-	    uint32_t AXSS_target = (AXSS_old & 0x00ffffff) | 0x47000000;
-	    replace_register_write(vec_raw, 0x0d, AXSS_target);
-	    fprintf(stdout, "... AXSS (gold): 0x%08x (was: 0x%08x)\n", AXSS_target, AXSS_old);
-      }
-
-	// Edit the silver stream BSPI register value.
-      uint32_t BSPI = replace_register_write(vec_raw, 0x1f, 0x0c);
-      fprintf(stdout, "BSPI: 0x00000c (was: 0x%08x)\n", BSPI);
-
-	/* Gold images have the CRC disabled. */
-      while (disable_stream_crc(vec_raw)) {
-	      /* repeat */
+      if (compress.compress) {
+	    compress_result_t res;
+	    if (! compress_stream(vec_raw, "gold", compress, res, stdout))
+		  return -1;
       }
 
       FILE*fd_out = fopen(path_out, "wb");
@@ -115,8 +105,10 @@ int main(int argc, char*argv[])
 	    return -1;
       }
 
-      size_t rc = fwrite(&vec_raw[0], 1, vec_raw.size(), fd_out);
-      assert(rc == vec_raw.size());
+      { metrics_phase phase ("write output", vec_raw.size());
+	    size_t rc = fwrite(&vec_raw[0], 1, vec_raw.size(), fd_out);
+	    assert(rc == vec_raw.size());
+      }
 
       fclose(fd_out);
 
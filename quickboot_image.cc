@@ -0,0 +1,542 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "quickboot_image.h"
+# include  "metrics.h"
+# include  "packet_index.h"
+# include  "replace_register_write.h"
+# include  "test_image_compat.h"
+# include  "disable_stream_crc.h"
+# include  "stream_crc.h"
+# include  "config_profile.h"
+# include  <cstdlib>
+# include  <cstring>
+# include  <cassert>
+
+using namespace std;
+
+static bool test_gold_image_compatible(const packet_index&index, const vector<uint8_t>&vec,
+				       FILE*err);
+
+
+/*
+ * Interpret a command line flag that sets a quickboot option. Return
+ * false if the flag is not a quickboot option.
+ */
+bool parse_quickboot_flag(quickboot_options_t&opt, const char*flag)
+{
+      if (strcmp(flag,"--bpi16") == 0) {
+	    opt.bpi16 = true;
+
+      } else if (strcmp(flag,"--spi") == 0) {
+	    opt.spi = true;
+
+      } else if (strncmp(flag,"--bpi16-rs0=",12) == 0) {
+	    opt.bpi16_rs0 = strtoul(flag+12, 0, 10);
+
+      } else if (strncmp(flag,"--bpi16-rs1=",12) == 0) {
+	    opt.bpi16_rs1 = strtoul(flag+12, 0, 10);
+
+      } else if (strcmp(flag,"--no-bpi16-rs0") == 0) {
+	    opt.bpi16_rs0 = 0;
+
+      } else if (strcmp(flag,"--no-bpi16-rs1") == 0) {
+	    opt.bpi16_rs1 = 0;
+
+      } else if (strncmp(flag,"--multiboot=",12) == 0) {
+	    opt.multiboot_offset = strtoul(flag+12, 0, 0);
+
+      } else if (strcmp(flag,"--disable-silver") == 0) {
+	    opt.disable_silver = true;
+
+      } else if (strcmp(flag,"--no-disable-silver") == 0) {
+	    opt.disable_silver = false;
+
+      } else if (strcmp(flag,"--debug-trash-silver") == 0) {
+	    opt.debug_trash_silver = true;
+
+      } else if (strncmp(flag,"--flash-sector=",15) == 0) {
+	    opt.flash_sector = strtoul(flag+15, 0, 0);
+
+      } else if (strncmp(flag,"--config-profile=",17) == 0) {
+	    opt.config_profile = flag+17;
+
+      } else {
+	    return parse_compress_flag(opt.compress, flag)
+		  || parse_boot_estimate_flag(opt.boot_estimate, flag);
+      }
+
+      return true;
+}
+
+/*
+ * Apply the register edits of the config profile to a copy of the
+ * silver stream, and fix up the CRC checks to match.
+ */
+static void profile_silver_image(vector<uint8_t>&vec, const config_profile_t&profile,
+				 bool addr32, FILE*log)
+{
+      packet_index index;
+      index.build(vec);
+
+      size_t crc_checks = 0;
+      const crc_model_t crc_model = check_stream_crcs(&vec[0], index, crc_checks);
+
+      vector<register_edit_t> edits;
+      config_profile_edits(edits, profile, &vec[0], index, addr32);
+      size_t changed = replace_register_writes(&vec[0], index, edits);
+      print_config_profile_edits(log, "silver", edits, 0);
+
+      if (changed == 0)
+	    return;
+
+      if (crc_model != CRC_MODEL_NONE) {
+	    size_t crc_count = update_stream_crcs(&vec[0], index, crc_model);
+	    fprintf(log, "Recomputed %zu CRC checks in silver stream.\n", crc_count);
+
+      } else if (crc_checks > 0) {
+	    fprintf(log, "Disabling CRC in silver stream (Replace CRC with Reset CRC).\n");
+	    size_t crc_count = disable_stream_crcs(&vec[0], index);
+	    fprintf(log, "... %zu CRC checks disabled.\n", crc_count);
+      }
+}
+
+/*
+ * Make the quickboot image: the header in the first two sectors, then
+ * the gold image, and the silver image at the multiboot address. The
+ * gold image is a copy of the gold stream with the register edits for
+ * a gold image.
+ */
+bool make_quickboot_image(vector<uint8_t>&vec_out, vector<manifest_region_t>&regions,
+			  const bit_file_view&view_gold, bool gold_is_silver,
+			  const bit_file_view&vec_silver,
+			  quickboot_options_t&opt, FILE*log)
+{
+      metrics_phase phase ("quickboot image");
+
+      const bool spi_gen = opt.spi;
+      const bool bpi16_gen = opt.bpi16;
+      const bool debug_trash_silver = opt.debug_trash_silver;
+      size_t&multiboot_offset = opt.multiboot_offset;
+      size_t&flash_sector = opt.flash_sector;
+
+      assert(spi_gen != bpi16_gen);
+
+	// If the flash sector size is not otherwise specified, then
+	// choose a default based on the targeted flash device.
+      if (flash_sector == 0) {
+	    if (spi_gen) {
+		  flash_sector = 4096;
+	    } else if (bpi16_gen) {
+		  flash_sector = 256*1024;
+	    }
+      }
+
+	// The config profile must be for the flash type.
+      const config_profile_t*profile = 0;
+      if (! opt.config_profile.empty()) {
+	    profile = check_config_profile(opt.config_profile.c_str(), bpi16_gen, opt.err);
+	    if (profile == 0)
+		  return false;
+	    fprintf(log, "Config profile: %s (%s)\n", profile->name, profile->description);
+      }
+
+      vector<uint8_t> vec_gold;
+      view_gold.copy(vec_gold);
+
+	// Index the configuration packets of the gold stream once,
+	// and use the index for all the checks and edits below.
+      packet_index index_gold;
+      index_gold.build(vec_gold);
+
+	// Check the CRC of the gold stream before it is edited, so
+	// that the CRC can be recomputed after.
+      size_t gold_crc_checks = 0;
+      const crc_model_t gold_crc_model = check_stream_crcs(&vec_gold[0], index_gold, gold_crc_checks);
+
+	// If the gold file is not going to be a copy of the silver
+	// file, then check that it is compatible with this process.
+      if (! gold_is_silver && !test_gold_image_compatible(index_gold, vec_gold, opt.err)) {
+	    fprintf(opt.err, "Gold stream is not compatible with Quickboot assembly.\n");
+	    return false;
+      }
+
+      if (! test_silver_image_compatible(vec_silver.payload(), vec_silver.payload_size(), opt.err)) {
+	    fprintf(opt.err, "Silver stream is not compatible with Quickboot assembly.\n");
+	    return false;
+      }
+
+      {
+	    packet_index index_silver;
+	    index_silver.build(vec_silver.payload(), vec_silver.payload_size());
+	    size_t silver_crc_checks = 0;
+	    crc_model_t silver_crc_model = check_stream_crcs(vec_silver.payload(), index_silver, silver_crc_checks);
+	    if (silver_crc_checks > 0 && silver_crc_model == CRC_MODEL_NONE)
+		  fprintf(log, "WARNING        : CRC checks in silver stream do not validate.\n");
+      }
+
+	/* Guess a multiboot address based on the target device we are
+	   generating for. Let the command line override this guess. */
+      if (multiboot_offset == 0 && bpi16_gen) {
+	    multiboot_offset = 0x00800000;
+      } else if (multiboot_offset == 0 && spi_gen) {
+	    multiboot_offset = 0x00400000;
+      }
+
+      if (multiboot_offset == 0) {
+	    fprintf(opt.err, "Unable to guess the MULTIBOOT address. Please use --multiboot=<number>\n");
+	    return false;
+      }
+
+      if (multiboot_offset % flash_sector != 0) {
+	    fprintf(opt.err, "MULTIBOOT Address 0x%08zx is not on a prom sector boundary\n", multiboot_offset);
+	    fprintf(opt.err, "PROM sector size is %zu bytes\n", flash_sector);
+	    return false;
+      }
+
+
+      fprintf(log, "MULTIBOOT Address: 0x%08zx\n", multiboot_offset);
+      fprintf(log, "PROM erase block Size: %zu bytes\n", flash_sector);
+
+	// SPI read commands with 3-byte addresses only reach the
+	// first 16 MBytes of the flash. If the silver image ends past
+	// that, the config profile uses the 4-byte address commands.
+      opt.spi_addr32 = spi_gen && profile && multiboot_offset + vec_silver.size() > 0x01000000;
+      if (opt.spi_addr32)
+	    fprintf(log, "Silver image ends past 16 MBytes, using 4-byte SPI addresses.\n");
+
+	// Collect the register edits for the gold image, and apply
+	// them all at once.
+      vector<register_edit_t> gold_edits;
+      gold_edits.push_back(register_edit_t(0x0d, 0x474f4c44, axss_gold_transform));
+      if (profile) {
+	    config_profile_edits(gold_edits, *profile, &vec_gold[0], index_gold, opt.spi_addr32);
+      } else if (bpi16_gen) {
+	    gold_edits.push_back(register_edit_t(0x09, 0x062055dc));
+	    gold_edits.push_back(register_edit_t(0x0e, 0x0000000e));
+      }
+
+      replace_register_writes(&vec_gold[0], index_gold, gold_edits);
+
+      const uint32_t AXSS_old = gold_edits[0].old_value;
+      const uint32_t AXSS_target = gold_edits[0].new_value;
+      if (AXSS_old == 0) {
+	    fprintf(log, "WARNING        : AXSS is not present in source stream.\n");
+
+      } else if (AXSS_old == 0x53494c56) { // SILV
+	      // Replace SILV with GOLD
+	    fprintf(log, "... AXSS (gold): 0x474f4c44 (was: 0x%08x)\n", AXSS_old);
+
+      } else if ((AXSS_old & 0xff000000) == 0x53000000) { // S...
+	      // Replace a leading S with G
+	    fprintf(log, "... AXSS (gold): 0x%08x (was: 0x%08x)\n", AXSS_target, AXSS_old);
+      }
+
+
+      if (profile) {
+	    print_config_profile_edits(log, "gold", gold_edits, 1);
+
+      } else if (bpi16_gen) {
+	      //uint32_t WBSTAR = index_gold.replace_register_write(vec_gold, 0x10, 0x20000000);
+	      //fprintf(log, "WBSTAR (gold): 0x20000000 (was: 0x%08x)\n", WBSTAR);
+
+	    fprintf(log, "COR0 (gold): 0x062055dc (was: 0x%08x)\n", gold_edits[1].old_value);
+	    fprintf(log, "COR1 (gold): 0x0000000e (was: 0x%08x)\n", gold_edits[2].old_value);
+      }
+
+	// Recompute the CRC checks to match the edits. If the CRC of
+	// the input could not be validated, then disable the CRC
+	// checks instead.
+      if (gold_crc_model != CRC_MODEL_NONE) {
+	    size_t crc_count = update_stream_crcs(&vec_gold[0], index_gold, gold_crc_model);
+	    fprintf(log, "Recomputed %zu CRC checks in gold stream.\n", crc_count);
+
+      } else if (gold_crc_checks > 0) {
+	    fprintf(log, "WARNING        : CRC checks in gold stream do not validate.\n");
+	    fprintf(log, "Disabling CRC in gold stream (Replace CRC with Reset CRC).\n");
+	    size_t crc_count = disable_stream_crcs(&vec_gold[0], index_gold);
+	    fprintf(log, "... %zu CRC checks disabled.\n", crc_count);
+      }
+
+	// The silver image is only copied if the config profile or
+	// the compression edits it.
+      const bool silver_edited = profile || opt.compress.compress;
+      vector<uint8_t> silver_edit;
+      if (silver_edited)
+	    vec_silver.copy(silver_edit);
+      if (profile)
+	    profile_silver_image(silver_edit, *profile, opt.spi_addr32, log);
+
+	// Compress the images after the edits, so that the size that
+	// is checked against the multiboot address is the size of the
+	// compressed gold image.
+      bool gold_estimated = false;
+      if (opt.compress.compress) {
+	    compress_result_t res;
+	    if (! compress_stream(vec_gold, "gold", opt.compress, res, log, opt.err))
+		  return false;
+	    gold_estimated = ! res.rewritten;
+	    if (! compress_stream(silver_edit, "silver", opt.compress, res, log, opt.err))
+		  return false;
+      }
+      const size_t silver_size = silver_edited? silver_edit.size() : vec_silver.size();
+
+      if ((vec_gold.size() + flash_sector + flash_sector) > multiboot_offset) {
+	    fprintf(opt.err, "Unable to fit gold bits into region.\n");
+	    fprintf(opt.err, "Gold file is %zu bytes\n", vec_gold.size());
+	    fprintf(opt.err, "MULTIBOOT byte address is 0x%08zx\n", multiboot_offset);
+	    fprintf(opt.err, "Quickboot header is %zu bytes\n", flash_sector + flash_sector);
+	    if (gold_estimated)
+		  fprintf(opt.err, "--compress only estimated the gold image; pass "
+			  "--frame-addresses=<path> to rewrite it smaller.\n");
+	    return false;
+      }
+
+	/* Now the vec_gold and vec_silver vectors contain the bit
+	   files that will go into the quickboot assembled mcs
+	   stream. */
+      size_t out_size = multiboot_offset + silver_size;
+	/* BPI16 flash holds 16bit words, and the bytes of each word
+	   are swapped as the image is written out, so make the image
+	   a whole number of words. The extra byte is erased flash. */
+      if (bpi16_gen)
+	    out_size = (out_size + 1) & ~(size_t)1;
+      vec_out.resize(out_size);
+      memset(&vec_out[0], 0xff, vec_out.size());
+
+	/* Write the gold file into the stream. */
+      fprintf(log, "Write GOLD image at byte address 0x%08zx\n",
+	      flash_sector+flash_sector);
+      memcpy(&vec_out[flash_sector+flash_sector], &vec_gold[0], vec_gold.size());
+
+	/* Write the silver file into the stream. */
+      fprintf(log, "Write SILVER image at byte address 0x%08zx\n",
+	      multiboot_offset);
+      if (silver_edited)
+	    memcpy(&vec_out[multiboot_offset], &silver_edit[0], silver_size);
+      else
+	    vec_silver.copy(&vec_out[multiboot_offset]);
+
+	// To simulate failing to program a segment of the prom, erase
+	// some random sector in the silver image.
+      if (debug_trash_silver) {
+	    size_t trash_offset = silver_size / 2;
+	    trash_offset &= ~(flash_sector-1);
+	    fprintf(log, "**** DEBUG Trash sector at 0x%08zx in silver image.\n", trash_offset);
+	    memset(&vec_out[multiboot_offset+trash_offset], 0xff, flash_sector);
+      }
+
+	/* Generate a quickboot header for the type of flash that we
+	   are targetting. */
+      assert(spi_gen || bpi16_gen);
+      if (spi_gen) {
+	    spi_quickboot_header(vec_out, multiboot_offset, flash_sector, opt, log);
+
+      } else if (bpi16_gen) {
+	    bpi16_quickboot_header(vec_out, multiboot_offset, flash_sector, opt, log);
+      }
+
+      if (opt.boot_estimate.estimate
+	  && ! report_quickboot_boot(&vec_out[0], flash_sector,
+				     &vec_out[flash_sector+flash_sector], vec_gold.size(),
+				     &vec_out[multiboot_offset], silver_size,
+				     bpi16_gen, opt.boot_estimate, log, opt.err))
+	    return false;
+
+      regions.clear();
+      regions.push_back(manifest_region_t("header", 0, flash_sector+flash_sector));
+      regions.push_back(manifest_region_t("gold", flash_sector+flash_sector, vec_gold.size()));
+      regions.push_back(manifest_region_t("silver", multiboot_offset, silver_size));
+
+      return true;
+}
+
+
+static bool test_gold_image_compatible(const packet_index&index, const vector<uint8_t>&vec,
+				       FILE*err)
+{
+      if (!test_basic_image_compatibility(index, &vec[0], err)) {
+	    fprintf(err, "Gold image fails basic tests.\n");
+	    return false;
+      }
+
+      uint32_t AXSS = index.extract_register_write(vec, 0x0d);
+      if (AXSS != 0x474f4c44) {
+	    fprintf(err, "Found AXSS=0x%08x\n (s/b 0x474f4c44)\n", AXSS);
+	    return false;
+      }
+
+      return true;
+}
+
+void spi_quickboot_header(vector<uint8_t>&dst, size_t mb_offset, size_t sector,
+			  const quickboot_options_t&opt, FILE*log)
+{
+      fprintf(log, "Quickboot SPI header\n");
+      fprintf(log, "Critical Switch word is aa:99:55:66 at 0x%08zx (page 0)\n", sector-4);
+
+      memset(&dst[0], 0xff, sector-4);
+
+      if (opt.disable_silver) {
+	    dst[sector- 4] = 0xff;
+	    dst[sector- 3] = 0xff;
+	    dst[sector- 2] = 0xff;
+	    dst[sector- 1] = 0xff;
+      } else {
+	    dst[sector- 4] = 0xaa; /* Sync word */
+	    dst[sector- 3] = 0x99;
+	    dst[sector- 2] = 0x55;
+	    dst[sector- 1] = 0x66;
+      }
+      size_t ptr = sector;
+      put_word(&dst[ptr], 0x20000000); /* NOOP */
+      ptr += 4;
+
+	// A config profile gives the SPI read command. Write it to
+	// BSPI and have the FPGA use it (BSPI_Read), so that the
+	// silver image is read with the same bus width as the rest.
+      const config_profile_t*profile = opt.config_profile.empty()? 0 : find_config_profile(opt.config_profile.c_str());
+      if (profile) {
+	    const uint32_t BSPI = config_profile_bspi(*profile, opt.spi_addr32);
+	    fprintf(log, "BSPI (quickboot header): 0x%08x\n", BSPI);
+	    put_word(&dst[ptr+ 0], 0x3003e001); /* Write to BSPI */
+	    put_word(&dst[ptr+ 4], BSPI);
+	    put_word(&dst[ptr+ 8], 0x30008001); /* Write to COMMAND */
+	    put_word(&dst[ptr+12], 0x00000012); /* ... BSPI_Read */
+	    put_word(&dst[ptr+16], 0x20000000); /* NOOP */
+	    ptr += 20;
+      }
+
+      put_word(&dst[ptr+0], 0x30020001); /* Write to WBSTAR */
+      put_word(&dst[ptr+4], mb_offset);
+      put_word(&dst[ptr+8], 0x30008001); /* Write to COMMAND */
+      put_word(&dst[ptr+12], 0x0000000f); /* ... IPROG command */
+      ptr += 16;
+
+	/* Fill the reset of the second sector with NOOP commands */
+      for ( ; ptr < sector+sector ; ptr += 4)
+	    put_word(&dst[ptr], 0x20000000);
+}
+
+void bpi16_quickboot_header(vector<uint8_t>&dst, size_t mb_offset, size_t sector,
+			    const quickboot_options_t&opt, FILE*log)
+{
+      fprintf(log, "Quickboot BPI header\n");
+      fprintf(log, "Critical Switch word is 00:00:00:bb 11:22:00:44 aa:99:44:66 at 0x%08zx (page 0)\n", sector-12);
+
+      uint32_t WBSTAR = 0;
+	// In the quickboot header for a BPI16 device, we use RS[0]
+	// instead of any other multiboot bits.
+
+	// Enable the RS pins.
+      WBSTAR |= 0x20000000; /* RS_TS_B */
+
+	// RS[0] connects to A[23] on the flash, and RS[1] to
+	// A[24]. So transfer those address bits RS[] part of WBSTAR.
+	// (Actually, the mapping may be more complicated then that in
+	// the hardware, but this is what we do logically.)
+      if ((opt.bpi16_rs0!=0) && (mb_offset & (1 << opt.bpi16_rs0)))
+	    WBSTAR |= 0x40000000; /* RS[0]*/
+      if ((opt.bpi16_rs1!=0) && (mb_offset & (1 << opt.bpi16_rs1)))
+	    WBSTAR |= 0x80000000; /* RS[1] */
+
+      WBSTAR |= (mb_offset & 0x00ffffff) / 2;
+
+      fprintf(log, "WBSTAR (quickboot header): 0x%08x\n", WBSTAR);
+
+      memset(&dst[0], 0xff, sector);
+
+	// BPI16 devices don't have a simple single word that is a
+	// critical sync word, so use these 3 words in the critical
+	// sync flash.
+      if (opt.disable_silver) {
+	      // If the silver is disabled, then leave the critical
+	      // switch word out.
+	    dst[sector-12] = 0xff;
+	    dst[sector-11] = 0xff;
+	    dst[sector-10] = 0xff;
+	    dst[sector- 9] = 0xff;
+	    dst[sector- 8] = 0xff;
+	    dst[sector- 7] = 0xff;
+	    dst[sector- 6] = 0xff;
+	    dst[sector- 5] = 0xff;
+	    dst[sector- 4] = 0xff;
+	    dst[sector- 3] = 0xff;
+	    dst[sector- 2] = 0xff;
+	    dst[sector- 1] = 0xff;
+      } else {
+	    dst[sector-12] = 0x00; /* Critical Switch word word */
+	    dst[sector-11] = 0x00;
+	    dst[sector-10] = 0x00;
+	    dst[sector- 9] = 0xbb;
+	    dst[sector- 8] = 0x11; /* bus width detect */
+	    dst[sector- 7] = 0x22;
+	    dst[sector- 6] = 0x00;
+	    dst[sector- 5] = 0x44;
+	    dst[sector- 4] = 0xaa; /* Sync word */
+	    dst[sector- 3] = 0x99;
+	    dst[sector- 2] = 0x55;
+	    dst[sector- 1] = 0x66;
+      }
+      dst[sector+ 0] = 0x20; /* NOOP */
+      dst[sector+ 1] = 0x00;
+      dst[sector+ 2] = 0x00;
+      dst[sector+ 3] = 0x00;
+      dst[sector+ 4] = 0x20; /* NOOP */
+      dst[sector+ 5] = 0x00;
+      dst[sector+ 6] = 0x00;
+      dst[sector+ 7] = 0x00;
+      dst[sector+ 8] = 0x20; /* NOOP */
+      dst[sector+ 9] = 0x00;
+      dst[sector+10] = 0x00;
+      dst[sector+11] = 0x00;
+      dst[sector+12] = 0x20; /* NOOP */
+      dst[sector+13] = 0x00;
+      dst[sector+14] = 0x00;
+      dst[sector+15] = 0x00;
+      dst[sector+16] = 0x20; /* NOOP */
+      dst[sector+17] = 0x00;
+      dst[sector+18] = 0x00;
+      dst[sector+19] = 0x00;
+      dst[sector+20] = 0x30; /* WRITE to WBSTAR */
+      dst[sector+21] = 0x02;
+      dst[sector+22] = 0x00;
+      dst[sector+23] = 0x01;
+      dst[sector+24] = (WBSTAR >> 24) & 0xff;
+      dst[sector+25] = (WBSTAR >> 16) & 0xff;
+      dst[sector+26] = (WBSTAR >>  8) & 0xff;
+      dst[sector+27] = (WBSTAR >>  0) & 0xff;
+      dst[sector+28] = 0x30; /* Write to COMMAND */
+      dst[sector+29] = 0x00;
+      dst[sector+30] = 0x80;
+      dst[sector+31] = 0x01;
+      dst[sector+32] = 0x00;
+      dst[sector+33] = 0x00;
+      dst[sector+34] = 0x00;
+      dst[sector+35] = 0x0f; /* ... IPROG command */
+
+	/* Fill the reset of the second sector with NOOP commands */
+      for (size_t idx = 36 ; idx < sector ; idx += 4) {
+	    dst[sector+idx+0] = 0x20;
+	    dst[sector+idx+1] = 0x00;
+	    dst[sector+idx+2] = 0x00;
+	    dst[sector+idx+3] = 0x00;
+      }
+}
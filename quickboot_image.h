@@ -0,0 +1,110 @@
+#ifndef __quickboot_image_H
+#define __quickboot_image_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "read_bit_file.h"
+# include  "flash_manifest.h"
+# include  "frame_compress.h"
+# include  "boot_estimate.h"
+# include  <vector>
+# include  <string>
+# include  <cstdio>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * Options for a quickboot image with a gold and a silver design, as
+ * described in XAPP1081.
+ */
+struct quickboot_options_t {
+      quickboot_options_t()
+      : bpi16(false), spi(false), multiboot_offset(0), flash_sector(0),
+	bpi16_rs0(23), bpi16_rs1(24), disable_silver(false),
+	debug_trash_silver(false), spi_addr32(false), err(stderr) { }
+
+	// The flash type. Exactly one of these must be set.
+      bool bpi16;
+      bool spi;
+	// The multiboot address and the flash sector size. Zero
+	// picks the default for the flash type, and the value that is
+	// used is written back.
+      size_t multiboot_offset;
+      size_t flash_sector;
+	// Multiboot address bits that map to RS[1:0] in WBSTAR for
+	// BPI16 flash. Zero means the bit is not used.
+      int bpi16_rs0;
+      int bpi16_rs1;
+	// Leave the Critical Switch word out of the header.
+      bool disable_silver;
+	// Blank a sector in the silver image, to test the fallback.
+      bool debug_trash_silver;
+	// The name of a configuration speed profile, or empty to
+	// keep the registers of the streams.
+      std::string config_profile;
+	// The SPI read command of the config profile uses 4-byte
+	// addresses. make_quickboot_image sets this if the silver
+	// image ends past the first 16 MBytes of the flash.
+      bool spi_addr32;
+	// Write the copies of frames in the gold and silver images
+	// with MFWR.
+      compress_options_t compress;
+	// Print an estimate of the configuration time of the image.
+      boot_estimate_options_t boot_estimate;
+	// Where the error messages go. A program that makes many
+	// images at once (the server) gives each its own.
+      FILE*err;
+};
+
+/*
+ * Make the quickboot image that quickboot_builder writes, from gold
+ * and silver streams that are already loaded. The streams are only
+ * read, so many images can be made from the same streams at once. If
+ * gold_is_silver is true, then the gold stream is a copy of the silver
+ * stream, and is not checked as a gold stream. The regions of the
+ * image are returned for the manifest.
+ *
+ * Progress messages go to the log. Return false (after printing a
+ * message to opt.err) if the image cannot be made.
+ */
+extern bool make_quickboot_image(std::vector<uint8_t>&vec_out,
+				 std::vector<manifest_region_t>&regions,
+				 const bit_file_view&view_gold, bool gold_is_silver,
+				 const bit_file_view&vec_silver,
+				 quickboot_options_t&opt, FILE*log);
+
+/*
+ * Write the quickboot header into the first two sectors of dst, which
+ * must already be at least 2*sector bytes. The header sends the FPGA
+ * to the multiboot address (the silver image) unless the Critical
+ * Switch word at the end of the first sector is erased.
+ */
+extern void spi_quickboot_header(std::vector<uint8_t>&dst, size_t mb_offset, size_t sector,
+				 const quickboot_options_t&opt, FILE*log);
+extern void bpi16_quickboot_header(std::vector<uint8_t>&dst, size_t mb_offset, size_t sector,
+				   const quickboot_options_t&opt, FILE*log);
+
+/*
+ * Interpret a command line flag that sets a quickboot option. Return
+ * false if the flag is not a quickboot option.
+ */
+extern bool parse_quickboot_flag(quickboot_options_t&opt, const char*flag);
+
+#endif
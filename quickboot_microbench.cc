@@ -0,0 +1,317 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Time the kernels that do the real work in the quickboot tools, on
+ * synthetic streams of several sizes. For each kernel and size, the
+ * best time of a number of runs is reported as ns/op (one op is one
+ * run of the kernel over the whole stream) and as MB/s of stream.
+ *
+ * COMMAND LINE FLAGS:
+ *   --sizes=<N>,<N>,... (default: 4,16,64,256)
+ *                    Sizes of the frame data, in MBytes.
+ *
+ *   --min-time=<secs> (default: 0.25)
+ *                    Keep running each kernel for at least this long,
+ *                    and at least 3 times.
+ *
+ *   --kernel=<name>
+ *                    Only run the kernels whose name starts with this.
+ */
+
+# include  "synth_stream.h"
+# include  "read_bit_file.h"
+# include  "packet_index.h"
+# include  "replace_register_write.h"
+# include  "disable_stream_crc.h"
+# include  "stream_crc.h"
+# include  "bit_swizzle.h"
+# include  "write_to_mcs_file.h"
+# include  "sha256.h"
+# include  <vector>
+# include  <string>
+# include  <chrono>
+# include  <cstdint>
+# include  <cstdio>
+# include  <cstdlib>
+# include  <cstring>
+
+using namespace std;
+
+/*
+ * This sink only counts the text, so that the encoder is timed
+ * without the file system.
+ */
+class count_sink : public mcs_sink {
+
+    public:
+      count_sink() : count(0) { }
+      ~count_sink() { }
+
+      void write(const char*, size_t len) { count += len; }
+
+      size_t count;
+};
+
+/*
+ * The inputs and scratch space of the kernels. The file is the whole
+ * .bit file, in memory and in a temporary file, and the stream is the
+ * stream with the header stripped off.
+ */
+struct bench_state_t {
+      vector<uint8_t> file;
+      FILE*file_fd;
+      vector<uint8_t> stream;
+      vector<uint8_t> work;
+      packet_index index;
+      crc_model_t crc_model;
+      uint32_t result;
+};
+
+static void kernel_read_bit_file(bench_state_t&st)
+{
+      rewind(st.file_fd);
+      read_bit_file(st.work, st.file_fd);
+}
+
+static void kernel_bit_file_view(bench_state_t&st)
+{
+      bit_file_view view;
+      view.map_buffer(&st.file[0], st.file.size());
+      view.copy(st.work);
+}
+
+static void kernel_packet_index(bench_state_t&st)
+{
+      packet_index index;
+      index.build(st.stream);
+      st.result += index.size();
+}
+
+static void kernel_replace_register_writes(bench_state_t&st)
+{
+      vector<register_edit_t> edits;
+      edits.push_back(register_edit_t(0x0d, 0x474f4c44, axss_gold_transform));
+      edits.push_back(register_edit_t(0x09, 0x062055dc));
+      edits.push_back(register_edit_t(0x0e, 0x0000000e));
+      st.result += replace_register_writes(&st.work[0], st.index, edits);
+}
+
+static void kernel_replace_register_write_scan(bench_state_t&st)
+{
+	// This version indexes the stream itself.
+      st.result += replace_register_write(st.work, 0x0d, 0x474f4c44);
+}
+
+static void kernel_check_stream_crcs(bench_state_t&st)
+{
+      size_t count = 0;
+      st.crc_model = check_stream_crcs(&st.stream[0], st.index, count);
+      st.result += count;
+}
+
+static void kernel_update_stream_crcs(bench_state_t&st)
+{
+      st.result += update_stream_crcs(&st.work[0], st.index, CRC_MODEL_CONTINUE);
+}
+
+static void kernel_disable_stream_crcs(bench_state_t&st)
+{
+      st.result += disable_stream_crcs(&st.work[0], st.index);
+}
+
+static void kernel_bit_swizzle_x16(bench_state_t&st)
+{
+      bit_swizzle(&st.work[0], &st.stream[0], st.stream.size() & ~(size_t)1, SWIZZLE_X16);
+}
+
+static void kernel_write_to_mcs_1(bench_state_t&st)
+{
+      mcs_options_t opt;
+      opt.threads = 1;
+      opt.log = 0;
+      count_sink sink;
+      write_to_mcs(sink, st.stream, 0, opt);
+      st.result += sink.count;
+}
+
+static void kernel_write_to_mcs_n(bench_state_t&st)
+{
+      mcs_options_t opt;
+      opt.log = 0;
+      count_sink sink;
+      write_to_mcs(sink, st.stream, 0, opt);
+      st.result += sink.count;
+}
+
+static void kernel_write_to_mcs_sparse(bench_state_t&st)
+{
+      mcs_options_t opt;
+      opt.sparse = true;
+      opt.log = 0;
+      count_sink sink;
+      write_to_mcs(sink, st.stream, 0, opt);
+      st.result += sink.count;
+}
+
+static void kernel_crc32c(bench_state_t&st)
+{
+      st.result += crc32c(&st.stream[0], st.stream.size());
+}
+
+static void kernel_sha256(bench_state_t&st)
+{
+      uint8_t digest[32];
+      sha256::digest(digest, &st.stream[0], st.stream.size());
+      st.result += digest[0];
+}
+
+struct kernel_t {
+      const char*name;
+      void (*fun)(bench_state_t&st);
+};
+
+static const kernel_t kernels[] = {
+      { "read_bit_file",            kernel_read_bit_file },
+      { "bit_file_view",            kernel_bit_file_view },
+      { "packet_index",             kernel_packet_index },
+      { "replace_register_writes",  kernel_replace_register_writes },
+      { "replace_register_write",   kernel_replace_register_write_scan },
+      { "check_stream_crcs",        kernel_check_stream_crcs },
+      { "update_stream_crcs",       kernel_update_stream_crcs },
+      { "disable_stream_crcs",      kernel_disable_stream_crcs },
+      { "bit_swizzle_x16",          kernel_bit_swizzle_x16 },
+      { "write_to_mcs/1",           kernel_write_to_mcs_1 },
+      { "write_to_mcs/N",           kernel_write_to_mcs_n },
+      { "write_to_mcs/sparse",      kernel_write_to_mcs_sparse },
+      { "crc32c",                   kernel_crc32c },
+      { "sha256",                   kernel_sha256 },
+      { 0, 0 }
+};
+
+/*
+ * Run the kernel until it has run for min_time, and at least 3 times,
+ * and return the best time of a single run.
+ */
+static double time_kernel(const kernel_t&kernel, bench_state_t&st, double min_time, unsigned&runs)
+{
+      double best = 0.0;
+      double total = 0.0;
+      runs = 0;
+      while (runs < 3 || total < min_time) {
+	    const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+	    kernel.fun(st);
+	    const double secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+	    if (runs == 0 || secs < best)
+		  best = secs;
+	    total += secs;
+	    runs += 1;
+      }
+      return best;
+}
+
+int main(int argc, char*argv[])
+{
+      vector<size_t> sizes;
+      double min_time = 0.25;
+      const char*kernel_prefix = "";
+
+      for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (strncmp(argv[optarg],"--sizes=",8) == 0) {
+		  const char*cp = argv[optarg] + 8;
+		  while (*cp) {
+			char*ep;
+			sizes.push_back(strtoul(cp, &ep, 0));
+			cp = *ep == ','? ep+1 : ep;
+			if (ep == cp && *cp) {
+			      fprintf(stderr, "Bad size list: %s\n", argv[optarg]+8);
+			      return -1;
+			}
+		  }
+
+	    } else if (strncmp(argv[optarg],"--min-time=",11) == 0) {
+		  min_time = strtod(argv[optarg]+11, 0);
+
+	    } else if (strncmp(argv[optarg],"--kernel=",9) == 0) {
+		  kernel_prefix = argv[optarg] + 9;
+
+	    } else {
+		  fprintf(stderr, "Unknown flag: %s\n", argv[optarg]);
+		  return -1;
+	    }
+      }
+
+      if (sizes.empty()) {
+	    sizes.push_back(4);
+	    sizes.push_back(16);
+	    sizes.push_back(64);
+	    sizes.push_back(256);
+      }
+
+      fprintf(stdout, "%-24s %8s %14s %10s %6s\n", "Kernel", "MBytes", "ns/op", "MB/s", "Runs");
+
+      uint32_t result = 0;
+      for (size_t sdx = 0 ; sdx < sizes.size() ; sdx += 1) {
+	    bench_state_t st;
+	    synth_options_t opt;
+	    opt.fdri_bytes = sizes[sdx] * 1024 * 1024;
+	    make_synth_bit_file(st.file, opt);
+
+	    st.file_fd = tmpfile();
+	    if (st.file_fd == 0) {
+		  fprintf(stderr, "Unable to make a temporary file.\n");
+		  return -1;
+	    }
+	    fwrite(&st.file[0], 1, st.file.size(), st.file_fd);
+	    fflush(st.file_fd);
+
+	    bit_file_view view;
+	    view.map_buffer(&st.file[0], st.file.size());
+	    view.copy(st.stream);
+	    st.work = st.stream;
+	    st.index.build(st.stream);
+	    st.crc_model = CRC_MODEL_NONE;
+	    st.result = 0;
+
+	    const double mbytes = st.stream.size() / (1024.0*1024.0);
+
+	    for (const kernel_t*cur = kernels ; cur->name ; cur += 1) {
+		  if (strncmp(cur->name, kernel_prefix, strlen(kernel_prefix)) != 0)
+			continue;
+
+		    // Each kernel starts from a fresh copy of the stream.
+		  st.work = st.stream;
+		  unsigned runs;
+		  double secs = time_kernel(*cur, st, min_time, runs);
+		  fprintf(stdout, "%-24s %8.1f %14.0f %10.1f %6u\n", cur->name, mbytes,
+			  secs * 1e9, mbytes / secs, runs);
+		  fflush(stdout);
+	    }
+
+	    fclose(st.file_fd);
+	    result += st.result;
+      }
+
+	// Use the results, so that the kernels are not optimized away.
+      if (result == 0x12345678)
+	    fprintf(stdout, "(%08x)\n", result);
+
+      return 0;
+}
@@ -0,0 +1,693 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "quickboot_serve.h"
+# include  "quickboot_image.h"
+# include  "read_bit_file.h"
+# include  "write_to_mcs_file.h"
+# include  <map>
+# include  <set>
+# include  <deque>
+# include  <memory>
+# include  <mutex>
+# include  <condition_variable>
+# include  <thread>
+# include  <chrono>
+# include  <cstdint>
+# include  <cstdlib>
+# include  <cstring>
+# ifndef _WIN32
+# include  <sys/types.h>
+# include  <sys/stat.h>
+# include  <sys/socket.h>
+# include  <sys/time.h>
+# include  <sys/un.h>
+# include  <unistd.h>
+# include  <limits.h>
+# include  <signal.h>
+# include  <cerrno>
+# endif
+
+using namespace std;
+
+# ifndef _WIN32
+
+/*
+ * The protocol is one request per connection. The client sends a
+ * line with the protocol version, then each flag on a line of its
+ * own, and then an empty line:
+ *
+ *    QB1
+ *    --silver=/path/to/silver.bit
+ *    --spi
+ *    <empty line>
+ *
+ * The server answers with a line that gives the sizes of the messages
+ * and of the image, and the time it took to build it in microseconds,
+ * followed by the messages and the image:
+ *
+ *    OK <message-bytes> <image-bytes> <usecs>
+ *    ERROR <message-bytes>
+ *
+ * Paths are passed as they are, so the client sends absolute paths.
+ */
+
+static bool write_all(int fd, const char*buf, size_t len)
+{
+      while (len > 0) {
+	    ssize_t rc = write(fd, buf, len);
+	    if (rc < 0) {
+		  if (errno == EINTR)
+			continue;
+		  return false;
+	    }
+	    buf += rc;
+	    len -= rc;
+      }
+      return true;
+}
+
+static bool read_all(int fd, char*buf, size_t len)
+{
+      while (len > 0) {
+	    ssize_t rc = read(fd, buf, len);
+	    if (rc < 0) {
+		  if (errno == EINTR)
+			continue;
+		  return false;
+	    }
+	    if (rc == 0)
+		  return false;
+	    buf += rc;
+	    len -= rc;
+      }
+      return true;
+}
+
+/*
+ * Read a line, without the newline. The lines of the protocol are
+ * short, so reading a byte at a time is good enough.
+ */
+static bool read_line(int fd, string&line)
+{
+      line.clear();
+      for (;;) {
+	    char ch;
+	    ssize_t rc = read(fd, &ch, 1);
+	    if (rc < 0 && errno == EINTR)
+		  continue;
+	    if (rc <= 0)
+		  return false;
+	    if (ch == '\n')
+		  return true;
+	    if (line.size() >= 4096)
+		  return false;
+	    line.push_back(ch);
+      }
+}
+
+/*
+ * A loaded input file. The stamp identifies the version of the file,
+ * so that a file that changes on disk is loaded again.
+ */
+struct serve_input_t {
+      bit_file_view view;
+      string stamp;
+};
+
+/*
+ * A finished image, as it is sent to clients, and the messages that
+ * were printed while it was made.
+ */
+struct serve_result_t {
+      vector<char> data;
+      string log;
+};
+
+struct server_t {
+      mutex lock;
+      map<string, shared_ptr<serve_input_t> > inputs;
+	// The paths that are being loaded, and the signal that a load
+	// is done.
+      set<string> loading;
+      condition_variable input_loaded;
+	// Results are dropped oldest first.
+      map<string, shared_ptr<const serve_result_t> > results;
+      deque<string> result_order;
+      unsigned max_images;
+
+      mutex log_lock;
+      FILE*log;
+      unsigned long next_request;
+
+	// The connections that are being served, and the limit. The
+	// accept loop waits for a free slot before it accepts another.
+      mutex slot_lock;
+      condition_variable slot_free;
+      unsigned active;
+      unsigned max_active;
+};
+
+/*
+ * The stamp includes the inode and the change time as well as the
+ * modification time, to the nanosecond, so that a file that is
+ * replaced or rewritten within the same second is loaded again. Only
+ * a regular, non-empty file gets a stamp, so that a client cannot
+ * name a directory or an empty file and upset the loader.
+ */
+
+static bool file_stamp(const string&path, string&stamp, string&msg)
+{
+      struct stat sb;
+      if (stat(path.c_str(), &sb) != 0) {
+	    msg += "Unable to open input file: " + path + "\n";
+	    return false;
+      }
+      if (! S_ISREG(sb.st_mode)) {
+	    msg += "Input is not a regular file: " + path + "\n";
+	    return false;
+      }
+      if (sb.st_size == 0) {
+	    msg += "Input file is empty: " + path + "\n";
+	    return false;
+      }
+
+      char buf[160];
+      snprintf(buf, sizeof buf, "%llu:%llu:%llu:%lld.%09ld:%lld.%09ld",
+	       (unsigned long long)sb.st_dev, (unsigned long long)sb.st_ino,
+	       (unsigned long long)sb.st_size,
+	       (long long)sb.st_mtim.tv_sec, (long)sb.st_mtim.tv_nsec,
+	       (long long)sb.st_ctim.tv_sec, (long)sb.st_ctim.tv_nsec);
+      stamp = buf;
+      return true;
+}
+
+/*
+ * Load the input file, without the server lock. The messages of the
+ * loader go to the client too.
+ */
+static bool load_input(const string&path, serve_input_t&input, string&msg)
+{
+      FILE*fd = fopen(path.c_str(), "rb");
+      if (fd == 0) {
+	    msg += "Unable to open input file: " + path + "\n";
+	    return false;
+      }
+
+      char*err_buf = 0;
+      size_t err_len = 0;
+      FILE*err = open_memstream(&err_buf, &err_len);
+      if (err == 0) {
+	    fclose(fd);
+	    msg += "Unable to make a message buffer.\n";
+	    return false;
+      }
+
+      bool rc = input.view.load(fd, path.c_str(), 0, err);
+      fclose(fd);
+
+      fclose(err);
+      msg.append(err_buf, err_len);
+      free(err_buf);
+
+      if (! rc) {
+	    msg += "Unable to load input file: " + path + "\n";
+	    return false;
+      }
+
+      msg += "Reading input file: " + path + "\n";
+      return true;
+}
+
+/*
+ * Get the loaded input file, loading it if it is not loaded yet, or
+ * if it changed since it was loaded. The file is loaded without the
+ * lock, so that requests for other files, and for results in memory,
+ * do not wait for it. The path is marked as loading in the meantime,
+ * and a request for the same path waits for that load to finish
+ * instead of loading the file again.
+ */
+static bool get_input(server_t&server, const string&path, shared_ptr<serve_input_t>&res,
+		      string&msg)
+{
+      string stamp;
+      if (! file_stamp(path, stamp, msg))
+	    return false;
+
+      unique_lock<mutex> lock (server.lock);
+      for (;;) {
+	    map<string, shared_ptr<serve_input_t> >::const_iterator cur = server.inputs.find(path);
+	    if (cur != server.inputs.end() && cur->second->stamp == stamp) {
+		  res = cur->second;
+		  return true;
+	    }
+	    if (server.loading.find(path) == server.loading.end())
+		  break;
+	    server.input_loaded.wait(lock);
+      }
+
+      server.loading.insert(path);
+      lock.unlock();
+
+      shared_ptr<serve_input_t> input (new serve_input_t);
+      input->stamp = stamp;
+      bool rc = load_input(path, *input, msg);
+
+      lock.lock();
+      server.loading.erase(path);
+      if (rc)
+	    server.inputs[path] = input;
+      server.input_loaded.notify_all();
+
+      if (! rc)
+	    return false;
+
+      res = input;
+      return true;
+}
+
+/*
+ * Get the result for the request, building it if it is not in memory
+ * already. Messages for the client are added to msg.
+ */
+static bool serve_build(server_t&server, const vector<string>&args,
+			shared_ptr<const serve_result_t>&result, bool&cached, string&msg)
+{
+      quickboot_options_t opt;
+      mcs_options_t mcs_options;
+      string path_gold, path_silver;
+      bool bin_flag = false;
+
+      for (size_t idx = 0 ; idx < args.size() ; idx += 1) {
+	    const char*flag = args[idx].c_str();
+	    if (parse_quickboot_flag(opt, flag))
+		  continue;
+	    if (parse_mcs_flag(mcs_options, flag))
+		  continue;
+
+	    if (strncmp(flag,"--gold=",7) == 0) {
+		  path_gold = flag + 7;
+
+	    } else if (strncmp(flag,"--silver=",9) == 0) {
+		  path_silver = flag + 9;
+
+	    } else if (strcmp(flag,"--format=mcs") == 0) {
+		  bin_flag = false;
+
+	    } else if (strcmp(flag,"--format=bin") == 0) {
+		  bin_flag = true;
+
+	    } else {
+		  msg += string("Unknown flag: ") + flag + "\n";
+		  return false;
+	    }
+      }
+
+      if (opt.spi == opt.bpi16) {
+	    msg += "Please specify one of --bpi16 or --spi\n";
+	    return false;
+      }
+
+      if (mcs_options.record_length != 16 && mcs_options.record_length != 32
+	  && mcs_options.record_length != 64) {
+	    msg += "MCS record length must be 16, 32 or 64 bytes.\n";
+	    return false;
+      }
+
+      if (path_silver.empty()) {
+	    msg += "No silver file file? Please specify --silver=<path>\n";
+	    return false;
+      }
+
+      const bool gold_is_silver = path_gold.empty();
+
+      shared_ptr<serve_input_t> silver, gold;
+      if (! get_input(server, path_silver, silver, msg))
+	    return false;
+      if (gold_is_silver)
+	    gold = silver;
+      else if (! get_input(server, path_gold, gold, msg))
+	    return false;
+
+	/* The result depends on the flags and the versions of the
+	   input files that they name. */
+      string key;
+      for (size_t idx = 0 ; idx < args.size() ; idx += 1)
+	    key += args[idx] + "\n";
+      key += silver->stamp + "\n" + gold->stamp;
+
+      {
+	    lock_guard<mutex> guard (server.lock);
+	    map<string, shared_ptr<const serve_result_t> >::const_iterator cur = server.results.find(key);
+	    if (cur != server.results.end()) {
+		  result = cur->second;
+		  cached = true;
+		  return true;
+	    }
+      }
+
+	/* The progress and the error messages of the build both go
+	   to the messages of this request, so that the client sees
+	   them in order, and they never mix with other requests. */
+      char*log_buf = 0;
+      size_t log_len = 0;
+      FILE*log = open_memstream(&log_buf, &log_len);
+      if (log == 0) {
+	    msg += "Unable to make a message buffer.\n";
+	    return false;
+      }
+      opt.err = log;
+
+      shared_ptr<serve_result_t> res (new serve_result_t);
+      vector<uint8_t> vec_out;
+      vector<manifest_region_t> regions;
+      bool rc = make_quickboot_image(vec_out, regions, gold->view, gold_is_silver,
+				     silver->view, opt, log);
+      if (rc) {
+	    if (opt.bpi16)
+		  mcs_options.swizzle = SWIZZLE_X16;
+	    mcs_options.log = log;
+
+	    mcs_buffer_sink sink (res->data);
+	    if (bin_flag)
+		  write_to_bin(sink, vec_out, 0, mcs_options);
+	    else
+		  write_to_mcs(sink, vec_out, 0, mcs_options);
+      }
+
+      fclose(log);
+      res->log.assign(log_buf, log_len);
+      free(log_buf);
+
+      if (! rc) {
+	    msg += res->log;
+	    return false;
+      }
+
+      lock_guard<mutex> guard (server.lock);
+      if (server.results.find(key) == server.results.end())
+	    server.result_order.push_back(key);
+      server.results[key] = res;
+      while (server.result_order.size() > server.max_images) {
+	    server.results.erase(server.result_order.front());
+	    server.result_order.pop_front();
+      }
+
+      result = res;
+      cached = false;
+      return true;
+}
+
+static void serve_connection(server_t*server, int fd)
+{
+      const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+
+      string line;
+      vector<string> args;
+      if (! read_line(fd, line) || line != "QB1") {
+	    close(fd);
+	    return;
+      }
+
+      for (;;) {
+	    if (! read_line(fd, line)) {
+		  close(fd);
+		  return;
+	    }
+	    if (line.empty())
+		  break;
+	    args.push_back(line);
+      }
+
+      shared_ptr<const serve_result_t> result;
+      bool cached = false;
+      string msg;
+      bool rc = serve_build(*server, args, result, cached, msg);
+
+      const double build_secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+      char hdr[128];
+      if (rc) {
+	    msg = result->log + msg;
+	    if (cached)
+		  msg += "Image from memory cache\n";
+	    snprintf(hdr, sizeof hdr, "OK %zu %zu %lu\n", msg.size(), result->data.size(),
+		     (unsigned long)(build_secs * 1000000.0));
+      } else {
+	    snprintf(hdr, sizeof hdr, "ERROR %zu\n", msg.size());
+      }
+
+      bool sent = write_all(fd, hdr, strlen(hdr)) && write_all(fd, msg.data(), msg.size());
+      if (sent && rc && ! result->data.empty())
+	    sent = write_all(fd, &result->data[0], result->data.size());
+      close(fd);
+
+      const double secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+
+      lock_guard<mutex> guard (server->log_lock);
+      server->next_request += 1;
+      fprintf(server->log, "Request %lu: %s, %zu bytes in %.3f ms (ready in %.3f ms)%s\n",
+	      server->next_request, rc? (cached? "cached" : "built") : "FAILED",
+	      rc? result->data.size() : (size_t)0, secs*1000.0, build_secs*1000.0,
+	      sent? "" : ", client went away");
+      fflush(server->log);
+}
+
+static void serve_thread(server_t*server, int fd)
+{
+      serve_connection(server, fd);
+
+      lock_guard<mutex> guard (server->slot_lock);
+      server->active -= 1;
+      server->slot_free.notify_one();
+}
+
+int quickboot_serve(const char*path, unsigned max_images, unsigned max_connections, FILE*log)
+{
+      struct sockaddr_un addr;
+      memset(&addr, 0, sizeof addr);
+      addr.sun_family = AF_UNIX;
+      if (strlen(path) >= sizeof addr.sun_path) {
+	    fprintf(stderr, "Socket path is too long: %s\n", path);
+	    return -1;
+      }
+      strcpy(addr.sun_path, path);
+
+	/* Remove the socket of an earlier server, but never any other
+	   kind of file. */
+      struct stat sb;
+      if (lstat(path, &sb) == 0) {
+	    if (! S_ISSOCK(sb.st_mode)) {
+		  fprintf(stderr, "%s exists, and is not a socket.\n", path);
+		  return -1;
+	    }
+	    unlink(path);
+      }
+
+      int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (sock < 0) {
+	    perror("socket");
+	    return -1;
+      }
+
+      if (bind(sock, (struct sockaddr*)&addr, sizeof addr) < 0) {
+	    perror(path);
+	    close(sock);
+	    return -1;
+      }
+
+      if (listen(sock, 64) < 0) {
+	    perror("listen");
+	    close(sock);
+	    return -1;
+      }
+
+	/* A client that goes away must not take the server with it. */
+      signal(SIGPIPE, SIG_IGN);
+
+      server_t server;
+      server.max_images = max_images;
+      server.log = log;
+      server.next_request = 0;
+      server.active = 0;
+      server.max_active = max_connections;
+      if (server.max_active == 0)
+	    server.max_active = thread::hardware_concurrency();
+      if (server.max_active == 0)
+	    server.max_active = 4;
+
+      fprintf(log, "Serving quickboot images on %s (keeping up to %u images, "
+	      "serving up to %u clients at once)\n", path, max_images, server.max_active);
+      fflush(log);
+
+      for (;;) {
+	      // Wait for a free slot, so that a burst of clients waits
+	      // in the listen queue instead of starting a thread each.
+	    {
+		  unique_lock<mutex> guard (server.slot_lock);
+		  while (server.active >= server.max_active)
+			server.slot_free.wait(guard);
+	    }
+
+	    int fd = accept(sock, 0, 0);
+	    if (fd < 0) {
+		  if (errno != EINTR)
+			perror("accept");
+		  continue;
+	    }
+
+	      // Don't let a client that sends nothing, or that never
+	      // reads the answer, hold a thread and a slot forever.
+	    struct timeval tv;
+	    tv.tv_sec = 10;
+	    tv.tv_usec = 0;
+	    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+	    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+
+	    {
+		  lock_guard<mutex> guard (server.slot_lock);
+		  server.active += 1;
+	    }
+	    thread(serve_thread, &server, fd).detach();
+      }
+
+      close(sock);
+      return 0;
+}
+
+int quickboot_request(const char*path, const vector<string>&args, const char*path_out, FILE*log)
+{
+      const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+
+      struct sockaddr_un addr;
+      memset(&addr, 0, sizeof addr);
+      addr.sun_family = AF_UNIX;
+      if (strlen(path) >= sizeof addr.sun_path) {
+	    fprintf(stderr, "Socket path is too long: %s\n", path);
+	    return -1;
+      }
+      strcpy(addr.sun_path, path);
+
+      int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (sock < 0) {
+	    perror("socket");
+	    return -1;
+      }
+
+      if (connect(sock, (struct sockaddr*)&addr, sizeof addr) < 0) {
+	    fprintf(stderr, "Unable to connect to server: %s\n", path);
+	    close(sock);
+	    return -1;
+      }
+
+	/* The server does not run in our working directory, so send
+	   the input paths as absolute paths. */
+      string req = "QB1\n";
+      for (size_t idx = 0 ; idx < args.size() ; idx += 1) {
+	    const string&arg = args[idx];
+	    size_t eq = arg.find('=');
+	    char buf[PATH_MAX];
+	    if (eq != string::npos && (arg.compare(0,eq,"--gold") == 0 || arg.compare(0,eq,"--silver") == 0)
+		&& realpath(arg.c_str()+eq+1, buf))
+		  req += arg.substr(0,eq+1) + buf + "\n";
+	    else
+		  req += arg + "\n";
+      }
+      req += "\n";
+
+      string line;
+      if (! write_all(sock, req.data(), req.size()) || ! read_line(sock, line)) {
+	    fprintf(stderr, "Lost connection to server: %s\n", path);
+	    close(sock);
+	    return -1;
+      }
+
+      size_t msg_len = 0, data_len = 0;
+      unsigned long usecs = 0;
+      bool rc;
+      if (sscanf(line.c_str(), "OK %zu %zu %lu", &msg_len, &data_len, &usecs) == 3) {
+	    rc = true;
+      } else if (sscanf(line.c_str(), "ERROR %zu", &msg_len) == 1) {
+	    rc = false;
+      } else {
+	    fprintf(stderr, "Bad answer from server: %s\n", line.c_str());
+	    close(sock);
+	    return -1;
+      }
+
+      string msg (msg_len, 0);
+      if (msg_len > 0 && ! read_all(sock, &msg[0], msg_len)) {
+	    fprintf(stderr, "Lost connection to server: %s\n", path);
+	    close(sock);
+	    return -1;
+      }
+
+      fwrite(msg.data(), 1, msg.size(), rc? log : stderr);
+
+      if (! rc) {
+	    close(sock);
+	    return -1;
+      }
+
+      FILE*fd_out = fopen(path_out, "wb");
+      if (fd_out == 0) {
+	    fprintf(stderr, "Unable to open output file: %s\n", path_out);
+	    close(sock);
+	    return -1;
+      }
+
+      vector<char> buf (0x10000);
+      size_t remain = data_len;
+      while (remain > 0) {
+	    size_t trans = min(remain, buf.size());
+	    if (! read_all(sock, &buf[0], trans)) {
+		  fprintf(stderr, "Lost connection to server: %s\n", path);
+		  fclose(fd_out);
+		  close(sock);
+		  return -1;
+	    }
+	    fwrite(&buf[0], 1, trans, fd_out);
+	    remain -= trans;
+      }
+
+      fclose(fd_out);
+      close(sock);
+
+      const double secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+      fprintf(log, "Served %zu bytes in %.3f ms (server %.3f ms)\n", data_len,
+	      secs*1000.0, usecs/1000.0);
+      return 0;
+}
+
+# else
+
+int quickboot_serve(const char*, unsigned, unsigned, FILE*)
+{
+      fprintf(stderr, "Server mode is not available on this system.\n");
+      return -1;
+}
+
+int quickboot_request(const char*, const vector<string>&, const char*, FILE*)
+{
+      fprintf(stderr, "Server mode is not available on this system.\n");
+      return -1;
+}
+
+# endif
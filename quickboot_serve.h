@@ -0,0 +1,58 @@
+#ifndef __quickboot_serve_H
+#define __quickboot_serve_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <string>
+# include  <cstdio>
+
+/*
+ * quickboot_builder can run as a server that builds images for
+ * clients on the same host, over a Unix domain socket. The server
+ * keeps the input files that it has loaded, and the images that it
+ * has made, in memory, so a repeat request costs only the time to
+ * send the result.
+ *
+ * A request is the list of quickboot_builder flags that describe the
+ * image (--gold, --silver, the flash type, multiboot and .mcs flags)
+ * and optionally --format=bin to get a binary image instead of an
+ * .mcs stream.
+ */
+
+/*
+ * Serve requests on the socket until the process is killed. Keep up
+ * to max_images results in memory, and serve up to max_connections
+ * clients at once (0 means one for each processor). Each request is
+ * logged to the log with its latency. Return non-zero if the socket
+ * cannot be set up.
+ */
+extern int quickboot_serve(const char*path, unsigned max_images, unsigned max_connections,
+			   FILE*log);
+
+/*
+ * Send a request to the server on the socket, and write the result to
+ * path_out. The messages of the build are printed to the log. Return
+ * non-zero if the request fails.
+ */
+extern int quickboot_request(const char*path, const std::vector<std::string>&args,
+			     const char*path_out, FILE*log);
+
+#endif
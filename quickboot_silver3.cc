@@ -28,7 +28,8 @@
  */
 
 # include  "read_bit_file.h"
-# include  "replace_register_write.h"
+# include  "quickboot_stream.h"
+# include  "metrics.h"
 # include  <vector>
 # include  <cstdio>
 # include  <cstdint>
@@ -44,6 +45,9 @@ int main(int argc, char*argv[])
       const char*path_raw = 0;
 
       for (int optarg = 1 ; optarg < argc ; optarg += 1) {
+	    if (parse_metrics_flag(argv[0], argv[optarg]))
+		  continue;
+
 	    if (strncmp(argv[optarg], "--output=",9) == 0) {
 		  path_out = argv[optarg] + 9;
 
@@ -83,9 +87,7 @@ int main(int argc, char*argv[])
       fclose(fd_raw);
       fd_raw = 0;
 
-	// Edit the silver stream BSPI register value.
-      uint32_t old_BSPI = replace_register_write(vec_raw, 0x1f, 0x0c);
-      fprintf(stdout, "BSPI (silver): 0x00000c (was: 0x%08x)\n", old_BSPI);
+      make_silver3_stream(vec_raw, stdout);
 
       FILE*fd_out = fopen(path_out, "wb");
       if (fd_out == 0) {
@@ -93,8 +95,10 @@ int main(int argc, char*argv[])
 	    return -1;
       }
 
-      size_t rc = fwrite(&vec_raw[0], 1, vec_raw.size(), fd_out);
-      assert(rc == vec_raw.size());
+      { metrics_phase phase ("write output", vec_raw.size());
+	    size_t rc = fwrite(&vec_raw[0], 1, vec_raw.size(), fd_out);
+	    assert(rc == vec_raw.size());
+      }
 
       fclose(fd_out);
 
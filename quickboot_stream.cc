@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "quickboot_stream.h"
+# include  "metrics.h"
+# include  "packet_index.h"
+# include  "replace_register_write.h"
+# include  "test_image_compat.h"
+# include  "disable_stream_crc.h"
+# include  "stream_crc.h"
+
+using namespace std;
+
+bool make_gold_stream(vector<uint8_t>&vec, bool bpi16, FILE*log)
+{
+      metrics_phase phase ("gold edits", vec.size());
+
+	// Index the configuration packets once. The edits below only
+	// replace register values, so the index stays valid.
+      packet_index index;
+      index.build(vec);
+
+      if (! test_silver_image_compatible(index, &vec[0]))
+	    return false;
+
+	// Check the CRC before the stream is edited, so that the CRC
+	// can be recomputed after.
+      size_t crc_checks = 0;
+      const crc_model_t crc_model = check_stream_crcs(&vec[0], index, crc_checks);
+
+      vector<register_edit_t> edits;
+      edits.push_back(register_edit_t(0x0d, 0x474f4c44, axss_gold_transform));
+      if (bpi16) {
+	    edits.push_back(register_edit_t(0x09, 0x062055dc));
+	    edits.push_back(register_edit_t(0x0e, 0x0000000e));
+      }
+
+      replace_register_writes(&vec[0], index, edits);
+
+      const uint32_t AXSS_old = edits[0].old_value;
+      const uint32_t AXSS_target = edits[0].new_value;
+      if (AXSS_old == 0) {
+	    fprintf(log, "WARNING        : AXSS is not present in source stream.\n");
+
+      } else if (AXSS_old == 0x53494c56) { // SILV
+	      // Replace SILV with GOLD
+	    fprintf(log, "... AXSS (gold): 0x474f4c44 (was: 0x%08x)\n", AXSS_old);
+
+      } else if ((AXSS_old & 0xff000000) == 0x53000000) { // S...
+	      // Replace a leading S with G
+	    fprintf(log, "... AXSS: 0x%08x (was: 0x%08x)\n", AXSS_target, AXSS_old);
+      }
+
+
+      if (bpi16) {
+	    fprintf(log, "COR0 (gold): 0x062055dc (was: 0x%08x)\n", edits[1].old_value);
+	    fprintf(log, "COR1 (gold): 0x0000000e (was: 0x%08x)\n", edits[2].old_value);
+      }
+
+      if (crc_model != CRC_MODEL_NONE) {
+	    size_t crc_count = update_stream_crcs(&vec[0], index, crc_model);
+	    fprintf(log, "Recomputed %zu CRC checks in gold stream.\n", crc_count);
+
+      } else if (crc_checks > 0) {
+	    fprintf(log, "WARNING        : CRC checks in source stream do not validate.\n");
+	    fprintf(log, "Disable CRC in gold stream (Replace CRC with Reset CRC)\n");
+	    size_t crc_count = disable_stream_crcs(&vec[0], index);
+	    fprintf(log, "... %zu CRC checks disabled.\n", crc_count);
+      }
+
+      return true;
+}
+
+void make_gold3_stream(vector<uint8_t>&vec, FILE*log)
+{
+      metrics_phase phase ("gold edits", vec.size());
+
+      packet_index index;
+      index.build(vec);
+
+	// Check the CRC before the stream is edited, so that the CRC
+	// can be recomputed after.
+      size_t crc_checks = 0;
+      const crc_model_t crc_model = check_stream_crcs(&vec[0], index, crc_checks);
+
+	// Edit the AXSS and BSPI registers in one go.
+      vector<register_edit_t> edits;
+      edits.push_back(register_edit_t(0x0d, 0x474f4c44, axss_gold_transform));
+      edits.push_back(register_edit_t(0x1f, 0x0c));
+
+      replace_register_writes(&vec[0], index, edits);
+
+      const uint32_t AXSS_old = edits[0].old_value;
+      const uint32_t AXSS_target = edits[0].new_value;
+      if (AXSS_old == 0) {
+	    fprintf(log, "WARNING        : AXSS is not present in source stream.\n");
+
+      } else if (AXSS_old == 0x53494c56) { // SILV
+	      // Replace SILV with GOLD
+	    fprintf(log, "... AXSS (gold): 0x474f4c44 (was: 0x%08x)\n", AXSS_old);
+
+      } else if ((AXSS_old & 0xff000000) == 0x53000000) { // S...
+	      // Replace a leading S with G
+	    fprintf(log, "... AXSS (gold): 0x%08x (was: 0x%08x)\n", AXSS_target, AXSS_old);
+      }
+
+      fprintf(log, "BSPI: 0x00000c (was: 0x%08x)\n", edits[1].old_value);
+
+	/* Recompute the CRC checks of the gold image to match the
+	   edits, or disable them if the source CRC does not
+	   validate. */
+      if (crc_model != CRC_MODEL_NONE) {
+	    size_t crc_count = update_stream_crcs(&vec[0], index, crc_model);
+	    fprintf(log, "CRC: %zu checks recomputed\n", crc_count);
+
+      } else if (crc_checks > 0) {
+	    fprintf(log, "WARNING        : CRC checks in source stream do not validate.\n");
+	    size_t crc_count = disable_stream_crcs(&vec[0], index);
+	    fprintf(log, "CRC: %zu checks disabled\n", crc_count);
+      }
+}
+
+void make_silver3_stream(vector<uint8_t>&vec, FILE*log)
+{
+      metrics_phase phase ("silver edits", vec.size());
+
+      packet_index index;
+      index.build(vec);
+
+	// Check the CRC before the stream is edited, so that the CRC
+	// can be recomputed after.
+      size_t crc_checks = 0;
+      const crc_model_t crc_model = check_stream_crcs(&vec[0], index, crc_checks);
+      if (crc_checks > 0 && crc_model == CRC_MODEL_NONE)
+	    fprintf(log, "WARNING        : CRC checks in source stream do not validate.\n");
+
+	// Edit the silver stream BSPI register value.
+      uint32_t old_BSPI = index.replace_register_write(vec, 0x1f, 0x0c);
+      fprintf(log, "BSPI (silver): 0x00000c (was: 0x%08x)\n", old_BSPI);
+
+      if (old_BSPI != 0x0c && crc_model != CRC_MODEL_NONE) {
+	    size_t crc_count = update_stream_crcs(&vec[0], index, crc_model);
+	    fprintf(log, "CRC: %zu checks recomputed\n", crc_count);
+      }
+}
@@ -0,0 +1,49 @@
+#ifndef __quickboot_stream_H
+#define __quickboot_stream_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <cstdio>
+# include  <cstdint>
+
+/*
+ * These are the stream edits that quickboot_gold, quickboot_gold3 and
+ * quickboot_silver3 make. Each takes a stream (with the header already
+ * stripped off) and edits it in place, printing what it changes to
+ * the log.
+ */
+
+/*
+ * Turn a silver stream into the gold stream of a quickboot image:
+ * AXSS is set to GOLD, and for BPI16 flash the COR0 and COR1 are set
+ * for the faster configuration. Return false if the silver stream
+ * cannot be used in a quickboot image.
+ */
+extern bool make_gold_stream(std::vector<uint8_t>&vec, bool bpi16, FILE*log);
+
+/*
+ * Make a stream ready to install as the gold or silver design of a
+ * quickboot_builder3 design set.
+ */
+extern void make_gold3_stream(std::vector<uint8_t>&vec, FILE*log);
+extern void make_silver3_stream(std::vector<uint8_t>&vec, FILE*log);
+
+#endif
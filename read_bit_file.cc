@@ -19,83 +19,201 @@
  */
 
 # include  "read_bit_file.h"
+# include  "read_mcs_file.h"
+# include  "metrics.h"
 # include  <cstring>
 # include  <cassert>
 
 using namespace std;
 
+bit_file_view::bit_file_view()
+: data_(0), len_(0), pad_(0)
+{
+}
+
+bit_file_view::~bit_file_view()
+{
+}
+
+void bit_file_view::unmap()
+{
+      file_.unmap();
+      image_.clear();
+      data_ = 0;
+      len_ = 0;
+      pad_ = 0;
+}
 
 /*
- * Read a bit file into the dst vector, and strip the header details
- * off. The result is a vector that starts at the mark (0xffffffff)
- * bytes.
- *
- * Optionally, make sure the mark is padded to be at least pad_ff
- * bytes of pad.
+ * Map the bit file into memory, and find where the header ends. The
+ * view is the 0xff pad (at least pad_ff bytes) followed by the rest
+ * of the stream. No part of the stream is copied.
  */
-void read_bit_file(vector<uint8_t>&dst, FILE*fd, size_t pad_ff)
+bool bit_file_view::map(FILE*fd, size_t pad_ff, FILE*err)
 {
-      fseek(fd, 0, SEEK_END);
-      size_t file_size = ftell(fd);
-      assert(file_size > 0);
+      unmap();
 
-      dst.resize(file_size);
+      if (! file_.map(fd, err))
+	    return false;
 
-      fseek(fd, 0, SEEK_SET);
-      size_t rc = fread(&dst[0], 1, file_size, fd);
-      if (rc != file_size) {
-	    fprintf(stderr, "Unable to read bit file bytes\n");
-	    dst.clear();
-	    return;
+      if (! find_stream_(file_.data(), file_.size(), pad_ff, err)) {
+	    unmap();
+	    return false;
       }
 
-	/* Look for 0xff bytes that indicate the end of the header. */
+      return true;
+}
 
-      rc = 0;
-      while (rc < dst.size() && dst[rc] != 0xff) {
-	    rc += 1;
+/*
+ * View a stream that the caller already has in memory, such as a bit
+ * file that was received over the network. Nothing is copied, so the
+ * memory must stay valid for as long as the view is used.
+ */
+bool bit_file_view::map_buffer(const uint8_t*data, size_t len, size_t pad_ff, FILE*err)
+{
+      unmap();
+
+      if (! find_stream_(data, len, pad_ff, err)) {
+	    unmap();
+	    return false;
       }
 
-      if (rc == dst.size()) {
-	    fprintf(stderr, "Unable to find end of header in bit file.\n");
-	    dst.clear();
-	    return;
+      return true;
+}
+
+/*
+ * Decode an .mcs file, and treat the image that it writes as the
+ * contents of a bit file. The image starts at the lowest address that
+ * the .mcs file writes.
+ */
+bool bit_file_view::map_mcs(FILE*fd, size_t pad_ff, FILE*err)
+{
+      unmap();
+
+      vector<mcs_extent_t> extents;
+      if (! read_mcs_file(extents, fd, err))
+	    return false;
+
+      return map_extents_(extents, pad_ff, err);
+}
+
+bool bit_file_view::map_mcs_buffer(const uint8_t*text, size_t len, size_t pad_ff, FILE*err)
+{
+      unmap();
+
+      vector<mcs_extent_t> extents;
+      if (! read_mcs_file(extents, text, len, err))
+	    return false;
+
+      return map_extents_(extents, pad_ff, err);
+}
+
+bool bit_file_view::map_extents_(const vector<mcs_extent_t>&extents, size_t pad_ff, FILE*err)
+{
+      if (extents.empty()) {
+	    fprintf(err, "mcs file has no data records.\n");
+	    return false;
+      }
+
+      size_t base = extents[0].address;
+      for (size_t idx = 1 ; idx < extents.size() ; idx += 1) {
+	    if (extents[idx].address < base)
+		  base = extents[idx].address;
+      }
+
+      mcs_extents_to_image(image_, extents, base);
+
+      if (! find_stream_(&image_[0], image_.size(), pad_ff, err)) {
+	    unmap();
+	    return false;
       }
 
-	/* rc is now the offset into the image where the first 0xff
-	   (after the header) starts. Now count the number of 0xff
-	   bytes are present. */
+      return true;
+}
+
+bool bit_file_view::load(FILE*fd, const char*path, size_t pad_ff, FILE*err)
+{
+      metrics_phase phase ("read input");
+
+      bool rc = is_mcs_path(path)? map_mcs(fd, pad_ff, err) : map(fd, pad_ff, err);
+      phase.add_bytes(len_);
+      return rc;
+}
+
+bool bit_file_view::find_stream_(const uint8_t*base, size_t size, size_t pad_ff, FILE*err)
+{
+	/* Look for 0xff bytes that indicate the end of the header. */
+      const uint8_t*hdr_end = (const uint8_t*)memchr(base, 0xff, size);
+      if (hdr_end == 0) {
+	    fprintf(err, "Unable to find end of header in bit file.\n");
+	    return false;
+      }
+
+	/* Now count the number of 0xff bytes that are present. The
+	   pad is at least that long, and the stream proper starts
+	   after them. */
+      size_t ptr = hdr_end - base;
       size_t ff_count = 0;
-      while ((dst[rc+ff_count] == 0xff) && ((rc+ff_count) < dst.size()))
+      while ((ptr+ff_count) < size && base[ptr+ff_count] == 0xff)
 	    ff_count += 1;
 
       if (pad_ff < ff_count)
 	    pad_ff = ff_count;
 
-	/* Now ff_count is the number of leading ff bytes that we
-	   have, and pad_ff is the number of ff bytes that we
-	   nead. Also, pad_ff >= ff_count. */
-
-      if ((pad_ff-ff_count) > rc) {
-	      /* If the amount of extra pad we need is more then the
-		 amount of header that we can trim, then expand the
-		 target array to make room for the pad. Note that we
-		 can overwrite header with pad. */
-	    size_t shift = pad_ff - ff_count - rc;
-	    dst.resize(dst.size() + shift);
-	    memmove(&dst[shift], &dst[0], dst.size());
-
-      } else if ((pad_ff-ff_count) < rc) {
-	      /* If the amount of extra pad we need is less then the
-		 amount of header that we can trim, then trim off the
-		 excess header and shrink the target array. Leave
-		 enough space for the target ff pad. */
-	    size_t shift = rc - (pad_ff-ff_count);
-	    memmove(&dst[0], &dst[shift], dst.size() - shift);
-	    dst.resize(dst.size() - shift);
+      pad_  = pad_ff;
+      data_ = base + ptr + ff_count;
+      len_  = size - ptr - ff_count;
+      return true;
+}
+
+void bit_file_view::copy(uint8_t*dst) const
+{
+      memset(dst, 0xff, pad_);
+      if (len_ > 0)
+	    memcpy(dst+pad_, data_, len_);
+}
+
+void bit_file_view::copy(vector<uint8_t>&dst) const
+{
+      dst.resize(size());
+      if (dst.size() > 0)
+	    copy(&dst[0]);
+}
+
+/*
+ * Read a bit file into the dst vector, and strip the header details
+ * off. The result is a vector that starts at the mark (0xffffffff)
+ * bytes.
+ *
+ * Optionally, make sure the mark is padded to be at least pad_ff
+ * bytes of pad.
+ */
+void read_bit_file(vector<uint8_t>&dst, FILE*fd, size_t pad_ff)
+{
+      metrics_phase phase ("read input");
+
+      bit_file_view view;
+      if (! view.map(fd, pad_ff)) {
+	    dst.clear();
+	    return;
       }
 
-	/* In any case, make sure the prefix starts with pad. This may
-	   erase unused header, or fill in new array space. */
-      memset(&dst[0], 0xff, pad_ff);
+      view.copy(dst);
+      phase.add_bytes(dst.size());
+}
+
+/*
+ * Return true if the path names an .mcs file.
+ */
+bool is_mcs_path(const char*path)
+{
+      size_t len = strlen(path);
+      if (len < 4)
+	    return false;
+
+      const char*ext = path + len - 4;
+      return ext[0] == '.'
+	    && (ext[1] == 'm' || ext[1] == 'M')
+	    && (ext[2] == 'c' || ext[2] == 'C')
+	    && (ext[3] == 's' || ext[3] == 'S');
 }
@@ -20,11 +20,85 @@
  *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+# include  "map_file.h"
 # include  <vector>
 # include  <cstdio>
 # include  <cstdint>
 # include  <cstdlib>
 
+struct mcs_extent_t;
+
+/*
+ * A bit_file_view is a read-only view of the stream in a .bit file,
+ * with the header stripped off. The file is mapped into memory, and
+ * the leading 0xff pad is virtual, so it costs nothing to make the
+ * pad larger. Use the copy() methods to get an editable image.
+ *
+ * The view can also hold a stream that is decoded from an .mcs
+ * file. In that case, the decoded image is held by the view. Either
+ * kind of file can instead be in memory, so that a program can make
+ * images without going through the file system.
+ */
+class bit_file_view {
+
+    public:
+      bit_file_view();
+      ~bit_file_view();
+
+	// Map the file and locate the end of the header. The view
+	// starts with at least pad_ff bytes of 0xff pad. Return false
+	// (after printing a message to err) if this is not a bit file.
+      bool map(FILE*fd, size_t pad_ff =0, FILE*err =stderr);
+	// Decode an .mcs file that holds a bit stream.
+      bool map_mcs(FILE*fd, size_t pad_ff =0, FILE*err =stderr);
+	// The same, but for a .bit or .mcs file that is already in
+	// memory. map_buffer() does not copy the data, so it must
+	// outlive the view.
+      bool map_buffer(const uint8_t*data, size_t len, size_t pad_ff =0,
+		      FILE*err =stderr);
+      bool map_mcs_buffer(const uint8_t*text, size_t len, size_t pad_ff =0,
+			  FILE*err =stderr);
+	// Use map_mcs() if the path names an .mcs file, and map()
+	// otherwise.
+      bool load(FILE*fd, const char*path, size_t pad_ff =0, FILE*err =stderr);
+      void unmap();
+
+	// Size of the stream, including the pad.
+      size_t size() const { return pad_ + len_; }
+
+      uint8_t operator[] (size_t idx) const
+      { return idx < pad_? 0xff : data_[idx-pad_]; }
+
+	// The stream is the pad followed by the payload. The
+	// payload is the part that is actually in the file.
+      size_t pad_size() const { return pad_; }
+      const uint8_t*payload() const { return data_; }
+      size_t payload_size() const { return len_; }
+
+	// Copy the stream, pad included, into the destination.
+      void copy(uint8_t*dst) const;
+      void copy(std::vector<uint8_t>&dst) const;
+
+    private:
+      bool find_stream_(const uint8_t*base, size_t size, size_t pad_ff, FILE*err);
+      bool map_extents_(const std::vector<mcs_extent_t>&extents, size_t pad_ff, FILE*err);
+
+    private:
+      const uint8_t*data_;
+      size_t len_;
+      size_t pad_;
+
+	// The mapped .bit file, or the image decoded from an .mcs file.
+      mapped_file file_;
+      std::vector<uint8_t> image_;
+
+    private: // not implemented
+      bit_file_view(const bit_file_view&);
+      bit_file_view& operator= (const bit_file_view&);
+};
+
 extern void read_bit_file(std::vector<uint8_t>&dst, FILE*fd, size_t pad_ff =0);
 
+extern bool is_mcs_path(const char*path);
+
 #endif
@@ -0,0 +1,345 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "read_mcs_file.h"
+# include  "metrics.h"
+# include  "map_file.h"
+# include  <cstring>
+
+# if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define HAVE_X86_SIMD 1
+#  include  <immintrin.h>
+# endif
+
+using namespace std;
+
+/*
+ * Table that maps a hex digit (either case) to its value. Anything
+ * that is not a hex digit maps to 0xff.
+ */
+struct hex_value_table_t {
+      hex_value_table_t()
+      {
+	    memset(value, 0xff, sizeof value);
+	    for (int idx = 0 ; idx < 10 ; idx += 1)
+		  value['0'+idx] = idx;
+	    for (int idx = 0 ; idx < 6 ; idx += 1) {
+		  value['A'+idx] = 10+idx;
+		  value['a'+idx] = 10+idx;
+	    }
+      }
+      uint8_t value[256];
+};
+static const hex_value_table_t hex_value;
+
+/*
+ * Decode cnt bytes from 2*cnt hex digits. Add the bytes into the sum,
+ * and return false if there are any characters that are not hex
+ * digits. These are the scalar versions, and also handle the tails
+ * that the SIMD versions leave behind.
+ */
+static bool hex_decode_scalar(uint8_t*dst, const uint8_t*src, size_t cnt, unsigned&sum)
+{
+      unsigned bad = 0;
+      for (size_t idx = 0 ; idx < cnt ; idx += 1) {
+	    uint8_t hi = hex_value.value[src[2*idx+0]];
+	    uint8_t lo = hex_value.value[src[2*idx+1]];
+	    bad |= hi | lo;
+	    dst[idx] = (hi << 4) | (lo & 0x0f);
+	    sum += dst[idx];
+      }
+      return (bad & 0xf0) == 0;
+}
+
+# ifdef HAVE_X86_SIMD
+/*
+ * SSSE3 version: 16 bytes from 32 digits at a time. A digit is valid
+ * if it is in '0'-'9', or (with the case bit set) in 'a'-'f'. Its
+ * value is the low nibble, plus 9 for letters. pmaddubsw then
+ * combines the high and low digits of each byte.
+ */
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i hex_digits_ssse3(__m128i txt, int&valid)
+{
+      __m128i digit = _mm_sub_epi8(txt, _mm_set1_epi8('0'));
+      __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+      __m128i letter = _mm_sub_epi8(_mm_or_si128(txt, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+      __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+      valid &= _mm_movemask_epi8(_mm_or_si128(is_digit, is_letter));
+
+      __m128i val = _mm_and_si128(txt, _mm_set1_epi8(0x0f));
+      val = _mm_add_epi8(val, _mm_and_si128(is_letter, _mm_set1_epi8(9)));
+      return _mm_maddubs_epi16(val, _mm_set1_epi16(0x0110));
+}
+
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i hex_decode16_ssse3(uint8_t*dst, const uint8_t*src, int&valid)
+{
+      __m128i txt0 = _mm_loadu_si128((const __m128i*)(src+ 0));
+      __m128i txt1 = _mm_loadu_si128((const __m128i*)(src+16));
+      __m128i val = _mm_packus_epi16(hex_digits_ssse3(txt0, valid),
+				     hex_digits_ssse3(txt1, valid));
+      _mm_storeu_si128((__m128i*)dst, val);
+      return _mm_sad_epu8(val, _mm_setzero_si128());
+}
+
+__attribute__((target("ssse3")))
+static bool hex_decode_ssse3(uint8_t*dst, const uint8_t*src, size_t cnt, unsigned&sum)
+{
+      int valid = 0xffff;
+      __m128i acc = _mm_setzero_si128();
+
+      size_t idx = 0;
+      for ( ; idx+16 <= cnt ; idx += 16)
+	    acc = _mm_add_epi64(acc, hex_decode16_ssse3(dst+idx, src+2*idx, valid));
+
+      sum += _mm_cvtsi128_si32(acc) + _mm_extract_epi16(acc, 4);
+      if (valid != 0xffff)
+	    return false;
+      return hex_decode_scalar(dst+idx, src+2*idx, cnt-idx, sum);
+}
+
+/*
+ * AVX2 version: 32 bytes from 64 digits at a time. The pack works
+ * within 128bit lanes, so the quadwords need to be put back in order.
+ * The tail is done here too, and not by calling the SSSE3 version, to
+ * avoid the penalty for mixing legacy SSE and AVX instructions.
+ */
+__attribute__((target("avx2"), always_inline))
+static inline __m256i hex_digits_avx2(__m256i txt, int&valid)
+{
+      __m256i digit = _mm256_sub_epi8(txt, _mm256_set1_epi8('0'));
+      __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+      __m256i letter = _mm256_sub_epi8(_mm256_or_si256(txt, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+      __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+      valid &= _mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter));
+
+      __m256i val = _mm256_and_si256(txt, _mm256_set1_epi8(0x0f));
+      val = _mm256_add_epi8(val, _mm256_and_si256(is_letter, _mm256_set1_epi8(9)));
+      return _mm256_maddubs_epi16(val, _mm256_set1_epi16(0x0110));
+}
+
+__attribute__((target("avx2")))
+static bool hex_decode_avx2(uint8_t*dst, const uint8_t*src, size_t cnt, unsigned&sum)
+{
+      int valid = -1;
+      __m256i acc = _mm256_setzero_si256();
+
+      size_t idx = 0;
+      for ( ; idx+32 <= cnt ; idx += 32) {
+	    __m256i txt0 = _mm256_loadu_si256((const __m256i*)(src+2*idx+ 0));
+	    __m256i txt1 = _mm256_loadu_si256((const __m256i*)(src+2*idx+32));
+	    __m256i val = _mm256_packus_epi16(hex_digits_avx2(txt0, valid),
+					      hex_digits_avx2(txt1, valid));
+	    val = _mm256_permute4x64_epi64(val, 0xd8);
+	    _mm256_storeu_si256((__m256i*)(dst+idx), val);
+	    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(val, _mm256_setzero_si256()));
+      }
+
+      __m128i acc2 = _mm_add_epi64(_mm256_castsi256_si128(acc),
+				   _mm256_extracti128_si256(acc, 1));
+      int valid2 = 0xffff;
+      for ( ; idx+16 <= cnt ; idx += 16)
+	    acc2 = _mm_add_epi64(acc2, hex_decode16_ssse3(dst+idx, src+2*idx, valid2));
+
+      sum += _mm_cvtsi128_si32(acc2) + _mm_extract_epi16(acc2, 4);
+      if (valid != -1 || valid2 != 0xffff)
+	    return false;
+      return hex_decode_scalar(dst+idx, src+2*idx, cnt-idx, sum);
+}
+# endif
+
+typedef bool (*hex_decode_fun_t)(uint8_t*dst, const uint8_t*src, size_t cnt, unsigned&sum);
+
+/*
+ * Pick the best decoder for the processor that we are running on.
+ */
+static hex_decode_fun_t choose_hex_decode(void)
+{
+# ifdef HAVE_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+	    return hex_decode_avx2;
+      if (__builtin_cpu_supports("ssse3"))
+	    return hex_decode_ssse3;
+# endif
+      return hex_decode_scalar;
+}
+static const hex_decode_fun_t hex_decode = choose_hex_decode();
+
+bool read_mcs_file(vector<mcs_extent_t>&dst, const uint8_t*text, size_t len, FILE*err)
+{
+      metrics_phase phase ("mcs decode", len);
+
+      dst.clear();
+
+      size_t base = 0;
+      size_t fill = 0;
+      size_t line = 1;
+      size_t ptr = 0;
+
+      while (ptr < len) {
+	    uint8_t chr = text[ptr];
+	    if (chr == '\n') {
+		  line += 1;
+		  ptr += 1;
+		  continue;
+	    }
+	    if (chr == '\r' || chr == ' ' || chr == '\t') {
+		  ptr += 1;
+		  continue;
+	    }
+	    if (chr != ':') {
+		  fprintf(err, "mcs line %zu: Expecting ':' to start a record.\n", line);
+		  return false;
+	    }
+	    ptr += 1;
+
+	      // Every record has a count, address and type, and after
+	      // the data bytes a checksum.
+	    uint8_t head[4];
+	    unsigned sum = 0;
+	    if (ptr+8 > len || !hex_decode_scalar(head, text+ptr, 4, sum)) {
+		  fprintf(err, "mcs line %zu: Malformed record header.\n", line);
+		  return false;
+	    }
+	    ptr += 8;
+
+	    const size_t count = head[0];
+	    const size_t addr16 = (head[1] << 8) | head[2];
+	    const uint8_t type = head[3];
+
+	    if (ptr + 2*count + 2 > len) {
+		  fprintf(err, "mcs line %zu: Truncated record.\n", line);
+		  return false;
+	    }
+
+	    uint8_t tmp[256];
+	    uint8_t*data = tmp;
+
+	      // Data records are decoded directly into the extent
+	      // that they belong to. The extent grows in large steps,
+	      // and fill is how much of it is actually used. A data
+	      // record with no data writes nothing, so it is skipped.
+	    if (type == 0x00 && count > 0) {
+		  size_t address = base + addr16;
+		  if (dst.empty() || dst.back().address + fill != address) {
+			if (! dst.empty())
+			      dst.back().data.resize(fill);
+			dst.push_back(mcs_extent_t());
+			dst.back().address = address;
+			fill = 0;
+		  }
+
+		  vector<uint8_t>&ext = dst.back().data;
+		  if (fill + count > ext.size())
+			ext.resize(2*ext.size() + 64*1024);
+		  data = ext.data() + fill;
+		  fill += count;
+	    }
+
+	    if (! hex_decode(data, text+ptr, count, sum)) {
+		  fprintf(err, "mcs line %zu: Invalid hex digit in record.\n", line);
+		  return false;
+	    }
+	    ptr += 2*count;
+
+	    uint8_t check;
+	    if (! hex_decode_scalar(&check, text+ptr, 1, sum)) {
+		  fprintf(err, "mcs line %zu: Invalid hex digit in record.\n", line);
+		  return false;
+	    }
+	    ptr += 2;
+
+	    if (sum & 0xff) {
+		  fprintf(err, "mcs line %zu: Checksum error.\n", line);
+		  return false;
+	    }
+
+	    switch (type) {
+		case 0x00: /* Data */
+		  break;
+		case 0x01: /* End of file */
+		  if (! dst.empty())
+			dst.back().data.resize(fill);
+		  return true;
+		case 0x02: /* Extended segment address */
+		  if (count != 2) {
+			fprintf(err, "mcs line %zu: Malformed segment address record.\n", line);
+			return false;
+		  }
+		  base = ((data[0] << 8) | data[1]) << 4;
+		  break;
+		case 0x04: /* Extended linear address */
+		  if (count != 2) {
+			fprintf(err, "mcs line %zu: Malformed linear address record.\n", line);
+			return false;
+		  }
+		  base = (size_t)((data[0] << 8) | data[1]) << 16;
+		  break;
+		case 0x03: /* Start segment address */
+		case 0x05: /* Start linear address */
+		  break;
+		default:
+		  fprintf(err, "mcs line %zu: Unknown record type 0x%02x.\n", line, type);
+		  return false;
+	    }
+      }
+
+      fprintf(err, "mcs file is missing the end of file record.\n");
+      return false;
+}
+
+bool read_mcs_file(vector<mcs_extent_t>&dst, FILE*fd, FILE*err)
+{
+      mapped_file file;
+      if (! file.map(fd, err))
+	    return false;
+
+      return read_mcs_file(dst, file.data(), file.size(), err);
+}
+
+void mcs_extents_to_image(vector<uint8_t>&dst, const vector<mcs_extent_t>&src, size_t base_address)
+{
+      size_t end = base_address;
+      for (size_t idx = 0 ; idx < src.size() ; idx += 1) {
+	    if (src[idx].address + src[idx].data.size() > end)
+		  end = src[idx].address + src[idx].data.size();
+      }
+
+      dst.assign(end - base_address, 0xff);
+
+      for (size_t idx = 0 ; idx < src.size() ; idx += 1) {
+	    const mcs_extent_t&ext = src[idx];
+	    if (ext.address < base_address || ext.data.empty())
+		  continue;
+	    memcpy(&dst[ext.address - base_address], &ext.data[0], ext.data.size());
+      }
+}
+
+bool read_mcs_file(vector<uint8_t>&dst, FILE*fd, FILE*err)
+{
+      vector<mcs_extent_t> extents;
+      if (! read_mcs_file(extents, fd, err))
+	    return false;
+
+      mcs_extents_to_image(dst, extents);
+      return true;
+}
@@ -0,0 +1,62 @@
+#ifndef __read_mcs_file_H
+#define __read_mcs_file_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <cstdio>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * A contiguous run of bytes that an .mcs file writes, starting at the
+ * given byte address of the flash.
+ */
+struct mcs_extent_t {
+      size_t address;
+      std::vector<uint8_t> data;
+};
+
+/*
+ * Decode an .mcs (Intel HEX) file into a list of extents, in the order
+ * that the file writes them. Data records that continue where the
+ * previous record left off are merged into a single extent. Extended
+ * linear and extended segment address records are supported, and all
+ * the record checksums are checked. Return false (after printing a
+ * message to err) if the file is not a valid .mcs file.
+ */
+extern bool read_mcs_file(std::vector<mcs_extent_t>&dst, FILE*fd, FILE*err =stderr);
+extern bool read_mcs_file(std::vector<mcs_extent_t>&dst, const uint8_t*text, size_t len,
+			  FILE*err =stderr);
+
+/*
+ * Decode an .mcs file into a dense image of the flash, starting at
+ * flash address 0. Bytes that the file does not write are 0xff.
+ */
+extern bool read_mcs_file(std::vector<uint8_t>&dst, FILE*fd, FILE*err =stderr);
+
+/*
+ * Flatten a list of extents into a dense image that starts at the
+ * given flash address.
+ */
+extern void mcs_extents_to_image(std::vector<uint8_t>&dst, const std::vector<mcs_extent_t>&src,
+				 size_t base_address =0);
+
+#endif
@@ -19,96 +19,78 @@
  */
 
 # include  "replace_register_write.h"
-# include  <cassert>
+# include  "metrics.h"
+# include  "packet_index.h"
 
 using namespace std;
 
+/*
+ * Replace the value written to the register by the first write in the
+ * header of the stream, and return the old value. Callers that make
+ * several edits to the same stream should build a packet_index once
+ * and use its replace_register_write() method instead.
+ */
 uint32_t replace_register_write(std::vector<uint8_t>&vec, uint32_t addr, uint32_t val)
 {
-      const uint8_t magic[4] = {0xaa, 0x99, 0x55, 0x66};
-      size_t match = 0;
-      size_t ptr = 0;
-
-      const size_t SCAN_LIMIT = 0x300;
-
-	// Scan into the bit stream for the sync word.
-      while (ptr < SCAN_LIMIT && match < 4) {
-	    if (vec[ptr+match] == magic[match]) {
-		  match += 1;
-	    } else {
-		  ptr += 1;
-		  match = 0;
-	    }
-      }
+      packet_index index;
+      if (! index.build(vec))
+	    return 0;
+
+      return index.replace_register_write(vec, addr, val);
+}
 
-      if (match < 4)
+size_t replace_register_writes(std::vector<uint8_t>&vec, std::vector<register_edit_t>&edits)
+{
+      packet_index index;
+      if (! index.build(vec))
 	    return 0;
 
-	// Now the ptr points into the bit file at the first
-	// command. Step forward through the commands until we find
-	// the write to the address we are after, or we are past the
-	// interesting commands.
-      ptr += match;
-
-      while (ptr < SCAN_LIMIT) {
-	    uint32_t word = vec[ptr+0];
-	    word <<= 8;
-	    word |= vec[ptr+1];
-	    word <<= 8;
-	    word |= vec[ptr+2];
-	    word <<= 8;
-	    word |= vec[ptr+3];
-
-	      // Is this a NOP?
-	    if ((word&0xf8000000) == 0x20000000) { // NOP
-		  ptr += 4;
+      return replace_register_writes(&vec[0], index, edits);
+}
+
+size_t replace_register_writes(uint8_t*vec, const packet_index&index, std::vector<register_edit_t>&edits)
+{
+      metrics_phase phase ("register edits");
+
+      size_t count = 0;
+
+      for (size_t idx = 0 ; idx < edits.size() ; idx += 1) {
+	    register_edit_t&cur = edits[idx];
+	    cur.found = false;
+	    cur.changed = false;
+	    cur.old_value = 0;
+	    cur.new_value = 0;
+
+	    size_t ptr = index.header_write(cur.reg);
+	    if (ptr == 0)
+		  continue;
+
+	    cur.found = true;
+	    cur.old_value = get_word(vec+ptr);
+	    cur.new_value = cur.old_value;
+
+	    uint32_t val = cur.value;
+	    if (cur.transform && ! cur.transform(cur.old_value, val))
 		  continue;
-	    }
-
-	    if ((word&0xf8000000) == 0x28000000) { // READ
-		  ptr += 4;
-		  assert(0); // What are reads doing here?
-	    }
-
-	    if ((word&0xf8000000) == 0x30000000) { // WRITE
-		  uint32_t wc = word&0x3ff;
-		  uint32_t ad = (word>>13) & 0x3fff;
-		  if (ad != addr) {
-			ptr += 4 + wc*4;
-			continue;
-		  }
-
-		  assert(wc == 1);
-		  ptr += 4;
-		    // Get the existing word being written.
-		  word = vec[ptr+0];
-		  word <<= 8;
-		  word |= vec[ptr+1];
-		  word <<= 8;
-		  word |= vec[ptr+2];
-		  word <<= 8;
-		  word |= vec[ptr+3];
-		    // Put the new value into the word write.
-		  vec[ptr+3] = val & 0xff;
-		  val >>= 8;
-		  vec[ptr+2] = val & 0xff;
-		  val >>= 8;
-		  vec[ptr+1] = val & 0xff;
-		  val >>= 8;
-		  vec[ptr+0] = val & 0xff;
-		    // Return the old value.
-		  return word;
-	    }
-
-	      // The first type-2 header should mark the start of the
-	      // bit stream and the end of other commands.
-	    if ((word&0xe0000000) == 0x40000000) { // Type-2 header
-		  break;
-	    }
-
-	      // Everything should have been accounted for.
-	    assert(0);
+
+	    put_word(vec+ptr, val);
+	    cur.new_value = val;
+	    cur.changed = true;
+	    count += 1;
+      }
+
+      return count;
+}
+
+bool axss_gold_transform(uint32_t old_val, uint32_t&new_val)
+{
+      if (old_val == 0x53494c56) { // SILV
+	    new_val = 0x474f4c44; // GOLD
+      } else if ((old_val & 0xff000000) == 0x53000000) { // S...
+	    new_val = (old_val & 0x00ffffff) | 0x47000000;
+      } else {
+	    new_val = 0x474f4c44;
       }
 
-      return 0;
+      return true;
 }
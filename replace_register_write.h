@@ -22,6 +22,49 @@
 
 # include  <vector>
 # include  <cstdint>
+# include  <cstddef>
+
+class packet_index;
 
 extern uint32_t replace_register_write(std::vector<uint8_t>&vec, uint32_t addr, uint32_t val);
+
+/*
+ * A register_edit_t describes one edit to a register write in the
+ * header of a stream. If there is no transform function, the register
+ * is simply given the new value. If there is a transform function, it
+ * is passed the old value and returns the value to write, or returns
+ * false to leave the register alone.
+ *
+ * After the edits are applied, the found, changed, old_value and
+ * new_value members describe what was done, for reporting.
+ */
+struct register_edit_t {
+      register_edit_t(uint32_t r, uint32_t val, bool (*fun)(uint32_t, uint32_t&) =0)
+      : reg(r), value(val), transform(fun), found(false), changed(false), old_value(0), new_value(0) { }
+
+      uint32_t reg;
+      uint32_t value;
+      bool (*transform)(uint32_t old_val, uint32_t&new_val);
+
+      bool found;
+      bool changed;
+      uint32_t old_value;
+      uint32_t new_value;
+};
+
+/*
+ * Apply all the edits to the stream. The first version indexes the
+ * stream itself, the second uses an index that the caller already
+ * has. Return the number of registers that were changed.
+ */
+extern size_t replace_register_writes(std::vector<uint8_t>&vec, std::vector<register_edit_t>&edits);
+extern size_t replace_register_writes(uint8_t*vec, const packet_index&index, std::vector<register_edit_t>&edits);
+
+/*
+ * Transform for the AXSS register of a gold image: SILV becomes GOLD,
+ * and any other value with a leading S gets a leading G instead. All
+ * other values are replaced with GOLD.
+ */
+extern bool axss_gold_transform(uint32_t old_val, uint32_t&new_val);
+
 #endif
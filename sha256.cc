@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "sha256.h"
+# include  <cstring>
+
+static const uint32_t round_k[64] = {
+      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotr(uint32_t val, int cnt)
+{
+      return (val >> cnt) | (val << (32 - cnt));
+}
+
+sha256::sha256()
+: length_(0), fill_(0)
+{
+      state_[0] = 0x6a09e667;
+      state_[1] = 0xbb67ae85;
+      state_[2] = 0x3c6ef372;
+      state_[3] = 0xa54ff53a;
+      state_[4] = 0x510e527f;
+      state_[5] = 0x9b05688c;
+      state_[6] = 0x1f83d9ab;
+      state_[7] = 0x5be0cd19;
+}
+
+void sha256::block_(const uint8_t*blk)
+{
+      uint32_t w[64];
+      for (int idx = 0 ; idx < 16 ; idx += 1) {
+	    w[idx] = (blk[4*idx+0] << 24) | (blk[4*idx+1] << 16)
+		  | (blk[4*idx+2] << 8) | blk[4*idx+3];
+      }
+      for (int idx = 16 ; idx < 64 ; idx += 1) {
+	    uint32_t s0 = rotr(w[idx-15], 7) ^ rotr(w[idx-15], 18) ^ (w[idx-15] >> 3);
+	    uint32_t s1 = rotr(w[idx-2], 17) ^ rotr(w[idx-2], 19) ^ (w[idx-2] >> 10);
+	    w[idx] = w[idx-16] + s0 + w[idx-7] + s1;
+      }
+
+      uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+      uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+
+      for (int idx = 0 ; idx < 64 ; idx += 1) {
+	    uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+	    uint32_t ch = (e & f) ^ (~e & g);
+	    uint32_t t1 = h + s1 + ch + round_k[idx] + w[idx];
+	    uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+	    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+	    uint32_t t2 = s0 + maj;
+	    h = g;
+	    g = f;
+	    f = e;
+	    e = d + t1;
+	    d = c;
+	    c = b;
+	    b = a;
+	    a = t1 + t2;
+      }
+
+      state_[0] += a; state_[1] += b; state_[2] += c; state_[3] += d;
+      state_[4] += e; state_[5] += f; state_[6] += g; state_[7] += h;
+}
+
+void sha256::update(const uint8_t*data, size_t len)
+{
+      length_ += len;
+
+      if (fill_ > 0) {
+	    size_t trans = 64 - fill_;
+	    if (trans > len)
+		  trans = len;
+	    memcpy(buf_+fill_, data, trans);
+	    fill_ += trans;
+	    data += trans;
+	    len -= trans;
+	    if (fill_ < 64)
+		  return;
+	    block_(buf_);
+	    fill_ = 0;
+      }
+
+      for ( ; len >= 64 ; data += 64, len -= 64)
+	    block_(data);
+
+      memcpy(buf_, data, len);
+      fill_ = len;
+}
+
+void sha256::finish(uint8_t digest[32])
+{
+      uint64_t bits = length_ * 8;
+
+	// Pad with a 1 bit, then zeros up to the last 8 bytes of a
+	// block, then the message length in bits.
+      buf_[fill_++] = 0x80;
+      if (fill_ > 56) {
+	    memset(buf_+fill_, 0, 64-fill_);
+	    block_(buf_);
+	    fill_ = 0;
+      }
+      memset(buf_+fill_, 0, 56-fill_);
+      for (int idx = 0 ; idx < 8 ; idx += 1)
+	    buf_[56+idx] = bits >> (56 - 8*idx);
+      block_(buf_);
+      fill_ = 0;
+
+      for (int idx = 0 ; idx < 8 ; idx += 1) {
+	    digest[4*idx+0] = state_[idx] >> 24;
+	    digest[4*idx+1] = state_[idx] >> 16;
+	    digest[4*idx+2] = state_[idx] >>  8;
+	    digest[4*idx+3] = state_[idx] >>  0;
+      }
+}
+
+void sha256::digest(uint8_t digest[32], const uint8_t*data, size_t len)
+{
+      sha256 ctx;
+      ctx.update(data, len);
+      ctx.finish(digest);
+}
@@ -1,7 +1,7 @@
-#ifndef __extract_register_write_H
-#define __extract_register_write_H
+#ifndef __sha256_H
+#define __sha256_H
 /*
- * Copyright (c) 2015 Picture Elements, Inc.
+ * Copyright (c) 2026 Picture Elements, Inc.
  *    Stephen Williams (steve@icarus.com)
  *
  *    This source code is free software; you can redistribute it
@@ -20,9 +20,32 @@
  *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
-# include  <vector>
 # include  <cstdint>
+# include  <cstddef>
 
-extern uint32_t extract_register_write(const std::vector<uint8_t>&vec, uint32_t addr);
+/*
+ * SHA-256 message digest (FIPS 180-4). Feed the message in any number
+ * of pieces with update(), then call finish() to get the digest.
+ */
+class sha256 {
+
+    public:
+      sha256();
+
+      void update(const uint8_t*data, size_t len);
+      void finish(uint8_t digest[32]);
+
+	// Convenience for hashing a single buffer.
+      static void digest(uint8_t digest[32], const uint8_t*data, size_t len);
+
+    private:
+      void block_(const uint8_t*blk);
+
+    private:
+      uint32_t state_[8];
+      uint64_t length_;
+      uint8_t buf_[64];
+      size_t fill_;
+};
 
 #endif
@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "stream_crc.h"
+# include  "metrics.h"
+# include  "packet_index.h"
+# include  <cstring>
+
+# if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define HAVE_X86_SIMD 1
+#  include  <immintrin.h>
+# endif
+
+using namespace std;
+
+const uint32_t CRC32C_POLY = 0x82f63b78;
+
+const uint32_t REG_CRC = 0x00;
+const uint32_t REG_CMD = 0x04;
+const uint32_t CMD_RCRC = 0x07;
+
+/*
+ * Tables for the table driven CRC. The slice tables fold in a whole
+ * data word at a time (slice-by-4), and the address table folds in the
+ * 5 address bits that follow each data word.
+ */
+struct crc_tables_t {
+      crc_tables_t()
+      {
+	    for (uint32_t idx = 0 ; idx < 256 ; idx += 1) {
+		  uint32_t crc = idx;
+		  for (int bit = 0 ; bit < 8 ; bit += 1)
+			crc = (crc & 1)? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		  slice[0][idx] = crc;
+	    }
+	    for (int tab = 1 ; tab < 4 ; tab += 1) {
+		  for (int idx = 0 ; idx < 256 ; idx += 1) {
+			uint32_t crc = slice[tab-1][idx];
+			slice[tab][idx] = (crc >> 8) ^ slice[0][crc & 0xff];
+		  }
+	    }
+	    for (uint32_t idx = 0 ; idx < 32 ; idx += 1) {
+		  uint32_t crc = idx;
+		  for (int bit = 0 ; bit < 5 ; bit += 1)
+			crc = (crc & 1)? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		  addr[idx] = crc;
+	    }
+      }
+      uint32_t slice[4][256];
+      uint32_t addr[32];
+};
+static const crc_tables_t crc_tables;
+
+static inline uint32_t fold_address(uint32_t crc, uint32_t reg)
+{
+      return (crc >> 5) ^ crc_tables.addr[(crc ^ reg) & 0x1f];
+}
+
+static uint32_t crc_update_scalar(uint32_t crc, uint32_t reg, const uint8_t*words, size_t nwords)
+{
+      for (size_t idx = 0 ; idx < nwords ; idx += 1) {
+	    crc ^= get_word(words + 4*idx);
+	    crc = crc_tables.slice[3][crc & 0xff]
+		^ crc_tables.slice[2][(crc >> 8) & 0xff]
+		^ crc_tables.slice[1][(crc >> 16) & 0xff]
+		^ crc_tables.slice[0][crc >> 24];
+	    crc = fold_address(crc, reg);
+      }
+      return crc;
+}
+
+# ifdef HAVE_X86_SIMD
+/*
+ * The SSE4.2 crc32 instruction is exactly the CRC-32C update of a data
+ * word (without the inversions that the usual CRC-32C adds), so it
+ * replaces the slice tables. The address bits still need the table.
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc_update_sse42(uint32_t crc, uint32_t reg, const uint8_t*words, size_t nwords)
+{
+      for (size_t idx = 0 ; idx < nwords ; idx += 1) {
+	    uint32_t word;
+	    memcpy(&word, words + 4*idx, 4);
+	    crc = _mm_crc32_u32(crc, __builtin_bswap32(word));
+	    crc = fold_address(crc, reg);
+      }
+      return crc;
+}
+# endif
+
+typedef uint32_t (*crc_update_fun_t)(uint32_t crc, uint32_t reg, const uint8_t*words, size_t nwords);
+
+static crc_update_fun_t choose_crc_update(void)
+{
+# ifdef HAVE_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("sse4.2"))
+	    return crc_update_sse42;
+# endif
+      return crc_update_scalar;
+}
+static const crc_update_fun_t crc_update_fun = choose_crc_update();
+
+uint32_t config_crc_update(uint32_t crc, uint32_t reg, const uint8_t*words, size_t nwords)
+{
+      return crc_update_fun(crc, reg & 0x1f, words, nwords);
+}
+
+static uint32_t crc32c_scalar(uint32_t crc, const uint8_t*data, size_t len)
+{
+      size_t idx = 0;
+      for ( ; idx+4 <= len ; idx += 4) {
+	    crc ^= data[idx+0] | (data[idx+1] << 8) | (data[idx+2] << 16) | ((uint32_t)data[idx+3] << 24);
+	    crc = crc_tables.slice[3][crc & 0xff]
+		^ crc_tables.slice[2][(crc >> 8) & 0xff]
+		^ crc_tables.slice[1][(crc >> 16) & 0xff]
+		^ crc_tables.slice[0][crc >> 24];
+      }
+      for ( ; idx < len ; idx += 1)
+	    crc = (crc >> 8) ^ crc_tables.slice[0][(crc ^ data[idx]) & 0xff];
+      return crc;
+}
+
+# ifdef HAVE_X86_SIMD
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t*data, size_t len)
+{
+      size_t idx = 0;
+#  ifdef __x86_64__
+      uint64_t crc64 = crc;
+      for ( ; idx+8 <= len ; idx += 8) {
+	    uint64_t word;
+	    memcpy(&word, data+idx, 8);
+	    crc64 = _mm_crc32_u64(crc64, word);
+      }
+      crc = crc64;
+#  endif
+      for ( ; idx+4 <= len ; idx += 4) {
+	    uint32_t word;
+	    memcpy(&word, data+idx, 4);
+	    crc = _mm_crc32_u32(crc, word);
+      }
+      for ( ; idx < len ; idx += 1)
+	    crc = _mm_crc32_u8(crc, data[idx]);
+      return crc;
+}
+# endif
+
+typedef uint32_t (*crc32c_fun_t)(uint32_t crc, const uint8_t*data, size_t len);
+
+static crc32c_fun_t choose_crc32c(void)
+{
+# ifdef HAVE_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("sse4.2"))
+	    return crc32c_sse42;
+# endif
+      return crc32c_scalar;
+}
+static const crc32c_fun_t crc32c_fun = choose_crc32c();
+
+uint32_t crc32c(const uint8_t*data, size_t len, uint32_t crc)
+{
+      return ~crc32c_fun(~crc, data, len);
+}
+
+static inline bool is_rcrc(const uint8_t*vec, const packet_info_t&pkt)
+{
+      return pkt.reg == REG_CMD && pkt.word_count == 1
+	    && get_word(vec + pkt.offset + 4) == CMD_RCRC;
+}
+
+static inline bool is_crc_check(const packet_info_t&pkt)
+{
+      return pkt.type == 1 && pkt.reg == REG_CRC && pkt.word_count == 1;
+}
+
+/*
+ * Check the stream against both models at once. The two CRCs are the
+ * same until the first CRC check, so only fold them separately after
+ * that. Clear the bits of the models (1<<model) that fail.
+ */
+static unsigned check_stream(const uint8_t*vec, const packet_index&index, size_t&count)
+{
+      unsigned pass = (1 << CRC_MODEL_CONTINUE) | (1 << CRC_MODEL_RESET);
+      uint32_t crc_cont = 0;
+      uint32_t crc_reset = 0;
+
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.opcode != 2 || pkt.word_count == 0)
+		  continue;
+
+	    const uint8_t*data = vec + pkt.offset + 4;
+
+	    if (is_crc_check(pkt)) {
+		  uint32_t val = get_word(data);
+		  if (val != crc_cont)
+			pass &= ~(1 << CRC_MODEL_CONTINUE);
+		  if (val != crc_reset)
+			pass &= ~(1 << CRC_MODEL_RESET);
+		  crc_reset = 0;
+		  count += 1;
+		  continue;
+	    }
+
+	    if (index.holds_stream(vec, idx)) {
+		  packet_index sub_index;
+		  sub_index.build(data, 4 * (size_t)pkt.word_count);
+		  pass &= check_stream(data, sub_index, count);
+	    }
+
+	    if (crc_cont == crc_reset) {
+		  crc_cont = config_crc_update(crc_cont, pkt.reg, data, pkt.word_count);
+		  crc_reset = crc_cont;
+	    } else {
+		  crc_cont = config_crc_update(crc_cont, pkt.reg, data, pkt.word_count);
+		  crc_reset = config_crc_update(crc_reset, pkt.reg, data, pkt.word_count);
+	    }
+
+	    if (is_rcrc(vec, pkt)) {
+		  crc_cont = 0;
+		  crc_reset = 0;
+	    }
+      }
+
+      return pass;
+}
+
+crc_model_t check_stream_crcs(const uint8_t*vec, const packet_index&index, size_t&count)
+{
+      metrics_phase phase ("crc check");
+
+      count = 0;
+      unsigned pass = check_stream(vec, index, count);
+      if (count == 0)
+	    return CRC_MODEL_NONE;
+      if (pass & (1 << CRC_MODEL_CONTINUE))
+	    return CRC_MODEL_CONTINUE;
+      if (pass & (1 << CRC_MODEL_RESET))
+	    return CRC_MODEL_RESET;
+      return CRC_MODEL_NONE;
+}
+
+size_t update_stream_crcs(uint8_t*vec, const packet_index&index, crc_model_t model)
+{
+      metrics_phase phase ("crc update");
+
+      if (model == CRC_MODEL_NONE)
+	    return 0;
+
+      size_t count = 0;
+      uint32_t crc = 0;
+
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.opcode != 2 || pkt.word_count == 0)
+		  continue;
+
+	    uint8_t*data = vec + pkt.offset + 4;
+
+	    if (is_crc_check(pkt)) {
+		  put_word(data, crc);
+		  if (model == CRC_MODEL_RESET)
+			crc = 0;
+		  count += 1;
+		  continue;
+	    }
+
+	      // Fix up the stream of another SLR first, because its
+	      // words are also folded into this CRC.
+	    if (index.holds_stream(vec, idx)) {
+		  packet_index sub_index;
+		  sub_index.build(data, 4 * (size_t)pkt.word_count);
+		  count += update_stream_crcs(data, sub_index, model);
+	    }
+
+	    crc = config_crc_update(crc, pkt.reg, data, pkt.word_count);
+
+	    if (is_rcrc(vec, pkt))
+		  crc = 0;
+      }
+
+      return count;
+}
@@ -0,0 +1,73 @@
+#ifndef __stream_crc_H
+#define __stream_crc_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <cstdint>
+# include  <cstddef>
+
+class packet_index;
+
+/*
+ * The configuration logic keeps a CRC of all the register writes in
+ * the stream, and a write to the CRC register checks the value
+ * written against it. The CRC is the CRC-32C polynomial, and each
+ * data word is folded in together with the 5bit address of the
+ * register that it is written to. The Reset CRC command clears it.
+ *
+ * Vendors do not say whether a CRC check also clears the CRC, so both
+ * behaviors are modeled, and the input stream decides which one
+ * applies.
+ */
+enum crc_model_t {
+      CRC_MODEL_NONE = 0,  // The stream CRC checks do not validate
+      CRC_MODEL_CONTINUE,  // CRC checks leave the CRC alone
+      CRC_MODEL_RESET      // CRC checks clear the CRC
+};
+
+/*
+ * Fold nwords big-endian data words, all written to the register,
+ * into the CRC.
+ */
+extern uint32_t config_crc_update(uint32_t crc, uint32_t reg, const uint8_t*words, size_t nwords);
+
+/*
+ * The standard CRC-32C (Castagnoli) of a block of bytes, with the
+ * usual inversions. Pass the result for one block as the crc for the
+ * next to continue the CRC over several blocks.
+ */
+extern uint32_t crc32c(const uint8_t*data, size_t len, uint32_t crc =0);
+
+/*
+ * Check all the CRC checks in the stream (including the streams of
+ * other SLRs) and return the model that they all validate with, or
+ * CRC_MODEL_NONE if there is none. The count is the number of CRC
+ * checks found. If there are none, the result is CRC_MODEL_NONE.
+ */
+extern crc_model_t check_stream_crcs(const uint8_t*vec, const packet_index&index, size_t&count);
+
+/*
+ * Recompute the value of every CRC check in the stream, using the
+ * model returned by check_stream_crcs() before the stream was
+ * edited. Return the number of CRC checks written.
+ */
+extern size_t update_stream_crcs(uint8_t*vec, const packet_index&index, crc_model_t model);
+
+#endif
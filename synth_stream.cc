@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "synth_stream.h"
+# include  "packet_index.h"
+# include  "stream_crc.h"
+# include  <cstring>
+
+using namespace std;
+
+/*
+ * Words of a type-1 write packet header, for the register and word
+ * count, and of the other packets that the stream uses.
+ */
+static inline uint32_t type1_write(uint32_t reg, uint32_t cnt)
+{ return 0x30000000 | (reg << 13) | cnt; }
+
+static const uint32_t NOOP = 0x20000000;
+
+static const uint32_t REG_CRC    = 0x00;
+static const uint32_t REG_FAR    = 0x01;
+static const uint32_t REG_FDRI   = 0x02;
+static const uint32_t REG_CMD    = 0x04;
+static const uint32_t REG_CTL0   = 0x05;
+static const uint32_t REG_MASK   = 0x06;
+static const uint32_t REG_COR0   = 0x09;
+static const uint32_t REG_IDCODE = 0x0c;
+static const uint32_t REG_AXSS   = 0x0d;
+static const uint32_t REG_COR1   = 0x0e;
+static const uint32_t REG_WBSTAR = 0x10;
+static const uint32_t REG_TIMER  = 0x11;
+static const uint32_t REG_CTL1   = 0x18;
+static const uint32_t REG_BSPI   = 0x1f;
+
+static const uint32_t CMD_NULL     = 0x00;
+static const uint32_t CMD_WCFG     = 0x01;
+static const uint32_t CMD_START    = 0x05;
+static const uint32_t CMD_RCRC     = 0x07;
+static const uint32_t CMD_GRESTORE = 0x0a;
+static const uint32_t CMD_DESYNC   = 0x0d;
+
+static void put(vector<uint8_t>&dst, uint32_t word)
+{
+      size_t ptr = dst.size();
+      dst.resize(ptr + 4);
+      put_word(&dst[ptr], word);
+}
+
+static void put_write(vector<uint8_t>&dst, uint32_t reg, uint32_t val)
+{
+      put(dst, type1_write(reg, 1));
+      put(dst, val);
+}
+
+/*
+ * A small, fast random number generator (xorshift64*), so that large
+ * streams are quick to make, and are the same on every system.
+ */
+struct synth_random_t {
+      explicit synth_random_t(uint32_t seed)
+      : state(0x9e3779b97f4a7c15ULL ^ seed) { if (state == 0) state = 1; }
+
+      uint32_t next()
+      {
+	    state ^= state >> 12;
+	    state ^= state << 25;
+	    state ^= state >> 27;
+	    return (state * 0x2545f4914f6cdd1dULL) >> 32;
+      }
+
+      uint64_t state;
+};
+
+/*
+ * Fill the frame data. Of every 7 frames, 3 are blank (0), 1 is a
+ * repeated pattern, and 3 are random. The last frame is the pad frame
+ * that the vendor tools write, and is blank.
+ */
+static void fill_frames(uint8_t*dst, size_t frames, size_t frame_words, uint32_t seed)
+{
+      synth_random_t rand (seed);
+      const size_t frame_bytes = 4 * frame_words;
+
+      for (size_t frame = 0 ; frame < frames ; frame += 1) {
+	    uint8_t*ptr = dst + frame * frame_bytes;
+	    switch (frame % 7) {
+		case 0:
+		case 1:
+		case 2:
+		  memset(ptr, 0, frame_bytes);
+		  break;
+		case 3:
+		  for (size_t idx = 0 ; idx < frame_words ; idx += 1)
+			put_word(ptr + 4*idx, 0x12345678);
+		  break;
+		default:
+		  for (size_t idx = 0 ; idx < frame_words ; idx += 1)
+			put_word(ptr + 4*idx, rand.next());
+		  break;
+	    }
+      }
+
+      memset(dst + frames * frame_bytes, 0, frame_bytes);
+}
+
+void make_synth_stream(vector<uint8_t>&dst, const synth_options_t&opt)
+{
+      size_t frame_words;
+      uint32_t idcode;
+      switch (opt.family) {
+	  case SYNTH_ULTRASCALE:
+	    frame_words = 123;
+	    idcode = 0x03822093; // KU040
+	    break;
+	  case SYNTH_ULTRASCALE_PLUS:
+	    frame_words = 93;
+	    idcode = 0x04b31093; // VU9P
+	    break;
+	  default:
+	    frame_words = 101;
+	    idcode = 0x03651093; // 7K325T
+	    break;
+      }
+
+      const size_t frames = (opt.fdri_bytes + 4*frame_words - 1) / (4*frame_words);
+      const size_t fdri_words = (frames + 1) * frame_words;
+
+      dst.clear();
+      dst.reserve(4*fdri_words + 4096);
+
+	/* The pad, bus width detect and sync word. */
+      dst.resize(32, 0xff);
+      put(dst, 0x000000bb);
+      put(dst, 0x11220044);
+      put(dst, 0xffffffff);
+      put(dst, 0xffffffff);
+      put(dst, 0xaa995566);
+      put(dst, NOOP);
+
+	/* The header register writes. */
+      put_write(dst, REG_CMD, CMD_RCRC);
+      put(dst, NOOP);
+      put(dst, NOOP);
+      put_write(dst, REG_TIMER, 0);
+      if (opt.write_wbstar)
+	    put_write(dst, REG_WBSTAR, opt.wbstar);
+      put_write(dst, REG_CMD, CMD_NULL);
+      put(dst, NOOP);
+      put_write(dst, REG_CMD, CMD_RCRC);
+      put(dst, NOOP);
+      put(dst, NOOP);
+      put_write(dst, REG_CTL1, 0);
+      put_write(dst, REG_COR0, opt.cor0);
+      put_write(dst, REG_COR1, opt.cor1);
+      put_write(dst, REG_IDCODE, idcode);
+      if (opt.write_axss)
+	    put_write(dst, REG_AXSS, opt.axss);
+      if (opt.write_bspi)
+	    put_write(dst, REG_BSPI, opt.bspi);
+      put_write(dst, REG_MASK, 0x00000401);
+      put_write(dst, REG_CTL0, 0x00000401);
+      put_write(dst, REG_CMD, CMD_WCFG);
+      put(dst, NOOP);
+      put_write(dst, REG_FAR, 0);
+
+	/* The frame data, as a type-2 write to FDRI. */
+      put(dst, type1_write(REG_FDRI, 0));
+      put(dst, 0x50000000 | fdri_words);
+      size_t ptr = dst.size();
+      dst.resize(ptr + 4*fdri_words);
+      fill_frames(&dst[ptr], frames, frame_words, opt.seed);
+
+	/* The CRC checks are written as 0, and fixed up below. */
+      if (opt.crc != SYNTH_CRC_NONE)
+	    put_write(dst, REG_CRC, 0);
+      put_write(dst, REG_CMD, CMD_GRESTORE);
+      put(dst, NOOP);
+      put_write(dst, REG_CMD, CMD_START);
+      put_write(dst, REG_FAR, 0x03be0000);
+      if (opt.crc != SYNTH_CRC_NONE)
+	    put_write(dst, REG_CRC, 0);
+      put_write(dst, REG_CMD, CMD_DESYNC);
+      for (size_t idx = 0 ; idx < 100 ; idx += 1)
+	    put(dst, NOOP);
+
+      if (opt.crc == SYNTH_CRC_VALID) {
+	    packet_index index;
+	    index.build(dst);
+	    update_stream_crcs(&dst[0], index, CRC_MODEL_CONTINUE);
+
+      } else if (opt.crc == SYNTH_CRC_BAD) {
+	    packet_index index;
+	    index.build(dst);
+	    for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+		  if (index[idx].reg == REG_CRC && index[idx].word_count == 1)
+			put_word(&dst[index[idx].offset+4], 0xdeadbeef);
+	    }
+      }
+}
+
+static void put_field(vector<uint8_t>&dst, char key, const char*text)
+{
+      size_t len = strlen(text) + 1;
+      dst.push_back(key);
+      dst.push_back(len >> 8);
+      dst.push_back(len);
+      dst.insert(dst.end(), text, text+len);
+}
+
+void make_synth_bit_file(vector<uint8_t>&dst, const synth_options_t&opt)
+{
+      vector<uint8_t> stream;
+      make_synth_stream(stream, opt);
+
+	/* The header ends at the first 0xff, so the stream length may
+	   not have any 0xff bytes in it. */
+      for (;;) {
+	    size_t len = stream.size();
+	    if ((len & 0xff) != 0xff && ((len>>8) & 0xff) != 0xff
+		&& ((len>>16) & 0xff) != 0xff && ((len>>24) & 0xff) != 0xff)
+		  break;
+	    put(stream, NOOP);
+      }
+
+      const char*part;
+      switch (opt.family) {
+	  case SYNTH_ULTRASCALE:
+	    part = "xcku040-ffva1156-2-e";
+	    break;
+	  case SYNTH_ULTRASCALE_PLUS:
+	    part = "xcvu9p-flga2104-2-i";
+	    break;
+	  default:
+	    part = "7k325tffg900";
+	    break;
+      }
+
+      static const uint8_t magic[13] = { 0x00, 0x09, 0x0f, 0xf0, 0x0f, 0xf0, 0x0f, 0xf0,
+					 0x0f, 0xf0, 0x00, 0x00, 0x01 };
+      dst.assign(magic, magic+13);
+      put_field(dst, 'a', "synth;UserID=0X00000000");
+      put_field(dst, 'b', part);
+      put_field(dst, 'c', "2026/01/01");
+      put_field(dst, 'd', "00:00:00");
+      dst.push_back('e');
+      put(dst, stream.size());
+      dst.insert(dst.end(), stream.begin(), stream.end());
+}
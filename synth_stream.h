@@ -0,0 +1,86 @@
+#ifndef __synth_stream_H
+#define __synth_stream_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <vector>
+# include  <cstdint>
+# include  <cstddef>
+
+/*
+ * Make synthetic configuration streams, for testing and benchmarks.
+ * The streams are laid out like the streams that the vendor tools
+ * write: the bus width detect pattern, the sync word, header register
+ * writes, the frame data as a type-2 FDRI write, CRC checks, and the
+ * startup commands. The frame data is a mix of blank frames, frames
+ * of a repeated pattern, and random frames, so that it is neither all
+ * blank nor all noise. The same options always make the same stream.
+ */
+
+enum synth_family_t {
+      SYNTH_7SERIES = 0,
+      SYNTH_ULTRASCALE,
+      SYNTH_ULTRASCALE_PLUS
+};
+
+enum synth_crc_t {
+      SYNTH_CRC_NONE = 0, // No CRC checks
+      SYNTH_CRC_VALID,    // CRC checks with the right values
+      SYNTH_CRC_BAD       // CRC checks that do not validate
+};
+
+struct synth_options_t {
+      synth_options_t()
+      : family(SYNTH_7SERIES), fdri_bytes(4*1024*1024), seed(1), crc(SYNTH_CRC_VALID),
+	axss(0x53494c56), bspi(0x0b), cor0(0x066055dc), cor1(0), wbstar(0),
+	write_axss(true), write_bspi(true), write_wbstar(true) { }
+
+	// The family sets the frame size and the IDCODE.
+      synth_family_t family;
+	// Size of the frame data. It is rounded up to whole frames.
+      size_t fdri_bytes;
+	// Seed for the random frames.
+      uint32_t seed;
+      synth_crc_t crc;
+	// Values of the header register writes. The AXSS, BSPI and
+	// WBSTAR writes can be left out.
+      uint32_t axss;
+      uint32_t bspi;
+      uint32_t cor0;
+      uint32_t cor1;
+      uint32_t wbstar;
+      bool write_axss;
+      bool write_bspi;
+      bool write_wbstar;
+};
+
+/*
+ * Make the stream, starting with the 0xff pad in front of the bus
+ * width detect pattern. This is what a bit_file_view holds.
+ */
+extern void make_synth_stream(std::vector<uint8_t>&dst, const synth_options_t&opt);
+
+/*
+ * Make the contents of a .bit file, with the header, that holds the
+ * stream.
+ */
+extern void make_synth_bit_file(std::vector<uint8_t>&dst, const synth_options_t&opt);
+
+#endif
@@ -19,67 +19,64 @@
  */
 
 # include  "test_image_compat.h"
-# include  "extract_register_write.h"
+# include  "packet_index.h"
 # include  <cstdio>
 
 using namespace std;
 
-bool test_basic_image_compatibility(const std::vector<uint8_t>&vec)
+/*
+ * The basic test is that the stream has a sync word, and that it does
+ * not have an IPROG command anywhere in it.
+ */
+bool test_basic_image_compatibility(const packet_index&index, const uint8_t*vec, FILE*err)
 {
-      const uint8_t magic_sync[4] = {0xaa, 0x99, 0x55, 0x66};
-      size_t match = 0;
-      size_t ptr = 0;
-
-      while (ptr < 0x100 && match < 4) {
-	    if (vec[ptr+match] == magic_sync[match]) {
-		  match += 1;
-	    } else {
-		  ptr += 1;
-		  match = 0;
-	    }
-      }
-
-      if (match < 4) {
-	    fprintf(stderr, "Unable to find sync word in bit file.\n");
+      if (! index.valid()) {
+	    fprintf(err, "Unable to find sync word in bit file.\n");
 	    return false;
       }
 
-      ptr += match;
+      for (size_t idx = 0 ; idx < index.size() ; idx += 1) {
+	    const packet_info_t&pkt = index[idx];
+	    if (pkt.type != 1 || pkt.opcode != 2 || pkt.reg != 0x04)
+		  continue;
+	    if (pkt.word_count < 1)
+		  continue;
+	    if (get_word(vec+pkt.offset+4) != 0x0f)
+		  continue;
 
-      const uint8_t magic_iprog[8] = {0x30, 0x00, 0x80, 0x01, 0x00, 0x00, 0x00, 0x0f};
-
-      match = 0;
-      while (ptr < 0x100 && match < 8) {
-	    if (vec[ptr+match] == magic_iprog[match]) {
-		  match += 1;
-	    } else {
-		  ptr += 1;
-		  match = 0;
-	    }
-      }
-
-      if (match < 8) {
-	    return true;
+	    fprintf(err, "Found IPROG command in bit stream.\n");
+	    return false;
       }
 
-      fprintf(stderr, "Found IPROG command in bit stream.\n");
-
-      return false;
+      return true;
 }
 
-bool test_silver_image_compatible(const std::vector<uint8_t>&vec)
+bool test_silver_image_compatible(const packet_index&index, const uint8_t*vec, FILE*err)
 {
-      if (!test_basic_image_compatibility(vec)) {
-	    fprintf(stderr, "Silver image fails basic tests.\n");
+      if (!test_basic_image_compatibility(index, vec, err)) {
+	    fprintf(err, "Silver image fails basic tests.\n");
 	    return false;
       }
 
-
-      uint32_t AXSS = extract_register_write(vec, 0x0d);
+      uint32_t AXSS = index.extract_register_write(vec, 0x0d);
       if (AXSS != 0x53494c56 && ((AXSS&0xff000000) != 0x53000000)) {
-	    fprintf(stderr, "Found AXSS=0x%08x\n (s/b 0x53494c56)\n", AXSS);
+	    fprintf(err, "Found AXSS=0x%08x\n (s/b 0x53494c56)\n", AXSS);
 	    return false;
       }
 
       return true;
 }
+
+bool test_basic_image_compatibility(const uint8_t*vec, size_t len, FILE*err)
+{
+      packet_index index;
+      index.build(vec, len);
+      return test_basic_image_compatibility(index, vec, err);
+}
+
+bool test_silver_image_compatible(const uint8_t*vec, size_t len, FILE*err)
+{
+      packet_index index;
+      index.build(vec, len);
+      return test_silver_image_compatible(index, vec, err);
+}
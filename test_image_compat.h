@@ -21,9 +21,27 @@
  */
 
 # include  <vector>
+# include  <cstdio>
 # include  <cstdint>
+# include  <cstddef>
 
-extern bool test_basic_image_compatibility(const std::vector<uint8_t>&vec);
-extern bool test_silver_image_compatible(const std::vector<uint8_t>&vec);
+class packet_index;
+
+	// The reason a stream fails is printed to err.
+extern bool test_basic_image_compatibility(const uint8_t*vec, size_t len, FILE*err =stderr);
+extern bool test_silver_image_compatible(const uint8_t*vec, size_t len, FILE*err =stderr);
+
+	// Variants that use a packet_index that is already built for
+	// the stream.
+extern bool test_basic_image_compatibility(const packet_index&index, const uint8_t*vec,
+					   FILE*err =stderr);
+extern bool test_silver_image_compatible(const packet_index&index, const uint8_t*vec,
+					 FILE*err =stderr);
+
+inline bool test_basic_image_compatibility(const std::vector<uint8_t>&vec)
+{ return test_basic_image_compatibility(&vec[0], vec.size()); }
+
+inline bool test_silver_image_compatible(const std::vector<uint8_t>&vec)
+{ return test_silver_image_compatible(&vec[0], vec.size()); }
 
 #endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  "work_pool.h"
+# include  <thread>
+
+using namespace std;
+
+work_pool::work_pool(unsigned threads)
+: nthreads_(threads)
+{
+      if (nthreads_ == 0)
+	    nthreads_ = thread::hardware_concurrency();
+      if (nthreads_ == 0)
+	    nthreads_ = 1;
+
+      for (unsigned idx = 0 ; idx < nthreads_ ; idx += 1)
+	    queue_.push_back(new queue_t);
+}
+
+work_pool::~work_pool()
+{
+      for (size_t idx = 0 ; idx < queue_.size() ; idx += 1)
+	    delete queue_[idx];
+}
+
+/*
+ * Take the next task from the front of our own queue, or else steal
+ * from the back of the queue of another thread. Tasks are never added
+ * while the pool runs, so when all the queues are empty, we are done.
+ */
+bool work_pool::next_task_(unsigned self, size_t&idx)
+{
+      {
+	    queue_t&mine = *queue_[self];
+	    lock_guard<mutex> guard (mine.lock);
+	    if (! mine.tasks.empty()) {
+		  idx = mine.tasks.front();
+		  mine.tasks.pop_front();
+		  return true;
+	    }
+      }
+
+      for (unsigned off = 1 ; off < nthreads_ ; off += 1) {
+	    queue_t&victim = *queue_[(self+off) % nthreads_];
+	    lock_guard<mutex> guard (victim.lock);
+	    if (! victim.tasks.empty()) {
+		  idx = victim.tasks.back();
+		  victim.tasks.pop_back();
+		  return true;
+	    }
+      }
+
+      return false;
+}
+
+void work_pool::worker_(work_pool*pool, unsigned self, void (*fun)(size_t, void*), void*arg)
+{
+      size_t idx;
+      while (pool->next_task_(self, idx))
+	    fun(idx, arg);
+}
+
+void work_pool::run(size_t ntasks, void (*fun)(size_t idx, void*arg), void*arg)
+{
+	/* Deal the tasks out round robin, so that each thread starts
+	   with a share of the work. */
+      for (size_t idx = 0 ; idx < ntasks ; idx += 1)
+	    queue_[idx % nthreads_]->tasks.push_back(idx);
+
+      unsigned nthreads = nthreads_;
+      if (nthreads > ntasks)
+	    nthreads = ntasks > 0? ntasks : 1;
+
+      vector<thread> pool;
+      for (unsigned idx = 1 ; idx < nthreads ; idx += 1)
+	    pool.push_back(thread(worker_, this, idx, fun, arg));
+      worker_(this, 0, fun, arg);
+      for (size_t idx = 0 ; idx < pool.size() ; idx += 1)
+	    pool[idx].join();
+}
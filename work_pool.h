@@ -0,0 +1,70 @@
+#ifndef __work_pool_H
+#define __work_pool_H
+/*
+ * Copyright (c) 2026 Picture Elements, Inc.
+ *    Stephen Williams (steve@icarus.com)
+ *
+ *    This source code is free software; you can redistribute it
+ *    and/or modify it in source code form under the terms of the GNU
+ *    General Public License as published by the Free Software
+ *    Foundation; either version 2 of the License, or (at your option)
+ *    any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+# include  <deque>
+# include  <vector>
+# include  <mutex>
+# include  <cstddef>
+
+/*
+ * A work_pool runs a batch of tasks, numbered 0 to ntasks-1, on a
+ * pool of threads. The tasks are dealt out to a deque for each thread
+ * up front. A thread takes its own tasks from the front of its deque,
+ * and when that is empty it steals from the back of the deque of
+ * another thread, so that threads that draw short tasks help the
+ * others finish.
+ */
+class work_pool {
+
+    public:
+	// Make a pool with this many threads. 0 means one thread for
+	// each processor.
+      explicit work_pool(unsigned threads =0);
+      ~work_pool();
+
+      unsigned threads() const { return nthreads_; }
+
+	// Run fun(idx, arg) for each idx from 0 to ntasks-1, and wait
+	// for all the tasks to finish. The calling thread is one of
+	// the threads of the pool.
+      void run(size_t ntasks, void (*fun)(size_t idx, void*arg), void*arg);
+
+    private:
+      struct queue_t {
+	    std::mutex lock;
+	    std::deque<size_t> tasks;
+      };
+
+      bool next_task_(unsigned self, size_t&idx);
+      static void worker_(work_pool*pool, unsigned self,
+			  void (*fun)(size_t, void*), void*arg);
+
+    private:
+      unsigned nthreads_;
+      std::vector<queue_t*> queue_;
+
+    private: // not implemented
+      work_pool(const work_pool&);
+      work_pool& operator= (const work_pool&);
+};
+
+#endif
@@ -19,48 +19,630 @@
  */
 
 # include  "write_to_mcs_file.h"
+# include  "metrics.h"
+# include  <algorithm>
+# include  <chrono>
+# include  <condition_variable>
+# include  <mutex>
+# include  <thread>
+# include  <cstdlib>
+# include  <cstring>
+# include  <cassert>
+# include  <cerrno>
+# ifndef _WIN32
+# include  <sys/uio.h>
+# endif
 
+# if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define HAVE_X86_SIMD 1
+#  include  <immintrin.h>
+# endif
+
+using namespace std;
+
+/*
+ * Longest possible record is 255 data bytes, encoded as hex, plus the
+ * colon, count, address, type, checksum and newline.
+ */
+static const size_t MAX_RECORD_CHARS = 1 + 2 + 4 + 2 + 2*255 + 2 + 1;
+
+/*
+ * Table that maps a byte to its two hex digits.
+ */
+struct hex_table_t {
+      hex_table_t()
+      {
+	    static const char digits[] = "0123456789ABCDEF";
+	    for (int idx = 0 ; idx < 256 ; idx += 1) {
+		  text[idx][0] = digits[idx >> 4];
+		  text[idx][1] = digits[idx & 15];
+	    }
+      }
+      char text[256][2];
+};
+static const hex_table_t hex_table;
+
+static inline char* put_hex8(char*out, unsigned val)
+{
+      memcpy(out, hex_table.text[val & 0xff], 2);
+      return out + 2;
+}
+
+/*
+ * Encode the bytes as hex into the output, and return the sum of the
+ * bytes. These are the scalar versions, and also handle the tails
+ * that the SIMD versions leave behind.
+ */
+static unsigned hex_encode_scalar(char*out, const uint8_t*src, size_t cnt)
+{
+      unsigned sum = 0;
+      for (size_t idx = 0 ; idx < cnt ; idx += 1) {
+	    memcpy(out + 2*idx, hex_table.text[src[idx]], 2);
+	    sum += src[idx];
+      }
+      return sum;
+}
+
+# ifdef HAVE_X86_SIMD
 /*
- * Write the entire assembled vector into the output file as an .mcs
- * stream.
+ * SSSE3 version: 16 bytes at a time. Split the bytes into nibbles,
+ * look up the digits with pshufb, and interleave the high and low
+ * digits back together. psadbw gives the byte sum. The block encoder
+ * is inlined into the AVX2 version as well, for the 16 byte blocks of
+ * its tail, where it is compiled to VEX instructions.
  */
-void write_to_mcs_file(FILE*fd, const std::vector<uint8_t>&vec, size_t start_address)
+__attribute__((target("ssse3"), always_inline))
+static inline __m128i hex_encode16_ssse3(char*out, const uint8_t*src)
 {
-      size_t address = start_address;
+      const __m128i digits = _mm_setr_epi8('0','1','2','3','4','5','6','7',
+					   '8','9','A','B','C','D','E','F');
+      const __m128i mask = _mm_set1_epi8(0x0f);
 
-      while (address < vec.size()) {
-	    int sum = 2 + 4 + ((address>>16)&0xff) + ((address>>24)&0xff);
+      __m128i val = _mm_loadu_si128((const __m128i*)src);
+      __m128i hi = _mm_and_si128(_mm_srli_epi16(val, 4), mask);
+      __m128i lo = _mm_and_si128(val, mask);
+      hi = _mm_shuffle_epi8(digits, hi);
+      lo = _mm_shuffle_epi8(digits, lo);
+      _mm_storeu_si128((__m128i*)(out+ 0), _mm_unpacklo_epi8(hi, lo));
+      _mm_storeu_si128((__m128i*)(out+16), _mm_unpackhi_epi8(hi, lo));
+      return _mm_sad_epu8(val, _mm_setzero_si128());
+}
 
-	      /* Write an extended address record. */
-	    fprintf(fd, ":02000004%04zX%02X\n", address>>16, 0xff & -sum);
+__attribute__((target("ssse3")))
+static unsigned hex_encode_ssse3(char*out, const uint8_t*src, size_t cnt)
+{
+      __m128i acc = _mm_setzero_si128();
 
-	      /* Now write up to 64K worth of bytes, 16 at a time. */
-	    size_t addr2 = 0;
-	    while ((addr2 < 0x10000) && ((address+addr2) < vec.size())) {
-		  size_t trans = 16;
-		  int sum = 0;
+      size_t idx = 0;
+      for ( ; idx+16 <= cnt ; idx += 16)
+	    acc = _mm_add_epi64(acc, hex_encode16_ssse3(out+2*idx, src+idx));
 
-		  if (address+addr2+trans > vec.size())
-			trans = vec.size() - address - addr2;
+      unsigned sum = _mm_cvtsi128_si32(acc) + _mm_extract_epi16(acc, 4);
+      return sum + hex_encode_scalar(out+2*idx, src+idx, cnt-idx);
+}
 
-		  fprintf(fd, ":%02zX%04zX00", trans, addr2);
-		  sum += trans;
-		  sum += (addr2&0xff) + ((addr2>>8) & 0xff);
+/*
+ * AVX2 version: 32 bytes at a time. The unpack instructions work
+ * within 128bit lanes, so the lanes need to be put back in order
+ * before they are stored. The tail is done here too, and not by
+ * calling the SSSE3 version, to avoid the penalty for mixing legacy
+ * SSE and AVX instructions.
+ */
+__attribute__((target("avx2")))
+static unsigned hex_encode_avx2(char*out, const uint8_t*src, size_t cnt)
+{
+      const __m256i digits = _mm256_setr_epi8('0','1','2','3','4','5','6','7',
+					      '8','9','A','B','C','D','E','F',
+					      '0','1','2','3','4','5','6','7',
+					      '8','9','A','B','C','D','E','F');
+      const __m256i mask = _mm256_set1_epi8(0x0f);
+      __m256i acc = _mm256_setzero_si256();
+
+      size_t idx = 0;
+      for ( ; idx+32 <= cnt ; idx += 32) {
+	    __m256i val = _mm256_loadu_si256((const __m256i*)(src+idx));
+	    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(val, 4), mask);
+	    __m256i lo = _mm256_and_si256(val, mask);
+	    hi = _mm256_shuffle_epi8(digits, hi);
+	    lo = _mm256_shuffle_epi8(digits, lo);
+	    __m256i txt0 = _mm256_unpacklo_epi8(hi, lo);
+	    __m256i txt1 = _mm256_unpackhi_epi8(hi, lo);
+	    _mm256_storeu_si256((__m256i*)(out+2*idx+ 0), _mm256_permute2x128_si256(txt0, txt1, 0x20));
+	    _mm256_storeu_si256((__m256i*)(out+2*idx+32), _mm256_permute2x128_si256(txt0, txt1, 0x31));
+	    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(val, _mm256_setzero_si256()));
+      }
+
+      __m128i acc2 = _mm_add_epi64(_mm256_castsi256_si128(acc),
+				   _mm256_extracti128_si256(acc, 1));
+      for ( ; idx+16 <= cnt ; idx += 16)
+	    acc2 = _mm_add_epi64(acc2, hex_encode16_ssse3(out+2*idx, src+idx));
+
+      unsigned sum = _mm_cvtsi128_si32(acc2) + _mm_extract_epi16(acc2, 4);
+      return sum + hex_encode_scalar(out+2*idx, src+idx, cnt-idx);
+}
+# endif
+
+typedef unsigned (*hex_encode_fun_t)(char*out, const uint8_t*src, size_t cnt);
+
+/*
+ * Pick the best encoder for the processor that we are running on.
+ */
+static hex_encode_fun_t choose_hex_encode(void)
+{
+# ifdef HAVE_X86_SIMD
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2"))
+	    return hex_encode_avx2;
+      if (__builtin_cpu_supports("ssse3"))
+	    return hex_encode_ssse3;
+# endif
+      return hex_encode_scalar;
+}
+static const hex_encode_fun_t hex_encode = choose_hex_encode();
+
+/*
+ * Return true if all the bytes are 0xff (erased flash).
+ */
+static bool is_blank(const uint8_t*src, size_t cnt)
+{
+      size_t idx = 0;
+      for ( ; idx+8 <= cnt ; idx += 8) {
+	    uint64_t word;
+	    memcpy(&word, src+idx, 8);
+	    if (word != UINT64_C(0xffffffffffffffff))
+		  return false;
+      }
+      for ( ; idx < cnt ; idx += 1) {
+	    if (src[idx] != 0xff)
+		  return false;
+      }
+      return true;
+}
+
+static char* put_extended_address(char*out, size_t address)
+{
+      int sum = 2 + 4 + ((address>>16)&0xff) + ((address>>24)&0xff);
+      memcpy(out, ":02000004", 9);
+      out = put_hex8(out+9, address>>24);
+      out = put_hex8(out, address>>16);
+      out = put_hex8(out, -sum);
+      *out++ = '\n';
+      return out;
+}
 
-		  for (size_t idx = 0 ; idx < trans ; idx += 1) {
-			fprintf(fd, "%02X", vec[address+addr2+idx]);
-			sum += vec[address+addr2+idx];
+static char* put_data_record(char*out, size_t addr2, const uint8_t*data, size_t trans)
+{
+      unsigned sum = trans + (addr2&0xff) + ((addr2>>8) & 0xff);
+
+      *out++ = ':';
+      out = put_hex8(out, trans);
+      out = put_hex8(out, addr2>>8);
+      out = put_hex8(out, addr2);
+      out = put_hex8(out, 0x00);
+      sum += hex_encode(out, data, trans);
+      out += 2*trans;
+      out = put_hex8(out, -sum);
+      *out++ = '\n';
+      return out;
+}
+
+/*
+ * Render one segment of the image into the buffer. A segment is the
+ * extended address record and up to 64K worth of bytes, a record at a
+ * time. Each segment has its own addresses and checksums, so segments
+ * can be rendered independently of each other.
+ *
+ * The extended address record for a segment is only written when the
+ * first record of the segment is written, so segments that are blank
+ * (in sparse mode) or not selected leave nothing at all in the buffer.
+ *
+ * If the options call for a swizzle, the segment is converted into the
+ * scratch buffer first, and rendered from there.
+ */
+static void encode_segment(vector<char>&buf, vector<uint8_t>&scratch,
+			   const vector<uint8_t>&vec, size_t address,
+			   const mcs_options_t&opt)
+{
+      const size_t record_length = opt.record_length;
+      const size_t seg_size = min(vec.size() - address, (size_t)0x10000);
+      const size_t nrecords = (seg_size + record_length - 1) / record_length;
+      metrics_phase phase ("mcs segment", seg_size);
+
+      const uint8_t*src = &vec[address];
+      if (opt.swizzle != SWIZZLE_NONE) {
+	    metrics_phase swz_phase ("swizzle", seg_size);
+	    scratch.resize(seg_size);
+	    bit_swizzle(&scratch[0], src, seg_size, opt.swizzle);
+	    src = &scratch[0];
+      }
+
+      buf.resize(MAX_RECORD_CHARS + nrecords * (12 + 2*record_length));
+      char*out = &buf[0];
+      bool need_extended_address = true;
+
+      size_t addr2 = 0;
+      while (addr2 < seg_size) {
+	    size_t trans = record_length;
+
+	    if (addr2+trans > seg_size)
+		  trans = seg_size - addr2;
+
+	      /* Skip to the end of sectors that are not selected. */
+	    if (! opt.sector_select.empty()) {
+		  size_t sec = (address+addr2) / opt.sector_size;
+		  if (sec >= opt.sector_select.size() || ! opt.sector_select[sec]) {
+			addr2 = (sec+1) * opt.sector_size - address;
+			continue;
 		  }
+	    }
 
-		  fprintf(fd, "%02X\n", 0xff & -sum);
+	    const uint8_t*data = src + addr2;
+	    if (opt.sparse && is_blank(data, trans)) {
 		  addr2 += trans;
+		  continue;
 	    }
 
-	    address += addr2;
+	      /* Write an extended address record. */
+	    if (need_extended_address) {
+		  out = put_extended_address(out, address);
+		  need_extended_address = false;
+	    }
+
+	    out = put_data_record(out, addr2, data, trans);
+	    addr2 += trans;
       }
 
-      fprintf(stdout, "MCS target device size >= 0x%08zx\n", address);
+      buf.resize(out - &buf[0]);
+}
+
+mcs_sink::~mcs_sink()
+{
+}
+
+void mcs_sink::write_batch(const char*const*text, const size_t*len, size_t count)
+{
+      for (size_t idx = 0 ; idx < count ; idx += 1)
+	    write(text[idx], len[idx]);
+}
+
+mcs_buffer_sink::mcs_buffer_sink(vector<char>&dst)
+: dst_(dst)
+{
+}
+
+mcs_buffer_sink::~mcs_buffer_sink()
+{
+}
+
+void mcs_buffer_sink::write(const char*text, size_t len)
+{
+      dst_.insert(dst_.end(), text, text+len);
+}
+
+mcs_span_sink::mcs_span_sink(char*buf, size_t size)
+: buf_(buf), size_(size), length_(0)
+{
+}
+
+mcs_span_sink::~mcs_span_sink()
+{
+}
+
+void mcs_span_sink::write(const char*text, size_t len)
+{
+      if (length_ < size_)
+	    memcpy(buf_+length_, text, min(len, size_-length_));
+      length_ += len;
+}
+
+mcs_file_sink::mcs_file_sink(FILE*fd)
+: fd_(fd)
+{
+	// The batches bypass the stdio buffer, so anything already
+	// in the buffer must go first.
+      fflush(fd_);
+}
+
+mcs_file_sink::~mcs_file_sink()
+{
+}
+
+void mcs_file_sink::write(const char*text, size_t len)
+{
+      write_batch(&text, &len, 1);
+}
+
+/*
+ * On systems that have it, writev() writes a batch of segments in one
+ * system call without first gathering them into yet another buffer.
+ */
+void mcs_file_sink::write_batch(const char*const*text, const size_t*len, size_t count)
+{
+# ifndef _WIN32
+      struct iovec iov[64];
+      size_t idx = 0;
+      while (idx < count) {
+	    int cnt = 0;
+	    for ( ; idx < count && cnt < 64 ; idx += 1) {
+		  iov[cnt].iov_base = (char*)text[idx];
+		  iov[cnt].iov_len  = len[idx];
+		  cnt += 1;
+	    }
+
+	    struct iovec*cur = iov;
+	    while (cnt > 0) {
+		  ssize_t rc = writev(fileno(fd_), cur, cnt);
+		  if (rc < 0) {
+			if (errno == EINTR)
+			      continue;
+			perror("write mcs file");
+			return;
+		  }
+		    // Skip what was written, allowing for a short
+		    // write that stops in the middle of a buffer.
+		  while (cnt > 0 && (size_t)rc >= cur->iov_len) {
+			rc -= cur->iov_len;
+			cur += 1;
+			cnt -= 1;
+		  }
+		  if (cnt > 0) {
+			cur->iov_base = (char*)cur->iov_base + rc;
+			cur->iov_len -= rc;
+		  }
+	    }
+      }
+# else
+      for (size_t idx = 0 ; idx < count ; idx += 1)
+	    fwrite(text[idx], 1, len[idx], fd_);
+# endif
+}
+
+/*
+ * Pass a list of rendered segments to the sink, in order, leaving out
+ * the segments that rendered to nothing.
+ */
+static void write_segments(mcs_sink&out, vector<char>*const*seg, size_t count)
+{
+      const char*text[64];
+      size_t len[64];
+      size_t idx = 0;
+      while (idx < count) {
+	    size_t cnt = 0;
+	    for ( ; idx < count && cnt < 64 ; idx += 1) {
+		  if (seg[idx]->empty())
+			continue;
+		  text[cnt] = &(*seg[idx])[0];
+		  len[cnt]  = seg[idx]->size();
+		  cnt += 1;
+	    }
+	    if (cnt > 0)
+		  out.write_batch(text, len, cnt);
+      }
+}
+
+/*
+ * State shared between the segment encoder threads and the thread
+ * that writes the segments. The segments are rendered into a ring of
+ * slots, and a worker may not run more than a ring's worth of
+ * segments ahead of the writer.
+ */
+struct segment_ring_t {
+      mutex lock;
+      condition_variable cond;
+      size_t next_segment;
+      size_t written;
+      vector< vector<char> > slot;
+      vector<bool> ready;
+};
+
+static void encode_segment_worker(segment_ring_t*ring, const vector<uint8_t>*vec,
+				  size_t start_address, size_t nsegments,
+				  const mcs_options_t*opt)
+{
+      const size_t window = ring->slot.size();
+      vector<uint8_t> scratch;
+      unique_lock<mutex> lock (ring->lock);
+
+      for (;;) {
+	    while (ring->next_segment < nsegments
+		   && ring->next_segment >= ring->written + window)
+		  ring->cond.wait(lock);
+
+	    if (ring->next_segment >= nsegments)
+		  break;
+
+	    size_t seg = ring->next_segment++;
+	    lock.unlock();
+
+	    encode_segment(ring->slot[seg%window], scratch, *vec, start_address + seg*0x10000, *opt);
+
+	    lock.lock();
+	    ring->ready[seg%window] = true;
+	    ring->cond.notify_all();
+      }
+}
+
+/*
+ * Encode the entire assembled vector as an .mcs stream. The image is
+ * cut into 64K segments, which are rendered on a pool of threads and
+ * passed to the sink in address order.
+ */
+void write_to_mcs(mcs_sink&out, const std::vector<uint8_t>&vec, size_t start_address,
+		  const mcs_options_t&opt)
+{
+      metrics_phase phase ("mcs encode", vec.size());
+
+      assert(opt.record_length > 0 && opt.record_length <= 255);
+      assert(opt.sector_select.empty() || opt.sector_size % opt.record_length == 0);
+	// Pairs of bytes are swapped relative to the start of the
+	// image, so segments must start on a pair, and the image must
+	// be whole pairs. Padding an odd byte here would lose its
+	// partner in the swap.
+      assert(opt.swizzle != SWIZZLE_X16 || start_address % 2 == 0);
+      assert(opt.swizzle != SWIZZLE_X16 || vec.size() % 2 == 0);
+
+      const chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+
+      const size_t nsegments = start_address < vec.size()
+	    ? (vec.size() - start_address + 0xffff) / 0x10000
+	    : 0;
+
+      unsigned nthreads = opt.threads;
+      if (nthreads == 0)
+	    nthreads = thread::hardware_concurrency();
+      if (nthreads == 0)
+	    nthreads = 1;
+      if (nthreads > nsegments)
+	    nthreads = nsegments > 0? nsegments : 1;
+
+      if (nthreads == 1) {
+	    vector<char> buf;
+	    vector<uint8_t> scratch;
+	    vector<char>*segp = &buf;
+	    for (size_t seg = 0 ; seg < nsegments ; seg += 1) {
+		  encode_segment(buf, scratch, vec, start_address + seg*0x10000, opt);
+		  write_segments(out, &segp, 1);
+	    }
+
+      } else {
+	    segment_ring_t ring;
+	    ring.next_segment = 0;
+	    ring.written = 0;
+	    ring.slot.resize(4 * nthreads);
+	    ring.ready.resize(4 * nthreads, false);
+	    const size_t window = ring.slot.size();
+
+	    vector<thread> pool;
+	    for (unsigned idx = 0 ; idx < nthreads ; idx += 1)
+		  pool.push_back(thread(encode_segment_worker, &ring, &vec,
+					start_address, nsegments, &opt));
+
+	    vector< vector<char>* > batch (window);
+	    size_t seg = 0;
+	    while (seg < nsegments) {
+		  unique_lock<mutex> lock (ring.lock);
+		  while (! ring.ready[seg%window])
+			ring.cond.wait(lock);
+
+		    // Collect all the segments that are ready, in
+		    // order, and write them in one go.
+		  size_t end = seg;
+		  while (end < nsegments && end < seg+window && ring.ready[end%window]) {
+			batch[end-seg] = &ring.slot[end%window];
+			end += 1;
+		  }
+		  lock.unlock();
+
+		  write_segments(out, &batch[0], end-seg);
+
+		  lock.lock();
+		  for (size_t idx = seg ; idx < end ; idx += 1)
+			ring.ready[idx%window] = false;
+		  ring.written = end;
+		  ring.cond.notify_all();
+		  seg = end;
+	    }
+
+	    for (unsigned idx = 0 ; idx < nthreads ; idx += 1)
+		  pool[idx].join();
+      }
 
 	/* EOF Marker */
-      fprintf(fd, ":00000001FF\n");
+      out.write(":00000001FF\n", 12);
+
+      const size_t address = max(start_address, vec.size());
+      const double secs = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+      const double mbytes = (address - start_address) / (1024.0*1024.0);
+
+	/* The target device must be big enough to hold the whole
+	   image, even if the tail of it was left out as blank. */
+      if (opt.log) {
+	    fprintf(opt.log, "MCS target device size >= 0x%08zx\n", address);
+	    fprintf(opt.log, "MCS encoded %.1f MBytes in %.3f s (%.1f MB/s, %u threads)\n",
+		    mbytes, secs, secs > 0? mbytes/secs : 0.0, nthreads);
+      }
+}
+
+void write_to_mcs_file(FILE*fd, const std::vector<uint8_t>&vec, size_t start_address,
+		       const mcs_options_t&opt)
+{
+      mcs_file_sink out (fd);
+      write_to_mcs(out, vec, start_address, opt);
+}
+
+/*
+ * Split the image into the two nibble streams, and encode each. An
+ * odd last byte is paired with an erased (0xff) byte.
+ */
+void write_to_mcs_dual_qspi(mcs_sink&primary, mcs_sink&secondary,
+			    const std::vector<uint8_t>&vec, size_t start_address,
+			    const mcs_options_t&opt)
+{
+      assert(start_address % 2 == 0);
+
+      const size_t half = (vec.size() + 1) / 2;
+      vector<uint8_t> vec_primary (half);
+      vector<uint8_t> vec_secondary (half);
+      {
+	    metrics_phase phase ("dual qspi split", vec.size());
+	    const size_t even = vec.size() & ~(size_t)1;
+	    if (even > 0)
+		  bit_swizzle_dual_qspi(&vec_primary[0], &vec_secondary[0], &vec[0], even);
+	    if (even < vec.size()) {
+		  uint8_t tail[2] = { vec[even], 0xff };
+		  bit_swizzle_dual_qspi(&vec_primary[half-1], &vec_secondary[half-1], tail, 2);
+	    }
+      }
+
+      mcs_options_t part_opt = opt;
+      part_opt.swizzle = SWIZZLE_NONE;
+      write_to_mcs(primary, vec_primary, start_address/2, part_opt);
+
+	// Both parts are the same size, so only describe one.
+      part_opt.log = 0;
+      write_to_mcs(secondary, vec_secondary, start_address/2, part_opt);
+}
+
+/*
+ * Write the image as the raw bytes of the flash, in the byte layout of
+ * the options, a segment at a time.
+ */
+void write_to_bin(mcs_sink&out, const std::vector<uint8_t>&vec, size_t start_address,
+		  const mcs_options_t&opt)
+{
+      metrics_phase phase ("bin encode", vec.size());
+
+      assert(opt.swizzle != SWIZZLE_X16 || start_address % 2 == 0);
+      assert(opt.swizzle != SWIZZLE_X16 || vec.size() % 2 == 0);
+
+      vector<uint8_t> scratch;
+      for (size_t address = start_address ; address < vec.size() ; address += 0x10000) {
+	    const size_t seg_size = min(vec.size() - address, (size_t)0x10000);
+	    if (opt.swizzle == SWIZZLE_NONE) {
+		  out.write((const char*)&vec[address], seg_size);
+		  continue;
+	    }
+
+	    scratch.resize(seg_size);
+	    bit_swizzle(&scratch[0], &vec[address], seg_size, opt.swizzle);
+	    out.write((const char*)&scratch[0], seg_size);
+      }
+}
+
+bool parse_mcs_flag(mcs_options_t&opt, const char*flag)
+{
+      if (strcmp(flag,"--sparse-mcs") == 0) {
+	    opt.sparse = true;
+
+      } else if (strncmp(flag,"--mcs-record-length=",20) == 0) {
+	    opt.record_length = strtoul(flag+20, 0, 0);
+
+      } else if (strncmp(flag,"--mcs-threads=",14) == 0) {
+	    opt.threads = strtoul(flag+14, 0, 0);
+
+      } else {
+	    return false;
+      }
+
+      return true;
 }
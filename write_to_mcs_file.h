@@ -20,11 +20,141 @@
  *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+# include  "bit_swizzle.h"
 # include  <vector>
 # include  <cstdint>
 # include  <cstdio>
 
+/*
+ * Options that control the format of the .mcs stream.
+ */
+struct mcs_options_t {
+      mcs_options_t()
+      : record_length(16), sparse(false), threads(0), swizzle(SWIZZLE_NONE),
+	sector_size(0), log(stdout) { }
+
+	// Number of data bytes in each data record. 16, 32 or 64.
+      size_t record_length;
+	// Leave out data records that are all 0xff, and extended
+	// address records for segments that are all 0xff. This
+	// assumes the programmer erases the flash first.
+      bool sparse;
+	// Number of threads that encode segments. 0 means one per
+	// processor.
+      unsigned threads;
+	// Convert the image to this byte layout as it is written. The
+	// image itself is not changed.
+      swizzle_t swizzle;
+	// If sector_select is not empty, then only write the sectors
+	// (of sector_size bytes, numbered from address 0) that are
+	// selected. This is for writing updates to parts of a flash.
+      std::vector<bool> sector_select;
+      size_t sector_size;
+	// Print a summary of the stream here, or nowhere if nil.
+      FILE*log;
+};
+
+/*
+ * An mcs_sink receives the .mcs text in order, as it is encoded. The
+ * encoder passes a batch of buffers at a time to write_batch(), which
+ * by default calls write() for each of them, so that a sink can pass
+ * them on without first copying them together.
+ */
+class mcs_sink {
+
+    public:
+      virtual ~mcs_sink();
+
+      virtual void write(const char*text, size_t len) =0;
+      virtual void write_batch(const char*const*text, const size_t*len, size_t count);
+};
+
+/*
+ * This sink appends the text to a vector.
+ */
+class mcs_buffer_sink : public mcs_sink {
+
+    public:
+      explicit mcs_buffer_sink(std::vector<char>&dst);
+      ~mcs_buffer_sink();
+
+      void write(const char*text, size_t len);
+
+    private:
+      std::vector<char>&dst_;
+};
+
+/*
+ * This sink writes the text into a buffer that the caller provides.
+ * Text that does not fit is dropped, but still counted, so if the
+ * length() is more than the size, then the buffer was too small and
+ * length() is the size that is needed.
+ */
+class mcs_span_sink : public mcs_sink {
+
+    public:
+      mcs_span_sink(char*buf, size_t size);
+      ~mcs_span_sink();
+
+      void write(const char*text, size_t len);
 
-extern void write_to_mcs_file(FILE*fd, const std::vector<uint8_t>&vec, size_t skip_bytes =0);
+      size_t length() const { return length_; }
+      bool overflow() const { return length_ > size_; }
+
+    private:
+      char*buf_;
+      size_t size_;
+      size_t length_;
+};
+
+/*
+ * This sink writes the text to a file. Once the sink is made, write
+ * to the file only through the sink.
+ */
+class mcs_file_sink : public mcs_sink {
+
+    public:
+      explicit mcs_file_sink(FILE*fd);
+      ~mcs_file_sink();
+
+      void write(const char*text, size_t len);
+      void write_batch(const char*const*text, const size_t*len, size_t count);
+
+    private:
+      FILE*fd_;
+};
+
+/*
+ * Encode the image, starting at start_address, as an .mcs stream into
+ * the sink or file.
+ */
+extern void write_to_mcs(mcs_sink&out, const std::vector<uint8_t>&vec, size_t start_address =0,
+			 const mcs_options_t&opt =mcs_options_t());
+extern void write_to_mcs_file(FILE*fd, const std::vector<uint8_t>&vec, size_t skip_bytes =0,
+			      const mcs_options_t&opt =mcs_options_t());
+
+/*
+ * Encode the image for dual quad-SPI (x8 SPI) flash, as one .mcs
+ * stream for each of the two flash parts (see bit_swizzle_dual_qspi).
+ * Each part holds one nibble of every byte, so it holds half as many
+ * bytes, at half the addresses of the image. The start_address must
+ * be even. The swizzle of the options does not apply.
+ */
+extern void write_to_mcs_dual_qspi(mcs_sink&primary, mcs_sink&secondary,
+				   const std::vector<uint8_t>&vec, size_t start_address,
+				   const mcs_options_t&opt =mcs_options_t());
+
+/*
+ * Write the image, starting at start_address, as a binary image of the
+ * flash instead. Only the swizzle of the options applies.
+ */
+extern void write_to_bin(mcs_sink&out, const std::vector<uint8_t>&vec, size_t start_address =0,
+			 const mcs_options_t&opt =mcs_options_t());
+
+/*
+ * Interpret a command line flag that sets an .mcs option. Return
+ * false if the flag is not an .mcs option.
+ */
+extern bool parse_mcs_flag(mcs_options_t&opt, const char*flag);
 
 #endif